@@ -314,6 +314,13 @@ static void AllocateFlags() {
               &DebugOptions::set_xla_gpu_disable_ptxas_optimizations),
           flag_values->xla_gpu_disable_ptxas_optimizations(),
           "In XLA:GPU run ptxas in -O0 (default is -O3)."),
+      tensorflow::Flag(
+          "xla_persistent_cache_dir",
+          string_setter_for(&DebugOptions::set_xla_persistent_cache_dir),
+          flag_values->xla_persistent_cache_dir(),
+          "Directory in which compiled executables are stored, so that later "
+          "compilations of the same modules, also in other processes, load "
+          "them instead of compiling them again."),
 
       tensorflow::Flag(
           "xla_dump_to", string_setter_for(&DebugOptions::set_xla_dump_to),
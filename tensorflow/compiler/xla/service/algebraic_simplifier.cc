@@ -3884,15 +3884,15 @@ Status AlgebraicSimplifierVisitor::HandleMap(HloInstruction* map) {
 StatusOr<bool> AlgebraicSimplifier::Run(HloModule* module) {
   XLA_VLOG_LINES(2,
                  "AlgebraicSimplifier::Run(), before:\n" + module->ToString());
-  bool changed = false;
-  for (auto* comp : module->MakeNonfusionComputations()) {
-    if (AlgebraicSimplifierVisitor::Run(comp, options_, this)) {
-      changed = true;
-    }
-  }
+  TF_ASSIGN_OR_RETURN(bool changed, HloComputationPass::Run(module));
   XLA_VLOG_LINES(2,
                  "AlgebraicSimplifier::Run(), after:\n" + module->ToString());
   return changed;
 }
 
+StatusOr<bool> AlgebraicSimplifier::RunOnComputation(
+    HloComputation* computation) {
+  return AlgebraicSimplifierVisitor::Run(computation, options_, this);
+}
+
 }  // namespace xla
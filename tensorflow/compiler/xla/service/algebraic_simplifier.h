@@ -92,7 +92,7 @@ class AlgebraicSimplifierOptions {
 };
 
 // A pass which performs algebraic simplifications.
-class AlgebraicSimplifier : public HloModulePass {
+class AlgebraicSimplifier : public HloComputationPass {
  public:
   // If is_layout_sensitive is true, then the simplifier preserves layout during
   // transformation. Otherwise, layout is ignored.
@@ -101,8 +101,8 @@ class AlgebraicSimplifier : public HloModulePass {
   ~AlgebraicSimplifier() override = default;
   absl::string_view name() const override { return "algsimp"; }
 
-  // Run algebraic simplification on the given computation. Returns whether the
-  // computation was changed.
+  // Run algebraic simplification on the given module. Returns whether the
+  // module was changed.
   StatusOr<bool> Run(HloModule* module) override;
 
   // Create constant from literal with tiles and element size updated in the
@@ -114,6 +114,11 @@ class AlgebraicSimplifier : public HloModulePass {
     return constant;
   }
 
+ protected:
+  // Run algebraic simplification on the given computation. Returns whether the
+  // computation was changed.
+  StatusOr<bool> RunOnComputation(HloComputation* computation) override;
+
  private:
   AlgebraicSimplifierOptions options_;
 };
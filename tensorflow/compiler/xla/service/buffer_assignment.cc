@@ -1215,6 +1215,8 @@ Status BufferAssigner::AssignBuffersWithSequentialOrdering(
         absl::make_unique<LazyBestFitHeap>(alignment)));
     algorithms->push_back(
         absl::make_unique<GlobalDecreasingSizeBestFitHeap>(alignment));
+    algorithms->push_back(
+        absl::make_unique<GlobalMemoryPressureBestFitHeap>(alignment));
     return absl::make_unique<ChooseBestHeapAlgorithm>(std::move(algorithms));
   };
 
@@ -17,11 +17,22 @@ limitations under the License.
 
 #include <utility>
 
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/compiler/xla/xla.pb.h"
 #include "tensorflow/compiler/xla/xla_data.pb.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/raw_coding.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
+#include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/public/version.h"
 
 namespace xla {
 
@@ -35,6 +46,16 @@ int64 GetUniqueId() {
   return id;
 }
 
+// Goes into the keys of the persistent tier, so that changing how keys are
+// computed or files are laid out makes the old files unreachable.
+constexpr char kPersistentFormat[] = "xla_persistent_cache_v2";
+
+// The files of the persistent tier start with this magic, the size of the
+// serialized executable, as a fixed64, and its masked crc32c, as a fixed32.
+constexpr char kPersistentMagic[] = "XLAEXEC1";
+constexpr size_t kPersistentMagicSize = sizeof(kPersistentMagic) - 1;
+constexpr size_t kPersistentHeaderSize = kPersistentMagicSize + 8 + 4;
+
 }  // namespace
 
 ExecutionHandle CompilationCache::Insert(
@@ -67,4 +88,94 @@ StatusOr<std::shared_ptr<Executable>> CompilationCache::LookUp(
   }
 }
 
+/* static */ absl::optional<string> CompilationCache::PersistentKey(
+    const HloModule& module, absl::string_view platform_name) {
+  if (module.config().seed() != 0) {
+    return absl::nullopt;
+  }
+  // Where the executable is stored does not change it.
+  HloModuleConfig config = module.config();
+  DebugOptions debug_options = config.debug_options();
+  debug_options.clear_xla_persistent_cache_dir();
+  config.set_debug_options(debug_options);
+
+  // Instruction names and ids depend on what else the client built, so the
+  // module is printed in canonical form, with everything that changes what it
+  // computes. Executables compiled by another build of XLA may call runtime
+  // functions that this one does not have, so the build is part of the key.
+  HloPrintOptions print_options = HloPrintOptions::Canonical()
+                                      .set_print_large_constants(true)
+                                      .set_print_backend_config(true)
+                                      .set_print_control_dependencies(true);
+  const tensorflow::Fprint128 fingerprint =
+      tensorflow::Fingerprint128(absl::StrCat(
+          kPersistentFormat, "\n", tf_git_version(), "\n",
+          tf_compiler_version(), "\n", platform_name, "\n",
+          config.compilation_cache_key(), "\n",
+          module.input_output_alias_config().ToString(), "\n",
+          module.dynamic_parameter_binding().ToString(), "\n",
+          module.entry_computation()->ToString(print_options)));
+  return absl::StrFormat("%016x%016x", fingerprint.high64, fingerprint.low64);
+}
+
+StatusOr<string> CompilationCache::LookUpPersistent(const string& directory,
+                                                    const string& key) const {
+  tensorflow::Env* env = tensorflow::Env::Default();
+  const string path = tensorflow::io::JoinPath(directory, key);
+  if (!env->FileExists(path).ok()) {
+    return NotFound("no persistent executable for key %s", key);
+  }
+  string contents;
+  TF_RETURN_IF_ERROR(tensorflow::ReadFileToString(env, path, &contents));
+  if (contents.size() < kPersistentHeaderSize ||
+      absl::string_view(contents).substr(0, kPersistentMagicSize) !=
+          kPersistentMagic) {
+    return DataLoss("%s is not a persistent executable", path);
+  }
+  const uint64 size =
+      tensorflow::core::DecodeFixed64(contents.data() + kPersistentMagicSize);
+  const uint32 crc = tensorflow::crc32c::Unmask(tensorflow::core::DecodeFixed32(
+      contents.data() + kPersistentMagicSize + 8));
+  if (size != contents.size() - kPersistentHeaderSize) {
+    return DataLoss("persistent executable %s has %d bytes, expected %d", path,
+                    contents.size() - kPersistentHeaderSize, size);
+  }
+  if (tensorflow::crc32c::Value(contents.data() + kPersistentHeaderSize,
+                                size) != crc) {
+    return DataLoss("persistent executable %s fails its checksum", path);
+  }
+  VLOG(2) << "loaded persistent executable: " << path;
+  return contents.substr(kPersistentHeaderSize);
+}
+
+Status CompilationCache::InsertPersistent(const string& directory,
+                                          const string& key,
+                                          const string& serialized) {
+  tensorflow::Env* env = tensorflow::Env::Default();
+  TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(directory));
+  string contents(kPersistentMagic);
+  tensorflow::core::PutFixed64(&contents, serialized.size());
+  tensorflow::core::PutFixed32(
+      &contents, tensorflow::crc32c::Mask(tensorflow::crc32c::Value(
+                     serialized.data(), serialized.size())));
+  absl::StrAppend(&contents, serialized);
+
+  // Writes a file of its own and renames it over the key's, so that readers
+  // never see a partly written file.
+  const string path = tensorflow::io::JoinPath(directory, key);
+  string temp_path = absl::StrCat(path, ".tmp");
+  if (!env->CreateUniqueFileName(&temp_path, "")) {
+    return InternalError("could not create a temporary file name for %s",
+                         path);
+  }
+  TF_RETURN_IF_ERROR(tensorflow::WriteStringToFile(env, temp_path, contents));
+  Status status = env->RenameFile(temp_path, path);
+  if (!status.ok()) {
+    env->DeleteFile(temp_path).IgnoreError();
+    return status;
+  }
+  VLOG(2) << "stored persistent executable: " << path;
+  return Status::OK();
+}
+
 }  // namespace xla
@@ -21,7 +21,10 @@ limitations under the License.
 #include <string>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 #include "tensorflow/compiler/xla/service/executable.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/service/hlo_module_config.h"
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/core/platform/macros.h"
@@ -32,6 +35,13 @@ namespace xla {
 
 // A cache which stores Executables indexed by computation handle and version.
 //
+// Behind it is an optional persistent tier, which stores executables that
+// Compiler::SerializeExecutable serialized in the files of a directory, so
+// that later processes can load them instead of compiling them again. Each
+// file is named after a key that identifies the module and how it is
+// compiled, and records the size and checksum of the executable, so that
+// truncated or corrupt files are not loaded.
+//
 // TODO(b/119042872): Provide mechanism for removing computations from the
 // compilation cache.
 class CompilationCache {
@@ -45,6 +55,25 @@ class CompilationCache {
   StatusOr<std::shared_ptr<Executable>> LookUp(
       const ExecutionHandle& handle) const;
 
+  // Returns the key of the persistent tier for compiling 'module', with its
+  // config, for the platform named 'platform_name'. Returns nullopt if the
+  // executable must not be reused, as when the config asks for a fresh random
+  // seed.
+  static absl::optional<string> PersistentKey(const HloModule& module,
+                                              absl::string_view platform_name);
+
+  // Returns the serialized executable stored under 'key' in 'directory'.
+  // Returns NotFound if there is none, and DataLoss if the stored one is
+  // corrupt.
+  StatusOr<string> LookUpPersistent(const string& directory,
+                                    const string& key) const;
+
+  // Stores 'serialized' under 'key' in 'directory', creating the directory if
+  // needed. Replaces the file for 'key' at once, so that concurrent lookups,
+  // also from other processes, read either the old or the new one.
+  Status InsertPersistent(const string& directory, const string& key,
+                          const string& serialized);
+
  protected:
   mutable tensorflow::mutex mutex_;
 
@@ -0,0 +1,172 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/compilation_cache.h"
+
+#include <memory>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_module_config.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/compiler/xla/xla.pb.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace xla {
+namespace {
+
+class CompilationCacheTest : public HloTestBase {
+ protected:
+  // Returns a directory of its own for each test.
+  string CacheDir() {
+    return tensorflow::io::JoinPath(
+        tensorflow::testing::TmpDir(),
+        absl::StrCat(
+            ::testing::UnitTest::GetInstance()->current_test_info()->name(),
+            "_cache"));
+  }
+
+  // Returns the persistent key of the module in 'hlo_text', parsed with
+  // 'config'.
+  absl::optional<string> Key(const string& hlo_text,
+                             const HloModuleConfig& config,
+                             absl::string_view platform_name = "Host") {
+    std::unique_ptr<HloModule> module =
+        ParseAndReturnVerifiedModule(hlo_text, config).ValueOrDie();
+    return CompilationCache::PersistentKey(*module, platform_name);
+  }
+
+  CompilationCache cache_;
+};
+
+const char* const kModule = R"(
+  HloModule module
+
+  ENTRY main {
+    p0 = f32[4] parameter(0)
+    constant = f32[4] constant({1, 2, 3, 4})
+    ROOT add = f32[4] add(p0, constant)
+  }
+)";
+
+TEST_F(CompilationCacheTest, PersistentTierRoundTrips) {
+  const string dir = CacheDir();
+  const string serialized("serialized\0executable", 21);
+  TF_ASSERT_OK(cache_.InsertPersistent(dir, "key", serialized));
+  StatusOr<string> loaded = cache_.LookUpPersistent(dir, "key");
+  TF_ASSERT_OK(loaded.status());
+  EXPECT_EQ(loaded.ValueOrDie(), serialized);
+
+  // Inserting again replaces the executable.
+  TF_ASSERT_OK(cache_.InsertPersistent(dir, "key", "replaced"));
+  EXPECT_EQ(cache_.LookUpPersistent(dir, "key").ValueOrDie(), "replaced");
+}
+
+TEST_F(CompilationCacheTest, PersistentTierMissingKeyIsNotFound) {
+  const string dir = CacheDir();
+  TF_ASSERT_OK(cache_.InsertPersistent(dir, "key", "serialized"));
+  EXPECT_EQ(cache_.LookUpPersistent(dir, "other_key").status().code(),
+            tensorflow::error::NOT_FOUND);
+  EXPECT_EQ(cache_.LookUpPersistent(tensorflow::io::JoinPath(dir, "missing"),
+                                    "key")
+                .status()
+                .code(),
+            tensorflow::error::NOT_FOUND);
+}
+
+TEST_F(CompilationCacheTest, PersistentTierDetectsCorruptFiles) {
+  const string dir = CacheDir();
+  const string path = tensorflow::io::JoinPath(dir, "key");
+  tensorflow::Env* env = tensorflow::Env::Default();
+  TF_ASSERT_OK(cache_.InsertPersistent(dir, "key", "serialized executable"));
+  string contents;
+  TF_ASSERT_OK(tensorflow::ReadFileToString(env, path, &contents));
+
+  string flipped = contents;
+  flipped.back() ^= 1;
+  TF_ASSERT_OK(tensorflow::WriteStringToFile(env, path, flipped));
+  EXPECT_EQ(cache_.LookUpPersistent(dir, "key").status().code(),
+            tensorflow::error::DATA_LOSS);
+
+  TF_ASSERT_OK(tensorflow::WriteStringToFile(
+      env, path, contents.substr(0, contents.size() - 1)));
+  EXPECT_EQ(cache_.LookUpPersistent(dir, "key").status().code(),
+            tensorflow::error::DATA_LOSS);
+
+  TF_ASSERT_OK(tensorflow::WriteStringToFile(env, path, "XLA"));
+  EXPECT_EQ(cache_.LookUpPersistent(dir, "key").status().code(),
+            tensorflow::error::DATA_LOSS);
+}
+
+TEST_F(CompilationCacheTest, PersistentKeyIdentifiesModuleAndConfig) {
+  const HloModuleConfig config = GetModuleConfigForTest();
+  absl::optional<string> key = Key(kModule, config);
+  ASSERT_TRUE(key.has_value());
+  EXPECT_EQ(Key(kModule, config), key);
+
+  // The names of instructions do not matter, what the module computes does.
+  EXPECT_EQ(Key(R"(
+    HloModule renamed
+
+    ENTRY main {
+      x = f32[4] parameter(0)
+      y = f32[4] constant({1, 2, 3, 4})
+      ROOT z = f32[4] add(x, y)
+    }
+  )",
+                config),
+            key);
+  EXPECT_NE(Key(R"(
+    HloModule module
+
+    ENTRY main {
+      p0 = f32[4] parameter(0)
+      constant = f32[4] constant({1, 2, 3, 5})
+      ROOT add = f32[4] add(p0, constant)
+    }
+  )",
+                config),
+            key);
+
+  EXPECT_NE(Key(kModule, config, "CUDA"), key);
+
+  HloModuleConfig other_config = config;
+  DebugOptions debug_options = config.debug_options();
+  debug_options.set_xla_cpu_enable_fast_math(
+      !debug_options.xla_cpu_enable_fast_math());
+  other_config.set_debug_options(debug_options);
+  EXPECT_NE(Key(kModule, other_config), key);
+
+  // Where the cache is does not change what is stored in it.
+  debug_options = config.debug_options();
+  debug_options.set_xla_persistent_cache_dir(CacheDir());
+  other_config.set_debug_options(debug_options);
+  EXPECT_EQ(Key(kModule, other_config), key);
+}
+
+TEST_F(CompilationCacheTest, NoPersistentKeyForRandomSeeds) {
+  HloModuleConfig config = GetModuleConfigForTest();
+  config.set_seed(42);
+  EXPECT_FALSE(Key(kModule, config).has_value());
+}
+
+}  // namespace
+}  // namespace xla
@@ -56,6 +56,18 @@ Compiler::CompileAheadOfTime(
   return CompileAheadOfTime(std::move(module_group), options);
 }
 
+StatusOr<string> Compiler::SerializeExecutable(const Executable& executable) {
+  return Unimplemented("Serializing executables is not implemented on this "
+                       "compiler.");
+}
+
+StatusOr<std::unique_ptr<Executable>> Compiler::DeserializeExecutable(
+    const string& serialized, const HloModuleConfig& config,
+    se::StreamExecutor* executor) {
+  return Unimplemented("Deserializing executables is not implemented on "
+                       "this compiler.");
+}
+
 /* static */ std::map<se::Platform::Id, Compiler::CompilerFactory>*
 Compiler::GetPlatformCompilerFactories() {
   static auto* r = new std::map<se::Platform::Id, CompilerFactory>;
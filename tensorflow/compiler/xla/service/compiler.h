@@ -226,6 +226,20 @@ class Compiler {
                      const AotCompilationOptions& options,
                      std::unique_ptr<AotCompilationMetadata>* metadata);
 
+  // Serializes 'executable', which this compiler built, so that
+  // DeserializeExecutable can load it in another process on the same kind of
+  // device. Returns Unimplemented if the compiler does not support it, or if
+  // 'executable' was not built with config().debug_options()
+  // .xla_persistent_cache_dir() set.
+  virtual StatusOr<string> SerializeExecutable(const Executable& executable);
+
+  // Loads an executable that SerializeExecutable serialized, for the module it
+  // was built from compiled with 'config'. Returns an error if 'serialized'
+  // can't run on the device of 'executor'.
+  virtual StatusOr<std::unique_ptr<Executable>> DeserializeExecutable(
+      const string& serialized, const HloModuleConfig& config,
+      se::StreamExecutor* executor);
+
   /////
   // The Compiler class also serves as a point to register compiler objects
   // for the various platforms.
@@ -0,0 +1,249 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/attention_rewriter.h"
+
+#include <limits>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/layout_util.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_runtime.h"
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// The operands of an attention that AttentionRewriter rewrites.
+struct Attention {
+  HloInstruction* q;
+  HloInstruction* k;
+  HloInstruction* v;
+  float scale;
+};
+
+// Returns the dimensions [0, n).
+std::vector<int64> Iota(int64 n) {
+  std::vector<int64> dimensions(n);
+  absl::c_iota(dimensions, 0);
+  return dimensions;
+}
+
+// Returns true if 'computation' applies 'opcode' to its two scalar parameters.
+bool IsScalarBinaryComputation(const HloComputation* computation,
+                               HloOpcode opcode) {
+  const HloInstruction* root = computation->root_instruction();
+  return computation->num_parameters() == 2 &&
+         computation->instruction_count() == 3 && root->opcode() == opcode &&
+         ShapeUtil::IsScalar(root->shape()) &&
+         root->operand(0)->opcode() == HloOpcode::kParameter &&
+         root->operand(1)->opcode() == HloOpcode::kParameter &&
+         root->operand(0) != root->operand(1);
+}
+
+// Returns true if 'instruction' is an f32 scalar constant, whose value it sets
+// '*value' to.
+bool IsF32ScalarConstant(const HloInstruction* instruction, float* value) {
+  if (instruction->opcode() != HloOpcode::kConstant ||
+      !ShapeUtil::IsScalarWithElementType(instruction->shape(), F32)) {
+    return false;
+  }
+  *value = instruction->literal().GetFirstElement<float>();
+  return true;
+}
+
+// Returns true if 'reduce' reduces the last dimension of 'input' with
+// 'opcode', starting from a constant, whose value it sets '*init' to.
+bool IsRowReduce(const HloInstruction* reduce, const HloInstruction* input,
+                 HloOpcode opcode, float* init) {
+  return reduce->opcode() == HloOpcode::kReduce &&
+         reduce->operand_count() == 2 && reduce->operand(0) == input &&
+         reduce->dimensions() ==
+             std::vector<int64>{input->shape().rank() - 1} &&
+         IsScalarBinaryComputation(reduce->to_apply(), opcode) &&
+         IsF32ScalarConstant(reduce->operand(1), init);
+}
+
+// Returns the operand of 'broadcast' if it broadcasts a row reduction back
+// over the last dimension of a shape of rank 'rank', or nullptr.
+const HloInstruction* RowBroadcastOperand(const HloInstruction* broadcast,
+                                          int64 rank) {
+  if (broadcast->opcode() != HloOpcode::kBroadcast ||
+      broadcast->dimensions() != Iota(rank - 1)) {
+    return nullptr;
+  }
+  return broadcast->operand(0);
+}
+
+// Returns true if 'dot' is an f32 batched matrix product whose batch
+// dimensions are the leading dimensions of its operands and result, and that
+// contracts dimension 'lhs_contracting' of its lhs with 'rhs_contracting' of
+// its rhs.
+bool IsBatchMatMul(const HloInstruction* dot, int64 lhs_contracting,
+                   int64 rhs_contracting) {
+  if (dot->opcode() != HloOpcode::kDot ||
+      dot->shape().element_type() != F32 ||
+      dot->operand(0)->shape().element_type() != F32 ||
+      dot->operand(1)->shape().element_type() != F32) {
+    return false;
+  }
+  const int64 rank = dot->shape().rank();
+  if (rank < 2 || dot->operand(0)->shape().rank() != rank ||
+      dot->operand(1)->shape().rank() != rank) {
+    return false;
+  }
+  const std::vector<int64> batch_dimensions = Iota(rank - 2);
+  const DotDimensionNumbers& dnums = dot->dot_dimension_numbers();
+  return absl::c_equal(dnums.lhs_batch_dimensions(), batch_dimensions) &&
+         absl::c_equal(dnums.rhs_batch_dimensions(), batch_dimensions) &&
+         dnums.lhs_contracting_dimensions_size() == 1 &&
+         dnums.lhs_contracting_dimensions(0) == lhs_contracting &&
+         dnums.rhs_contracting_dimensions_size() == 1 &&
+         dnums.rhs_contracting_dimensions(0) == rhs_contracting;
+}
+
+// Returns the attention that 'out' computes, if it computes one.
+absl::optional<Attention> MatchAttention(HloInstruction* out) {
+  // Only arrays have a rank.
+  if (out->opcode() != HloOpcode::kDot || !out->shape().IsArray()) {
+    return absl::nullopt;
+  }
+  const int64 rank = out->shape().rank();
+  if (!IsBatchMatMul(out, rank - 1, rank - 2)) {
+    return absl::nullopt;
+  }
+
+  // probs = divide(exp, broadcast(reduce(exp, 0), to_apply=add))
+  const HloInstruction* probs = out->operand(0);
+  if (probs->opcode() != HloOpcode::kDivide || probs->user_count() != 1) {
+    return absl::nullopt;
+  }
+  const HloInstruction* exp = probs->operand(0);
+  const HloInstruction* sum = RowBroadcastOperand(probs->operand(1), rank);
+  float init;
+  if (exp->opcode() != HloOpcode::kExp || sum == nullptr ||
+      !IsRowReduce(sum, exp, HloOpcode::kAdd, &init) || init != 0) {
+    return absl::nullopt;
+  }
+
+  // exp = exponential(subtract(scores, broadcast(reduce(scores, -inf),
+  //                                              to_apply=maximum)))
+  const HloInstruction* shifted = exp->operand(0);
+  if (shifted->opcode() != HloOpcode::kSubtract) {
+    return absl::nullopt;
+  }
+  HloInstruction* scores = shifted->mutable_operand(0);
+  const HloInstruction* max = RowBroadcastOperand(shifted->operand(1), rank);
+  if (max == nullptr ||
+      !IsRowReduce(max, scores, HloOpcode::kMaximum, &init) ||
+      (init != -std::numeric_limits<float>::infinity() &&
+       init != std::numeric_limits<float>::lowest())) {
+    return absl::nullopt;
+  }
+
+  // scores = dot(q, k), optionally multiplied or divided by a broadcast scalar
+  // constant.
+  float scale = 1;
+  HloInstruction* qk = scores;
+  if (scores->opcode() == HloOpcode::kMultiply ||
+      scores->opcode() == HloOpcode::kDivide) {
+    const bool is_divide = scores->opcode() == HloOpcode::kDivide;
+    for (int64 i = 1; i >= (is_divide ? 1 : 0); --i) {
+      const HloInstruction* broadcast = scores->operand(i);
+      float value;
+      if (broadcast->opcode() == HloOpcode::kBroadcast &&
+          IsF32ScalarConstant(broadcast->operand(0), &value)) {
+        scale = is_divide ? 1 / value : value;
+        qk = scores->mutable_operand(1 - i);
+        break;
+      }
+    }
+    if (qk == scores) {
+      return absl::nullopt;
+    }
+  }
+  if (!IsBatchMatMul(qk, rank - 1, rank - 1)) {
+    return absl::nullopt;
+  }
+  return Attention{qk->mutable_operand(0), qk->mutable_operand(1),
+                   out->mutable_operand(1), scale};
+}
+
+// Replaces 'out' by a call to the fused attention runtime function.
+Status RewriteAttention(HloInstruction* out, const Attention& attention) {
+  VLOG(2) << "Rewriting attention " << out->ToString();
+  HloComputation* computation = out->parent();
+  const int64 rank = out->shape().rank();
+  int64 batch = 1;
+  for (int64 i = 0; i < rank - 2; ++i) {
+    batch *= out->shape().dimensions(i);
+  }
+  const std::vector<int64> dimensions = {
+      batch, attention.q->shape().dimensions(rank - 2),
+      attention.k->shape().dimensions(rank - 2),
+      attention.q->shape().dimensions(rank - 1),
+      attention.v->shape().dimensions(rank - 1)};
+  HloInstruction* dimensions_constant =
+      computation->AddInstruction(HloInstruction::CreateConstant(
+          LiteralUtil::CreateR1<int64>(dimensions)));
+  HloInstruction* scale_constant = computation->AddInstruction(
+      HloInstruction::CreateConstant(LiteralUtil::CreateR0(attention.scale)));
+
+  // The runtime function reads its operands, and writes its result, in the
+  // default row-major layout.
+  const std::vector<HloInstruction*> operands = {
+      attention.q, attention.k, attention.v, dimensions_constant,
+      scale_constant};
+  std::vector<Shape> operand_shapes_with_layout;
+  for (const HloInstruction* operand : operands) {
+    operand_shapes_with_layout.push_back(
+        LayoutUtil::GetWithDefaultLayout(operand->shape()));
+  }
+  HloInstruction* custom_call =
+      computation->AddInstruction(HloInstruction::CreateCustomCall(
+          LayoutUtil::GetWithDefaultLayout(out->shape()), operands,
+          runtime::kFusedAttentionF32SymbolName, operand_shapes_with_layout));
+  return computation->ReplaceInstruction(out, custom_call);
+}
+
+}  // namespace
+
+StatusOr<bool> AttentionRewriter::Run(HloModule* module) {
+  bool changed = false;
+  for (HloComputation* computation : module->MakeNonfusionComputations()) {
+    // Rewriting an attention only removes instructions it depends on, which
+    // come before it in post order.
+    for (HloInstruction* instruction :
+         computation->MakeInstructionPostOrder()) {
+      absl::optional<Attention> attention = MatchAttention(instruction);
+      if (attention.has_value()) {
+        TF_RETURN_IF_ERROR(RewriteAttention(instruction, *attention));
+        changed = true;
+      }
+    }
+  }
+  return changed;
+}
+
+}  // namespace cpu
+}  // namespace xla
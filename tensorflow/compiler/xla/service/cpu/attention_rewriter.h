@@ -0,0 +1,55 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_ATTENTION_REWRITER_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_ATTENTION_REWRITER_H_
+
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+
+namespace xla {
+namespace cpu {
+
+// AttentionRewriter replaces attention, written as a batched dot of the
+// softmax of a batched dot,
+//
+//   scores = f32[B..., Sq, Sk] dot(q, k), contracting the last dimensions of
+//            both, and optionally multiplied or divided by a scalar constant
+//   max = reduce(scores, -inf), dimensions={last}, to_apply=maximum
+//   exp = exponential(subtract(scores, broadcast(max)))
+//   sum = reduce(exp, 0), dimensions={last}, to_apply=add
+//   probs = divide(exp, broadcast(sum))
+//   out = f32[B..., Sq, Dv] dot(probs, v), contracting the last dimension
+//         of probs with the second to last of v
+//
+// with the leading dimensions being batch dimensions of both dots, by a
+// custom call to the __xla_cpu_runtime_FusedAttentionF32 runtime function,
+// which computes it without materializing the scores. The rewrite is skipped
+// if something else uses the probabilities.
+//
+// Runs before dot decomposition, on the dots as the client wrote them.
+class AttentionRewriter : public HloModulePass {
+ public:
+  ~AttentionRewriter() override {}
+
+  absl::string_view name() const override { return "cpu-attention-rewriter"; }
+
+  StatusOr<bool> Run(HloModule* module) override;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_ATTENTION_REWRITER_H_
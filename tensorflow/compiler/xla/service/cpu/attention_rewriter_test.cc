@@ -0,0 +1,172 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/attention_rewriter.h"
+
+#include "absl/strings/str_replace.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_runtime.h"
+#include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
+#include "tensorflow/compiler/xla/service/hlo_instructions.h"
+#include "tensorflow/compiler/xla/service/hlo_matchers.h"
+#include "tensorflow/compiler/xla/test.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace xla {
+namespace {
+
+namespace op = xla::testing::opcode_matchers;
+
+class AttentionRewriterTest : public HloTestBase {
+ protected:
+  // Returns a module computing attention, with 'scores' computed from the dot
+  // of the queries and keys 'qk', 'lowest' starting the row maximum, and 'root'
+  // using the attention 'out' or the probabilities 'probs'.
+  string AttentionModule(const string& scores, const string& lowest,
+                         const string& root) {
+    return absl::StrReplaceAll(R"(
+      HloModule attention
+
+      max {
+        lhs = f32[] parameter(0)
+        rhs = f32[] parameter(1)
+        ROOT max = f32[] maximum(lhs, rhs)
+      }
+
+      add {
+        lhs = f32[] parameter(0)
+        rhs = f32[] parameter(1)
+        ROOT add = f32[] add(lhs, rhs)
+      }
+
+      ENTRY main {
+        q = f32[2,4,16,8] parameter(0)
+        k = f32[2,4,32,8] parameter(1)
+        v = f32[2,4,32,6] parameter(2)
+        qk = f32[2,4,16,32] dot(q, k), lhs_batch_dims={0,1},
+          rhs_batch_dims={0,1}, lhs_contracting_dims={3},
+          rhs_contracting_dims={3}
+        c = f32[] constant(0.125)
+        scale = f32[2,4,16,32] broadcast(c), dimensions={}
+        scores = f32[2,4,16,32] $scores
+        lowest = f32[] constant($lowest)
+        row_max = f32[2,4,16] reduce(scores, lowest), dimensions={3},
+          to_apply=max
+        row_max.broadcast = f32[2,4,16,32] broadcast(row_max),
+          dimensions={0,1,2}
+        shifted = f32[2,4,16,32] subtract(scores, row_max.broadcast)
+        exp = f32[2,4,16,32] exponential(shifted)
+        zero = f32[] constant(0)
+        row_sum = f32[2,4,16] reduce(exp, zero), dimensions={3},
+          to_apply=add
+        row_sum.broadcast = f32[2,4,16,32] broadcast(row_sum),
+          dimensions={0,1,2}
+        probs = f32[2,4,16,32] divide(exp, row_sum.broadcast)
+        out = f32[2,4,16,6] dot(probs, v), lhs_batch_dims={0,1},
+          rhs_batch_dims={0,1}, lhs_contracting_dims={3},
+          rhs_contracting_dims={2}
+        ROOT root = $root
+      }
+    )",
+                               {{"$scores", scores},
+                                {"$lowest", lowest},
+                                {"$root", root}});
+  }
+
+  // Rewrites 'hlo_text' into '*module', and returns whether that changed it.
+  bool Rewrite(const string& hlo_text, std::unique_ptr<HloModule>* module) {
+    *module = ParseAndReturnVerifiedModule(hlo_text).ValueOrDie();
+    return cpu::AttentionRewriter().Run(module->get()).ValueOrDie();
+  }
+};
+
+const char* const kNegateOut = "f32[2,4,16,6] negate(out)";
+
+TEST_F(AttentionRewriterTest, RewritesScaledAttention) {
+  std::unique_ptr<HloModule> module;
+  ASSERT_TRUE(Rewrite(
+      AttentionModule("multiply(qk, scale)", "-inf", kNegateOut), &module));
+
+  const HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root, op::Negate(op::CustomCall(
+                        cpu::runtime::kFusedAttentionF32SymbolName,
+                        op::Parameter(0), op::Parameter(1), op::Parameter(2),
+                        op::Constant(), op::Constant())));
+  const HloInstruction* custom_call = root->operand(0);
+  EXPECT_TRUE(
+      Cast<HloCustomCallInstruction>(custom_call)->layout_constrained());
+  EXPECT_EQ(custom_call->operand(3)->literal(),
+            LiteralUtil::CreateR1<int64>({8, 16, 32, 8, 6}));
+  EXPECT_EQ(custom_call->operand(4)->literal(),
+            LiteralUtil::CreateR0<float>(0.125));
+  // The scores and the softmax are gone.
+  EXPECT_EQ(module->entry_computation()->instruction_count(), 7);
+}
+
+TEST_F(AttentionRewriterTest, RewritesOtherScalings) {
+  std::unique_ptr<HloModule> module;
+  ASSERT_TRUE(Rewrite(
+      AttentionModule("divide(qk, scale)", "-inf", kNegateOut), &module));
+  EXPECT_EQ(module->entry_computation()
+                ->root_instruction()
+                ->operand(0)
+                ->operand(4)
+                ->literal(),
+            LiteralUtil::CreateR0<float>(8));
+
+  EXPECT_TRUE(Rewrite(
+      AttentionModule("multiply(scale, qk)", "-inf", kNegateOut), &module));
+  EXPECT_TRUE(Rewrite(
+      AttentionModule("multiply(qk, scale)", "-3.40282347e+38", kNegateOut),
+      &module));
+}
+
+TEST_F(AttentionRewriterTest, KeepsOtherComputations) {
+  std::unique_ptr<HloModule> module;
+  // Not a scaling.
+  EXPECT_FALSE(Rewrite(AttentionModule("add(qk, scale)", "-inf", kNegateOut),
+                       &module));
+  // Not a maximum of the scores.
+  EXPECT_FALSE(Rewrite(
+      AttentionModule("multiply(qk, scale)", "0", kNegateOut), &module));
+  // Rewriting would not save materializing the probabilities.
+  EXPECT_FALSE(Rewrite(
+      AttentionModule("multiply(qk, scale)", "-inf",
+                      "(f32[2,4,16,6], f32[2,4,16,32]) tuple(out, probs)"),
+      &module));
+}
+
+TEST_F(AttentionRewriterTest, KeepsOtherDots) {
+  std::unique_ptr<HloModule> module;
+  EXPECT_FALSE(Rewrite(R"(
+    HloModule other_dots
+
+    ENTRY main {
+      x = f32[8] parameter(0)
+      y = f32[8] parameter(1)
+      m = f32[4,8] parameter(2)
+      scalar = f32[] dot(x, y), lhs_contracting_dims={0},
+        rhs_contracting_dims={0}
+      vector = f32[4] dot(m, y), lhs_contracting_dims={1},
+        rhs_contracting_dims={0}
+      ROOT tuple = (f32[], f32[4]) tuple(scalar, vector)
+    }
+  )",
+                       &module));
+}
+
+}  // namespace
+}  // namespace xla
@@ -29,6 +29,7 @@ limitations under the License.
 // IWYU pragma: no_include "llvm/Config/Targets.def.inc"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/strip.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/IR/Function.h"
@@ -38,6 +39,7 @@ limitations under the License.
 #include "llvm/IR/Verifier.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Target/TargetMachine.h"
@@ -56,17 +58,21 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/conditional_simplifier.h"
 #include "tensorflow/compiler/xla/service/conditional_to_select.h"
 #include "tensorflow/compiler/xla/service/convolution_group_converter.h"
+#include "tensorflow/compiler/xla/service/cpu/attention_rewriter.h"
 #include "tensorflow/compiler/xla/service/cpu/buffer_info_util.h"
 #include "tensorflow/compiler/xla/service/cpu/compiler_functor.h"
 #include "tensorflow/compiler/xla/service/cpu/conv_canonicalization.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_copy_insertion.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_executable.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_executable.pb.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_hlo_support_checker.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_instruction_fusion.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_layout_assignment.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_options.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_runtime.h"
 #include "tensorflow/compiler/xla/service/cpu/disassembler.h"
 #include "tensorflow/compiler/xla/service/cpu/dot_op_emitter.h"
+#include "tensorflow/compiler/xla/service/cpu/inter_op_parallelizer.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_emitter.h"
 #include "tensorflow/compiler/xla/service/cpu/parallel_task_assignment.h"
@@ -112,7 +118,11 @@ limitations under the License.
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/compiler/xla/xla_data.pb.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/dynamic_annotations.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/public/version.h"
 
 namespace xla {
 namespace cpu {
@@ -250,8 +260,12 @@ class CollectProfileCandidates : public DfsHloVisitorWithDefault {
 
 Status CpuCompiler::RunHloPassesThroughLayoutAssn(
     HloModule* module, bool /*is_aot_compile*/,
-    LLVMTargetMachineFeatures* target_machine_features) {
+    LLVMTargetMachineFeatures* target_machine_features,
+    tensorflow::thread::ThreadPool* thread_pool) {
   HloPassPipeline pipeline("HLO passes through layout assignment");
+  if (thread_pool != nullptr) {
+    pipeline.set_thread_pool(thread_pool);
+  }
   pipeline.AddInvariantChecker<HloVerifier>(/*layout_sensitive=*/false,
                                             /*allow_mixed_precision=*/false);
 
@@ -275,6 +289,9 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
   // TODO(b/65775800): Fix wrong output bug in Call and remove the CallInliner
   // pass.
   pipeline.AddPass<CallInliner>();
+  if (options::FusedAttentionEnabled(module->config())) {
+    pipeline.AddPass<AttentionRewriter>();
+  }
   pipeline.AddPass<BatchDotSimplification>();
   pipeline.AddPass<DotDecomposer>();
   // After canonicalization, there may be more batch dots that can be
@@ -350,8 +367,12 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
 
 Status CpuCompiler::RunHloPassesAfterLayoutAssn(
     HloModule* module, bool is_aot_compile,
-    LLVMTargetMachineFeatures* target_machine_features) {
+    LLVMTargetMachineFeatures* target_machine_features,
+    tensorflow::thread::ThreadPool* thread_pool) {
   HloPassPipeline pipeline("HLO passes after layout assignment");
+  if (thread_pool != nullptr) {
+    pipeline.set_thread_pool(thread_pool);
+  }
   // After layout assignment, use a layout-sensitive verifier.
   auto& after_layout_assn =
       pipeline.AddPass<HloPassPipeline>("after layout assignment");
@@ -389,6 +410,10 @@ Status CpuCompiler::RunHloPassesAfterLayoutAssn(
     // and thread synchronization dependencies which would likely increase
     // binary size (and most AOT applications are single-threaded).
     // TODO(b/29630486) Support multi-threaded AOT.
+    if (options::InterOpParallelismEnabled(module->config())) {
+      pipeline.AddPass<InterOpParallelizer>(max_parallelism,
+                                            ShapeSizeBytesFunction());
+    }
     pipeline.AddPass<ParallelTaskAssigner>(
         max_parallelism, ShapeSizeBytesFunction(), target_machine_features);
   }
@@ -408,14 +433,27 @@ Status CpuCompiler::RunHloPassesAfterLayoutAssn(
 Status CpuCompiler::RunHloPasses(HloModule* module, bool is_aot_compile,
                                  llvm::TargetMachine* target_machine) {
   LLVMTargetMachineFeatures target_machine_features(target_machine);
-  TF_RETURN_IF_ERROR(RunHloPassesThroughLayoutAssn(module, is_aot_compile,
-                                                   &target_machine_features));
+  // Run passes on independent computations in parallel, if requested.
+  std::unique_ptr<tensorflow::thread::ThreadPool> thread_pool;
+  if (absl::optional<int64> num_threads =
+          options::ParallelHloPassThreads(module->config())) {
+    thread_pool = absl::make_unique<tensorflow::thread::ThreadPool>(
+        tensorflow::Env::Default(), "xla_cpu_hlo_passes",
+        *num_threads > 0 ? *num_threads
+                         : tensorflow::port::NumSchedulableCPUs());
+  }
+  TF_RETURN_IF_ERROR(RunHloPassesThroughLayoutAssn(
+      module, is_aot_compile, &target_machine_features, thread_pool.get()));
   return RunHloPassesAfterLayoutAssn(module, is_aot_compile,
-                                     &target_machine_features);
+                                     &target_machine_features,
+                                     thread_pool.get());
 }
 
 namespace {
 
+// The name of the LLVM module that the JIT compiles.
+const char* const kComputeModuleName = "__compute_module";
+
 // Align buffers to 16-byte boundaries.
 constexpr int64 kMemoryAlignment = 16;
 auto memory_alignment = [](LogicalBuffer::Color) { return kMemoryAlignment; };
@@ -473,7 +511,12 @@ std::pair<LLVMCompiler::ModuleHook, LLVMCompiler::ModuleHook> GetIRModuleHooks(
     if (user_hook) {
       user_hook(llvm_module);
     }
-    llvm_ir::DumpIrIfEnabled(*hlo_module_ptr, llvm_module, optimized);
+    // The partitions of a module that is compiled in parallel are named
+    // after it, with the partition number as a suffix.
+    llvm_ir::DumpIrIfEnabled(
+        *hlo_module_ptr, llvm_module, optimized,
+        absl::StripPrefix(llvm_module.getModuleIdentifier(),
+                          kComputeModuleName));
   };
   return {[hook](const llvm::Module& llvm_module) {
             return hook(/*optimized=*/false, llvm_module);
@@ -606,6 +649,16 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
   std::call_once(llvm_command_line_options_initialized,
                  &llvm_ir::InitializeLLVMCommandLineOptions, module->config());
 
+  // An executable that may be serialized is compiled from the module as
+  // DeserializeExecutable will load it, so that both order the instructions,
+  // and so assign buffers and profile indices, the same way.
+  const bool serializable =
+      !module->config().debug_options().xla_persistent_cache_dir().empty();
+  if (serializable) {
+    TF_ASSIGN_OR_RETURN(module, HloModule::CreateFromProto(module->ToProto(),
+                                                           module->config()));
+  }
+
   ModuleHook pre_optimization_ir_hook;
   ModuleHook post_optimization_ir_hook;
   std::tie(pre_optimization_ir_hook, post_optimization_ir_hook) =
@@ -615,7 +668,7 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
   // Compile must be thread-safe so create a new LLVM context for the module.
   auto llvm_context = absl::make_unique<llvm::LLVMContext>();
   auto llvm_module =
-      absl::make_unique<llvm::Module>("__compute_module", *llvm_context);
+      absl::make_unique<llvm::Module>(kComputeModuleName, *llvm_context);
 
   auto jit = absl::make_unique<SimpleOrcJIT>(
       CompilerTargetOptions(module->config()),
@@ -626,6 +679,7 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
       OrcJITPostCompilationHook::Create(module.get()));
   llvm_module->setDataLayout(jit->data_layout());
   llvm_module->setTargetTriple(jit->target_triple().getTriple());
+  jit->set_retain_object_files(serializable);
 
   HloComputation* entry_computation = module->entry_computation();
   std::unordered_map<const HloInstruction*, int64> instruction_to_profile_idx;
@@ -651,15 +705,12 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
   TF_ASSIGN_OR_RETURN(HloSchedule schedule,
                       ScheduleModule(module.get(), BufferSizeBytesFunction(),
                                      DFSMemoryScheduler));
+  if (serializable) {
+    TF_RETURN_IF_ERROR(module->set_schedule(schedule));
+  }
 
-  // Run buffer allocation on the HLO graph.
-  TF_ASSIGN_OR_RETURN(
-      std::unique_ptr<BufferAssignment> assignment,
-      BufferAssigner::Run(module.get(),
-                          absl::make_unique<SequentialHloOrdering>(schedule),
-                          BufferSizeBytesFunction(), memory_alignment,
-                          /*allow_input_output_aliasing=*/false,
-                          /*allocate_buffers_for_constants=*/true));
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<BufferAssignment> assignment,
+                      AssignBuffers(*module, schedule));
   DumpHloModuleIfEnabled(*module, *assignment, "after_optimizations");
 
   // Each computation is a single function.  Emit all embedded computations
@@ -717,8 +768,19 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
 
   TF_RETURN_IF_ERROR(VerifyLlvmModule(*llvm_module));
 
-  // JIT compile the LLVM IR module to in-memory machine code.
-  jit->AddModule(std::move(llvm_module));
+  // JIT compile the LLVM IR module to in-memory machine code, in parallel if
+  // requested.
+  if (absl::optional<int64> num_threads =
+          options::ParallelCodegenThreads(module->config())) {
+    tensorflow::thread::ThreadPool thread_pool(
+        tensorflow::Env::Default(), "xla_cpu_codegen",
+        *num_threads > 0 ? *num_threads
+                         : tensorflow::port::NumSchedulableCPUs());
+    jit->AddModuleInParallel(std::move(llvm_module), &thread_pool);
+  } else {
+    jit->AddModule(std::move(llvm_module));
+  }
+  std::vector<string> object_files = jit->TakeObjectFiles();
   cpu_executable.reset(new CpuExecutable(
       std::move(jit), std::move(assignment), std::move(module), function_name,
       std::move(hlo_profile_printer_data), std::move(hlo_profile_index_map)));
@@ -727,11 +789,148 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
     static_cast<CpuExecutable&>(*cpu_executable)
         .set_ir_module_string(ir_module_string);
   }
+  if (serializable) {
+    static_cast<CpuExecutable&>(*cpu_executable)
+        .set_object_files(std::move(object_files));
+  }
 
   VLOG(1) << "Compilation finished";
   return std::move(cpu_executable);
 }
 
+StatusOr<std::unique_ptr<BufferAssignment>> CpuCompiler::AssignBuffers(
+    const HloModule& module, const HloSchedule& schedule) {
+  // Run buffer allocation on the HLO graph. The ordering keeps the buffers of
+  // concurrent calls, if any, apart.
+  return BufferAssigner::Run(
+      &module, absl::make_unique<ConcurrentCallsHloOrdering>(schedule),
+      BufferSizeBytesFunction(), memory_alignment,
+      /*allow_input_output_aliasing=*/false,
+      /*allocate_buffers_for_constants=*/true);
+}
+
+StatusOr<string> CpuCompiler::SerializeExecutable(
+    const Executable& executable) {
+  const auto& cpu_executable = static_cast<const CpuExecutable&>(executable);
+  if (cpu_executable.object_files().empty() ||
+      !cpu_executable.module().has_schedule()) {
+    return Unimplemented(
+        "Executable for %s was not compiled with xla_persistent_cache_dir set",
+        cpu_executable.module().name());
+  }
+
+  CpuExecutableProto proto;
+  *proto.mutable_hlo_module() = cpu_executable.module().ToProto();
+  proto.set_buffer_assignment_fingerprint(tensorflow::Fingerprint64(
+      cpu_executable.buffer_assignment().ToProto().SerializeAsString()));
+  const llvm::TargetMachine& target_machine =
+      *cpu_executable.jit().target_machine();
+  proto.set_target_triple(target_machine.getTargetTriple().getTriple());
+  proto.set_target_cpu(target_machine.getTargetCPU().str());
+  proto.set_target_features(target_machine.getTargetFeatureString().str());
+  for (const string& object_file : cpu_executable.object_files()) {
+    proto.add_object_files(object_file);
+  }
+  proto.set_entry_function_name(cpu_executable.entry_function_name());
+  proto.set_build_version(tf_git_version());
+  proto.set_runtime_abi_version(runtime::kRuntimeAbiVersion);
+  if (cpu_executable.hlo_profiling_enabled()) {
+    *proto.mutable_hlo_profile_printer_data() =
+        cpu_executable.hlo_profile_printer_data();
+  }
+  return proto.SerializeAsString();
+}
+
+StatusOr<std::unique_ptr<Executable>> CpuCompiler::DeserializeExecutable(
+    const string& serialized, const HloModuleConfig& config,
+    se::StreamExecutor* stream_exec) {
+  TF_RET_CHECK(stream_exec != nullptr);
+  CpuExecutableProto proto;
+  if (!proto.ParseFromString(serialized)) {
+    return DataLoss("Failed to parse serialized CPU executable");
+  }
+  // The object files call runtime functions by name, and those of another
+  // build may take other arguments.
+  if (proto.build_version() != tf_git_version() ||
+      proto.runtime_abi_version() != runtime::kRuntimeAbiVersion) {
+    return FailedPrecondition(
+        "Executable was compiled by XLA %s with runtime ABI version %d, but "
+        "this is XLA %s with runtime ABI version %d",
+        proto.build_version(), proto.runtime_abi_version(), tf_git_version(),
+        runtime::kRuntimeAbiVersion);
+  }
+  std::call_once(llvm_command_line_options_initialized,
+                 &llvm_ir::InitializeLLVMCommandLineOptions, config);
+
+  // The object files may only be loaded for the target they were compiled for,
+  // which is the host's at the time.
+  auto jit = absl::make_unique<SimpleOrcJIT>(
+      CompilerTargetOptions(config), CodeGenOptLevel(config),
+      options::OptimizeForSizeRequested(config),
+      config.debug_options().xla_llvm_disable_expensive_passes(),
+      /*pre_optimization_hook=*/nullptr, /*post_optimization_hook=*/nullptr,
+      /*post_codegen_hook=*/nullptr);
+  const llvm::TargetMachine& target_machine = *jit->target_machine();
+  if (target_machine.getTargetTriple().getTriple() != proto.target_triple() ||
+      target_machine.getTargetCPU() != proto.target_cpu() ||
+      target_machine.getTargetFeatureString() != proto.target_features()) {
+    return FailedPrecondition(
+        "Executable was compiled for %s (%s), but the host is %s (%s)",
+        proto.target_triple(), proto.target_cpu(),
+        target_machine.getTargetTriple().getTriple(),
+        target_machine.getTargetCPU().str());
+  }
+
+  // The module keeps the layouts it was compiled with, which layout assignment
+  // may have chosen, so its entry computation layout comes from the proto.
+  TF_ASSIGN_OR_RETURN(HloModuleConfig module_config,
+                      HloModule::CreateModuleConfigFromProto(
+                          proto.hlo_module(), config.debug_options()));
+  HloModuleConfig executable_config = config;
+  *executable_config.mutable_entry_computation_layout() =
+      module_config.entry_computation_layout();
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<HloModule> module,
+      HloModule::CreateFromProto(proto.hlo_module(), executable_config));
+  TF_RET_CHECK(module->has_schedule());
+
+  // The object files address buffers by the allocations they were compiled
+  // against, so the recomputed assignment must match the original exactly.
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<BufferAssignment> assignment,
+                      AssignBuffers(*module, module->schedule()));
+  if (tensorflow::Fingerprint64(assignment->ToProto().SerializeAsString()) !=
+      proto.buffer_assignment_fingerprint()) {
+    return FailedPrecondition(
+        "Buffer assignment of %s differs from the one it was compiled with",
+        module->name());
+  }
+
+  for (const string& object_file : proto.object_files()) {
+    jit->AddObjectFile(llvm::MemoryBuffer::getMemBufferCopy(object_file));
+  }
+  if (!jit->FindCompiledSymbol(proto.entry_function_name())) {
+    return DataLoss("Serialized CPU executable has no entry function %s",
+                    proto.entry_function_name());
+  }
+
+  std::unique_ptr<HloProfileIndexMap> hlo_profile_index_map;
+  std::unique_ptr<HloProfilePrinterData> hlo_profile_printer_data;
+  if (module->config().hlo_profiling_enabled()) {
+    hlo_profile_index_map = absl::make_unique<HloProfileIndexMap>(*module);
+    hlo_profile_printer_data = absl::make_unique<HloProfilePrinterData>(
+        proto.hlo_profile_printer_data());
+  }
+
+  std::vector<string> object_files(proto.object_files().begin(),
+                                   proto.object_files().end());
+  auto cpu_executable = absl::make_unique<CpuExecutable>(
+      std::move(jit), std::move(assignment), std::move(module),
+      proto.entry_function_name(), std::move(hlo_profile_printer_data),
+      std::move(hlo_profile_index_map));
+  cpu_executable->set_object_files(std::move(object_files));
+  return std::unique_ptr<Executable>(std::move(cpu_executable));
+}
+
 StatusOr<std::vector<std::unique_ptr<AotCompilationResult>>>
 CpuCompiler::CompileAheadOfTime(std::unique_ptr<HloModuleGroup> module_group,
                                 const AotCompilationOptions& aot_options) {
@@ -21,11 +21,13 @@ limitations under the License.
 #include "absl/types/span.h"
 #include "llvm/Target/TargetMachine.h"
 #include "tensorflow/compiler/xla/cpu_function_runtime.h"
+#include "tensorflow/compiler/xla/service/buffer_assignment.h"
 #include "tensorflow/compiler/xla/service/cpu/target_machine_features.h"
 #include "tensorflow/compiler/xla/service/executable.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/service/llvm_compiler.h"
 #include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/stream_executor_no_cuda.h"
 
@@ -56,6 +58,16 @@ class CpuAotCompilationOptions : public AotCompilationOptions {
                            RelocationModel relocation_model);
   ~CpuAotCompilationOptions() override;
 
+  // Serializes the optimized module, its schedule and the object files the JIT
+  // compiled it to. The buffer assignment is recomputed on deserialization and
+  // checked against the original, and the object files are only loaded on a
+  // host with the same target.
+  StatusOr<string> SerializeExecutable(const Executable& executable) override;
+
+  StatusOr<std::unique_ptr<Executable>> DeserializeExecutable(
+      const string& serialized, const HloModuleConfig& config,
+      se::StreamExecutor* stream_exec) override;
+
   se::Platform::Id PlatformId() const override;
 
   // The triple used for compilation, similar to clang's -target flag.
@@ -156,15 +168,24 @@ class CpuCompiler : public LLVMCompiler {
   Status RunHloPasses(HloModule* module, bool is_aot_compile,
                       llvm::TargetMachine* target_machine);
 
-  // Runs HLO passes up to and including layout assignment.
+  // Runs HLO passes up to and including layout assignment. Passes that can
+  // run on computations in parallel do so on 'thread_pool', if not null.
   Status RunHloPassesThroughLayoutAssn(
       HloModule* module, bool /*is_aot_compile*/,
-      LLVMTargetMachineFeatures* target_machine_features);
+      LLVMTargetMachineFeatures* target_machine_features,
+      tensorflow::thread::ThreadPool* thread_pool);
 
-  // Runs HLO passes after layout assignment.
+  // Runs HLO passes after layout assignment. Passes that can run on
+  // computations in parallel do so on 'thread_pool', if not null.
   Status RunHloPassesAfterLayoutAssn(
       HloModule* module, bool is_aot_compile,
-      LLVMTargetMachineFeatures* target_machine_features);
+      LLVMTargetMachineFeatures* target_machine_features,
+      tensorflow::thread::ThreadPool* thread_pool);
+
+  // Assigns buffers to the scheduled 'module', the same way for compilation
+  // and deserialization.
+  StatusOr<std::unique_ptr<BufferAssignment>> AssignBuffers(
+      const HloModule& module, const HloSchedule& schedule);
 
   TF_DISALLOW_COPY_AND_ASSIGN(CpuCompiler);
 };
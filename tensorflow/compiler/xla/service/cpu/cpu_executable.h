@@ -71,6 +71,16 @@ class CpuExecutable : public Executable {
     ir_module_string_ = ir_module_string;
   }
 
+  // The object files the JIT compiled, if it was told to retain them; what
+  // CpuCompiler::SerializeExecutable stores.
+  const std::vector<string>& object_files() const { return object_files_; }
+
+  void set_object_files(std::vector<string> object_files) {
+    object_files_ = std::move(object_files);
+  }
+
+  const string& entry_function_name() const { return entry_function_name_; }
+
   static int64 ShapeSizeBytes(const Shape& shape);
 
   // Type of the computation function we expect in the JIT.
@@ -85,6 +95,8 @@ class CpuExecutable : public Executable {
 
   const BufferAssignment& buffer_assignment() const { return *assignment_; }
 
+  const SimpleOrcJIT& jit() const { return *jit_; }
+
  private:
   // This is for sharing the code between ExecuteOnStream and
   // ExecuteAsyncOnStream.
@@ -145,6 +157,8 @@ class CpuExecutable : public Executable {
   // positives.
   string ir_module_string_;
 
+  std::vector<string> object_files_;
+
   ComputeFunctionType compute_function_;
 
   // Entry function name for the computation.
@@ -18,6 +18,7 @@ limitations under the License.
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_split.h"
 #include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/platform/logging.h"
 
 namespace {
 
@@ -26,6 +27,11 @@ const char* const kLlvmIrDotTilingFactor = "xla_llvm_dot_tiling_factor";
 const char* const kXlaForceEnableExperimentalLlvmIrGemm =
     "xla_force_enable_experimental_llvm_ir_gemm";
 const char* const kLlvmIrGemmTileSize = "xla_llvm_ir_gemm_tile_size";
+const char* const kXlaCpuParallelTaskProfile = "xla_cpu_parallel_task_profile";
+const char* const kXlaCpuInterOpParallelism = "xla_cpu_inter_op_parallelism";
+const char* const kXlaCpuParallelHloPasses = "xla_cpu_parallel_hlo_passes";
+const char* const kXlaCpuParallelCodegen = "xla_cpu_parallel_codegen";
+const char* const kXlaCpuFusedAttention = "xla_cpu_fused_attention";
 
 }  // namespace
 
@@ -99,6 +105,59 @@ absl::optional<std::tuple<int64, int64, int64>> LlvmIrGemmTileSize(
                                          tile_size_n_in_vector_width);
 }
 
+absl::optional<string> ParallelTaskProfilePath(const HloModuleConfig& config) {
+  const auto& extra_options_map =
+      config.debug_options().xla_backend_extra_options();
+  auto it = extra_options_map.find(kXlaCpuParallelTaskProfile);
+  if (it == extra_options_map.end() || it->second.empty()) {
+    return absl::nullopt;
+  }
+  return it->second;
+}
+
+bool InterOpParallelismEnabled(const HloModuleConfig& config) {
+  const auto& extra_options_map =
+      config.debug_options().xla_backend_extra_options();
+  return extra_options_map.count(kXlaCpuInterOpParallelism) > 0;
+}
+
+// Returns the number of threads that the option 'name' asks for, 0 for one
+// per core if its value is empty, or nullopt if it is not set. An invalid
+// value is ignored with a warning, so that a typo does not use every core.
+static absl::optional<int64> NumThreadsOption(const HloModuleConfig& config,
+                                              const char* name) {
+  const auto& extra_options_map =
+      config.debug_options().xla_backend_extra_options();
+  auto it = extra_options_map.find(name);
+  if (it == extra_options_map.end()) {
+    return absl::nullopt;
+  }
+  if (it->second.empty()) {
+    return 0;
+  }
+  int64 num_threads;
+  if (!absl::SimpleAtoi(it->second, &num_threads) || num_threads < 0) {
+    LOG(WARNING) << "Ignoring invalid number of threads \"" << it->second
+                 << "\" for " << name;
+    return absl::nullopt;
+  }
+  return num_threads;
+}
+
+absl::optional<int64> ParallelHloPassThreads(const HloModuleConfig& config) {
+  return NumThreadsOption(config, kXlaCpuParallelHloPasses);
+}
+
+absl::optional<int64> ParallelCodegenThreads(const HloModuleConfig& config) {
+  return NumThreadsOption(config, kXlaCpuParallelCodegen);
+}
+
+bool FusedAttentionEnabled(const HloModuleConfig& config) {
+  const auto& extra_options_map =
+      config.debug_options().xla_backend_extra_options();
+  return extra_options_map.count(kXlaCpuFusedAttention) > 0;
+}
+
 }  // namespace options
 }  // namespace cpu
 }  // namespace xla
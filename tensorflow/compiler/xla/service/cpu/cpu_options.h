@@ -30,6 +30,23 @@ bool ForceEnableExperimentalLlvmIrGemm(const HloModuleConfig& config);
 absl::optional<int64> LlvmIrGemvTilingFactor(const HloModuleConfig& config);
 absl::optional<std::tuple<int64, int64, int64>> LlvmIrGemmTileSize(
     const HloModuleConfig& config);
+// Returns the path of a serialized HloExecutionProfileData of a previous run
+// of the module, used to choose parallel task counts, if one is configured.
+absl::optional<string> ParallelTaskProfilePath(const HloModuleConfig& config);
+// Returns true if independent parts of the entry computation should run
+// concurrently on the intra-op thread pool (see inter_op_parallelizer.h).
+bool InterOpParallelismEnabled(const HloModuleConfig& config);
+// Returns the number of threads to run HLO passes on in parallel across
+// computations, or 0 for one per core, if that is enabled. Passes run
+// sequentially if the number of threads is invalid.
+absl::optional<int64> ParallelHloPassThreads(const HloModuleConfig& config);
+// Returns the number of threads to split the LLVM module over and compile it
+// on (see llvm_module_splitter.h), or 0 for one per core, if that is enabled.
+// The module is compiled whole if the number of threads is invalid.
+absl::optional<int64> ParallelCodegenThreads(const HloModuleConfig& config);
+// Returns true if attention should be rewritten to calls to the fused
+// attention runtime function (see attention_rewriter.h).
+bool FusedAttentionEnabled(const HloModuleConfig& config);
 
 }  // namespace options
 }  // namespace cpu
@@ -15,14 +15,22 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/cpu/cpu_runtime.h"
 
+#include <algorithm>
 #include <functional>
+#include <memory>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "tensorflow/compiler/xla/service/computation_placer.h"
 #include "tensorflow/compiler/xla/service/llvm_ir/llvm_util.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/platform/dynamic_annotations.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/profiler/lib/traceme.h"
 #include "tensorflow/stream_executor/stream_executor.h"
@@ -85,8 +93,14 @@ extern const char* const kReleaseOutfeedBufferAfterPopulationSymbolName =
     "__xla_cpu_runtime_ReleaseOutfeedBufferAfterPopulation";
 extern const char* const kParallelForkJoinSymbolName =
     "__xla_cpu_runtime_ParallelForkJoin";
+extern const char* const kParallelCallsSymbolName =
+    "__xla_cpu_runtime_ParallelCalls";
 extern const char* const kKeyValueSortSymbolName =
     "__xla_cpu_runtime_KeyValueSort";
+extern const char* const kKeySortSymbolName = "__xla_cpu_runtime_KeySort";
+extern const char* const kAllReduceSymbolName = "__xla_cpu_runtime_AllReduce";
+extern const char* const kFusedAttentionF32SymbolName =
+    "__xla_cpu_runtime_FusedAttentionF32";
 extern const char* const kTracingStartSymbolName =
     "__xla_cpu_runtime_TracingStart";
 extern const char* const kTracingEndSymbolName = "__xla_cpu_runtime_TracingEnd";
@@ -107,6 +121,151 @@ tensorflow::string ShapeString(const void* shape_ptr, xla::int32 shape_length) {
   return "<invalid shape>";
 }
 
+int GetDeviceOrdinal(const xla::ExecutableRunOptions* run_options) {
+  if (run_options == nullptr) {
+    return 0;
+  }
+  if (run_options->stream() != nullptr) {
+    return run_options->stream()->parent()->device_ordinal();
+  }
+  return std::max(run_options->device_ordinal(), 0);
+}
+
+// Returns the replica executing on the device of `run_options`. Without a
+// device assignment, replica i is assumed to run on device ordinal i.
+int GetReplicaId(const xla::ExecutableRunOptions* run_options) {
+  const int device_ordinal = GetDeviceOrdinal(run_options);
+  const xla::DeviceAssignment* device_assignment =
+      run_options ? run_options->device_assignment() : nullptr;
+  if (device_assignment == nullptr) {
+    return device_ordinal;
+  }
+  for (int replica = 0; replica < device_assignment->replica_count();
+       ++replica) {
+    if ((*device_assignment)(replica, 0) == device_ordinal) {
+      return replica;
+    }
+  }
+  LOG(FATAL) << "Device ordinal " << device_ordinal
+             << " is not in the device assignment "
+             << device_assignment->ToString();
+}
+
+// The replicas taking part in one execution of an all-reduce.
+struct AllReduceParticipants {
+  explicit AllReduceParticipants(int replica_count)
+      : inputs(replica_count, nullptr),
+        outputs(replica_count, nullptr),
+        arrived(replica_count),
+        departed(replica_count) {}
+
+  // Buffers of each replica, indexed by replica id.
+  std::vector<const void*> inputs;
+  std::vector<void*> outputs;
+  // Counted down once by every replica after publishing its buffers, and
+  // after it is done reading and writing the buffers of the other replicas.
+  tensorflow::BlockingCounter arrived;
+  tensorflow::BlockingCounter departed;
+  // Number of replicas that have joined; guarded by the rendezvous mutex.
+  int joined = 0;
+};
+
+// Matches up the replica threads executing the same all-reduce. Similar to
+// the xfeed managers, there is one process wide instance, because the
+// replicas of a computation run from different executables' threads.
+class AllReduceRendezvous {
+ public:
+  // Publishes the buffers of `replica_id` for the all-reduce `key` and
+  // returns the participants of the current execution of that all-reduce.
+  // Once the last replica has joined, the key is reset so that the next
+  // execution of the same all-reduce, e.g. in a while loop, starts afresh.
+  std::shared_ptr<AllReduceParticipants> Join(const tensorflow::string& key,
+                                              int replica_count, int replica_id,
+                                              const void* input, void* output) {
+    absl::MutexLock lock(&mu_);
+    std::shared_ptr<AllReduceParticipants>& slot = pending_[key];
+    if (slot == nullptr) {
+      slot = std::make_shared<AllReduceParticipants>(replica_count);
+    }
+    std::shared_ptr<AllReduceParticipants> participants = slot;
+    CHECK_EQ(participants->inputs.size(), replica_count)
+        << "Mismatched replica counts for all-reduce " << key;
+    CHECK(participants->outputs[replica_id] == nullptr)
+        << "Replica " << replica_id << " joined all-reduce " << key
+        << " twice";
+    participants->inputs[replica_id] = input;
+    participants->outputs[replica_id] = output;
+    if (++participants->joined == replica_count) {
+      pending_.erase(key);
+    }
+    return participants;
+  }
+
+ private:
+  absl::Mutex mu_;
+  absl::flat_hash_map<tensorflow::string,
+                      std::shared_ptr<AllReduceParticipants>>
+      pending_ GUARDED_BY(mu_);
+};
+
+AllReduceRendezvous* GetAllReduceRendezvous() {
+  static auto* rendezvous = new AllReduceRendezvous();
+  return rendezvous;
+}
+
+// Reduces elements [begin, end) of all replicas' inputs and writes the result
+// to all replicas' outputs. Elements are processed in blocks that are fully
+// read before they are written, so inputs and outputs may alias.
+template <typename T, typename ReduceFn>
+void AllReduceSlice(const AllReduceParticipants& participants,
+                    xla::int64 begin, xla::int64 end, ReduceFn reduce) {
+  constexpr xla::int64 kBlockSize = 1024;
+  T acc[kBlockSize];
+  const int replica_count = participants.inputs.size();
+  for (xla::int64 block = begin; block < end; block += kBlockSize) {
+    const xla::int64 n = std::min(kBlockSize, end - block);
+    const T* first = static_cast<const T*>(participants.inputs[0]) + block;
+    std::copy(first, first + n, acc);
+    for (int replica = 1; replica < replica_count; ++replica) {
+      const T* in = static_cast<const T*>(participants.inputs[replica]) + block;
+      for (xla::int64 i = 0; i < n; ++i) {
+        acc[i] = reduce(acc[i], in[i]);
+      }
+    }
+    for (int replica = 0; replica < replica_count; ++replica) {
+      std::copy(acc, acc + n,
+                static_cast<T*>(participants.outputs[replica]) + block);
+    }
+  }
+}
+
+template <typename T>
+void AllReduceSlice(const AllReduceParticipants& participants,
+                    xla::int64 begin, xla::int64 end,
+                    xla::cpu::runtime::AllReduceKind kind) {
+  using xla::cpu::runtime::AllReduceKind;
+  switch (kind) {
+    case AllReduceKind::kSum:
+      AllReduceSlice<T>(participants, begin, end,
+                        [](T a, T b) { return a + b; });
+      break;
+    case AllReduceKind::kProduct:
+      AllReduceSlice<T>(participants, begin, end,
+                        [](T a, T b) { return a * b; });
+      break;
+    case AllReduceKind::kMin:
+      AllReduceSlice<T>(participants, begin, end,
+                        [](T a, T b) { return std::min(a, b); });
+      break;
+    case AllReduceKind::kMax:
+      AllReduceSlice<T>(participants, begin, end,
+                        [](T a, T b) { return std::max(a, b); });
+      break;
+    default:
+      LOG(FATAL) << "Unknown all-reduce kind " << static_cast<int>(kind);
+  }
+}
+
 }  // namespace
 
 extern "C" {
@@ -212,3 +371,70 @@ __xla_cpu_runtime_ReleaseOutfeedBufferAfterPopulation(
   xfeed->outfeed()->ReleaseCurrentBuffer(buffer_length, buffer_ptr,
                                          std::move(shape));
 }
+
+TF_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_AllReduce(
+    const xla::ExecutableRunOptions* run_options, const char* op_key,
+    xla::int32 replica_count, xla::int32 reduction_kind,
+    xla::int32 element_type, xla::int64 element_count,
+    const void* input_buffer, void* output_buffer) {
+  const int replica_id = GetReplicaId(run_options);
+  CHECK_LT(replica_id, replica_count);
+  VLOG(2) << "AllReduce " << op_key << " of " << element_count
+          << " elements on replica " << replica_id;
+
+  // Executables running on disjoint sets of devices may use the same names
+  // for their all-reduces, so tell them apart by their device assignment.
+  const xla::DeviceAssignment* device_assignment =
+      run_options ? run_options->device_assignment() : nullptr;
+  tensorflow::string key = op_key;
+  if (device_assignment != nullptr) {
+    for (int replica = 0; replica < replica_count; ++replica) {
+      absl::StrAppend(&key, ",", (*device_assignment)(replica, 0));
+    }
+  }
+
+  std::shared_ptr<AllReduceParticipants> participants =
+      GetAllReduceRendezvous()->Join(key, replica_count, replica_id,
+                                     input_buffer, output_buffer);
+  participants->arrived.DecrementCount();
+  participants->arrived.Wait();
+
+  // Every replica reduces its own slice of the elements across all replicas
+  // and broadcasts the result, which fuses a reduce-scatter and an
+  // all-gather without staging any data in between.
+  const xla::int64 slice_size =
+      (element_count + replica_count - 1) / replica_count;
+  const xla::int64 begin = std::min(element_count, replica_id * slice_size);
+  const xla::int64 end = std::min(element_count, begin + slice_size);
+  const auto kind =
+      static_cast<xla::cpu::runtime::AllReduceKind>(reduction_kind);
+  switch (static_cast<xla::PrimitiveType>(element_type)) {
+    case xla::F32:
+      AllReduceSlice<float>(*participants, begin, end, kind);
+      break;
+    case xla::F64:
+      AllReduceSlice<double>(*participants, begin, end, kind);
+      break;
+    case xla::S32:
+      AllReduceSlice<xla::int32>(*participants, begin, end, kind);
+      break;
+    case xla::S64:
+      AllReduceSlice<xla::int64>(*participants, begin, end, kind);
+      break;
+    case xla::U32:
+      AllReduceSlice<xla::uint32>(*participants, begin, end, kind);
+      break;
+    case xla::U64:
+      AllReduceSlice<xla::uint64>(*participants, begin, end, kind);
+      break;
+    default:
+      LOG(FATAL) << "Unsupported all-reduce element type "
+                 << xla::PrimitiveType_Name(
+                        static_cast<xla::PrimitiveType>(element_type));
+  }
+
+  // Other replicas may still be reading this replica's input or writing its
+  // output.
+  participants->departed.DecrementCount();
+  participants->departed.Wait();
+}
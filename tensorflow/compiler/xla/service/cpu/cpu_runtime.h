@@ -64,7 +64,11 @@ extern const char* const kReleaseInfeedBufferAfterDequeueSymbolName;
 extern const char* const kAcquireOutfeedBufferForPopulationSymbolName;
 extern const char* const kReleaseOutfeedBufferAfterPopulationSymbolName;
 extern const char* const kParallelForkJoinSymbolName;
+extern const char* const kParallelCallsSymbolName;
 extern const char* const kKeyValueSortSymbolName;
+extern const char* const kKeySortSymbolName;
+extern const char* const kAllReduceSymbolName;
+extern const char* const kFusedAttentionF32SymbolName;
 
 extern const char* const kTracingStartSymbolName;
 extern const char* const kTracingEndSymbolName;
@@ -73,10 +77,25 @@ extern const char* const kTracingEndSymbolName;
 // prefix.
 extern const char* const kXlaCpuRuntimeSymbolNamePrefix;
 
+// The version of the calling convention of the runtime functions above. It
+// must be bumped whenever the signature or the meaning of the arguments of one
+// changes, so that serialized executables that call the old one are not
+// loaded.
+constexpr int32 kRuntimeAbiVersion = 1;
+
 // Returns the infeed manager used by the CPU runtime for the CPU device
 // `device_ordinal`.  Note the device ordinal does not name a CPU
 XfeedManager* GetXfeedManager(int device_ordinal);
 
+// Reduction computations supported by __xla_cpu_runtime_AllReduce. The values
+// are baked into the generated code, so they must not be renumbered.
+enum class AllReduceKind : int32 {
+  kSum = 0,
+  kProduct = 1,
+  kMin = 2,
+  kMax = 3,
+};
+
 }  // namespace runtime
 }  // namespace cpu
 }  // namespace xla
@@ -152,6 +171,24 @@ extern void __xla_cpu_runtime_ReleaseOutfeedBufferAfterPopulation(
     const xla::ExecutableRunOptions* run_options, xla::int32 buffer_length,
     void* buffer_ptr, const void* shape_ptr, xla::int32 shape_length);
 
+// Reduces `element_count` elements of primitive type `element_type` (an
+// xla::PrimitiveType) across the `replica_count` replicas executing the
+// all-reduce named `op_key`, combining them with `reduction_kind` (an
+// xla::cpu::runtime::AllReduceKind) and writing the result to
+// `output_buffer` on every replica. `input_buffer` and `output_buffer` may
+// alias.
+//
+// The replica executing the call is identified by looking up the device
+// ordinal of run_options in its device assignment. Blocks until all replicas
+// have joined the rendezvous for `op_key`; the replicas then each reduce a
+// disjoint slice of the elements directly from the other replicas' buffers,
+// and return once every slice has been written.
+extern void __xla_cpu_runtime_AllReduce(
+    const xla::ExecutableRunOptions* run_options, const char* op_key,
+    xla::int32 replica_count, xla::int32 reduction_kind,
+    xla::int32 element_type, xla::int64 element_count,
+    const void* input_buffer, void* output_buffer);
+
 }  // extern "C"
 
 #endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_RUNTIME_H_
@@ -18,12 +18,14 @@ limitations under the License.
 #include <memory>
 #include <string>
 #include <tuple>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "absl/strings/str_format.h"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/compiler/xla/array2d.h"
 #include "tensorflow/compiler/xla/client/local_client.h"
+#include "tensorflow/compiler/xla/service/computation_placer.h"
 #include "tensorflow/compiler/xla/service/cpu/runtime_matmul.h"
 #include "tensorflow/compiler/xla/service/cpu/runtime_matmul_mkl.h"
 #include "tensorflow/compiler/xla/service/cpu/runtime_single_threaded_matmul.h"
@@ -236,5 +238,76 @@ INSTANTIATE_TEST_CASE_P(MKLMatMulTestInstantiaion, MKLMatMulTest,
                         MKLMatMulTest::Name);
 #endif  // INTEL_MKL
 
+// Runs __xla_cpu_runtime_AllReduce from one thread per replica, `iterations`
+// times in a row, and returns the outputs of the last iteration. Replica r
+// runs on device ordinal replica_count - 1 - r and holds the elements
+// r * element_count, ..., (r + 1) * element_count - 1.
+std::vector<std::vector<int32>> RunAllReduce(int replica_count,
+                                             int64 element_count,
+                                             runtime::AllReduceKind kind,
+                                             bool in_place, int iterations) {
+  DeviceAssignment device_assignment(replica_count, /*computation_count=*/1);
+  std::vector<ExecutableRunOptions> run_options(replica_count);
+  std::vector<std::vector<int32>> inputs(replica_count);
+  std::vector<std::vector<int32>> outputs(replica_count);
+  for (int replica = 0; replica < replica_count; ++replica) {
+    device_assignment(replica, 0) = replica_count - 1 - replica;
+    run_options[replica].set_device_ordinal(replica_count - 1 - replica);
+    run_options[replica].set_device_assignment(&device_assignment);
+    outputs[replica].resize(element_count);
+  }
+  std::vector<std::unique_ptr<tensorflow::Thread>> threads;
+  for (int replica = 0; replica < replica_count; ++replica) {
+    threads.emplace_back(tensorflow::Env::Default()->StartThread(
+        tensorflow::ThreadOptions(), absl::StrFormat("replica%d", replica),
+        [&, replica]() {
+          for (int i = 0; i < iterations; ++i) {
+            inputs[replica].resize(element_count);
+            for (int64 j = 0; j < element_count; ++j) {
+              inputs[replica][j] = replica * element_count + j;
+            }
+            std::vector<int32>& output =
+                in_place ? inputs[replica] : outputs[replica];
+            __xla_cpu_runtime_AllReduce(
+                &run_options[replica], "all-reduce", replica_count,
+                static_cast<int32>(kind), S32, element_count,
+                inputs[replica].data(), output.data());
+          }
+        }));
+  }
+  threads.clear();
+  return in_place ? inputs : outputs;
+}
+
+TEST_F(CpuRuntimeTest, AllReduceSum) {
+  const int kReplicas = 4;
+  const int64 kElements = 3000;
+  for (bool in_place : {false, true}) {
+    std::vector<std::vector<int32>> outputs = RunAllReduce(
+        kReplicas, kElements, runtime::AllReduceKind::kSum, in_place,
+        /*iterations=*/3);
+    for (int replica = 0; replica < kReplicas; ++replica) {
+      for (int64 j = 0; j < kElements; ++j) {
+        // Sum over r of r * kElements + j.
+        const int32 expected = kElements * 6 + j * kReplicas;
+        ASSERT_EQ(expected, outputs[replica][j])
+            << "in_place=" << in_place << " replica=" << replica
+            << " j=" << j;
+      }
+    }
+  }
+}
+
+TEST_F(CpuRuntimeTest, AllReduceMaxFewerElementsThanReplicas) {
+  const int kReplicas = 4;
+  const int64 kElements = 3;
+  std::vector<std::vector<int32>> outputs =
+      RunAllReduce(kReplicas, kElements, runtime::AllReduceKind::kMax,
+                   /*in_place=*/false, /*iterations=*/2);
+  for (int replica = 0; replica < kReplicas; ++replica) {
+    EXPECT_EQ(std::vector<int32>({9, 10, 11}), outputs[replica]);
+  }
+}
+
 }  // namespace
 }  // namespace xla
@@ -0,0 +1,323 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/inter_op_parallelizer.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/service/cpu/backend_configs.pb.h"
+#include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/status_macros.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace xla {
+namespace cpu {
+
+namespace {
+
+// Instruction cost, in the units of the DefaultCostModel of
+// ParallelTaskAssignment, below which work is not worth a task of its own.
+// About 100us of work on a 2GHz core.
+const int64 kMinCostPerTask = 100000;
+
+// Minimum cost of a chain for it to run as a concurrent call, so that the
+// call outweighs its dispatch to the thread pool.
+const int64 kMinCostPerConcurrentCall = 10000;
+
+// Returns true if 'instruction' may be moved into a concurrent call.
+// Parameters, constants and tuple plumbing are cheap and stay in the entry
+// computation, and so do control flow, side effects and cross-replica
+// communication, which must not block a thread of the thread pool.
+bool IsMovable(const HloInstruction& instruction) {
+  if (instruction.HasSideEffect() ||
+      !instruction.control_predecessors().empty() ||
+      !instruction.control_successors().empty()) {
+    return false;
+  }
+  switch (instruction.opcode()) {
+    case HloOpcode::kParameter:
+    case HloOpcode::kConstant:
+    case HloOpcode::kTuple:
+    case HloOpcode::kGetTupleElement:
+    case HloOpcode::kBitcast:
+    case HloOpcode::kAddDependency:
+    case HloOpcode::kWhile:
+    case HloOpcode::kConditional:
+    case HloOpcode::kCall:
+    case HloOpcode::kCustomCall:
+    case HloOpcode::kAllReduce:
+    case HloOpcode::kAllToAll:
+    case HloOpcode::kCollectivePermute:
+    case HloOpcode::kReplicaId:
+    case HloOpcode::kPartitionId:
+      return false;
+    default:
+      return true;
+  }
+}
+
+// A chain of instructions of the entry computation, in topological order.
+// Only the last instruction is used outside the chain.
+struct Chain {
+  std::vector<HloInstruction*> instructions;
+  // One more than the largest level of the instructions and chains it
+  // depends on.
+  int64 level = 0;
+  int64 cost = 0;
+};
+
+// Returns the estimated time of running chains with the given costs one
+// after the other, each split into up to 'max_parallelism' parallel tasks of
+// at least kMinCostPerTask, minus the estimated time of running them
+// concurrently, each on one thread.
+int64 ConcurrentSavings(absl::Span<const int64> costs, int64 max_parallelism) {
+  int64 sequential_time = 0;
+  int64 total_cost = 0;
+  int64 max_cost = 0;
+  for (int64 cost : costs) {
+    const int64 parallel_tasks =
+        std::min(max_parallelism, std::max(int64{1}, cost / kMinCostPerTask));
+    sequential_time += cost / parallel_tasks;
+    total_cost += cost;
+    max_cost = std::max(max_cost, cost);
+  }
+  return sequential_time - std::max(max_cost, total_cost / max_parallelism);
+}
+
+// Replaces 'calls' in 'computation' by one call to a computation that runs
+// them as concurrent calls, and returns that call.
+StatusOr<HloInstruction*> OutlineConcurrentCalls(
+    absl::Span<HloInstruction* const> calls, HloComputation* computation) {
+  HloComputation::Builder builder(
+      absl::StrCat("concurrent_", calls.front()->name()));
+  absl::flat_hash_map<HloInstruction*, HloInstruction*> parameters;
+  std::vector<HloInstruction*> arguments;
+  std::vector<HloInstruction*> concurrent_calls;
+  CallBackendConfig config;
+  config.set_concurrent(true);
+  for (HloInstruction* call : calls) {
+    std::vector<HloInstruction*> operands;
+    for (HloInstruction* operand : call->operands()) {
+      HloInstruction*& parameter = parameters[operand];
+      if (parameter == nullptr) {
+        parameter = builder.AddInstruction(HloInstruction::CreateParameter(
+            arguments.size(), operand->shape(), "p"));
+        arguments.push_back(operand);
+      }
+      operands.push_back(parameter);
+    }
+    HloInstruction* concurrent_call = builder.AddInstruction(
+        call->CloneWithNewOperands(call->shape(), operands));
+    TF_RETURN_IF_ERROR(concurrent_call->set_backend_config(config));
+    concurrent_calls.push_back(concurrent_call);
+  }
+  builder.AddInstruction(HloInstruction::CreateTuple(concurrent_calls));
+
+  HloComputation* group =
+      computation->parent()->AddEmbeddedComputation(builder.Build());
+  HloInstruction* group_call =
+      computation->AddInstruction(HloInstruction::CreateCall(
+          group->root_instruction()->shape(), arguments, group));
+  for (int64 i = 0; i < calls.size(); ++i) {
+    HloInstruction* element = computation->AddInstruction(
+        HloInstruction::CreateGetTupleElement(calls[i]->shape(), group_call,
+                                              i));
+    TF_RETURN_IF_ERROR(computation->ReplaceInstruction(calls[i], element));
+  }
+  return group_call;
+}
+
+}  // namespace
+
+bool IsConcurrentCall(const HloInstruction& instruction) {
+  if (instruction.opcode() != HloOpcode::kCall ||
+      instruction.raw_backend_config_string().empty()) {
+    return false;
+  }
+  StatusOr<CallBackendConfig> config =
+      instruction.backend_config<CallBackendConfig>();
+  return config.ok() && config.ValueOrDie().concurrent();
+}
+
+absl::flat_hash_set<const HloComputation*> ConcurrentComputations(
+    const HloModule& module) {
+  absl::flat_hash_set<const HloComputation*> computations;
+  // Visit callers before callees.
+  std::vector<HloComputation*> post_order = module.MakeComputationPostOrder();
+  for (auto it = post_order.rbegin(); it != post_order.rend(); ++it) {
+    const bool is_concurrent = computations.contains(*it);
+    for (const HloInstruction* instruction : (*it)->instructions()) {
+      if (is_concurrent || IsConcurrentCall(*instruction)) {
+        computations.insert(instruction->called_computations().begin(),
+                            instruction->called_computations().end());
+      }
+    }
+  }
+  return computations;
+}
+
+StatusOr<bool> InterOpParallelizer::Run(HloModule* module) {
+  if (max_parallelism_ <= 1) {
+    return false;
+  }
+  HloComputation* computation = module->entry_computation();
+  HloCostAnalysis cost_analysis(shape_size_function_);
+  Status cost_status = computation->Accept(&cost_analysis);
+  if (!cost_status.ok()) {
+    VLOG(1) << "Not parallelizing " << module->name() << ": " << cost_status;
+    return false;
+  }
+
+  // Partition the movable instructions into chains. Every other instruction
+  // gets a level of its own.
+  std::vector<Chain> chains;
+  absl::flat_hash_map<const HloInstruction*, int64> chain_index;
+  absl::flat_hash_map<const HloInstruction*, int64> instruction_level;
+  auto level_of = [&](const HloInstruction* instruction) {
+    auto it = chain_index.find(instruction);
+    return it != chain_index.end() ? chains[it->second].level
+                                   : instruction_level.at(instruction);
+  };
+  for (HloInstruction* instruction : computation->MakeInstructionPostOrder()) {
+    int64 level = 0;
+    for (const HloInstruction* operand : instruction->operands()) {
+      level = std::max(level, level_of(operand) + 1);
+    }
+    if (!IsMovable(*instruction)) {
+      instruction_level[instruction] = level;
+      continue;
+    }
+    const int64 cost = cost_analysis.flop_count(*instruction) +
+                       2 * cost_analysis.transcendental_count(*instruction) +
+                       10 * cost_analysis.bytes_accessed(*instruction);
+
+    // Extend the chain of the only operand that is in a chain, if this is
+    // its only user, and all other operands are computed before the chain
+    // starts, that is, they don't depend on the chain.
+    const HloInstruction* previous = nullptr;
+    int64 operands_in_chains = 0;
+    for (const HloInstruction* operand : instruction->unique_operands()) {
+      if (chain_index.contains(operand)) {
+        previous = operand;
+        ++operands_in_chains;
+      }
+    }
+    if (operands_in_chains == 1 && previous->user_count() == 1 &&
+        previous != computation->root_instruction()) {
+      Chain& chain = chains[chain_index.at(previous)];
+      const bool extends_chain = absl::c_all_of(
+          instruction->operands(), [&](const HloInstruction* operand) {
+            return operand == previous || level_of(operand) < chain.level;
+          });
+      if (extends_chain) {
+        chain.instructions.push_back(instruction);
+        chain.cost += cost;
+        chain_index[instruction] = chain_index.at(previous);
+        continue;
+      }
+    }
+    chain_index[instruction] = chains.size();
+    chains.emplace_back();
+    chains.back().instructions.push_back(instruction);
+    chains.back().level = level;
+    chains.back().cost = cost;
+  }
+
+  // Chains on the same level are independent. Pick the chains of each level
+  // that save the most time by running concurrently. Since the largest chains
+  // profit most from intra-op parallelism, these are the cheapest chains up
+  // to some cost.
+  std::map<int64, std::vector<int64>> chains_by_level;
+  for (int64 i = 0; i < chains.size(); ++i) {
+    if (chains[i].cost >= kMinCostPerConcurrentCall) {
+      chains_by_level[chains[i].level].push_back(i);
+    }
+  }
+  std::vector<std::vector<int64>> groups;
+  for (auto& level_and_chains : chains_by_level) {
+    std::vector<int64>& candidates = level_and_chains.second;
+    absl::c_stable_sort(candidates, [&](int64 a, int64 b) {
+      return chains[a].cost < chains[b].cost;
+    });
+    std::vector<int64> costs;
+    int64 best_savings = 0;
+    int64 best_size = 0;
+    for (int64 candidate : candidates) {
+      costs.push_back(chains[candidate].cost);
+      const int64 savings = ConcurrentSavings(costs, max_parallelism_);
+      if (costs.size() >= 2 && savings > best_savings) {
+        best_savings = savings;
+        best_size = costs.size();
+      }
+    }
+    if (best_size >= 2) {
+      candidates.resize(best_size);
+      groups.push_back(candidates);
+    }
+  }
+
+  for (const std::vector<int64>& group : groups) {
+    std::vector<HloInstruction*> calls;
+    for (int64 i : group) {
+      const std::vector<HloInstruction*>& instructions =
+          chains[i].instructions;
+      calls.push_back(module->OutlineExpressionFromComputation(
+          instructions, absl::StrCat("task_", instructions.back()->name()),
+          computation));
+    }
+    TF_ASSIGN_OR_RETURN(HloInstruction * group_call,
+                        OutlineConcurrentCalls(calls, computation));
+    VLOG(2) << "Running " << calls.size() << " calls concurrently in "
+            << group_call->ToString();
+  }
+  return !groups.empty();
+}
+
+ConcurrentCallsHloOrdering::ConcurrentCallsHloOrdering(
+    const HloSchedule& schedule)
+    : SequentialHloOrdering(schedule),
+      concurrent_computations_(ConcurrentComputations(*schedule.module())) {
+  for (const HloComputation* computation : module_->computations()) {
+    for (const HloInstruction* instruction : computation->instructions()) {
+      if (IsConcurrentCall(*instruction)) {
+        concurrent_calls_.insert(instruction);
+      }
+    }
+  }
+}
+
+const HloInstructionSequence* ConcurrentCallsHloOrdering::SequentialOrder(
+    const HloComputation& computation) const {
+  if (concurrent_computations_.contains(&computation)) {
+    return nullptr;
+  }
+  return SequentialHloOrdering::SequentialOrder(computation);
+}
+
+bool ConcurrentCallsHloOrdering::ExecutesBeforeInSameComputation(
+    const HloInstruction* a, const HloInstruction* b) const {
+  if (concurrent_calls_.contains(a) && concurrent_calls_.contains(b)) {
+    return false;
+  }
+  return SequentialHloOrdering::ExecutesBeforeInSameComputation(a, b);
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,107 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_INTER_OP_PARALLELIZER_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_INTER_OP_PARALLELIZER_H_
+
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_cost_analysis.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_ordering.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+#include "tensorflow/compiler/xla/service/hlo_schedule.h"
+
+namespace xla {
+namespace cpu {
+
+// Returns true if 'instruction' is a kCall that runs concurrently with the
+// other concurrent calls in its computation.
+bool IsConcurrentCall(const HloInstruction& instruction);
+
+// Returns the computations of 'module' that run inside a concurrent call,
+// directly or through nested calls, loops and conditionals. Code emitted for
+// them must not use the intra-op thread pool, whose threads they run on.
+absl::flat_hash_set<const HloComputation*> ConcurrentComputations(
+    const HloModule& module);
+
+// InterOpParallelizer partitions the entry computation into tasks that run
+// concurrently on the intra-op thread pool.
+//
+// Chains of instructions, in which every instruction but the first has a
+// single operand in the chain and is the only user of it, are the tasks.
+// Tasks are assigned to levels by the longest path to them from the
+// parameters, so tasks on the same level do not depend on each other. The
+// tasks of a level that a cost model expects to finish sooner concurrently,
+// each on one thread, than one after the other, each split by intra-op
+// parallelism, are outlined into concurrent calls:
+//
+//   group = (...) call(operands...), to_apply=
+//     { task.0 = call(p.0, p.1), to_apply=chain.0,
+//                backend_config={"concurrent":true}
+//       task.1 = call(p.2), to_apply=chain.1,
+//                backend_config={"concurrent":true}
+//       ROOT tuple = tuple(task.0, task.1) }
+//
+// The IR emitter lowers the concurrent calls of a computation to one
+// runtime ParallelCalls call.
+class InterOpParallelizer : public HloModulePass {
+ public:
+  // 'max_parallelism': the number of threads the module runs on.
+  // 'shape_size': shape size function used by HloCostAnalysis.
+  InterOpParallelizer(const int64 max_parallelism,
+                      const HloCostAnalysis::ShapeSizeFunction& shape_size)
+      : max_parallelism_(max_parallelism), shape_size_function_(shape_size) {}
+  ~InterOpParallelizer() override {}
+
+  absl::string_view name() const override {
+    return "cpu-inter-op-parallelizer";
+  }
+
+  StatusOr<bool> Run(HloModule* module) override;
+
+ private:
+  const int64 max_parallelism_;
+  const HloCostAnalysis::ShapeSizeFunction shape_size_function_;
+};
+
+// A SequentialHloOrdering of a module with concurrent calls. The concurrent
+// calls of a computation execute in no particular order relative to each
+// other. The computations that run inside them report no sequential order,
+// which keeps buffer assignment from simulating a heap in which the buffers
+// of concurrent calls reuse each other's memory.
+class ConcurrentCallsHloOrdering : public SequentialHloOrdering {
+ public:
+  explicit ConcurrentCallsHloOrdering(const HloSchedule& schedule);
+  ~ConcurrentCallsHloOrdering() override = default;
+
+  // Returns nullptr for computations that run inside concurrent calls.
+  const HloInstructionSequence* SequentialOrder(
+      const HloComputation& computation) const override;
+
+ protected:
+  bool ExecutesBeforeInSameComputation(const HloInstruction* a,
+                                       const HloInstruction* b) const override;
+
+ private:
+  absl::flat_hash_set<const HloInstruction*> concurrent_calls_;
+  const absl::flat_hash_set<const HloComputation*> concurrent_computations_;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_INTER_OP_PARALLELIZER_H_
@@ -0,0 +1,190 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/inter_op_parallelizer.h"
+
+#include <vector>
+
+#include "tensorflow/compiler/xla/service/buffer_assignment.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_executable.h"
+#include "tensorflow/compiler/xla/service/hlo_matchers.h"
+#include "tensorflow/compiler/xla/service/hlo_memory_scheduler.h"
+#include "tensorflow/compiler/xla/test.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace xla {
+namespace {
+
+namespace op = xla::testing::opcode_matchers;
+
+class InterOpParallelizerTest : public HloTestBase {
+ protected:
+  StatusOr<bool> RunInterOpParallelizer(HloModule* module) {
+    return cpu::InterOpParallelizer(/*max_parallelism=*/8,
+                                    cpu::CpuExecutable::ShapeSizeBytes)
+        .Run(module);
+  }
+
+  // Returns the concurrent calls in 'module'.
+  std::vector<const HloInstruction*> ConcurrentCalls(const HloModule& module) {
+    std::vector<const HloInstruction*> calls;
+    for (const HloComputation* computation : module.computations()) {
+      for (const HloInstruction* instruction : computation->instructions()) {
+        if (cpu::IsConcurrentCall(*instruction)) {
+          calls.push_back(instruction);
+        }
+      }
+    }
+    return calls;
+  }
+};
+
+// Two towers of elementwise ops that are too small for intra-op parallelism.
+const char* const kTwoTowersModule = R"(
+  HloModule two_towers
+
+  ENTRY entry {
+    p0 = f32[32,32] parameter(0)
+    p1 = f32[32,32] parameter(1)
+    exp0 = f32[32,32] exponential(p0)
+    log0 = f32[32,32] log(exp0)
+    exp1 = f32[32,32] exponential(p1)
+    log1 = f32[32,32] log(exp1)
+    ROOT add = f32[32,32] add(log0, log1)
+  }
+)";
+
+TEST_F(InterOpParallelizerTest, IndependentTowersRunConcurrently) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kTwoTowersModule));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunInterOpParallelizer(module.get()));
+  EXPECT_TRUE(changed);
+
+  const HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root, op::Add(op::GetTupleElement(op::Call()),
+                            op::GetTupleElement(op::Call())));
+  const HloInstruction* group = root->operand(0)->operand(0);
+  EXPECT_EQ(group, root->operand(1)->operand(0));
+  EXPECT_FALSE(cpu::IsConcurrentCall(*group));
+  EXPECT_THAT(group->to_apply()->root_instruction(),
+              op::Tuple(op::Call(op::Parameter()), op::Call(op::Parameter())));
+
+  std::vector<const HloInstruction*> calls = ConcurrentCalls(*module);
+  ASSERT_EQ(calls.size(), 2);
+  for (const HloInstruction* call : calls) {
+    EXPECT_EQ(call->parent(), group->to_apply());
+    EXPECT_THAT(call->to_apply()->root_instruction(),
+                op::Log(op::Exp(op::Parameter())));
+  }
+  EXPECT_EQ(cpu::ConcurrentComputations(*module).size(), 2);
+}
+
+TEST_F(InterOpParallelizerTest, DependentChainsStaySequential) {
+  const string hlo_string = R"(
+    HloModule dependent_chains
+
+    ENTRY entry {
+      p0 = f32[32,32] parameter(0)
+      exp0 = f32[32,32] exponential(p0)
+      log0 = f32[32,32] log(exp0)
+      exp1 = f32[32,32] exponential(log0)
+      log1 = f32[32,32] log(exp1)
+      ROOT add = f32[32,32] add(log0, log1)
+    }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunInterOpParallelizer(module.get()));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(InterOpParallelizerTest, LargeTowersUseIntraOpParallelism) {
+  const string hlo_string = R"(
+    HloModule large_towers
+
+    ENTRY entry {
+      p0 = f32[1024,1024] parameter(0)
+      p1 = f32[1024,1024] parameter(1)
+      exp0 = f32[1024,1024] exponential(p0)
+      exp1 = f32[1024,1024] exponential(p1)
+      ROOT add = f32[1024,1024] add(exp0, exp1)
+    }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunInterOpParallelizer(module.get()));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(InterOpParallelizerTest, SideEffectsStayInEntry) {
+  const string hlo_string = R"(
+    HloModule side_effects
+
+    ENTRY entry {
+      p0 = f32[32,32] parameter(0)
+      zero = f32[] constant(0)
+      one = f32[] constant(1)
+      rng0 = f32[32,32] rng(zero, one), distribution=rng_uniform
+      rng1 = f32[32,32] rng(zero, one), distribution=rng_uniform
+      ROOT add = f32[32,32] add(rng0, rng1)
+    }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunInterOpParallelizer(module.get()));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(InterOpParallelizerTest, ConcurrentCallsDoNotShareBuffers) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kTwoTowersModule));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunInterOpParallelizer(module.get()));
+  ASSERT_TRUE(changed);
+
+  auto size_fn = [](const BufferValue& buffer) {
+    return ShapeUtil::ByteSizeOf(buffer.shape(), sizeof(void*));
+  };
+  TF_ASSERT_OK_AND_ASSIGN(HloSchedule schedule,
+                          ScheduleModule(module.get(), size_fn));
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<BufferAssignment> assignment,
+      BufferAssigner::Run(
+          module.get(),
+          absl::make_unique<cpu::ConcurrentCallsHloOrdering>(schedule),
+          size_fn, [](LogicalBuffer::Color) { return 1; }));
+
+  // Sequentially, each tower could reuse the memory of the other one's
+  // temporaries. Concurrently, none of their buffers may overlap.
+  std::vector<const HloInstruction*> calls = ConcurrentCalls(*module);
+  ASSERT_EQ(calls.size(), 2);
+  for (const HloInstruction* a : calls[0]->to_apply()->instructions()) {
+    for (const HloInstruction* b : calls[1]->to_apply()->instructions()) {
+      if (a->opcode() == HloOpcode::kParameter ||
+          b->opcode() == HloOpcode::kParameter) {
+        continue;
+      }
+      TF_ASSERT_OK_AND_ASSIGN(BufferAllocation::Slice a_slice,
+                              assignment->GetUniqueTopLevelSlice(a));
+      TF_ASSERT_OK_AND_ASSIGN(BufferAllocation::Slice b_slice,
+                              assignment->GetUniqueTopLevelSlice(b));
+      EXPECT_FALSE(a_slice.OverlapsWith(b_slice))
+          << a->ToString() << " and " << b->ToString();
+    }
+  }
+}
+
+}  // namespace
+}  // namespace xla
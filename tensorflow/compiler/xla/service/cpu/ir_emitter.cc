@@ -40,11 +40,13 @@ limitations under the License.
 #include "llvm/IR/LLVMContext.h"
 #include "tensorflow/compiler/xla/layout_util.h"
 #include "tensorflow/compiler/xla/map_util.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
 #include "tensorflow/compiler/xla/service/buffer_assignment.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_options.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_runtime.h"
 #include "tensorflow/compiler/xla/service/cpu/dot_op_emitter.h"
 #include "tensorflow/compiler/xla/service/cpu/elemental_ir_emitter.h"
+#include "tensorflow/compiler/xla/service/cpu/inter_op_parallelizer.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_function.h"
 #include "tensorflow/compiler/xla/service/cpu/parallel_loop_emitter.h"
@@ -97,10 +99,18 @@ IrEmitter::IrEmitter(
       computation_to_profile_idx_(std::move(computation_to_profile_idx)),
       alias_analysis_(hlo_module, assignment, &llvm_module->getContext()),
       hlo_module_config_(hlo_module.config()),
+      single_threaded_eigen_config_(hlo_module.config()),
+      concurrent_computations_(ConcurrentComputations(hlo_module)),
+      in_concurrent_computation_(false),
       is_top_level_computation_(false),
       target_machine_features_(*target_machine_features),
       emit_code_for_msan_(emit_code_for_msan) {
   b_.setFastMathFlags(llvm_ir::GetCpuFastMathFlags(hlo_module_config_));
+  DebugOptions single_threaded_debug_options =
+      hlo_module_config_.debug_options();
+  single_threaded_debug_options.set_xla_cpu_multi_thread_eigen(false);
+  single_threaded_eigen_config_.set_debug_options(
+      single_threaded_debug_options);
   Status s = GatherComputationsByAllocationType(
       &hlo_module, &thread_local_computations_, &global_computations_);
   absl::c_sort(thread_local_computations_);
@@ -151,6 +161,7 @@ StatusOr<llvm::Function*> IrEmitter::EmitComputation(
   string function_name = name_uniquer_.GetUniqueName(function_name_prefix);
   VLOG(2) << "Emitting IR for CPU function [" << function_name_prefix << "]";
   is_top_level_computation_ = is_top_level_computation;
+  in_concurrent_computation_ = concurrent_computations_.contains(computation);
   num_dynamic_loop_bounds_ = 0;
   if (!computation->root_instruction()->outer_dimension_partitions().empty()) {
     num_dynamic_loop_bounds_ =
@@ -556,6 +567,38 @@ Status IrEmitter::HandleOutfeed(HloInstruction* outfeed) {
   return Status::OK();
 }
 
+// Returns true if `sort` sorts a single integer array with a comparator that
+// just compares its two parameters with less-than or greater-than, in which
+// case the sort can be done by the radix sort in __xla_cpu_runtime_KeySort.
+// Equal integers are indistinguishable, so the sort need not be stable.
+static bool IsIntegerKeySort(const HloSortInstruction* sort,
+                             bool* descending) {
+  if (sort->operand_count() != 1 ||
+      !primitive_util::IsIntegralType(sort->keys()->shape().element_type())) {
+    return false;
+  }
+  const HloComputation* comparator = sort->to_apply();
+  const HloInstruction* root = comparator->root_instruction();
+  if (comparator->instruction_count() != 3 ||
+      root->opcode() != HloOpcode::kCompare ||
+      root->operand(0)->opcode() != HloOpcode::kParameter ||
+      root->operand(1)->opcode() != HloOpcode::kParameter ||
+      root->operand(0) == root->operand(1)) {
+    return false;
+  }
+  const bool swapped = root->operand(0)->parameter_number() == 1;
+  switch (root->comparison_direction()) {
+    case ComparisonDirection::kLt:
+      *descending = swapped;
+      return true;
+    case ComparisonDirection::kGt:
+      *descending = !swapped;
+      return true;
+    default:
+      return false;
+  }
+}
+
 Status IrEmitter::HandleSort(HloInstruction* hlo) {
   const HloSortInstruction* sort = Cast<HloSortInstruction>(hlo);
   TF_RETURN_IF_ERROR(EmitTargetAddressForOp(sort));
@@ -628,6 +671,28 @@ Status IrEmitter::HandleSort(HloInstruction* hlo) {
     lower_dimensions *= normalized_keys_shape.dimensions(i);
   }
 
+  bool descending;
+  if (IsIntegerKeySort(sort, &descending)) {
+    llvm::FunctionType* key_sort_type = llvm::FunctionType::get(
+        b_.getVoidTy(),
+        {b_.getInt64Ty(), b_.getInt64Ty(), b_.getInt64Ty(), b_.getInt8PtrTy(),
+         b_.getInt32Ty(), b_.getInt1Ty(), b_.getInt1Ty(), b_.getInt8PtrTy()},
+        /*isVarArg=*/false);
+    auto* key_sort_func = llvm::dyn_cast<llvm::Function>(
+        module_->getOrInsertFunction(runtime::kKeySortSymbolName, key_sort_type)
+            .getCallee());
+    key_sort_func->setCallingConv(llvm::CallingConv::C);
+    key_sort_func->setDoesNotThrow();
+    Call(key_sort_func,
+         {b_.getInt64(higher_dimensions), b_.getInt64(sort_dimension_elements),
+          b_.getInt64(lower_dimensions),
+          PointerCast(destination_addresses[0], b_.getInt8PtrTy()),
+          b_.getInt32(ShapeUtil::ByteSizeOfPrimitiveType(keys_type)),
+          b_.getInt1(primitive_util::IsSignedIntegralType(keys_type)),
+          b_.getInt1(descending), GetExecutableRunOptionsArgument()});
+    return Status::OK();
+  }
+
   auto less_than_function = FindOrDie(emitted_functions_, sort->to_apply());
   CHECK(absl::c_binary_search(thread_local_computations_, sort->to_apply()));
   llvm::FunctionType* key_value_sort_type = llvm::FunctionType::get(
@@ -1000,7 +1065,7 @@ Status IrEmitter::HandleDot(HloInstruction* dot) {
   return EmitDotOperation(*dot, target_array, lhs_array, rhs_array,
                           /*addend_array=*/nullptr,
                           GetExecutableRunOptionsArgument(), &b_,
-                          hlo_module_config_, target_machine_features_);
+                          RuntimeCallConfig(), target_machine_features_);
 }
 
 StatusOr<llvm::Value*> IrEmitter::EmitElementalConvolution(
@@ -1245,7 +1310,7 @@ Status IrEmitter::HandleConvolution(HloInstruction* convolution) {
            int64_type,    int64_type,  int64_type,  int64_type},
           /*isVarArg=*/false);
       bool multi_threaded =
-          hlo_module_config_.debug_options().xla_cpu_multi_thread_eigen();
+          RuntimeCallConfig().debug_options().xla_cpu_multi_thread_eigen();
       bool use_mkl_dnn =
           hlo_module_config_.debug_options().xla_cpu_use_mkl_dnn();
 
@@ -1339,7 +1404,7 @@ Status IrEmitter::HandleFft(HloInstruction* fft) {
       /*isVarArg=*/false);
 
   bool multi_threaded_eigen =
-      hlo_module_config_.debug_options().xla_cpu_multi_thread_eigen();
+      RuntimeCallConfig().debug_options().xla_cpu_multi_thread_eigen();
   const char* fn_name = multi_threaded_eigen
                             ? runtime::kEigenFftSymbolName
                             : runtime::kEigenSingleThreadedFftSymbolName;
@@ -1362,15 +1427,145 @@ Status IrEmitter::HandleFft(HloInstruction* fft) {
   return Status::OK();
 }
 
-Status IrEmitter::HandleAllReduce(HloInstruction* crs) {
-  if (hlo_module_config_.replica_count() != 1) {
-    // TODO(b/33011107): Support nontrivial cross replica sum on CPU.
+// Returns true and sets `kind` if `computation` applies a reduction supported
+// by __xla_cpu_runtime_AllReduce to its two parameters.
+static bool MatchAllReduceKind(const HloComputation* computation,
+                               runtime::AllReduceKind* kind) {
+  const HloInstruction* root = computation->root_instruction();
+  if (computation->num_parameters() != 2 ||
+      computation->instruction_count() != 3 || root->operand_count() != 2 ||
+      root->operand(0)->opcode() != HloOpcode::kParameter ||
+      root->operand(1)->opcode() != HloOpcode::kParameter ||
+      root->operand(0) == root->operand(1)) {
+    return false;
+  }
+  switch (root->opcode()) {
+    case HloOpcode::kAdd:
+      *kind = runtime::AllReduceKind::kSum;
+      return true;
+    case HloOpcode::kMultiply:
+      *kind = runtime::AllReduceKind::kProduct;
+      return true;
+    case HloOpcode::kMinimum:
+      *kind = runtime::AllReduceKind::kMin;
+      return true;
+    case HloOpcode::kMaximum:
+      *kind = runtime::AllReduceKind::kMax;
+      return true;
+    default:
+      return false;
+  }
+}
+
+Status IrEmitter::HandleAllReduceMultipleReplica(HloInstruction* crs) {
+  const int64 replica_count = hlo_module_config_.replica_count();
+  for (const ReplicaGroup& group : crs->replica_groups()) {
+    if (group.replica_ids_size() != replica_count) {
+      return Unimplemented(
+          "AllReduce over a subset of the replicas is not implemented on CPU: "
+          "%s",
+          crs->ToString());
+    }
+  }
+  runtime::AllReduceKind kind;
+  if (!MatchAllReduceKind(crs->to_apply(), &kind)) {
     return Unimplemented(
-        "AllReduce with >1 replica is not implemented on CPU.");
+        "AllReduce with reduction computation %s is not implemented on CPU.",
+        crs->to_apply()->ToString());
+  }
+  for (const HloInstruction* operand : crs->operands()) {
+    const Shape& operand_shape = operand->shape();
+    CHECK(operand_shape.IsArray())
+        << "Operands to all-reduce must be arrays: " << crs->ToString();
+    switch (operand_shape.element_type()) {
+      case F32:
+      case F64:
+      case S32:
+      case S64:
+      case U32:
+      case U64:
+        break;
+      default:
+        return Unimplemented("AllReduce of %s is not implemented on CPU.",
+                             PrimitiveType_Name(operand_shape.element_type()));
+    }
   }
 
-  // When there is a single replica, a cross replica sum is the identity
-  // function, and the buffer assignment expects a copy.
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(crs));
+
+  llvm::Type* int8_ptr_type = b_.getInt8Ty()->getPointerTo();
+  llvm::Type* int32_type = b_.getInt32Ty();
+  llvm::FunctionType* all_reduce_type = llvm::FunctionType::get(
+      b_.getVoidTy(),
+      {int8_ptr_type, int8_ptr_type, int32_type, int32_type, int32_type,
+       b_.getInt64Ty(), int8_ptr_type, int8_ptr_type},
+      /*isVarArg=*/false);
+  llvm::Function* all_reduce_func = llvm::dyn_cast<llvm::Function>(
+      module_->getOrInsertFunction(runtime::kAllReduceSymbolName,
+                                   all_reduce_type)
+          .getCallee());
+  all_reduce_func->setCallingConv(llvm::CallingConv::C);
+  all_reduce_func->setDoesNotThrow();
+
+  // All-reduces with several operands produce a (one-deep) tuple, and each
+  // operand is reduced by a separate rendezvous.
+  std::vector<llvm::Value*> output_ptrs;
+  for (int64 i = 0; i < crs->operand_count(); ++i) {
+    const Shape& operand_shape = crs->operand(i)->shape();
+    llvm::Value* in_ptr = GetEmittedValueFor(crs->operand(i));
+    llvm::Value* out_ptr;
+    if (crs->operand_count() == 1) {
+      out_ptr = GetEmittedValueFor(crs);
+    } else {
+      TF_ASSIGN_OR_RETURN(const BufferAllocation::Slice out_slice,
+                          assignment_.GetUniqueSlice(crs, {i}));
+      out_ptr = EmitBufferPointer(out_slice, operand_shape);
+      output_ptrs.push_back(out_ptr);
+    }
+
+    // Every replica runs the same module, so the module and instruction names
+    // identify the all-reduce across the replicas. This also covers the
+    // all-core all-reduces formed by ArCrsCombiner, which keep the
+    // all_reduce_id of the cross-module all-reduce they replace.
+    llvm::Value* op_key = b_.CreateGlobalStringPtr(
+        absl::StrCat(crs->GetModule()->name(), ":", crs->name(), ":", i));
+    Call(all_reduce_func,
+         {BitCast(GetExecutableRunOptionsArgument(), int8_ptr_type), op_key,
+          b_.getInt32(replica_count), b_.getInt32(static_cast<int32>(kind)),
+          b_.getInt32(operand_shape.element_type()),
+          b_.getInt64(ShapeUtil::ElementsIn(operand_shape)),
+          BitCast(in_ptr, int8_ptr_type), BitCast(out_ptr, int8_ptr_type)});
+  }
+  if (crs->operand_count() > 1) {
+    llvm_ir::EmitTuple(GetIrArrayFor(crs), output_ptrs, &b_);
+  }
+  return Status::OK();
+}
+
+// Returns true if every replica group of `crs` holds a single replica, e.g.
+// for the cross-module all-reduces of spatially partitioned models, as
+// XLA:CPU runs one partition per replica.
+static bool HasSingleReplicaGroups(const HloInstruction* crs) {
+  if (crs->replica_groups().empty()) {
+    return false;
+  }
+  for (const ReplicaGroup& group : crs->replica_groups()) {
+    if (group.replica_ids_size() != 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Status IrEmitter::HandleAllReduce(HloInstruction* crs) {
+  if (hlo_module_config_.replica_count() != 1 &&
+      !HasSingleReplicaGroups(crs)) {
+    return HandleAllReduceMultipleReplica(crs);
+  }
+
+  // When there is a single replica, or every replica only reduces with
+  // itself, a cross replica sum is the identity function, and the buffer
+  // assignment expects a copy.
   //
   // TODO(b/80100934): We would like to eliminate one-replica CRS nodes entirely
   // in algebraic-simplifier, but currently on some platforms
@@ -2293,7 +2488,7 @@ Status IrEmitter::HandleFusion(HloInstruction* fusion) {
     TF_RETURN_IF_ERROR(
         EmitDotOperation(*dot, target_array, lhs_array, rhs_array,
                          &addend_array, GetExecutableRunOptionsArgument(), &b_,
-                         hlo_module_config_, target_machine_features_));
+                         RuntimeCallConfig(), target_machine_features_));
     return Status::OK();
   } else {
     return Unimplemented("Fusion kind not implemented on CPU");
@@ -2306,7 +2501,31 @@ Status IrEmitter::HandleCall(HloInstruction* call) {
 
   TF_RETURN_IF_ERROR(EmitTargetAddressForOp(call));
 
-  if (!computation->root_instruction()->outer_dimension_partitions().empty()) {
+  if (IsConcurrentCall(*call)) {
+    // The first concurrent call of a computation emits a call to
+    // ParallelCalls for all of them. Their operands are parameters of the
+    // computation, so they are all available at this point.
+    if (!emitted_concurrent_calls_.insert(call->parent()).second) {
+      return Status::OK();
+    }
+    std::vector<llvm::Function*> functions;
+    for (const HloInstruction* instruction : call->parent()->instructions()) {
+      if (IsConcurrentCall(*instruction)) {
+        functions.push_back(
+            FindOrDie(emitted_functions_, instruction->to_apply()));
+      }
+    }
+    std::vector<llvm::Value*> call_args = GetArrayFunctionCallArguments(
+        {}, &b_, computation->name(),
+        /*return_value_buffer=*/
+        llvm::Constant::getNullValue(b_.getInt8PtrTy()),
+        /*exec_run_options_arg=*/GetExecutableRunOptionsArgument(),
+        /*buffer_table_arg=*/GetBufferTableArgument(),
+        /*profile_counters_arg=*/GetProfileCountersArgument());
+    EmitCallToParallelCalls(call_args, functions, &b_, computation->name());
+  } else if (!computation->root_instruction()
+                  ->outer_dimension_partitions()
+                  .empty()) {
     // ParallelTaskAssignment assigned partitions, emit call to
     // ParallelForkJoin.
     std::vector<llvm::Value*> call_args = GetArrayFunctionCallArguments(
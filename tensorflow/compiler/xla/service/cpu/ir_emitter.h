@@ -24,6 +24,7 @@ limitations under the License.
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "llvm/ADT/Triple.h"
@@ -205,6 +206,10 @@ class IrEmitter : public DfsHloVisitorWithDefault,
   // twice, and we would know whether it's thread-local at codegen time.
   void EmitThreadLocalFunctionEpilogue(HloComputation* computation);
 
+  // Emits an all-reduce across more than one replica as a call to
+  // __xla_cpu_runtime_AllReduce for each of its operands.
+  Status HandleAllReduceMultipleReplica(HloInstruction* crs);
+
   // Convenience functions to generate a GEP into the profile counter parameter
   // which would correspond to the index for a given HLO instruction or
   // computation.
@@ -583,6 +588,28 @@ class IrEmitter : public DfsHloVisitorWithDefault,
 
   const HloModuleConfig& hlo_module_config_;
 
+  // Returns the module config to choose runtime calls of the computation
+  // being emitted by. Computations that run inside concurrent calls use the
+  // single-threaded Eigen runtime, since they already run on a thread of the
+  // intra-op thread pool.
+  const HloModuleConfig& RuntimeCallConfig() const {
+    return in_concurrent_computation_ ? single_threaded_eigen_config_
+                                      : hlo_module_config_;
+  }
+
+  // hlo_module_config_ with xla_cpu_multi_thread_eigen disabled.
+  HloModuleConfig single_threaded_eigen_config_;
+
+  // The computations that run inside concurrent calls, see
+  // inter_op_parallelizer.h.
+  const absl::flat_hash_set<const HloComputation*> concurrent_computations_;
+
+  // Whether the computation being emitted is in concurrent_computations_.
+  bool in_concurrent_computation_;
+
+  // The computations whose concurrent calls have been emitted.
+  absl::flat_hash_set<const HloComputation*> emitted_concurrent_calls_;
+
   bool is_top_level_computation_;
 
   const TargetMachineFeatures& target_machine_features_;
@@ -0,0 +1,203 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/llvm_module_splitter.h"
+
+#include <algorithm>
+#include <numeric>
+#include <set>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+namespace xla {
+namespace cpu {
+
+namespace {
+
+// Returns true if 'function' is only used as the callee of calls.
+bool OnlyCalledDirectly(const llvm::Function& function) {
+  for (const llvm::Use& use : function.uses()) {
+    const auto* call = llvm::dyn_cast<llvm::CallBase>(use.getUser());
+    if (call == nullptr || !call->isCallee(&use)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Adds the functions whose instructions use 'value', directly or through
+// constant expressions, to 'functions'. Returns false if 'value' has other
+// users, such as the initializers of globals.
+bool AddUsingFunctions(const llvm::Value* value,
+                       absl::flat_hash_set<const llvm::Function*>* functions) {
+  for (const llvm::User* user : value->users()) {
+    if (const auto* instruction = llvm::dyn_cast<llvm::Instruction>(user)) {
+      functions->insert(instruction->getFunction());
+    } else if (!llvm::isa<llvm::ConstantExpr>(user) ||
+               !AddUsingFunctions(user, functions)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Makes 'value' visible to the other partitions.
+void Externalize(llvm::GlobalValue* value) {
+  if (!value->hasName()) {
+    value->setName("xla_split_global");
+  }
+  if (value->hasLocalLinkage()) {
+    value->setLinkage(llvm::GlobalValue::ExternalLinkage);
+    value->setVisibility(llvm::GlobalValue::HiddenVisibility);
+  }
+}
+
+}  // namespace
+
+std::vector<std::unique_ptr<llvm::Module>> SplitModuleForParallelCompilation(
+    llvm::Module* module, int64 max_partitions) {
+  std::vector<llvm::Function*> roots;
+  absl::flat_hash_set<const llvm::Function*> is_root;
+  for (llvm::Function& function : *module) {
+    if (!function.isDeclaration() &&
+        (!function.hasLocalLinkage() || !OnlyCalledDirectly(function) ||
+         function.getInstructionCount() >= kMinInstructionsToSplitFunction)) {
+      roots.push_back(&function);
+      is_root.insert(&function);
+    }
+  }
+  const int64 num_partitions =
+      std::min<int64>(max_partitions, static_cast<int64>(roots.size()));
+  if (num_partitions < 2) {
+    return {};
+  }
+
+  // Find the functions that each root calls, directly or through other
+  // functions that are not roots.
+  std::vector<std::vector<const llvm::Function*>> functions_of_root(
+      roots.size());
+  std::vector<int64> root_sizes(roots.size(), 0);
+  for (int64 i = 0; i < roots.size(); ++i) {
+    std::vector<const llvm::Function*> stack = {roots[i]};
+    absl::flat_hash_set<const llvm::Function*> visited = {roots[i]};
+    while (!stack.empty()) {
+      const llvm::Function* function = stack.back();
+      stack.pop_back();
+      functions_of_root[i].push_back(function);
+      root_sizes[i] += function->getInstructionCount();
+      for (const llvm::BasicBlock& block : *function) {
+        for (const llvm::Instruction& instruction : block) {
+          const auto* call = llvm::dyn_cast<llvm::CallBase>(&instruction);
+          const llvm::Function* callee =
+              call != nullptr ? call->getCalledFunction() : nullptr;
+          if (callee != nullptr && !callee->isDeclaration() &&
+              !is_root.contains(callee) && visited.insert(callee).second) {
+            stack.push_back(callee);
+          }
+        }
+      }
+    }
+  }
+
+  // Assign the largest remaining root to the smallest partition, and each
+  // function to the partitions of the roots that call it.
+  std::vector<int64> order(roots.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int64 a, int64 b) {
+    return root_sizes[a] > root_sizes[b];
+  });
+  std::vector<int64> partition_sizes(num_partitions, 0);
+  absl::flat_hash_map<const llvm::GlobalValue*, std::set<int64>> partitions;
+  for (int64 i : order) {
+    const int64 partition =
+        std::min_element(partition_sizes.begin(), partition_sizes.end()) -
+        partition_sizes.begin();
+    partition_sizes[partition] += root_sizes[i];
+    for (const llvm::Function* function : functions_of_root[i]) {
+      partitions[function].insert(partition);
+    }
+    Externalize(roots[i]);
+  }
+
+  // Define each global in the partitions that use it, or, if several do, in
+  // the first of them only.
+  for (llvm::GlobalVariable& global : module->globals()) {
+    if (global.isDeclaration()) {
+      continue;
+    }
+    absl::flat_hash_set<const llvm::Function*> users;
+    const bool used_outside_functions =
+        !global.hasLocalLinkage() || !AddUsingFunctions(&global, &users);
+    std::set<int64> used_in;
+    for (const llvm::Function* user : users) {
+      auto it = partitions.find(user);
+      if (it != partitions.end()) {
+        used_in.insert(it->second.begin(), it->second.end());
+      }
+    }
+    if (used_outside_functions || used_in.size() > 1) {
+      Externalize(&global);
+      partitions[&global] = {used_in.empty() ? 0 : *used_in.begin()};
+    } else if (!used_in.empty()) {
+      partitions[&global] = used_in;
+    }
+  }
+
+  std::vector<std::unique_ptr<llvm::Module>> result;
+  for (int64 partition = 0; partition < num_partitions; ++partition) {
+    llvm::ValueToValueMapTy value_map;
+    std::unique_ptr<llvm::Module> partition_module = llvm::CloneModule(
+        *module, value_map, [&](const llvm::GlobalValue* value) {
+          if (!llvm::isa<llvm::Function>(value) &&
+              !llvm::isa<llvm::GlobalVariable>(value)) {
+            return partition == 0;
+          }
+          auto it = partitions.find(value);
+          return it != partitions.end() && it->second.count(partition) > 0;
+        });
+    partition_module->setModuleIdentifier(
+        absl::StrCat(module->getModuleIdentifier(), ".", partition));
+
+    // Drop the declarations of what other partitions define and this one
+    // does not use.
+    for (auto it = partition_module->begin(); it != partition_module->end();) {
+      llvm::Function& function = *it++;
+      if (function.isDeclaration() && function.use_empty()) {
+        function.eraseFromParent();
+      }
+    }
+    for (auto it = partition_module->global_begin();
+         it != partition_module->global_end();) {
+      llvm::GlobalVariable& global = *it++;
+      if (global.isDeclaration() && global.use_empty()) {
+        global.eraseFromParent();
+      }
+    }
+    result.push_back(std::move(partition_module));
+  }
+  return result;
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,53 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_LLVM_MODULE_SPLITTER_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_LLVM_MODULE_SPLITTER_H_
+
+#include <memory>
+#include <vector>
+
+#include "llvm/IR/Module.h"
+#include "tensorflow/compiler/xla/types.h"
+
+namespace xla {
+namespace cpu {
+
+// Functions with at least this many instructions are compiled on their own
+// rather than along with each of their callers.
+constexpr int64 kMinInstructionsToSplitFunction = 1000;
+
+// Splits 'module' into up to 'max_partitions' modules, in the same
+// LLVMContext, that can be optimized and compiled independently and then
+// linked together.
+//
+// The functions of 'module' that are called indirectly, that are visible
+// outside of it, or that are large are the roots of the partitions. Every
+// other function is only called directly, by a root or by another such
+// function, and is copied into each partition that calls it, so that LLVM
+// can inline it as it could in 'module'. Roots are distributed over the
+// partitions by size. Roots, and globals that are used by more than one
+// partition, get external linkage and hidden visibility in 'module', so that
+// the partitions can refer to them.
+//
+// Returns no partitions, and leaves 'module' unchanged, if 'module' has fewer
+// than two roots or 'max_partitions' is less than two.
+std::vector<std::unique_ptr<llvm::Module>> SplitModuleForParallelCompilation(
+    llvm::Module* module, int64 max_partitions);
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_LLVM_MODULE_SPLITTER_H_
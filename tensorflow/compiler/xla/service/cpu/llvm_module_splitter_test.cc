@@ -0,0 +1,205 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/llvm_module_splitter.h"
+
+#include <memory>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "tensorflow/compiler/xla/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+class LlvmModuleSplitterTest : public ::testing::Test {
+ protected:
+  std::unique_ptr<llvm::Module> ParseModule(const string& ir) {
+    llvm::SMDiagnostic diagnostic;
+    std::unique_ptr<llvm::Module> module =
+        llvm::parseAssemblyString(ir, diagnostic, context_);
+    CHECK(module != nullptr) << diagnostic.getMessage().str();
+    return module;
+  }
+
+  // Returns the partitions of 'partitions' that define the function or
+  // global named 'name'.
+  static std::vector<int> DefiningPartitions(
+      const std::vector<std::unique_ptr<llvm::Module>>& partitions,
+      const string& name) {
+    std::vector<int> result;
+    for (int i = 0; i < partitions.size(); ++i) {
+      const llvm::GlobalValue* value = partitions[i]->getNamedValue(name);
+      if (value != nullptr && !value->isDeclaration()) {
+        result.push_back(i);
+      }
+    }
+    return result;
+  }
+
+  llvm::LLVMContext context_;
+};
+
+// An entry function that runs two tasks through a runtime function, as the
+// IR emitter does for parallel tasks. Both tasks and the entry function call
+// a small reducer, and the tasks share a constant.
+const char* const kTasksModule = R"(
+@0 = private unnamed_addr constant [4 x float] [float 1.0, float 2.0, float 3.0, float 4.0]
+@1 = private unnamed_addr constant [4 x float] [float 5.0, float 6.0, float 7.0, float 8.0]
+@unused = private constant i32 7
+
+declare void @__xla_cpu_runtime_ParallelForkJoin(i8*)
+
+define internal float @reducer(float %a, float %b) {
+  %sum = fadd float %a, %b
+  ret float %sum
+}
+
+define internal void @task0(float* %out) {
+  %x = load float, float* getelementptr ([4 x float], [4 x float]* @0, i32 0, i32 1)
+  %y = call float @reducer(float %x, float %x)
+  store float %y, float* %out
+  ret void
+}
+
+define internal void @task1(float* %out) {
+  %x = load float, float* getelementptr ([4 x float], [4 x float]* @0, i32 0, i32 0)
+  %y = load float, float* getelementptr ([4 x float], [4 x float]* @1, i32 0, i32 2)
+  %z = call float @reducer(float %x, float %y)
+  store float %z, float* %out
+  ret void
+}
+
+define internal void @dead() {
+  %x = load i32, i32* @unused
+  ret void
+}
+
+define void @entry(float* %out) {
+  call void @__xla_cpu_runtime_ParallelForkJoin(i8* bitcast (void (float*)* @task0 to i8*))
+  call void @__xla_cpu_runtime_ParallelForkJoin(i8* bitcast (void (float*)* @task1 to i8*))
+  %x = call float @reducer(float 1.0, float 2.0)
+  %y = call float @reducer(float %x, float %x)
+  store float %y, float* %out
+  ret void
+}
+)";
+
+TEST_F(LlvmModuleSplitterTest, SplitsIndirectlyCalledFunctions) {
+  std::unique_ptr<llvm::Module> module = ParseModule(kTasksModule);
+  std::vector<std::unique_ptr<llvm::Module>> partitions =
+      SplitModuleForParallelCompilation(module.get(), /*max_partitions=*/8);
+  ASSERT_EQ(partitions.size(), 3);
+  EXPECT_FALSE(llvm::verifyModule(*module, &llvm::errs()));
+  for (const auto& partition : partitions) {
+    EXPECT_FALSE(llvm::verifyModule(*partition, &llvm::errs()));
+    EXPECT_EQ(partition->getFunction("dead"), nullptr);
+    EXPECT_EQ(partition->getNamedGlobal("unused"), nullptr);
+  }
+
+  // Each root is defined once, and called through external declarations.
+  for (const char* root : {"entry", "task0", "task1"}) {
+    EXPECT_EQ(DefiningPartitions(partitions, root).size(), 1) << root;
+    EXPECT_FALSE(module->getFunction(root)->hasLocalLinkage()) << root;
+  }
+  // The reducer is copied into each partition, so that it can be inlined.
+  EXPECT_EQ(DefiningPartitions(partitions, "reducer").size(), 3);
+  for (const auto& partition : partitions) {
+    EXPECT_TRUE(partition->getFunction("reducer")->hasLocalLinkage());
+  }
+
+  // The constant that both tasks use is defined once, and the other one in
+  // the partition of task1.
+  const llvm::GlobalVariable* shared = nullptr;
+  for (const llvm::GlobalVariable& global : module->globals()) {
+    if (!global.hasLocalLinkage() && !global.isDeclaration()) {
+      EXPECT_EQ(shared, nullptr);
+      shared = &global;
+    }
+  }
+  ASSERT_NE(shared, nullptr);
+  EXPECT_EQ(shared->getVisibility(), llvm::GlobalValue::HiddenVisibility);
+  EXPECT_EQ(DefiningPartitions(partitions, shared->getName().str()).size(), 1);
+  const std::vector<int> task1_partition =
+      DefiningPartitions(partitions, "task1");
+  int num_private_globals = 0;
+  for (const llvm::GlobalVariable& global :
+       partitions[task1_partition[0]]->globals()) {
+    num_private_globals += global.hasLocalLinkage();
+  }
+  EXPECT_EQ(num_private_globals, 1);
+}
+
+TEST_F(LlvmModuleSplitterTest, BalancesPartitions) {
+  std::unique_ptr<llvm::Module> module = ParseModule(kTasksModule);
+  std::vector<std::unique_ptr<llvm::Module>> partitions =
+      SplitModuleForParallelCompilation(module.get(), /*max_partitions=*/2);
+  ASSERT_EQ(partitions.size(), 2);
+  // The entry function is the largest root, and gets a partition of its own.
+  const std::vector<int> entry_partition =
+      DefiningPartitions(partitions, "entry");
+  ASSERT_EQ(entry_partition.size(), 1);
+  EXPECT_EQ(DefiningPartitions(partitions, "task0"),
+            DefiningPartitions(partitions, "task1"));
+  EXPECT_NE(DefiningPartitions(partitions, "task0"), entry_partition);
+}
+
+TEST_F(LlvmModuleSplitterTest, DoesNotSplitDirectCalls) {
+  std::unique_ptr<llvm::Module> module = ParseModule(R"(
+define internal float @reducer(float %a, float %b) {
+  %sum = fadd float %a, %b
+  ret float %sum
+}
+
+define float @entry(float %x) {
+  %y = call float @reducer(float %x, float %x)
+  ret float %y
+}
+)");
+  EXPECT_TRUE(
+      SplitModuleForParallelCompilation(module.get(), /*max_partitions=*/8)
+          .empty());
+  EXPECT_TRUE(module->getFunction("reducer")->hasLocalLinkage());
+}
+
+TEST_F(LlvmModuleSplitterTest, SplitsLargeFunctions) {
+  string body = "  %v0 = fadd float %x, %x\n";
+  for (int i = 1; i < kMinInstructionsToSplitFunction; ++i) {
+    absl::StrAppend(&body, "  %v", i, " = fadd float %v", i - 1, ", %x\n");
+  }
+  std::unique_ptr<llvm::Module> module = ParseModule(absl::StrCat(
+      "define internal float @large(float %x) {\n", body, "  ret float %v",
+      kMinInstructionsToSplitFunction - 1, "\n}\n\n",
+      "define float @entry(float %x) {\n",
+      "  %y = call float @large(float %x)\n", "  ret float %y\n}\n"));
+  std::vector<std::unique_ptr<llvm::Module>> partitions =
+      SplitModuleForParallelCompilation(module.get(), /*max_partitions=*/8);
+  ASSERT_EQ(partitions.size(), 2);
+  EXPECT_EQ(DefiningPartitions(partitions, "large").size(), 1);
+  EXPECT_EQ(DefiningPartitions(partitions, "entry").size(), 1);
+  for (const auto& partition : partitions) {
+    EXPECT_FALSE(llvm::verifyModule(*partition, &llvm::errs()));
+  }
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
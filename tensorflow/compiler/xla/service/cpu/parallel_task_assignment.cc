@@ -15,14 +15,21 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/cpu/parallel_task_assignment.h"
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_options.h"
 #include "tensorflow/compiler/xla/service/cpu/dot_op_emitter.h"
+#include "tensorflow/compiler/xla/service/cpu/inter_op_parallelizer.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
 #include "tensorflow/compiler/xla/service/cpu/shape_partition.h"
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/service/while_loop_analysis.h"
+#include "tensorflow/core/platform/env.h"
 
 namespace xla {
 namespace cpu {
@@ -104,10 +111,135 @@ class DefaultCostModel : public ParallelCostModel {
   const std::unique_ptr<HloCostAnalysis> cost_analysis_;
 };
 
+// Returns how many times each computation runs per execution of 'module',
+// for the computations reached from the entry computation through kWhile
+// bodies with a statically known trip count and through kCall.
+static absl::flat_hash_map<const HloComputation*, int64>
+ComputeExecutionCounts(HloModule* module) {
+  // A count of -1 marks computations that run an unknown number of times.
+  absl::flat_hash_map<const HloComputation*, int64> execution_counts;
+  auto add_executions = [&](const HloComputation* computation, int64 count) {
+    int64& total = execution_counts[computation];
+    total = (total < 0 || count < 0) ? -1 : total + count;
+  };
+  execution_counts[module->entry_computation()] = 1;
+  // Visit callers before callees, so that every count is final when used.
+  std::vector<HloComputation*> post_order = module->MakeComputationPostOrder();
+  for (auto it = post_order.rbegin(); it != post_order.rend(); ++it) {
+    auto count_it = execution_counts.find(*it);
+    if (count_it == execution_counts.end()) {
+      continue;
+    }
+    const int64 count = count_it->second;
+    for (auto* instruction : (*it)->instructions()) {
+      if (instruction->opcode() == HloOpcode::kWhile) {
+        absl::optional<int64> trip_count =
+            ComputeWhileLoopTripCount(instruction);
+        add_executions(instruction->while_body(),
+                       trip_count && count >= 0 ? count * *trip_count : -1);
+      } else if (instruction->opcode() == HloOpcode::kCall) {
+        add_executions(instruction->to_apply(), count);
+      }
+    }
+  }
+  for (auto it = execution_counts.begin(); it != execution_counts.end();) {
+    auto current = it++;
+    if (current->second <= 0) {
+      execution_counts.erase(current);
+    }
+  }
+  return execution_counts;
+}
+
+// Returns the name of the instruction described by 'instruction_info', the
+// "%name" that starts its long name.
+static absl::string_view InstructionName(
+    const HloProfilePrinterData::HloInstructionInfo& instruction_info) {
+  absl::string_view name = instruction_info.long_name();
+  name = name.substr(0, name.find(" = "));
+  absl::ConsumePrefix(&name, "%");
+  return name;
+}
+
+// Assigns parallel task counts from the cycles that instructions took in a
+// previous run of the module with a single thread, and falls back to
+// 'fallback' for instructions without measurements. Measured cycles include
+// effects that HloCostAnalysis does not model, like cache misses, vector
+// code and the actual cost of transcendental functions.
+class ProfileGuidedCostModel : public ParallelCostModel {
+ public:
+  ProfileGuidedCostModel(const int64 max_parallelism,
+                         const HloExecutionProfileData& profile,
+                         HloModule* module,
+                         std::unique_ptr<ParallelCostModel> fallback)
+      : max_parallelism_(max_parallelism), fallback_(std::move(fallback)) {
+    // The profile counters of instructions in loop bodies and called
+    // computations add up the cycles of all their executions.
+    const absl::flat_hash_map<const HloComputation*, int64> execution_counts =
+        ComputeExecutionCounts(module);
+    absl::flat_hash_map<absl::string_view, const HloComputation*>
+        computations_by_name;
+    for (auto* computation : module->computations()) {
+      computations_by_name[computation->name()] = computation;
+    }
+    const auto& counters = profile.profile_counters();
+    for (const auto& computation_info :
+         profile.printer_data().computation_infos()) {
+      auto computation_it = computations_by_name.find(computation_info.name());
+      if (computation_it == computations_by_name.end()) {
+        continue;
+      }
+      const HloComputation* computation = computation_it->second;
+      auto count_it = execution_counts.find(computation);
+      if (count_it == execution_counts.end()) {
+        continue;
+      }
+      absl::flat_hash_map<absl::string_view, const HloInstruction*>
+          instructions_by_name;
+      for (auto* instruction : computation->instructions()) {
+        instructions_by_name[instruction->name()] = instruction;
+      }
+      for (const auto& instruction_info :
+           computation_info.instruction_infos()) {
+        auto instruction_it =
+            instructions_by_name.find(InstructionName(instruction_info));
+        const int64 index = instruction_info.profile_index();
+        if (instruction_it == instructions_by_name.end() || index < 0 ||
+            index >= counters.size() || counters.Get(index) <= 0) {
+          continue;
+        }
+        cycles_per_execution_[instruction_it->second] =
+            counters.Get(index) / count_it->second;
+      }
+    }
+    VLOG(1) << "ProfileGuidedCostModel measured instructions: "
+            << cycles_per_execution_.size();
+  }
+  ~ProfileGuidedCostModel() override {}
+
+  int64 GetParallelTaskCount(HloInstruction* instruction) override {
+    auto it = cycles_per_execution_.find(instruction);
+    if (it == cycles_per_execution_.end()) {
+      return fallback_->GetParallelTaskCount(instruction);
+    }
+    // Same minimum per-thread cost as DefaultCostModel, in measured cycles.
+    const int64 min_cycles_per_thread = 100000;
+    // Return target parallel task count in [1, max_parallelism_].
+    return std::min(max_parallelism_,
+                    std::max(int64{1}, it->second / min_cycles_per_thread));
+  }
+
+ private:
+  const int64 max_parallelism_;
+  const std::unique_ptr<ParallelCostModel> fallback_;
+  absl::flat_hash_map<const HloInstruction*, int64> cycles_per_execution_;
+};
+
 ParallelTaskAssignment::ParallelTaskAssignment(
     const int64 max_parallelism,
     const HloCostAnalysis::ShapeSizeFunction& shape_size, HloModule* module,
-    const TargetMachineFeatures* target_machine_features)
+    const TargetMachineFeatures* target_machine_features,
+    const HloExecutionProfileData* profile)
     : target_machine_features_(*target_machine_features) {
   VLOG(1) << "ParallelTaskAssignment max_parallelism: " << max_parallelism;
   // Run cost analysis on 'module'.
@@ -124,6 +256,10 @@ ParallelTaskAssignment::ParallelTaskAssignment(
     // HLOs like CustomCall are not yet implemented in the HloCostAnalysis).
     cost_model_.reset(new SimpleCostModel(max_parallelism, shape_size));
   }
+  if (profile != nullptr) {
+    cost_model_.reset(new ProfileGuidedCostModel(
+        max_parallelism, *profile, module, std::move(cost_model_)));
+  }
 }
 
 int64 ParallelTaskAssignment::GetTargetParallelTaskCount(
@@ -158,9 +294,18 @@ int64 ParallelTaskAssignment::GetTargetParallelTaskCount(
 StatusOr<bool> ParallelTaskAssigner::Run(HloModule* module) {
   XLA_VLOG_LINES(2, "ParallelTaskAssigner ENTRY");
   XLA_VLOG_LINES(3, module->ToString());
+  // Load the profile of a previous run, if one is configured.
+  std::unique_ptr<HloExecutionProfileData> profile;
+  if (absl::optional<string> profile_path =
+          options::ParallelTaskProfilePath(module->config())) {
+    profile = absl::make_unique<HloExecutionProfileData>();
+    TF_RETURN_IF_ERROR(tensorflow::ReadBinaryProto(
+        tensorflow::Env::Default(), *profile_path, profile.get()));
+  }
+
   // Compute target parallel task counts for all instructions in 'module'.
   HloToParallelTasks hlo_to_parallel_tasks;
-  ComputeTargetParallelTasks(module, &hlo_to_parallel_tasks);
+  ComputeTargetParallelTasks(module, profile.get(), &hlo_to_parallel_tasks);
 
   // Assign parallel tasks to target specific instructions in 'module'.
   // TODO(b/27458679) Support inter-op parallelism.
@@ -193,8 +338,12 @@ bool ParallelTaskAssigner::AssignParallelTasksHelper(
                                            hlo_to_parallel_tasks);
       continue;
     } else if (instruction->opcode() == HloOpcode::kCall) {
-      changed |= AssignParallelTasksHelper(module, instruction->to_apply(),
-                                           hlo_to_parallel_tasks);
+      // Concurrent calls already run on the threads of the intra-op thread
+      // pool, so their computations stay sequential.
+      if (!IsConcurrentCall(*instruction)) {
+        changed |= AssignParallelTasksHelper(module, instruction->to_apply(),
+                                             hlo_to_parallel_tasks);
+      }
       continue;
     }
     // Skip if no parallel tasks were computed in first pass.
@@ -232,10 +381,11 @@ bool ParallelTaskAssigner::AssignParallelTasksHelper(
 }
 
 void ParallelTaskAssigner::ComputeTargetParallelTasks(
-    HloModule* module, HloToParallelTasks* hlo_to_parallel_tasks) {
-  ParallelTaskAssignment parallel_task_assignment(max_parallelism_,
-                                                  shape_size_function_, module,
-                                                  &target_machine_features_);
+    HloModule* module, const HloExecutionProfileData* profile,
+    HloToParallelTasks* hlo_to_parallel_tasks) {
+  ParallelTaskAssignment parallel_task_assignment(
+      max_parallelism_, shape_size_function_, module,
+      &target_machine_features_, profile);
 
   // Compute parallel task counts for all instructions in 'module'.
   for (auto* computation : module->MakeNonfusionComputations()) {
@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/cpu/target_machine_features.h"
 #include "tensorflow/compiler/xla/service/hlo_cost_analysis.h"
+#include "tensorflow/compiler/xla/service/hlo_execution_profile_data.pb.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
 
@@ -38,10 +39,15 @@ class ParallelTaskAssignment {
   // 'shape_size': shape size function used by HloCostAnalysis during parallel
   //               task assignment.
   // 'module': the containing HloModule.
+  // 'profile': if not null, an execution profile of a previous run of
+  //            'module' with a single thread. Instructions it measured are
+  //            assigned task counts from their measured cycles instead of
+  //            from HloCostAnalysis.
   ParallelTaskAssignment(const int64 max_parallelism,
                          const HloCostAnalysis::ShapeSizeFunction& shape_size,
                          HloModule* module,
-                         const TargetMachineFeatures* target_machine_features);
+                         const TargetMachineFeatures* target_machine_features,
+                         const HloExecutionProfileData* profile = nullptr);
   ~ParallelTaskAssignment() {}
 
   // Computes and returns the target parallel task count for 'instruction'.
@@ -60,6 +66,8 @@ class ParallelTaskAssignment {
 // own embedded computation, which is compiled as a parallel compute function,
 // and which is invoked from a kCall instruction that is lowered in codegen to
 // a runtime parallel fork/join call.
+// If the module config names a profile of a previous run (see
+// options::ParallelTaskProfilePath), the profile guides the task counts.
 class ParallelTaskAssigner : public HloModulePass {
  public:
   // 'max_parallelism': the maximum parallel task count per instruction.
@@ -94,8 +102,10 @@ class ParallelTaskAssigner : public HloModulePass {
       const HloToParallelTasks& hlo_to_parallel_tasks);
 
   // Computes target parallel task counts (returned in 'parallel_task_counts')
-  // for parallelizable instructions in 'module'.
+  // for parallelizable instructions in 'module', using 'profile' if it is not
+  // null.
   void ComputeTargetParallelTasks(HloModule* module,
+                                  const HloExecutionProfileData* profile,
                                   HloToParallelTasks* hlo_to_parallel_tasks);
 
   int64 max_parallelism_;
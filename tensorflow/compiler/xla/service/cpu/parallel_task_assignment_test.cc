@@ -14,11 +14,18 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/compiler/xla/service/cpu/parallel_task_assignment.h"
+
+#include <map>
+
+#include "absl/strings/str_cat.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_executable.h"
 #include "tensorflow/compiler/xla/service/cpu/target_machine_features_fake.h"
+#include "tensorflow/compiler/xla/service/hlo_execution_profile.h"
 #include "tensorflow/compiler/xla/test.h"
 #include "tensorflow/compiler/xla/tests/hlo_test_base.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
 
 namespace xla {
 namespace {
@@ -44,6 +51,43 @@ class ParallelTaskAssignmentTest : public HloTestBase {
                                      &target_machine_features_)
         .Run(module);
   }
+
+  // Parses 'hlo_string' with a profile that records 'cycles' for the named
+  // instructions and zero for all others.
+  StatusOr<std::unique_ptr<VerifiedHloModule>> ParseWithProfile(
+      const string& hlo_string,
+      const std::map<string, int64>& cycles_by_instruction_name) {
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<VerifiedHloModule> profiled_module,
+                        ParseAndReturnVerifiedModule(hlo_string));
+    HloCostAnalysis cost_analysis(shape_size_func_);
+    HloProfileIndexMap profile_index_map(*profiled_module);
+    std::unique_ptr<HloProfilePrinterData> profile_printer_data =
+        CreateHloProfilePrinterData(
+            profile_index_map, cost_analysis,
+            profiled_module->entry_computation()->name());
+    HloExecutionProfile profile(profile_printer_data.get(),
+                                &profile_index_map);
+    for (const auto* computation : profiled_module->computations()) {
+      for (const auto* instruction : computation->instructions()) {
+        auto it = cycles_by_instruction_name.find(instruction->name());
+        if (it != cycles_by_instruction_name.end()) {
+          profile.SetCyclesTakenBy(instruction, it->second);
+        }
+      }
+    }
+    const string profile_path = tensorflow::io::JoinPath(
+        tensorflow::testing::TmpDir(),
+        absl::StrCat(profiled_module->name(), ".profile.pb"));
+    TF_RETURN_IF_ERROR(tensorflow::WriteBinaryProto(
+        tensorflow::Env::Default(), profile_path, profile.ToProto()));
+
+    HloModuleConfig config = GetModuleConfigForTest();
+    DebugOptions debug_options = config.debug_options();
+    (*debug_options.mutable_xla_backend_extra_options())
+        ["xla_cpu_parallel_task_profile"] = profile_path;
+    config.set_debug_options(debug_options);
+    return ParseAndReturnVerifiedModule(hlo_string, config);
+  }
 };
 
 TEST_F(ParallelTaskAssignmentTest, DotOperationNotParallelized) {
@@ -125,5 +169,101 @@ TEST_F(ParallelTaskAssignmentTest, InfeedOutfeedOperationNotParallelized) {
   EXPECT_FALSE(changed);
 }
 
+TEST_F(ParallelTaskAssignmentTest, ProfileParallelizesSmallExpensiveOp) {
+  // Too small for HloCostAnalysis to parallelize, but measured to be slow.
+  const string hlo_string = R"(
+    HloModule TestTaskParallel_profile_small
+    ENTRY Exp {
+      p0 = f32[1000]{0} parameter(0)
+      ROOT exp = f32[1000]{0} exponential(p0)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_FALSE(changed);
+
+  TF_ASSERT_OK_AND_ASSIGN(m, ParseWithProfile(hlo_string, {{"exp", 1000000}}));
+  TF_ASSERT_OK_AND_ASSIGN(changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_TRUE(changed);
+}
+
+TEST_F(ParallelTaskAssignmentTest, ProfileKeepsLargeCheapOpSequential) {
+  // Large, but measured to take less than the minimum per-thread cost.
+  const string hlo_string = R"(
+    HloModule TestTaskParallel_profile_large
+    ENTRY Add {
+      p0 = f32[4096,1024]{1,0} parameter(0)
+      p1 = f32[4096,1024]{1,0} parameter(1)
+      ROOT add = f32[4096,1024]{1,0} add(p0, p1)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseWithProfile(hlo_string, {{"add", 50000}}));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(ParallelTaskAssignmentTest, ProfileCyclesInLoopAreDividedByTripCount) {
+  const string hlo_string = R"(
+    HloModule TestTaskParallel_profile_loop
+    cond {
+      p = (s32[], f32[1000]) parameter(0)
+      i = s32[] get-tuple-element(p), index=0
+      limit = s32[] constant(100)
+      ROOT lt = pred[] compare(i, limit), direction=LT
+    }
+    body {
+      p = (s32[], f32[1000]) parameter(0)
+      i = s32[] get-tuple-element(p), index=0
+      one = s32[] constant(1)
+      next_i = s32[] add(i, one)
+      x = f32[1000] get-tuple-element(p), index=1
+      exp = f32[1000] exponential(x)
+      ROOT t = (s32[], f32[1000]) tuple(next_i, exp)
+    }
+    ENTRY Loop {
+      p0 = f32[1000] parameter(0)
+      zero = s32[] constant(0)
+      init = (s32[], f32[1000]) tuple(zero, p0)
+      ROOT while = (s32[], f32[1000]) while(init), condition=cond, body=body
+    }
+  )";
+
+  // The counters add up all 100 iterations. 1000000 cycles per iteration are
+  // worth parallelizing, but 100000 cycles per iteration are not.
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseWithProfile(hlo_string, {{"exp", 100000000}}));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_TRUE(changed);
+
+  TF_ASSERT_OK_AND_ASSIGN(m,
+                          ParseWithProfile(hlo_string, {{"exp", 10000000}}));
+  TF_ASSERT_OK_AND_ASSIGN(changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(ParallelTaskAssignmentTest, MissingProfileIsAnError) {
+  const string hlo_string = R"(
+    HloModule TestTaskParallel_profile_missing
+    ENTRY Exp {
+      p0 = f32[1000]{0} parameter(0)
+      ROOT exp = f32[1000]{0} exponential(p0)
+    }
+  )";
+
+  HloModuleConfig config = GetModuleConfigForTest();
+  DebugOptions debug_options = config.debug_options();
+  (*debug_options.mutable_xla_backend_extra_options())
+      ["xla_cpu_parallel_task_profile"] =
+          tensorflow::io::JoinPath(tensorflow::testing::TmpDir(), "missing");
+  config.set_debug_options(debug_options);
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string, config));
+  EXPECT_FALSE(RunParallelTaskAssigner(m.get()).ok());
+}
+
 }  // namespace
 }  // namespace xla
@@ -30,6 +30,8 @@ using tensorflow::uint64;
 
 using ComputeFunctionType = void (*)(void*, const void*, const void**, void**,
                                      int64*, uint64*);
+using CallFunctionType = void (*)(void*, const void*, const void**, void**,
+                                  uint64*);
 
 // Dispatches 'num_partitions - 1' calls to 'function_ptr' in parallel.
 // Calls 'function_ptr' for first partition inline.
@@ -102,3 +104,55 @@ TF_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_ParallelForkJoin(
   bc.Wait();
   VLOG(2) << "ParallelForkJoin EXIT";
 }
+
+// Dispatches calls to 'functions[1]' to 'functions[num_calls - 1]' to the
+// intra-op thread pool, calls 'functions[0]' inline, and waits for all calls
+// to complete.
+//
+// The functions are compute functions of computations that run inside
+// concurrent calls. They get a copy of the run options without the intra-op
+// thread pool: their calls already occupy threads of the pool, and a nested
+// fork/join on it could wait for work that is queued behind itself. The
+// functions are called one after the other if there is no thread pool, or if
+// 'prof_counters' is set, so that the profile measures each call on its own.
+TF_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_ParallelCalls(
+    void* result_ptr, const void* run_options_ptr, const void** params,
+    void** buffer_table, uint64* prof_counters, int32 num_calls,
+    void** functions) {
+  VLOG(2) << "ParallelCalls ENTRY num_calls: " << num_calls;
+  CHECK_GT(num_calls, 1);
+  CHECK_NE(functions, nullptr);
+  const xla::ExecutableRunOptions* run_options =
+      static_cast<const xla::ExecutableRunOptions*>(run_options_ptr);
+  CHECK_NE(run_options, nullptr);
+
+  xla::ExecutableRunOptions call_run_options = *run_options;
+  call_run_options.set_intra_op_thread_pool(nullptr);
+  auto call = [&](int32 i) {
+    reinterpret_cast<CallFunctionType>(functions[i])(
+        result_ptr, &call_run_options, params, buffer_table, prof_counters);
+  };
+
+  if (run_options->intra_op_thread_pool() == nullptr ||
+      prof_counters != nullptr) {
+    for (int32 i = 0; i < num_calls; ++i) {
+      call(i);
+    }
+    VLOG(2) << "ParallelCalls EXIT";
+    return;
+  }
+
+  tensorflow::BlockingCounter bc(num_calls - 1);
+  for (int32 i = 1; i < num_calls; ++i) {
+    run_options->intra_op_thread_pool()->enqueueNoNotification([i, &call,
+                                                                 &bc]() {
+      call(i);
+      bc.DecrementCount();
+      VLOG(3) << "ParallelCalls call " << i << " done.";
+    });
+  }
+  call(0);
+  VLOG(3) << "ParallelCalls call 0 done.";
+  bc.Wait();
+  VLOG(2) << "ParallelCalls EXIT";
+}
@@ -28,6 +28,14 @@ extern void __xla_cpu_runtime_ParallelForkJoin(
     tensorflow::int32 num_partitions, tensorflow::int64* partitions,
     tensorflow::int32 num_partitioned_dims, void* function_ptr);
 
+// Calls the 'num_calls' compute functions in 'functions' concurrently and
+// joins threads before returning. See comments in runtime_fork_join.cc for
+// details.
+extern void __xla_cpu_runtime_ParallelCalls(
+    void* result_ptr, const void* run_options_ptr, const void** params,
+    void** buffer_table, tensorflow::uint64* prof_counters,
+    tensorflow::int32 num_calls, void** functions);
+
 }  // extern "C"
 
 #endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_FORK_JOIN_H_
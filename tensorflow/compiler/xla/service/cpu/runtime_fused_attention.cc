@@ -0,0 +1,108 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/runtime_fused_attention.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/platform/dynamic_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+using tensorflow::int64;
+
+namespace {
+
+using RowMajorMatrix =
+    Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+using ConstMatrixMap = Eigen::Map<const RowMajorMatrix>;
+using MatrixMap = Eigen::Map<RowMajorMatrix>;
+
+// The number of queries and keys in a block. A block of scores takes 64KB,
+// and, with the queries, keys and values it is computed from, stays in L2 for
+// the usual head dimensions.
+constexpr int64 kQueryBlockSize = 64;
+constexpr int64 kKeyBlockSize = 256;
+
+// Computes the attention of 'q_len' queries to 'kv_len' keys and values.
+void Attend(const float* q, const float* k, const float* v, float* out,
+            int64 q_len, int64 kv_len, int64 head_dim, int64 value_dim,
+            float scale) {
+  // Without keys, every softmax is empty and the attention is zero, as the dot
+  // with an empty contraction it replaces is, rather than 0 / 0.
+  if (kv_len == 0) {
+    std::fill(out, out + q_len * value_dim, 0.0f);
+    return;
+  }
+  RowMajorMatrix scores(std::min(q_len, kQueryBlockSize),
+                        std::min(kv_len, kKeyBlockSize));
+  Eigen::VectorXf row_max(scores.rows());
+  Eigen::VectorXf row_sum(scores.rows());
+  for (int64 q_begin = 0; q_begin < q_len; q_begin += kQueryBlockSize) {
+    const int64 q_size = std::min(kQueryBlockSize, q_len - q_begin);
+    ConstMatrixMap q_block(q + q_begin * head_dim, q_size, head_dim);
+    MatrixMap out_block(out + q_begin * value_dim, q_size, value_dim);
+    out_block.setZero();
+    row_max.head(q_size).setConstant(-std::numeric_limits<float>::infinity());
+    row_sum.head(q_size).setZero();
+
+    for (int64 k_begin = 0; k_begin < kv_len; k_begin += kKeyBlockSize) {
+      const int64 k_size = std::min(kKeyBlockSize, kv_len - k_begin);
+      ConstMatrixMap k_block(k + k_begin * head_dim, k_size, head_dim);
+      ConstMatrixMap v_block(v + k_begin * value_dim, k_size, value_dim);
+      auto block = scores.topLeftCorner(q_size, k_size);
+      block.noalias() = q_block * k_block.transpose();
+
+      // Rescales what the previous blocks contributed to the maximum this
+      // block raises it to, as the softmax over all keys so far would.
+      for (int64 i = 0; i < q_size; ++i) {
+        auto row = block.row(i).array();
+        row *= scale;
+        const float new_max = std::max(row_max(i), row.maxCoeff());
+        const float correction = std::exp(row_max(i) - new_max);
+        row = (row - new_max).exp();
+        row_sum(i) = row_sum(i) * correction + row.sum();
+        out_block.row(i) *= correction;
+        row_max(i) = new_max;
+      }
+      out_block.noalias() += block * v_block;
+    }
+    out_block.array().colwise() /= row_sum.head(q_size).array();
+  }
+}
+
+}  // namespace
+
+TF_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_FusedAttentionF32(
+    void* out, const void** operands) {
+  const int64* dims = static_cast<const int64*>(operands[3]);
+  const int64 batch = dims[0];
+  const int64 q_len = dims[1];
+  const int64 kv_len = dims[2];
+  const int64 head_dim = dims[3];
+  const int64 value_dim = dims[4];
+  const float scale = *static_cast<const float*>(operands[4]);
+  const float* q = static_cast<const float*>(operands[0]);
+  const float* k = static_cast<const float*>(operands[1]);
+  const float* v = static_cast<const float*>(operands[2]);
+  float* result = static_cast<float*>(out);
+  for (int64 b = 0; b < batch; ++b) {
+    Attend(q + b * q_len * head_dim, k + b * kv_len * head_dim,
+           v + b * kv_len * value_dim, result + b * q_len * value_dim, q_len,
+           kv_len, head_dim, value_dim, scale);
+  }
+}
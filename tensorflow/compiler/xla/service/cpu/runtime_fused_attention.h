@@ -0,0 +1,38 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_FUSED_ATTENTION_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_FUSED_ATTENTION_H_
+
+#include "tensorflow/core/platform/types.h"
+
+extern "C" {
+
+// Computes attention, softmax(scale * q * k^T) * v, for each of 'batch'
+// problems. A custom call target with the signature the CPU backend calls
+// custom call targets with (see AttentionRewriter):
+// - 'out' is the row-major f32[batch, q_len, value_dim] result.
+// - 'operands' are the row-major f32[batch, q_len, head_dim] queries,
+//   f32[batch, kv_len, head_dim] keys and f32[batch, kv_len, value_dim]
+//   values, an s64[5] array of batch, q_len, kv_len, head_dim and value_dim,
+//   and the f32[] scale.
+// The scores are computed and normalized a block of queries and keys at a
+// time, with a running maximum and sum per query, so the [q_len, kv_len]
+// matrix of scores is never materialized.
+extern void __xla_cpu_runtime_FusedAttentionF32(void* out,
+                                                const void** operands);
+}
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_FUSED_ATTENTION_H_
@@ -12,22 +12,331 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
+
 #include "tensorflow/compiler/xla/service/cpu/runtime_key_value_sort.h"
 
+#define EIGEN_USE_THREADS
+
 #include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <numeric>
-#include <string>
+#include <type_traits>
+#include <vector>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/compiler/xla/executable_run_options.h"
 #include "tensorflow/core/platform/dynamic_annotations.h"
+#include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
 
 namespace {
+using tensorflow::int16;
 using tensorflow::int32;
 using tensorflow::int64;
+using tensorflow::int8;
+using tensorflow::uint16;
+using tensorflow::uint32;
+using tensorflow::uint64;
+using tensorflow::uint8;
+
+// A row at least this long is split into chunks that are sorted in parallel
+// and then merged, when there are too few rows to keep the threads busy.
+constexpr int64 kMinParallelMergeSortElements = 1 << 15;
+
+// Rows shorter than this are sorted with std::sort instead of a radix sort.
+constexpr int64 kMinRadixSortElements = 256;
+
+// Estimated cycles per comparison through the compiled comparator.
+constexpr double kComparatorCycles = 20;
+
+// Returns the intra-op thread pool, or nullptr if sorts must run on the
+// calling thread. With profiling enabled the comparator updates the profile
+// counters, which must not be done from several threads.
+const Eigen::ThreadPoolDevice* GetThreadPool(const char* run_options,
+                                             const int64* prof_counters) {
+  if (run_options == nullptr || prof_counters != nullptr) {
+    return nullptr;
+  }
+  const Eigen::ThreadPoolDevice* pool =
+      reinterpret_cast<const xla::ExecutableRunOptions*>(run_options)
+          ->intra_op_thread_pool();
+  return pool != nullptr && pool->numThreads() > 1 ? pool : nullptr;
+}
+
+// Runs fn(begin, end) over [0, n), in parallel on `pool` if it is not null.
+void ParallelFor(const Eigen::ThreadPoolDevice* pool, int64 n,
+                 double cycles_per_unit,
+                 const std::function<void(int64, int64)>& fn) {
+  if (pool == nullptr || n <= 1) {
+    fn(0, n);
+    return;
+  }
+  pool->parallelFor(n, Eigen::TensorOpCost(0, 0, cycles_per_unit),
+                    [&fn](Eigen::Index begin, Eigen::Index end) {
+                      fn(begin, end);
+                    });
+}
+
+double SortCycles(int64 n) {
+  return kComparatorCycles * n * std::max(1.0, std::log2(n));
+}
+
+// Returns the number of elements of `a` among the first `k` elements of
+// std::merge(a, a + m, b, b + n, out, less), so that merging the pieces of
+// `a` and `b` it splits at separately gives the same (stable) result.
+template <typename T, typename Less>
+int64 MergeSplit(int64 k, const T* a, int64 m, const T* b, int64 n,
+                 Less& less) {
+  int64 lo = std::max<int64>(0, k - n);
+  int64 hi = std::min(k, m);
+  while (true) {
+    const int64 i = lo + (hi - lo) / 2;
+    const int64 j = k - i;
+    if (i > 0 && j < n && less(b[j], a[i - 1])) {
+      hi = i - 1;
+    } else if (j > 0 && i < m && !less(b[j - 1], a[i])) {
+      lo = i + 1;
+    } else {
+      return i;
+    }
+  }
+}
+
+// Sorts data[0, n) by sorting up to one chunk per thread with
+// sort_chunk(first, last, less), then merging adjacent chunks in rounds. The
+// merges of a round are split into pieces of roughly equal output size, so
+// the last round still uses all threads. The result is stable if sort_chunk
+// is. make_less() returns a comparator for use by a single thread.
+template <typename T, typename MakeLess, typename SortChunk>
+void ParallelMergeSort(T* data, int64 n, const MakeLess& make_less,
+                       const SortChunk& sort_chunk,
+                       const Eigen::ThreadPoolDevice* pool) {
+  const int64 num_threads = pool->numThreads();
+  const int64 num_chunks = std::max<int64>(
+      1, std::min(num_threads, n / (kMinParallelMergeSortElements / 4)));
+  std::vector<int64> bounds(num_chunks + 1);
+  for (int64 i = 0; i <= num_chunks; ++i) {
+    bounds[i] = n * i / num_chunks;
+  }
+  ParallelFor(pool, num_chunks, SortCycles(n / num_chunks),
+              [&](int64 begin, int64 end) {
+                auto less = make_less();
+                for (int64 i = begin; i < end; ++i) {
+                  sort_chunk(data + bounds[i], data + bounds[i + 1], less);
+                }
+              });
+
+  std::unique_ptr<T[]> buffer(new T[n]);
+  T* src = data;
+  T* dst = buffer.get();
+  for (int64 width = 1; width < num_chunks; width *= 2) {
+    const int64 num_merges = (num_chunks + 2 * width - 1) / (2 * width);
+    const int64 pieces_per_merge =
+        std::max<int64>(1, (num_threads + num_merges - 1) / num_merges);
+    ParallelFor(
+        pool, num_merges * pieces_per_merge,
+        kComparatorCycles * n / (num_merges * pieces_per_merge),
+        [&](int64 begin, int64 end) {
+          auto less = make_less();
+          for (int64 task = begin; task < end; ++task) {
+            const int64 merge = task / pieces_per_merge;
+            const int64 piece = task % pieces_per_merge;
+            const int64 lo = bounds[merge * 2 * width];
+            const int64 mid =
+                bounds[std::min(merge * 2 * width + width, num_chunks)];
+            const int64 hi =
+                bounds[std::min(merge * 2 * width + 2 * width, num_chunks)];
+            const int64 m = mid - lo;
+            const int64 total = hi - lo;
+            const int64 k_begin = total * piece / pieces_per_merge;
+            const int64 k_end = total * (piece + 1) / pieces_per_merge;
+            const int64 i_begin =
+                MergeSplit(k_begin, src + lo, m, src + mid, hi - mid, less);
+            const int64 i_end =
+                MergeSplit(k_end, src + lo, m, src + mid, hi - mid, less);
+            std::merge(src + lo + i_begin, src + lo + i_end,
+                       src + mid + (k_begin - i_begin),
+                       src + mid + (k_end - i_end), dst + lo + k_begin,
+                       std::ref(less));
+          }
+        });
+    std::swap(src, dst);
+  }
+  if (src != data) {
+    std::copy(src, src + n, data);
+  }
+}
+
+// Compares the elements at two indices of a row through the compiled
+// comparator. Not thread-safe; every thread uses its own instance.
+class RowComparator {
+ public:
+  RowComparator(char** values, int32 values_count, const int32* value_sizes,
+                char* run_options, int64* prof_counters,
+                void (*less_than)(char*, char*, char**, char**, int64*))
+      : values_(values),
+        values_count_(values_count),
+        value_sizes_(value_sizes),
+        run_options_(run_options),
+        prof_counters_(prof_counters),
+        less_than_(less_than),
+        comparison_values_(2 * values_count) {}
+
+  void set_row(int64 base_offset, int64 stride) {
+    base_offset_ = base_offset;
+    stride_ = stride;
+  }
+
+  bool operator()(int64 lhs, int64 rhs) {
+    const int64 lhs_element = base_offset_ + lhs * stride_;
+    const int64 rhs_element = base_offset_ + rhs * stride_;
+    for (int32 i = 0; i < values_count_; ++i) {
+      comparison_values_[i * 2] = values_[i] + lhs_element * value_sizes_[i];
+      comparison_values_[i * 2 + 1] =
+          values_[i] + rhs_element * value_sizes_[i];
+    }
+    char result = 0;  // Overwritten by less_than.
+    less_than_(&result, run_options_, comparison_values_.data(), nullptr,
+               prof_counters_);
+    return result != 0u;
+  }
+
+ private:
+  char** values_;
+  int32 values_count_;
+  const int32* value_sizes_;
+  char* run_options_;
+  int64* prof_counters_;
+  void (*less_than_)(char*, char*, char**, char**, int64*);
+  std::vector<char*> comparison_values_;
+  int64 base_offset_ = 0;
+  int64 stride_ = 1;
+};
+
+// Permutes a row of each of the values into the order given by `indices`,
+// using `scratch` of at least n times the largest value size.
+void ReorderRow(char** values, int32 values_count, const int32* value_sizes,
+                int64 base_offset, int64 stride, const int64* indices, int64 n,
+                char* scratch) {
+  for (int32 idx = 0; idx < values_count; ++idx) {
+    const int64 size = value_sizes[idx];
+    char* row = values[idx] + base_offset * size;
+    for (int64 i = 0; i < n; ++i) {
+      memcpy(scratch + i * size, row + indices[i] * stride * size, size);
+    }
+    for (int64 i = 0; i < n; ++i) {
+      memcpy(row + i * stride * size, scratch + i * size, size);
+    }
+  }
+}
+
+// Maps integer keys to unsigned integers with the same (or, if `descending`,
+// the opposite) order, and back.
+template <typename T>
+struct OrderedBits {
+  using Unsigned = typename std::make_unsigned<T>::type;
+  static constexpr Unsigned kSignBit =
+      std::is_signed<T>::value
+          ? static_cast<Unsigned>(Unsigned{1} << (sizeof(T) * 8 - 1))
+          : Unsigned{0};
+
+  static Unsigned Encode(T key, bool descending) {
+    const Unsigned bits = static_cast<Unsigned>(key) ^ kSignBit;
+    return descending ? static_cast<Unsigned>(~bits) : bits;
+  }
+  static T Decode(Unsigned bits, bool descending) {
+    if (descending) {
+      bits = static_cast<Unsigned>(~bits);
+    }
+    return static_cast<T>(static_cast<Unsigned>(bits ^ kSignBit));
+  }
+};
+
+// Sorts [first, last) with an LSD radix sort on bytes, skipping the bytes in
+// which all keys agree.
+template <typename U>
+void RadixSort(U* first, U* last) {
+  const int64 n = last - first;
+  if (n < kMinRadixSortElements) {
+    std::sort(first, last);
+    return;
+  }
+  std::unique_ptr<U[]> buffer(new U[n]);
+  U* src = first;
+  U* dst = buffer.get();
+  for (int shift = 0; shift < static_cast<int>(sizeof(U)) * 8; shift += 8) {
+    int64 offsets[256] = {0};
+    for (int64 i = 0; i < n; ++i) {
+      ++offsets[(src[i] >> shift) & 0xFF];
+    }
+    if (offsets[(src[0] >> shift) & 0xFF] == n) {
+      continue;
+    }
+    int64 offset = 0;
+    for (int64& bucket : offsets) {
+      const int64 count = bucket;
+      bucket = offset;
+      offset += count;
+    }
+    for (int64 i = 0; i < n; ++i) {
+      dst[offsets[(src[i] >> shift) & 0xFF]++] = src[i];
+    }
+    std::swap(src, dst);
+  }
+  if (src != first) {
+    std::copy(src, src + n, first);
+  }
+}
+
+template <typename T>
+void KeySort(int64 a, int64 b, int64 c, T* keys, bool descending,
+             const Eigen::ThreadPoolDevice* pool) {
+  using Bits = OrderedBits<T>;
+  using Unsigned = typename Bits::Unsigned;
+  const int64 num_rows = a * c;
+  auto sort_row = [&](int64 row, Unsigned* scratch, bool parallel) {
+    const int64 base_offset = row % c + (row - row % c) * b;
+    T* row_keys = keys + base_offset;
+    for (int64 i = 0; i < b; ++i) {
+      scratch[i] = Bits::Encode(row_keys[i * c], descending);
+    }
+    if (parallel) {
+      ParallelMergeSort(
+          scratch, b, [] { return std::less<Unsigned>(); },
+          [](Unsigned* first, Unsigned* last, std::less<Unsigned>&) {
+            RadixSort(first, last);
+          },
+          pool);
+    } else {
+      RadixSort(scratch, scratch + b);
+    }
+    for (int64 i = 0; i < b; ++i) {
+      row_keys[i * c] = Bits::Decode(scratch[i], descending);
+    }
+  };
+
+  if (pool != nullptr && num_rows < pool->numThreads() &&
+      b >= kMinParallelMergeSortElements) {
+    std::unique_ptr<Unsigned[]> scratch(new Unsigned[b]);
+    for (int64 row = 0; row < num_rows; ++row) {
+      sort_row(row, scratch.get(), /*parallel=*/true);
+    }
+    return;
+  }
+  ParallelFor(pool, num_rows, 4.0 * sizeof(T) * b,
+              [&](int64 begin, int64 end) {
+                std::unique_ptr<Unsigned[]> scratch(new Unsigned[b]);
+                for (int64 row = begin; row < end; ++row) {
+                  sort_row(row, scratch.get(), /*parallel=*/false);
+                }
+              });
+}
+
 }  // namespace
 
 TF_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_KeyValueSort(
@@ -49,65 +358,116 @@ TF_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_KeyValueSort(
   // many rows that we need to sort. We iterate through these, calculate a
   // 'base_offset' value which points to the first element in that row, and add
   // i * c for accessing the 'i'-th element in that row.
+  //
+  // Rows are independent, so they are sorted concurrently on the intra-op
+  // thread pool. If there are fewer rows than threads but the rows are long,
+  // each row is instead sorted by a parallel merge sort.
 
   int64 sort_dimension_elements = b;
   int64 num_iteration_elements = a * c;
   int64 sort_dimension_offset = c;
+  const int32 max_value_size =
+      *std::max_element(values_primitive_type_size_in_bytes,
+                        values_primitive_type_size_in_bytes + values_count);
+  const Eigen::ThreadPoolDevice* pool =
+      GetThreadPool(run_options, prof_counters);
 
-  std::unique_ptr<int64[]> indices(new int64[sort_dimension_elements]);
-  std::unique_ptr<char*[]> comparison_values(new char*[2 * values_count]);
-  std::iota(indices.get(), indices.get() + sort_dimension_elements, 0);
-  std::unique_ptr<std::string[]> reordered_values(
-      new std::string[sort_dimension_elements]);
-  for (int64 index = 0; index < num_iteration_elements; ++index) {
-    // 'index' can be split into two values which index into the 'c' dimension
-    // and the 'a' dimension, respectively. 'index' % 'c' is the index into the
-    // 'c' dimension, 'index' / 'c' is the index into the 'a' dimension. When
-    // calculating the base offset, we need to multiply the index into the 'a'
-    // dimension with 'b' * 'c'.
-    // 'index' / 'c' * 'c' * 'b' = ('index' - 'index' % 'c') * 'b'.
-    int64 base_offset =
-        index % sort_dimension_offset +
-        (index - index % sort_dimension_offset) * sort_dimension_elements;
-    auto compare_function = [&](int64 a, int64 b) -> bool {
-      int64 memory_index_lhs = (base_offset + a * sort_dimension_offset) *
-                               values_primitive_type_size_in_bytes[0];
-      int64 memory_index_rhs = (base_offset + b * sort_dimension_offset) *
-                               values_primitive_type_size_in_bytes[0];
-      for (int32 i = 0; i < values_count; ++i) {
-        comparison_values[i * 2] = values[i] + memory_index_lhs;
-        comparison_values[i * 2 + 1] = values[i] + memory_index_rhs;
-      }
-      char result = 0;  // Overwritten by less_than.
-      less_than(&result, run_options, comparison_values.get(), nullptr,
-                prof_counters);
-      return result != 0u;
-    };
+  auto make_less = [&]() {
+    return RowComparator(values, values_count,
+                         values_primitive_type_size_in_bytes, run_options,
+                         prof_counters, less_than);
+  };
+  auto sort_indices = [is_stable](int64* first, int64* last,
+                                  RowComparator& less) {
     if (is_stable) {
-      std::stable_sort(indices.get(), indices.get() + sort_dimension_elements,
-                       compare_function);
+      std::stable_sort(first, last, std::ref(less));
     } else {
-      std::sort(indices.get(), indices.get() + sort_dimension_elements,
-                compare_function);
+      std::sort(first, last, std::ref(less));
     }
+  };
+  // 'index' can be split into two values which index into the 'c' dimension
+  // and the 'a' dimension, respectively. 'index' % 'c' is the index into the
+  // 'c' dimension, 'index' / 'c' is the index into the 'a' dimension. When
+  // calculating the base offset, we need to multiply the index into the 'a'
+  // dimension with 'b' * 'c'.
+  // 'index' / 'c' * 'c' * 'b' = ('index' - 'index' % 'c') * 'b'.
+  auto base_offset_of = [&](int64 index) {
+    return index % sort_dimension_offset +
+           (index - index % sort_dimension_offset) * sort_dimension_elements;
+  };
 
-    // Reorder the values according to the order defined by 'indices'.
-    for (int32 idx = 0; idx < values_count; ++idx) {
-      for (int64 i = 0; i < sort_dimension_elements; ++i) {
-        int64 memory_index =
-            (base_offset + indices[i] * sort_dimension_offset) *
-            values_primitive_type_size_in_bytes[idx];
-
-        reordered_values[i] =
-            std::string(values[idx] + memory_index,
-                        values_primitive_type_size_in_bytes[idx]);
-      }
-      for (int64 i = 0; i < sort_dimension_elements; ++i) {
-        int64 memory_index = (base_offset + i * sort_dimension_offset) *
-                             values_primitive_type_size_in_bytes[idx];
-        memcpy(values[idx] + memory_index, reordered_values[i].c_str(),
-               values_primitive_type_size_in_bytes[idx]);
-      }
+  if (pool != nullptr && num_iteration_elements < pool->numThreads() &&
+      sort_dimension_elements >= kMinParallelMergeSortElements) {
+    std::unique_ptr<int64[]> indices(new int64[sort_dimension_elements]);
+    std::unique_ptr<char[]> scratch(
+        new char[sort_dimension_elements * max_value_size]);
+    for (int64 index = 0; index < num_iteration_elements; ++index) {
+      const int64 base_offset = base_offset_of(index);
+      std::iota(indices.get(), indices.get() + sort_dimension_elements, 0);
+      ParallelMergeSort(
+          indices.get(), sort_dimension_elements,
+          [&]() {
+            RowComparator less = make_less();
+            less.set_row(base_offset, sort_dimension_offset);
+            return less;
+          },
+          sort_indices, pool);
+      ReorderRow(values, values_count, values_primitive_type_size_in_bytes,
+                 base_offset, sort_dimension_offset, indices.get(),
+                 sort_dimension_elements, scratch.get());
     }
+    return;
+  }
+
+  ParallelFor(
+      pool, num_iteration_elements, SortCycles(sort_dimension_elements),
+      [&](int64 begin, int64 end) {
+        std::unique_ptr<int64[]> indices(new int64[sort_dimension_elements]);
+        std::unique_ptr<char[]> scratch(
+            new char[sort_dimension_elements * max_value_size]);
+        RowComparator less = make_less();
+        for (int64 index = begin; index < end; ++index) {
+          const int64 base_offset = base_offset_of(index);
+          std::iota(indices.get(), indices.get() + sort_dimension_elements, 0);
+          less.set_row(base_offset, sort_dimension_offset);
+          sort_indices(indices.get(),
+                       indices.get() + sort_dimension_elements, less);
+
+          // Reorder the values according to the order defined by 'indices'.
+          ReorderRow(values, values_count, values_primitive_type_size_in_bytes,
+                     base_offset, sort_dimension_offset, indices.get(),
+                     sort_dimension_elements, scratch.get());
+        }
+      });
+}
+
+void __xla_cpu_runtime_KeySort(
+    int64 a, int64 b, int64 c, char* keys, int32 key_size_in_bytes,
+    bool is_signed, bool descending, char* run_options) {
+  const Eigen::ThreadPoolDevice* pool =
+      GetThreadPool(run_options, /*prof_counters=*/nullptr);
+  switch (key_size_in_bytes) {
+    case 1:
+      return is_signed ? KeySort(a, b, c, reinterpret_cast<int8*>(keys),
+                                 descending, pool)
+                       : KeySort(a, b, c, reinterpret_cast<uint8*>(keys),
+                                 descending, pool);
+    case 2:
+      return is_signed ? KeySort(a, b, c, reinterpret_cast<int16*>(keys),
+                                 descending, pool)
+                       : KeySort(a, b, c, reinterpret_cast<uint16*>(keys),
+                                 descending, pool);
+    case 4:
+      return is_signed ? KeySort(a, b, c, reinterpret_cast<int32*>(keys),
+                                 descending, pool)
+                       : KeySort(a, b, c, reinterpret_cast<uint32*>(keys),
+                                 descending, pool);
+    case 8:
+      return is_signed ? KeySort(a, b, c, reinterpret_cast<int64*>(keys),
+                                 descending, pool)
+                       : KeySort(a, b, c, reinterpret_cast<uint64*>(keys),
+                                 descending, pool);
+    default:
+      LOG(FATAL) << "Unsupported key size " << key_size_in_bytes;
   }
 }
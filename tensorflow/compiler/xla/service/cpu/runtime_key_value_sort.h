@@ -16,7 +16,6 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_KEY_VALUE_SORT_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_KEY_VALUE_SORT_H_
 
-#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/platform/types.h"
 
 extern "C" {
@@ -35,12 +34,27 @@ extern "C" {
 // - pointers to the parameter buffers (char**)
 // - pointers to the buffer tables = nullptr for thread local functions (char**)
 // - profile counters = 'prof_counters' (int64*)
+// Independent rows are sorted concurrently on the intra-op thread pool of
+// 'run_options', unless profiling is enabled.
 extern void __xla_cpu_runtime_KeyValueSort(
     tensorflow::int64 a, tensorflow::int64 b, tensorflow::int64 c,
     char** values, tensorflow::int32 values_count,
     tensorflow::int32* values_primitive_type_size_in_bytes, bool is_stable,
     char* run_options, tensorflow::int64* prof_counters,
     void (*less_than)(char*, char*, char**, char**, tensorflow::int64*));
+
+// Sorts the 'b' dimension of the [a, b, c] shaped integer array 'keys', whose
+// elements have 'key_size_in_bytes' (1, 2, 4 or 8) bytes and are signed if
+// 'is_signed' is true, into ascending order, or descending order if
+// 'descending' is true. Used instead of __xla_cpu_runtime_KeyValueSort for
+// sorts of a single integer operand with a plain less-than or greater-than
+// comparator, since it needs no comparator calls. 'run_options' is an
+// xla::ExecutableRunOptions (char*).
+extern void __xla_cpu_runtime_KeySort(tensorflow::int64 a, tensorflow::int64 b,
+                                      tensorflow::int64 c, char* keys,
+                                      tensorflow::int32 key_size_in_bytes,
+                                      bool is_signed, bool descending,
+                                      char* run_options);
 }
 
 #endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_KEY_VALUE_SORT_H_
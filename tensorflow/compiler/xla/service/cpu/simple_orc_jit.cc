@@ -22,19 +22,26 @@ limitations under the License.
 #include <utility>
 
 #include "absl/memory/memory.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Mangler.h"
 #include "llvm/Support/CodeGen.h"
 #include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_runtime.h"
+#include "tensorflow/compiler/xla/service/cpu/llvm_module_splitter.h"
 #include "tensorflow/compiler/xla/service/cpu/orc_jit_memory_mapper.h"
 #include "tensorflow/compiler/xla/service/cpu/runtime_conv2d.h"
 #include "tensorflow/compiler/xla/service/cpu/runtime_conv2d_mkl.h"
 #include "tensorflow/compiler/xla/service/cpu/runtime_fft.h"
 #include "tensorflow/compiler/xla/service/cpu/runtime_fork_join.h"
 #include "tensorflow/compiler/xla/service/cpu/runtime_fp16.h"
+#include "tensorflow/compiler/xla/service/cpu/runtime_fused_attention.h"
 #include "tensorflow/compiler/xla/service/cpu/runtime_key_value_sort.h"
 #include "tensorflow/compiler/xla/service/cpu/runtime_matmul.h"
 #include "tensorflow/compiler/xla/service/cpu/runtime_matmul_mkl.h"
@@ -44,7 +51,9 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/cpu/windows_compatibility.h"
 #include "tensorflow/compiler/xla/service/custom_call_target_registry.h"
 #include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 
 namespace xla {
 namespace cpu {
@@ -104,7 +113,7 @@ SimpleOrcJIT::SimpleOrcJIT(
       symbol_resolver_(llvm::orc::createLegacyLookupResolver(
           execution_session_,
           [this](const std::string& name) -> llvm::JITSymbol {
-            return this->ResolveRuntimeSymbol(name);
+            return this->ResolveSymbol(name);
           },
           [](llvm::Error Err) {
             cantFail(std::move(Err), "lookupFlags failed");
@@ -131,16 +140,35 @@ SimpleOrcJIT::SimpleOrcJIT(
           }),
       compile_layer_(
           object_layer_,
-          CompilerFunctor(
-              target_machine_.get(), opt_level, optimize_for_size,
-              disable_expensive_passes, std::move(pre_optimization_hook),
-              std::move(post_optimization_hook), std::move(post_codegen_hook))),
+          CompilerFunctor(target_machine_.get(), opt_level, optimize_for_size,
+                          disable_expensive_passes, pre_optimization_hook,
+                          post_optimization_hook,
+                          [this](const llvm::object::ObjectFile& object) {
+                            this->NotifyObjectCompiled(object);
+                          })),
+      target_options_(target_options),
+      opt_level_(opt_level),
+      optimize_for_size_(optimize_for_size),
+      disable_expensive_passes_(disable_expensive_passes),
+      pre_optimization_hook_(std::move(pre_optimization_hook)),
+      post_optimization_hook_(std::move(post_optimization_hook)),
+      post_codegen_hook_(std::move(post_codegen_hook)),
       gdb_jit_event_listener_(
           llvm::JITEventListener::createGDBRegistrationListener()) {
   VLOG(1) << "CPU target: " << target_machine_->getTargetCPU().str()
           << " features: " << target_machine_->getTargetFeatureString().str();
 }
 
+llvm::JITSymbol SimpleOrcJIT::ResolveSymbol(const std::string& name) {
+  // The partitions of a module refer to each other's hidden symbols, so look
+  // at all symbols, not only exported ones.
+  if (auto symbol =
+          object_layer_.findSymbol(name, /*ExportedSymbolsOnly=*/false)) {
+    return symbol;
+  }
+  return ResolveRuntimeSymbol(name);
+}
+
 llvm::JITSymbol SimpleOrcJIT::ResolveRuntimeSymbol(const std::string& name) {
   void* func_addr = nullptr;
   if (name.size() > 1 && name.front() == data_layout_.getGlobalPrefix()) {
@@ -166,6 +194,16 @@ llvm::JITSymbol SimpleOrcJIT::ResolveRuntimeSymbol(const std::string& name) {
   return symbol_info;
 }
 
+void SimpleOrcJIT::NotifyObjectCompiled(
+    const llvm::object::ObjectFile& object) {
+  if (post_codegen_hook_) {
+    post_codegen_hook_(object);
+  }
+  if (retain_object_files_) {
+    object_files_.push_back(object.getData().str());
+  }
+}
+
 void SimpleOrcJIT::NotifyObjectFinalized(
     const llvm::object::ObjectFile& object,
     const llvm::RuntimeDyld::LoadedObjectInfo& object_info) {
@@ -188,6 +226,89 @@ SimpleOrcJIT::VModuleKeyT SimpleOrcJIT::AddModule(
   return key;
 }
 
+std::vector<SimpleOrcJIT::VModuleKeyT> SimpleOrcJIT::AddModuleInParallel(
+    std::unique_ptr<llvm::Module> module,
+    tensorflow::thread::ThreadPool* thread_pool) {
+  std::vector<std::unique_ptr<llvm::Module>> partition_modules =
+      SplitModuleForParallelCompilation(module.get(),
+                                        thread_pool->NumThreads());
+  if (partition_modules.empty()) {
+    return {AddModule(std::move(module))};
+  }
+  if (pre_optimization_hook_) {
+    pre_optimization_hook_(*module);
+  }
+
+  // LLVMContexts are not thread-safe, so each partition is moved to a context
+  // of its own through bitcode, and compiled with a TargetMachine of its own.
+  struct Partition {
+    string name;
+    llvm::SmallVector<char, 0> bitcode;
+    llvm::LLVMContext context;
+    std::unique_ptr<llvm::TargetMachine> target_machine;
+    std::unique_ptr<llvm::Module> module;
+    std::unique_ptr<llvm::MemoryBuffer> object;
+  };
+  std::vector<Partition> partitions(partition_modules.size());
+  for (int64 i = 0; i < partitions.size(); ++i) {
+    partitions[i].name = partition_modules[i]->getModuleIdentifier();
+    llvm::raw_svector_ostream ostream(partitions[i].bitcode);
+    llvm::WriteBitcodeToFile(*partition_modules[i], ostream);
+    partitions[i].target_machine =
+        InferTargetMachineForJIT(target_options_, opt_level_);
+  }
+  partition_modules.clear();
+  module.reset();
+
+  // The hooks need not be thread-safe, so they run one at a time.
+  tensorflow::mutex hook_mu;
+  LLVMCompiler::ModuleHook post_optimization_hook;
+  if (post_optimization_hook_) {
+    post_optimization_hook = [this, &hook_mu](const llvm::Module& module) {
+      tensorflow::mutex_lock lock(hook_mu);
+      post_optimization_hook_(module);
+    };
+  }
+  std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook =
+      [this, &hook_mu](const llvm::object::ObjectFile& object) {
+        tensorflow::mutex_lock lock(hook_mu);
+        NotifyObjectCompiled(object);
+      };
+
+  tensorflow::BlockingCounter counter(partitions.size());
+  for (Partition& partition : partitions) {
+    thread_pool->Schedule([&] {
+      partition.module = cantFail(llvm::parseBitcodeFile(
+          llvm::MemoryBufferRef(
+              llvm::StringRef(partition.bitcode.data(),
+                              partition.bitcode.size()),
+              partition.name),
+          partition.context));
+      partition.object = CompilerFunctor(
+          partition.target_machine.get(), opt_level_, optimize_for_size_,
+          disable_expensive_passes_, /*pre_optimization_hook=*/nullptr,
+          post_optimization_hook, post_codegen_hook)(*partition.module);
+      partition.module.reset();
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+
+  std::vector<VModuleKeyT> keys;
+  for (Partition& partition : partitions) {
+    keys.push_back(AddObjectFile(std::move(partition.object)));
+  }
+  return keys;
+}
+
+SimpleOrcJIT::VModuleKeyT SimpleOrcJIT::AddObjectFile(
+    std::unique_ptr<llvm::MemoryBuffer> object) {
+  auto key = execution_session_.allocateVModule();
+  cantFail(object_layer_.addObject(key, std::move(object)));
+  module_keys_.push_back(key);
+  return key;
+}
+
 void SimpleOrcJIT::RemoveModule(SimpleOrcJIT::VModuleKeyT key) {
   module_keys_.erase(std::remove(module_keys_.begin(), module_keys_.end(), key),
                      module_keys_.end());
@@ -227,6 +348,7 @@ bool RegisterKnownJITSymbols() {
 
   REGISTER_CPU_RUNTIME_SYMBOL(AcquireInfeedBufferForDequeue);
   REGISTER_CPU_RUNTIME_SYMBOL(AcquireOutfeedBufferForPopulation);
+  REGISTER_CPU_RUNTIME_SYMBOL(AllReduce);
   REGISTER_CPU_RUNTIME_SYMBOL(MKLConvF32);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenConvF16);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenConvF32);
@@ -244,10 +366,13 @@ bool RegisterKnownJITSymbols() {
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulF16);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulF32);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulF64);
+  REGISTER_CPU_RUNTIME_SYMBOL(FusedAttentionF32);
   REGISTER_CPU_RUNTIME_SYMBOL(ParallelForkJoin);
+  REGISTER_CPU_RUNTIME_SYMBOL(ParallelCalls);
   REGISTER_CPU_RUNTIME_SYMBOL(ReleaseInfeedBufferAfterDequeue);
   REGISTER_CPU_RUNTIME_SYMBOL(ReleaseOutfeedBufferAfterPopulation);
   REGISTER_CPU_RUNTIME_SYMBOL(KeyValueSort);
+  REGISTER_CPU_RUNTIME_SYMBOL(KeySort);
   REGISTER_CPU_RUNTIME_SYMBOL(TracingStart);
   REGISTER_CPU_RUNTIME_SYMBOL(TracingEnd);
 
@@ -27,9 +27,11 @@ limitations under the License.
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/Orc/SymbolStringPool.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Target/TargetMachine.h"
 #include "tensorflow/compiler/xla/service/cpu/compiler_functor.h"
 #include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 
 namespace xla {
 namespace cpu {
@@ -39,9 +41,10 @@ namespace cpu {
 // This class wraps Orc's functionality into a single interface that only
 // exposes what we need for XLA.
 //
-// Supports JIT-ing multiple modules but without cross-module linking.
-// Implements eager compilation - the module is lowered to binary as soon as
-// it's added to the JIT.
+// Supports JIT-ing multiple modules. Modules added with AddModule are not
+// linked with each other; the partitions of a module added with
+// AddModuleInParallel are. Implements eager compilation - the module is
+// lowered to binary as soon as it's added to the JIT.
 class SimpleOrcJIT {
  public:
   using ObjLayerT = llvm::orc::LegacyRTDyldObjectLinkingLayer;
@@ -72,6 +75,33 @@ class SimpleOrcJIT {
   // remove this module.
   VModuleKeyT AddModule(std::unique_ptr<llvm::Module> module);
 
+  // Splits a module into partitions with SplitModuleForParallelCompilation,
+  // optimizes and compiles the partitions on 'thread_pool', and adds them to
+  // the JIT. Adds the module as AddModule does if it can't be split. Returns
+  // the keys of the partitions, which must all be removed to remove the
+  // module.
+  //
+  // The pre-optimization hook is invoked on the module before it is split,
+  // and the post-optimization and post-codegen hooks on each partition, one
+  // at a time.
+  std::vector<VModuleKeyT> AddModuleInParallel(
+      std::unique_ptr<llvm::Module> module,
+      tensorflow::thread::ThreadPool* thread_pool);
+
+  // Adds an object file that was compiled for the same target, possibly by
+  // another process, to the JIT. Returns a key as AddModule does.
+  VModuleKeyT AddObjectFile(std::unique_ptr<llvm::MemoryBuffer> object);
+
+  // Makes the JIT keep a copy of every object file it compiles from now on,
+  // until the copies are taken with TakeObjectFiles.
+  void set_retain_object_files(bool retain_object_files) {
+    retain_object_files_ = retain_object_files;
+  }
+
+  // Returns the object files retained since the last call, in the order they
+  // were added to the JIT.
+  std::vector<string> TakeObjectFiles() { return std::move(object_files_); }
+
   // Remove a module from the JIT and free the memory associated with it.
   void RemoveModule(VModuleKeyT key);
 
@@ -88,8 +118,14 @@ class SimpleOrcJIT {
       llvm::CodeGenOpt::Level opt_level);
 
  private:
+  // Resolves a symbol that a compiled object refers to, either to a symbol
+  // defined by another partition of the same module or to a runtime symbol.
+  llvm::JITSymbol ResolveSymbol(const std::string& name);
   llvm::JITSymbol ResolveRuntimeSymbol(const std::string& name);
 
+  // Invoked after compiling a module or partition to 'object'.
+  void NotifyObjectCompiled(const llvm::object::ObjectFile& object);
+
   void NotifyObjectFinalized(
       const llvm::object::ObjectFile& object,
       const llvm::RuntimeDyld::LoadedObjectInfo& object_info);
@@ -103,6 +139,19 @@ class SimpleOrcJIT {
   ObjLayerT object_layer_;
   CompileLayerT compile_layer_;
 
+  // What compile_layer_ compiles with, to compile partitions the same way.
+  const llvm::TargetOptions target_options_;
+  const llvm::CodeGenOpt::Level opt_level_;
+  const bool optimize_for_size_;
+  const bool disable_expensive_passes_;
+  const LLVMCompiler::ModuleHook pre_optimization_hook_;
+  const LLVMCompiler::ModuleHook post_optimization_hook_;
+  const std::function<void(const llvm::object::ObjectFile&)>
+      post_codegen_hook_;
+
+  bool retain_object_files_ = false;
+  std::vector<string> object_files_;
+
   // Non owning pointer to a JIT event listener that registers the JIT events
   // with an attached GDB.
   //
@@ -0,0 +1,281 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/debug_options_flags.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/service/compiler.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_executable.pb.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_runtime.h"
+#include "tensorflow/compiler/xla/service/hlo_module_config.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/service/hlo_runner.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/tests/literal_test_util.h"
+#include "tensorflow/compiler/xla/tests/test_utils.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Returns a config that has the CPU backend compile executables it can
+// serialize for the persistent compilation cache.
+HloModuleConfig SerializableConfig(HloModuleConfig config) {
+  DebugOptions debug_options = config.debug_options();
+  debug_options.set_xla_persistent_cache_dir(tensorflow::testing::TmpDir());
+  config.set_debug_options(debug_options);
+  return config;
+}
+
+class CpuExecutableSerializationTest : public HloTestBase {
+ protected:
+  // Compiles 'hlo_text' with 'config', and returns the serialized executable.
+  string CompileAndSerialize(const string& hlo_text,
+                             const HloModuleConfig& config) {
+    std::unique_ptr<Executable> executable =
+        test_runner_
+            .CreateExecutable(
+                ParseAndReturnVerifiedModule(hlo_text, config).ValueOrDie(),
+                /*run_hlo_passes=*/true)
+            .ValueOrDie();
+    return backend().compiler()->SerializeExecutable(*executable).ValueOrDie();
+  }
+
+  StatusOr<std::unique_ptr<Executable>> Deserialize(
+      const string& serialized, const HloModuleConfig& config) {
+    return backend().compiler()->DeserializeExecutable(
+        serialized, config, backend().default_stream_executor());
+  }
+
+  // Runs 'hlo_text' compiled with 'config', and compiled for serialization,
+  // serialized and deserialized, and expects the results to be the same, bit
+  // for bit.
+  void RunAndCompareWithDeserialized(const string& hlo_text,
+                                     const HloModuleConfig& config) {
+    std::unique_ptr<HloModule> module =
+        ParseAndReturnVerifiedModule(hlo_text, config).ValueOrDie();
+    std::vector<Literal> arguments =
+        MakeFakeArguments(module.get()).ValueOrDie();
+    std::vector<Literal*> argument_ptrs;
+    for (Literal& argument : arguments) {
+      argument_ptrs.push_back(&argument);
+    }
+    Literal expected = ExecuteAndTransfer(std::move(module), argument_ptrs);
+
+    const HloModuleConfig serializable_config = SerializableConfig(config);
+    const string serialized =
+        CompileAndSerialize(hlo_text, serializable_config);
+    std::unique_ptr<Executable> executable =
+        Deserialize(serialized, serializable_config).ValueOrDie();
+    Literal actual =
+        test_runner_.Execute(std::move(executable), argument_ptrs).ValueOrDie();
+    EXPECT_TRUE(LiteralTestUtil::Equal(expected, actual));
+  }
+};
+
+const char* const kWhileModule = R"(
+  HloModule while_loop
+
+  condition {
+    state = (s32[], f32[64,64]) parameter(0)
+    i = s32[] get-tuple-element(state), index=0
+    limit = s32[] constant(5)
+    ROOT less-than = pred[] compare(i, limit), direction=LT
+  }
+
+  body {
+    state = (s32[], f32[64,64]) parameter(0)
+    i = s32[] get-tuple-element(state), index=0
+    one = s32[] constant(1)
+    next_i = s32[] add(i, one)
+    x = f32[64,64] get-tuple-element(state), index=1
+    dot = f32[64,64] dot(x, x), lhs_contracting_dims={1},
+      rhs_contracting_dims={0}
+    tanh = f32[64,64] tanh(dot)
+    ROOT tuple = (s32[], f32[64,64]) tuple(next_i, tanh)
+  }
+
+  ENTRY main {
+    p0 = f32[64,64] parameter(0)
+    zero = s32[] constant(0)
+    init = (s32[], f32[64,64]) tuple(zero, p0)
+    while = (s32[], f32[64,64]) while(init), condition=condition, body=body
+    ROOT result = f32[64,64] get-tuple-element(while), index=1
+  }
+)";
+
+TEST_F(CpuExecutableSerializationTest, WhileLoop) {
+  RunAndCompareWithDeserialized(kWhileModule, GetModuleConfigForTest());
+}
+
+TEST_F(CpuExecutableSerializationTest, ReductionsAndConstants) {
+  RunAndCompareWithDeserialized(R"(
+    HloModule reductions
+
+    add {
+      lhs = f32[] parameter(0)
+      rhs = f32[] parameter(1)
+      ROOT add = f32[] add(lhs, rhs)
+    }
+
+    ENTRY main {
+      p0 = f32[128,128] parameter(0)
+      constant = f32[4] constant({1, 2, 3, 4})
+      broadcast = f32[128,128,4] broadcast(constant), dimensions={2}
+      p0.broadcast = f32[128,128,4] broadcast(p0), dimensions={0,1}
+      mul = f32[128,128,4] multiply(broadcast, p0.broadcast)
+      zero = f32[] constant(0)
+      sum = f32[128] reduce(mul, zero), dimensions={1,2}, to_apply=add
+      ROOT tuple = (f32[128], f32[128,128,4]) tuple(sum, mul)
+    }
+  )",
+                                GetModuleConfigForTest());
+}
+
+TEST_F(CpuExecutableSerializationTest, ParallelCodegen) {
+  // Parallel code generation adds several object files to the JIT.
+  HloModuleConfig config = GetModuleConfigForTest();
+  DebugOptions debug_options = config.debug_options();
+  (*debug_options.mutable_xla_backend_extra_options())
+      ["xla_cpu_parallel_codegen"] = "4";
+  config.set_debug_options(debug_options);
+  RunAndCompareWithDeserialized(kWhileModule, config);
+}
+
+TEST_F(CpuExecutableSerializationTest, OnlySerializableWithCacheDir) {
+  std::unique_ptr<HloModule> module =
+      ParseAndReturnVerifiedModule(kWhileModule, GetModuleConfigForTest())
+          .ValueOrDie();
+  std::unique_ptr<Executable> executable =
+      test_runner_.CreateExecutable(std::move(module), /*run_hlo_passes=*/true)
+          .ValueOrDie();
+  EXPECT_EQ(
+      backend().compiler()->SerializeExecutable(*executable).status().code(),
+      tensorflow::error::UNIMPLEMENTED);
+}
+
+TEST_F(CpuExecutableSerializationTest, RejectsOtherTargets) {
+  const HloModuleConfig config = SerializableConfig(GetModuleConfigForTest());
+  CpuExecutableProto proto;
+  ASSERT_TRUE(proto.ParseFromString(CompileAndSerialize(kWhileModule, config)));
+  proto.set_target_cpu("some-other-cpu");
+  EXPECT_EQ(Deserialize(proto.SerializeAsString(), config).status().code(),
+            tensorflow::error::FAILED_PRECONDITION);
+}
+
+TEST_F(CpuExecutableSerializationTest, RejectsOtherBufferAssignments) {
+  const HloModuleConfig config = SerializableConfig(GetModuleConfigForTest());
+  CpuExecutableProto proto;
+  ASSERT_TRUE(proto.ParseFromString(CompileAndSerialize(kWhileModule, config)));
+  proto.set_buffer_assignment_fingerprint(
+      proto.buffer_assignment_fingerprint() + 1);
+  EXPECT_EQ(Deserialize(proto.SerializeAsString(), config).status().code(),
+            tensorflow::error::FAILED_PRECONDITION);
+}
+
+TEST_F(CpuExecutableSerializationTest, RejectsOtherBuilds) {
+  const HloModuleConfig config = SerializableConfig(GetModuleConfigForTest());
+  CpuExecutableProto proto;
+  ASSERT_TRUE(proto.ParseFromString(CompileAndSerialize(kWhileModule, config)));
+
+  CpuExecutableProto other_build = proto;
+  other_build.set_build_version("some-other-build");
+  EXPECT_EQ(Deserialize(other_build.SerializeAsString(), config)
+                .status()
+                .code(),
+            tensorflow::error::FAILED_PRECONDITION);
+
+  CpuExecutableProto other_runtime = proto;
+  other_runtime.set_runtime_abi_version(runtime::kRuntimeAbiVersion + 1);
+  EXPECT_EQ(Deserialize(other_runtime.SerializeAsString(), config)
+                .status()
+                .code(),
+            tensorflow::error::FAILED_PRECONDITION);
+}
+
+// Returns a module with 'num_layers' layers, which takes a while to compile.
+string LayeredModule(int num_layers) {
+  std::vector<string> layers;
+  string previous = "p0";
+  for (int i = 0; i < num_layers; ++i) {
+    layers.push_back(absl::StrCat(
+        "  dot", i, " = f32[64,64] dot(", previous,
+        ", p1), lhs_contracting_dims={1}, rhs_contracting_dims={0}\n",
+        "  tanh", i, " = f32[64,64] tanh(dot", i, ")\n",
+        "  layer", i, " = f32[64,64] add(tanh", i, ", ", previous, ")"));
+    previous = absl::StrCat("layer", i);
+  }
+  return absl::StrCat(
+      "HloModule layered\n\nENTRY main {\n  p0 = f32[64,64] parameter(0)\n",
+      "  p1 = f32[64,64] parameter(1)\n", absl::StrJoin(layers, "\n"),
+      "\n  ROOT root = f32[64,64] negate(", previous, ")\n}\n");
+}
+
+// Measures how long it takes to get an executable for a module of
+// 'num_layers' layers, by compiling it if 'load' is 0, or by deserializing it,
+// as a warm start from the persistent compilation cache does, if it is 1.
+void BM_CompileOrLoad(int num_iters, int num_layers, int load) {
+  tensorflow::testing::StopTiming();
+
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().ValueOrDie();
+  HloRunner runner(platform);
+  HloModuleConfig config;
+  config.set_debug_options(GetDebugOptionsFromFlags());
+  config = SerializableConfig(config);
+  const string hlo_text = LayeredModule(num_layers);
+  Compiler* compiler = runner.backend().compiler();
+  se::StreamExecutor* executor = runner.backend().default_stream_executor();
+  std::unique_ptr<Executable> executable =
+      runner
+          .CreateExecutable(ParseHloString(hlo_text, config).ValueOrDie(),
+                            /*run_hlo_passes=*/true)
+          .ValueOrDie();
+  const string serialized =
+      compiler->SerializeExecutable(*executable).ValueOrDie();
+
+  tensorflow::testing::UseRealTime();
+  for (int i = 0; i < num_iters; ++i) {
+    auto module = ParseHloString(hlo_text, config).ValueOrDie();
+    tensorflow::testing::StartTiming();
+    if (load) {
+      TF_CHECK_OK(compiler->DeserializeExecutable(serialized, config, executor)
+                      .status());
+    } else {
+      TF_CHECK_OK(
+          runner.CreateExecutable(std::move(module), /*run_hlo_passes=*/true)
+              .status());
+    }
+    tensorflow::testing::StopTiming();
+  }
+}
+
+BENCHMARK(BM_CompileOrLoad)
+    ->ArgPair(16, 0)
+    ->ArgPair(16, 1)
+    ->ArgPair(64, 0)
+    ->ArgPair(64, 1);
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,219 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
+#include "tensorflow/compiler/xla/debug_options_flags.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_runtime.h"
+#include "tensorflow/compiler/xla/service/cpu/runtime_fused_attention.h"
+#include "tensorflow/compiler/xla/service/hlo_module_config.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/service/hlo_runner.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/tests/literal_test_util.h"
+#include "tensorflow/compiler/xla/tests/test_utils.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+// Tests and benchmarks attention that the CPU backend rewrites to calls to the
+// fused attention runtime function with the xla_cpu_fused_attention backend
+// option.
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Returns a module computing attention with 'heads' heads of 'head_dim'
+// dimensions over sequences of 'seq_len' for a batch of 'batch'.
+string AttentionModule(int batch, int heads, int seq_len, int head_dim) {
+  const string qkv_shape =
+      absl::StrCat("f32[", batch, ",", heads, ",", seq_len, ",", head_dim, "]");
+  const string scores_shape =
+      absl::StrCat("f32[", batch, ",", heads, ",", seq_len, ",", seq_len, "]");
+  const string rows_shape =
+      absl::StrCat("f32[", batch, ",", heads, ",", seq_len, "]");
+  const string scale = absl::StrCat(1 / std::sqrt(head_dim));
+  return absl::StrReplaceAll(R"(
+    HloModule attention
+
+    max {
+      lhs = f32[] parameter(0)
+      rhs = f32[] parameter(1)
+      ROOT max = f32[] maximum(lhs, rhs)
+    }
+
+    add {
+      lhs = f32[] parameter(0)
+      rhs = f32[] parameter(1)
+      ROOT add = f32[] add(lhs, rhs)
+    }
+
+    ENTRY main {
+      q = $qkv parameter(0)
+      k = $qkv parameter(1)
+      v = $qkv parameter(2)
+      qk = $scores dot(q, k), lhs_batch_dims={0,1}, rhs_batch_dims={0,1},
+        lhs_contracting_dims={3}, rhs_contracting_dims={3}
+      c = f32[] constant($scale)
+      scale = $scores broadcast(c), dimensions={}
+      scores = $scores multiply(qk, scale)
+      lowest = f32[] constant(-inf)
+      row_max = $rows reduce(scores, lowest), dimensions={3}, to_apply=max
+      row_max.broadcast = $scores broadcast(row_max), dimensions={0,1,2}
+      shifted = $scores subtract(scores, row_max.broadcast)
+      exp = $scores exponential(shifted)
+      zero = f32[] constant(0)
+      row_sum = $rows reduce(exp, zero), dimensions={3}, to_apply=add
+      row_sum.broadcast = $scores broadcast(row_sum), dimensions={0,1,2}
+      probs = $scores divide(exp, row_sum.broadcast)
+      ROOT out = $qkv dot(probs, v), lhs_batch_dims={0,1},
+        rhs_batch_dims={0,1}, lhs_contracting_dims={3},
+        rhs_contracting_dims={2}
+    }
+  )",
+                             {{"$qkv", qkv_shape},
+                              {"$scores", scores_shape},
+                              {"$rows", rows_shape},
+                              {"$scale", scale}});
+}
+
+// Returns 'debug_options' with fused attention enabled.
+DebugOptions WithFusedAttention(DebugOptions debug_options) {
+  (*debug_options.mutable_xla_backend_extra_options())
+      ["xla_cpu_fused_attention"] = "";
+  return debug_options;
+}
+
+class CpuFusedAttentionTest : public HloTestBase {
+ protected:
+  // Runs 'hlo_text' with and without fused attention, and expects the results
+  // to be close.
+  void RunAndCompareWithUnfused(const string& hlo_text) {
+    HloModuleConfig config = GetModuleConfigForTest();
+    std::unique_ptr<HloModule> unfused_module =
+        ParseAndReturnVerifiedModule(hlo_text, config).ValueOrDie();
+    config.set_debug_options(WithFusedAttention(config.debug_options()));
+    std::unique_ptr<HloModule> fused_module =
+        ParseAndReturnVerifiedModule(hlo_text, config).ValueOrDie();
+
+    std::vector<Literal> arguments =
+        MakeFakeArguments(unfused_module.get()).ValueOrDie();
+    std::vector<Literal*> argument_ptrs;
+    for (Literal& argument : arguments) {
+      argument_ptrs.push_back(&argument);
+    }
+    Literal expected =
+        ExecuteAndTransfer(std::move(unfused_module), argument_ptrs);
+    Literal actual = ExecuteAndTransfer(std::move(fused_module), argument_ptrs);
+    EXPECT_TRUE(LiteralTestUtil::Near(expected, actual, ErrorSpec{1e-5, 1e-4}));
+  }
+};
+
+TEST_F(CpuFusedAttentionTest, RewritesAttention) {
+  HloModuleConfig config = GetModuleConfigForTest();
+  config.set_debug_options(WithFusedAttention(config.debug_options()));
+  std::unique_ptr<Executable> executable =
+      test_runner_
+          .CreateExecutable(
+              ParseAndReturnVerifiedModule(AttentionModule(1, 2, 16, 8), config)
+                  .ValueOrDie(),
+              /*run_hlo_passes=*/true)
+          .ValueOrDie();
+  const HloInstruction* root =
+      executable->module().entry_computation()->root_instruction();
+  EXPECT_EQ(root->opcode(), HloOpcode::kCustomCall);
+  EXPECT_EQ(root->custom_call_target(), runtime::kFusedAttentionF32SymbolName);
+}
+
+TEST_F(CpuFusedAttentionTest, SingleBlock) {
+  RunAndCompareWithUnfused(AttentionModule(1, 2, 16, 8));
+}
+
+TEST_F(CpuFusedAttentionTest, PartialBlocks) {
+  // Neither a multiple of the query nor of the key block size.
+  RunAndCompareWithUnfused(AttentionModule(2, 3, 300, 32));
+}
+
+TEST_F(CpuFusedAttentionTest, LongSequence) {
+  RunAndCompareWithUnfused(AttentionModule(1, 1, 1024, 64));
+}
+
+TEST_F(CpuFusedAttentionTest, NoKeys) {
+  // Attention to no keys is zero, as the dot with an empty contraction that
+  // the runtime function replaces is.
+  const std::vector<int64> dims = {/*batch=*/2, /*q_len=*/3, /*kv_len=*/0,
+                                   /*head_dim=*/4, /*value_dim=*/5};
+  const std::vector<float> q(2 * 3 * 4, 1.0f);
+  const float scale = 0.5f;
+  std::vector<float> out(2 * 3 * 5, std::nanf(""));
+  const void* operands[] = {q.data(), nullptr, nullptr, dims.data(), &scale};
+  __xla_cpu_runtime_FusedAttentionF32(out.data(), operands);
+  for (float value : out) {
+    EXPECT_EQ(value, 0.0f);
+  }
+}
+
+// Runs attention over sequences of 'seq_len' for 8 heads of 64 dimensions,
+// fused if 'fused' is 1.
+void BM_Attention(int num_iters, int seq_len, int fused) {
+  tensorflow::testing::StopTiming();
+
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().ValueOrDie();
+  HloRunner runner(platform);
+  HloModuleConfig config;
+  config.set_debug_options(fused
+                               ? WithFusedAttention(GetDebugOptionsFromFlags())
+                               : GetDebugOptionsFromFlags());
+  std::unique_ptr<HloModule> module =
+      ParseHloString(AttentionModule(1, 8, seq_len, 64), config).ValueOrDie();
+  std::vector<Literal> arguments =
+      MakeFakeArguments(module.get()).ValueOrDie();
+  std::vector<ScopedShapedBuffer> buffers =
+      runner.TransferLiteralsToDevice(arguments).ValueOrDie();
+  std::unique_ptr<Executable> executable =
+      runner.CreateExecutable(std::move(module), /*run_hlo_passes=*/true)
+          .ValueOrDie();
+
+  // Warm up.
+  TF_CHECK_OK(
+      runner.ExecuteWithDeviceBuffers(executable.get(), buffers).status());
+
+  tensorflow::testing::UseRealTime();
+  tensorflow::testing::StartTiming();
+  for (int i = 0; i < num_iters; ++i) {
+    TF_CHECK_OK(
+        runner.ExecuteWithDeviceBuffers(executable.get(), buffers).status());
+  }
+  tensorflow::testing::StopTiming();
+}
+
+BENCHMARK(BM_Attention)
+    ->ArgPair(128, 0)
+    ->ArgPair(128, 1)
+    ->ArgPair(512, 0)
+    ->ArgPair(512, 1)
+    ->ArgPair(2048, 0)
+    ->ArgPair(2048, 1);
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -55,6 +55,40 @@ CHECK: call void @__xla_cpu_runtime_KeyValueSort
                                 /*match_optimized_ir=*/true);
 }
 
+
+TEST_F(CpuKeyValueSortTest, SortR1IntegerKeys) {
+  const string hlo_text = R"(
+HloModule KeySort
+
+compare {
+  p.0.lhs = s32[] parameter(0)
+  p.0.rhs = s32[] parameter(1)
+  ROOT gt = pred[] compare(p.0.lhs, p.0.rhs), direction=GT
+}
+
+ENTRY main {
+  a = s32[10] parameter(0)
+
+  ROOT result = s32[10] sort(s32[10] a), dimensions={0}, to_apply=compare
+}
+)";
+
+  string filecheck_pattern = R"(
+CHECK: call void @__xla_cpu_runtime_KeySort
+CHECK-NOT: @__xla_cpu_runtime_KeyValueSort
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseHloString(hlo_text));
+
+  CpuAotCompilationOptions options{
+      /*triple=*/"x86_64", /*cpu_name=*/"", /*features=*/"",
+      /*entry_point_name=*/"entry",
+      /*relocation_model=*/CpuAotCompilationOptions::RelocationModel::Static};
+
+  CompileAheadOfTimeAndVerifyIr(std::move(module), options, filecheck_pattern,
+                                /*match_optimized_ir=*/true);
+}
 }  // namespace
 }  // namespace cpu
 }  // namespace xla
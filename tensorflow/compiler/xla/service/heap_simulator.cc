@@ -16,9 +16,12 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/heap_simulator.h"
 
 #include <algorithm>
+#include <iterator>
+#include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/algorithm/container.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/memory/memory.h"
 #include "tensorflow/compiler/xla/map_util.h"
@@ -691,6 +694,7 @@ void LazyBestFitHeap::Alloc(const BufferValue* buffer, int64 size) {
     }
     // The buffer is allocated a chunk out of the best-fitting free chunk.
     free_.erase(best_fit_it);
+    free_by_offset_.erase(best.offset);
     result_.chunk_map.emplace(buffer, Chunk{new_offset, size});
     // Add remaining portions of the best-fitting free chunk back into free_.
     AddFreeChunk(best.offset, new_offset - best.offset);
@@ -711,18 +715,17 @@ void LazyBestFitHeap::Alloc(const BufferValue* buffer, int64 size) {
   // chunk and grow the heap at the front, and choose whether to grow from the
   // front or back based on the amount of re-use.  But that's more complicated,
   // and these are all heuristics anyways, so it isn't implemented.
-  for (auto it = free_.begin(); it != free_.end(); ++it) {
-    if (it->chunk_end() == result_.heap_size) {
-      // Account for alignment in the last free chunk.
-      const Chunk last = *it;
-      const int64 new_offset = RoundUpToNearest(last.offset, alignment_);
-      if (new_offset >= last.chunk_end()) {
-        // There's no point in using the last free chunk if alignment causes us
-        // to skip over it anyways.
-        break;
-      }
+  if (!free_by_offset_.empty()) {
+    const Chunk last{free_by_offset_.rbegin()->first,
+                     free_by_offset_.rbegin()->second};
+    // Account for alignment in the last free chunk. There's no point in using
+    // the last free chunk if alignment causes us to skip over it anyways.
+    const int64 new_offset = RoundUpToNearest(last.offset, alignment_);
+    if (last.chunk_end() == result_.heap_size &&
+        new_offset < last.chunk_end()) {
       // The buffer is allocated a chunk that includes the last free chunk.
-      free_.erase(it);
+      free_.erase(last);
+      free_by_offset_.erase(last.offset);
       result_.chunk_map.emplace(buffer, Chunk{new_offset, size});
       // Add remaining portion of the last free chunk back into free_.
       AddFreeChunk(last.offset, new_offset - last.offset);
@@ -769,19 +772,27 @@ void LazyBestFitHeap::AddFreeChunk(int64 offset, int64 size) {
   // Coalesce the chunk with adjacent free chunks on either side.  We must
   // remove the free chunks from free_, since it's ordered by size.
   Chunk chunk{offset, size};
-  for (auto it = free_.begin(); it != free_.end();) {
-    if (it->chunk_end() == chunk.offset || it->offset == chunk.chunk_end()) {
-      chunk.offset = std::min(chunk.offset, it->offset);
-      chunk.size += it->size;
-      it = free_.erase(it);
-    } else {
-      ++it;
+  auto next_it = free_by_offset_.lower_bound(offset);
+  if (next_it != free_by_offset_.begin()) {
+    auto prev_it = std::prev(next_it);
+    if (prev_it->first + prev_it->second == chunk.offset) {
+      chunk.offset = prev_it->first;
+      chunk.size += prev_it->second;
+      free_.erase(Chunk{prev_it->first, prev_it->second});
+      free_by_offset_.erase(prev_it);
     }
   }
+  if (next_it != free_by_offset_.end() &&
+      next_it->first == chunk.chunk_end()) {
+    chunk.size += next_it->second;
+    free_.erase(Chunk{next_it->first, next_it->second});
+    free_by_offset_.erase(next_it);
+  }
 
   // This is the only place we add free chunks to free_.  It maintains the
   // invariant that all free chunks are disjoint and non-adjacent.
   free_.emplace(chunk);
+  free_by_offset_.emplace(chunk.offset, chunk.size);
 }
 
 HeapSimulator::Result LazyBestFitHeap::Finish() {
@@ -824,104 +835,106 @@ void GlobalDecreasingSizeBestFitHeap::Free(const BufferValue* buffer,
 
 namespace {
 
-// Node in BufferIntervalTree that stores the alloc and free times of a buffer,
-// and the chunk assigned to it.
-struct BufferIntervalTreeNode {
-  // Alloc time.
-  int64 start;
-  // Free time.
-  int64 end;
-  // Maximum free time of all nodes in the subtree where this node is the root.
-  int64 subtree_end;
-  // Allocated chunk for the buffer.
-  HeapSimulator::Chunk chunk;
-  // Left child.
-  BufferIntervalTreeNode* left;
-  // Right child.
-  BufferIntervalTreeNode* right;
-};
-
-// An interval tree that can query buffers overlapping in time.
+// An interval tree that can query buffers overlapping in time. The tree is
+// built over the live intervals of all buffers up front, balanced by alloc
+// time, and buffers are added to it as they are allocated chunks. Queries only
+// visit subtrees that contain an added buffer overlapping the queried interval.
 class BufferIntervalTree {
  public:
-  explicit BufferIntervalTree(int capacity) : node_storage_(capacity) {}
-
   using Chunk = HeapSimulator::Chunk;
 
-  // Adds a buffer to the interval tree, with the time interval and allocated
-  // chunk specified.
-  void Add(int64 start, int64 end, const Chunk& chunk) {
-    int index = node_count_;
-    DCHECK_LT(index, node_storage_.size());
-    ++node_count_;
-
-    node_storage_[index] =
-        BufferIntervalTreeNode{start, end, end, chunk, nullptr, nullptr};
-
-    if (index == 0) {
-      // This is root.
-      return;
+  // 'starts' holds the distinct alloc times of the buffers that may be added.
+  explicit BufferIntervalTree(std::vector<int64> starts) {
+    absl::c_sort(starts);
+    nodes_.reserve(starts.size());
+    for (int64 start : starts) {
+      nodes_.push_back(Node{start, -1, -1, Chunk{}});
     }
+  }
 
-    BufferIntervalTreeNode* parent = &node_storage_[0];
-    while (true) {
-      parent->subtree_end = std::max(parent->subtree_end, end);
-      if (parent->start > start) {
-        if (parent->left == nullptr) {
-          parent->left = &node_storage_[index];
-          return;
-        }
-        parent = parent->left;
+  // Adds a buffer to the interval tree, with the time interval and allocated
+  // chunk specified. 'start' must be one of the alloc times the tree was built
+  // with.
+  void Add(int64 start, int64 end, const Chunk& chunk) {
+    DCHECK_GE(end, start);
+    int64 lo = 0;
+    int64 hi = nodes_.size();
+    while (lo < hi) {
+      const int64 mid = lo + (hi - lo) / 2;
+      Node& node = nodes_[mid];
+      node.subtree_end = std::max(node.subtree_end, end);
+      if (node.start == start) {
+        DCHECK_EQ(node.end, -1) << "Buffer added twice";
+        node.end = end;
+        node.chunk = chunk;
+        return;
+      }
+      if (start < node.start) {
+        hi = mid;
       } else {
-        if (parent->right == nullptr) {
-          parent->right = &node_storage_[index];
-          return;
-        }
-        parent = parent->right;
+        lo = mid + 1;
       }
     }
+    LOG(FATAL) << "No buffer allocated at time " << start;
   }
 
   // Returns vector of allocated chunks that overlap with the given time
   // interval.
-  std::vector<Chunk> ChunksOverlappingInTime(int64 start, int64 end) {
+  std::vector<Chunk> ChunksOverlappingInTime(int64 start, int64 end) const {
     std::vector<Chunk> result;
-    if (node_count_ == 0) {
-      return result;
-    }
-    std::vector<BufferIntervalTreeNode*> visiting_stack;
-    visiting_stack.push_back(&node_storage_[0]);
+    // Subtrees to visit, as [lo, hi) ranges of nodes_.
+    std::vector<std::pair<int64, int64>> visiting_stack;
+    visiting_stack.emplace_back(0, nodes_.size());
     while (!visiting_stack.empty()) {
-      BufferIntervalTreeNode* top = visiting_stack.back();
+      const int64 lo = visiting_stack.back().first;
+      const int64 hi = visiting_stack.back().second;
       visiting_stack.pop_back();
-      if (start > top->subtree_end) {
+      if (lo >= hi) {
         continue;
       }
-      if (top->left != nullptr) {
-        visiting_stack.push_back(top->left);
+      const int64 mid = lo + (hi - lo) / 2;
+      const Node& node = nodes_[mid];
+      // subtree_end is -1 if no buffer in the subtree has been added.
+      if (start > node.subtree_end) {
+        continue;
       }
-      if (top->start <= end && top->end >= start) {
-        result.push_back(top->chunk);
+      visiting_stack.emplace_back(lo, mid);
+      if (node.end != -1 && node.start <= end && node.end >= start) {
+        result.push_back(node.chunk);
       }
-      if (end < top->start) {
+      if (end < node.start) {
         continue;
       }
-      if (top->right != nullptr) {
-        visiting_stack.push_back(top->right);
-      }
+      visiting_stack.emplace_back(mid + 1, hi);
     }
     return result;
   }
 
  private:
-  int64 node_count_ = 0;
-  std::vector<BufferIntervalTreeNode> node_storage_;
+  // Node of the tree, which is implicit in the order of nodes_: the root of
+  // the subtree of nodes [lo, hi) is the node in the middle of them.
+  struct Node {
+    // Alloc time.
+    int64 start;
+    // Free time, or -1 if the buffer has not been added yet.
+    int64 end;
+    // Maximum free time of the added buffers in the subtree where this node
+    // is the root, or -1 if there are none.
+    int64 subtree_end;
+    // Allocated chunk for the buffer.
+    HeapSimulator::Chunk chunk;
+  };
+
+  // Sorted by alloc time.
+  std::vector<Node> nodes_;
 };
 
 }  // namespace
 
-HeapSimulator::Result GlobalDecreasingSizeBestFitHeap::Finish() {
+std::vector<GlobalDecreasingSizeBestFitHeap::BufferInterval>
+GlobalDecreasingSizeBestFitHeap::SortedBufferIntervals() const {
   std::vector<BufferInterval> sorted_buffer_intervals;
+  sorted_buffer_intervals.reserve(buffer_intervals_.size());
   for (auto& entry : buffer_intervals_) {
     sorted_buffer_intervals.push_back(entry.second);
   }
@@ -935,8 +948,19 @@ HeapSimulator::Result GlobalDecreasingSizeBestFitHeap::Finish() {
                  }
                  return x.buffer->id() < y.buffer->id();
                });
+  return sorted_buffer_intervals;
+}
 
-  BufferIntervalTree interval_tree(sorted_buffer_intervals.size());
+HeapSimulator::Result GlobalDecreasingSizeBestFitHeap::Finish() {
+  std::vector<BufferInterval> sorted_buffer_intervals =
+      SortedBufferIntervals();
+
+  std::vector<int64> starts;
+  starts.reserve(sorted_buffer_intervals.size());
+  for (const BufferInterval& buffer_interval : sorted_buffer_intervals) {
+    starts.push_back(buffer_interval.start);
+  }
+  BufferIntervalTree interval_tree(std::move(starts));
   for (auto& buffer_interval : sorted_buffer_intervals) {
     auto chunks_overlapping_in_time = interval_tree.ChunksOverlappingInTime(
         buffer_interval.start, buffer_interval.end);
@@ -983,6 +1007,80 @@ HeapSimulator::Result GlobalDecreasingSizeBestFitHeap::Finish() {
   return result_;
 }
 
+std::vector<GlobalDecreasingSizeBestFitHeap::BufferInterval>
+GlobalMemoryPressureBestFitHeap::SortedBufferIntervals() const {
+  // Compute the total size of the live buffers at each time. A buffer is live
+  // from its alloc time up to, but not including, its free time.
+  std::vector<int64> live_size(current_time_ + 1, 0);
+  for (const auto& entry : buffer_intervals_) {
+    const BufferInterval& buffer_interval = entry.second;
+    live_size[buffer_interval.start] += buffer_interval.size;
+    live_size[buffer_interval.end] -= buffer_interval.size;
+  }
+  for (int64 time = 1; time < live_size.size(); ++time) {
+    live_size[time] += live_size[time - 1];
+  }
+
+  // A segment tree over live_size for the maximum over time intervals.
+  const int64 num_times = live_size.size();
+  std::vector<int64> max_live_size(2 * num_times, 0);
+  absl::c_copy(live_size, max_live_size.begin() + num_times);
+  for (int64 i = num_times - 1; i > 0; --i) {
+    max_live_size[i] =
+        std::max(max_live_size[2 * i], max_live_size[2 * i + 1]);
+  }
+  // Returns the maximum live size in the time interval [start, end).
+  auto memory_pressure = [&](int64 start, int64 end) {
+    int64 pressure = 0;
+    for (start += num_times, end += num_times; start < end;
+         start /= 2, end /= 2) {
+      if (start % 2 == 1) {
+        pressure = std::max(pressure, max_live_size[start++]);
+      }
+      if (end % 2 == 1) {
+        pressure = std::max(pressure, max_live_size[--end]);
+      }
+    }
+    return pressure;
+  };
+
+  struct SortKey {
+    int64 pressure;
+    int64 aligned_size;
+    BufferInterval buffer_interval;
+  };
+  std::vector<SortKey> sort_keys;
+  sort_keys.reserve(buffer_intervals_.size());
+  for (const auto& entry : buffer_intervals_) {
+    const BufferInterval& buffer_interval = entry.second;
+    sort_keys.push_back(
+        SortKey{memory_pressure(buffer_interval.start, buffer_interval.end),
+                RoundUpToNearest(buffer_interval.size, alignment_),
+                buffer_interval});
+  }
+  absl::c_sort(sort_keys, [](const SortKey& x, const SortKey& y) {
+    if (x.pressure != y.pressure) {
+      return x.pressure > y.pressure;
+    }
+    if (x.aligned_size != y.aligned_size) {
+      return x.aligned_size > y.aligned_size;
+    }
+    const BufferInterval& a = x.buffer_interval;
+    const BufferInterval& b = y.buffer_interval;
+    if (a.end - a.start != b.end - b.start) {
+      return a.end - a.start > b.end - b.start;
+    }
+    return a.buffer->id() < b.buffer->id();
+  });
+
+  std::vector<BufferInterval> sorted_buffer_intervals;
+  sorted_buffer_intervals.reserve(sort_keys.size());
+  for (const SortKey& sort_key : sort_keys) {
+    sorted_buffer_intervals.push_back(sort_key.buffer_interval);
+  }
+  return sorted_buffer_intervals;
+}
+
 HeapSimulator::Result ChooseBestHeapAlgorithm::Finish() {
   DCHECK(!algorithms_.empty());
   std::vector<Result> results(algorithms_.size());
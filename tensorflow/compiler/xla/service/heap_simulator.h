@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_HEAP_SIMULATOR_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_HEAP_SIMULATOR_H_
 
+#include <map>
 #include <memory>
 #include <set>
 #include <utility>
@@ -350,6 +351,10 @@ class LazyBestFitHeap : public HeapAlgorithm {
 
   // Maintain the set of free chunks, ordered by increasing size.
   std::set<Chunk, OrderChunkByIncreasingSize> free_;
+
+  // The same free chunks, as a map from offset to size, so that adjacent
+  // chunks are found without scanning free_.
+  std::map<int64, int64> free_by_offset_;
 };
 
 // GlobalDecreasingSizeBestFitHeap collects the live intervals of all buffers,
@@ -357,6 +362,10 @@ class LazyBestFitHeap : public HeapAlgorithm {
 // internally tracks the allocated buffers and their live intervals; when
 // allocating a buffer, it finds the best-fit free chunk during its live
 // interval.
+//
+// The allocated buffers are kept in a balanced interval tree, so finding the
+// buffers that overlap a live interval takes time logarithmic in the number of
+// buffers, plus linear in the number of overlapping buffers.
 class GlobalDecreasingSizeBestFitHeap : public HeapAlgorithm {
  public:
   GlobalDecreasingSizeBestFitHeap(int64 alignment) : alignment_(alignment) {}
@@ -366,14 +375,7 @@ class GlobalDecreasingSizeBestFitHeap : public HeapAlgorithm {
   void Free(const BufferValue* buffer, int64 size) override;
   Result Finish() override;
 
- private:
-  int64 alignment_;
-  Result result_;
-
-  // The current time represented as an integer. It increments by 1 at each
-  // Alloc or Free call.
-  int64 current_time_ = 0;
-
+ protected:
   // BufferInterval stores a buffer's size and time interval.
   struct BufferInterval {
     const BufferValue* buffer;
@@ -383,9 +385,38 @@ class GlobalDecreasingSizeBestFitHeap : public HeapAlgorithm {
     // Free time of the buffer.
     int64 end;
   };
+
+  // Returns the buffer intervals in the order in which Finish allocates them:
+  // by decreasing size, then by decreasing length of the live interval.
+  virtual std::vector<BufferInterval> SortedBufferIntervals() const;
+
+  const int64 alignment_;
+  Result result_;
+
+  // The current time represented as an integer. It increments by 1 at each
+  // Alloc or Free call.
+  int64 current_time_ = 0;
+
   absl::flat_hash_map<const BufferValue*, BufferInterval> buffer_intervals_;
 };
 
+// GlobalMemoryPressureBestFitHeap is a GlobalDecreasingSizeBestFitHeap that
+// allocates buffers by decreasing memory pressure, that is, by the peak of the
+// total size of live buffers during their live interval, and only then by
+// decreasing size. The buffers live at the peak of the heap, which bound its
+// size from below, are packed first, and small buffers fill the gaps around
+// them. Sizes are compared rounded up to the alignment, since that is the
+// space a buffer takes up in the heap.
+class GlobalMemoryPressureBestFitHeap : public GlobalDecreasingSizeBestFitHeap {
+ public:
+  GlobalMemoryPressureBestFitHeap(int64 alignment)
+      : GlobalDecreasingSizeBestFitHeap(alignment) {}
+  ~GlobalMemoryPressureBestFitHeap() override {}
+
+ protected:
+  std::vector<BufferInterval> SortedBufferIntervals() const override;
+};
+
 // A heap algorithm that chooses the best results from other algorithms added to
 // it.
 class ChooseBestHeapAlgorithm : public HeapAlgorithm {
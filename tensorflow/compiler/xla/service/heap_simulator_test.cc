@@ -16,11 +16,13 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/heap_simulator.h"
 
 #include <memory>
+#include <random>
 #include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "tensorflow/compiler/xla/literal.h"
 #include "tensorflow/compiler/xla/service/buffer_value.h"
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
@@ -32,6 +34,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/status_macros.h"
 #include "tensorflow/compiler/xla/tests/hlo_test_base.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace xla {
 namespace {
@@ -845,7 +848,6 @@ class HeapAlgorithmTestBase : public ::testing::Test {
   const BufferValue* buffer_h_;
   const BufferValue* buffer_i_;
 
- private:
   // Create a dummy BufferValue to pass to the heap algorithm.
   const BufferValue* DummyBufferValue() {
     const BufferValue::Id id = buffers_.size();
@@ -856,6 +858,7 @@ class HeapAlgorithmTestBase : public ::testing::Test {
     return buffers_.back().get();
   }
 
+ private:
   HloComputation::Builder builder_;
   std::vector<std::unique_ptr<BufferValue>> buffers_;
 };
@@ -1320,5 +1323,232 @@ TEST_F(GlobalDecreasingSizeBestFitHeapTest, BestFit) {
   EXPECT_EQ(0, result.chunk_map.at(buffer_e_).offset);
 }
 
+TEST_F(GlobalDecreasingSizeBestFitHeapTest, ManyBuffersOfEqualSize) {
+  // Buffers of equal size and lifetime are allocated in the order of their
+  // alloc times, which must not degrade the interval tree to a list.
+  GlobalDecreasingSizeBestFitHeap heap(/*alignment=*/1);
+  std::vector<const BufferValue*> buffers;
+  for (int i = 0; i < 10000; ++i) {
+    buffers.push_back(DummyBufferValue());
+    heap.Alloc(buffers.back(), 10);
+    if (i >= 2) {
+      heap.Free(buffers[i - 2], 10);
+    }
+  }
+  heap.Free(buffers[buffers.size() - 2], 10);
+  heap.Free(buffers.back(), 10);
+
+  const HeapSimulator::Result result = heap.Finish();
+  EXPECT_EQ(30, result.heap_size);
+  for (int i = 2; i < buffers.size(); ++i) {
+    const int64 offset = result.chunk_map.at(buffers[i]).offset;
+    EXPECT_NE(offset, result.chunk_map.at(buffers[i - 1]).offset);
+    EXPECT_NE(offset, result.chunk_map.at(buffers[i - 2]).offset);
+  }
+}
+
+class GlobalMemoryPressureBestFitHeapTest : public HeapAlgorithmTestBase {};
+
+TEST_F(GlobalMemoryPressureBestFitHeapTest, Empty) {
+  GlobalMemoryPressureBestFitHeap heap(/*alignment=*/1);
+  const HeapSimulator::Result result = heap.Finish();
+  EXPECT_EQ(0, result.heap_size);
+  EXPECT_EQ(0, result.chunk_map.size());
+}
+
+TEST_F(GlobalMemoryPressureBestFitHeapTest, PressureBeforeSize) {
+  // The buffers live at the peak, a, c and d, are allocated before the larger
+  // buffer b, which fills the gap above a. Allocating b first, as
+  // GlobalDecreasingSizeBestFitHeap does, leaves no room for d next to a and
+  // c, and grows the heap to 70.
+  //
+  // space
+  //   ^
+  //   |                  +-d-+
+  //   |      +-b-+    +----c----+
+  //   |   +-----------a-----------+
+  //   -----------------------------> time
+  GlobalMemoryPressureBestFitHeap heap(/*alignment=*/1);
+  heap.Alloc(buffer_a_, 20);
+  heap.Alloc(buffer_b_, 30);
+  heap.Free(buffer_b_, 30);
+  heap.Alloc(buffer_c_, 20);
+  heap.Alloc(buffer_d_, 20);
+  heap.Free(buffer_d_, 20);
+  heap.Free(buffer_c_, 20);
+  heap.Free(buffer_a_, 20);
+
+  const HeapSimulator::Result result = heap.Finish();
+  EXPECT_EQ(60, result.heap_size);
+  EXPECT_EQ(20, result.chunk_map.at(buffer_a_).size);
+  EXPECT_EQ(30, result.chunk_map.at(buffer_b_).size);
+  EXPECT_EQ(20, result.chunk_map.at(buffer_c_).size);
+  EXPECT_EQ(20, result.chunk_map.at(buffer_d_).size);
+
+  EXPECT_EQ(0, result.chunk_map.at(buffer_a_).offset);
+  EXPECT_EQ(20, result.chunk_map.at(buffer_b_).offset);
+  EXPECT_EQ(20, result.chunk_map.at(buffer_c_).offset);
+  EXPECT_EQ(40, result.chunk_map.at(buffer_d_).offset);
+}
+
+TEST_F(GlobalMemoryPressureBestFitHeapTest, AlignedSizesAreEqual) {
+  // With an alignment of 20, a and b take up the same space, so the longer
+  // lived a is allocated first, even though b is larger.
+  GlobalMemoryPressureBestFitHeap heap(/*alignment=*/20);
+  heap.Alloc(buffer_a_, 10);
+  heap.Alloc(buffer_b_, 15);
+  heap.Free(buffer_b_, 15);
+  heap.Free(buffer_a_, 10);
+
+  const HeapSimulator::Result result = heap.Finish();
+  EXPECT_EQ(35, result.heap_size);
+  EXPECT_EQ(0, result.chunk_map.at(buffer_a_).offset);
+  EXPECT_EQ(20, result.chunk_map.at(buffer_b_).offset);
+}
+
+// A synthetic sequence of Alloc and Free calls, for benchmarking heap
+// algorithms on the number of buffers of large modules.
+class SyntheticHeapTrace {
+ public:
+  // Allocates 'num_buffers' buffers one after the other. With 'uniform', all
+  // buffers have the same size and each is freed right before the second
+  // buffer after it is allocated. Otherwise sizes and lifetimes are random,
+  // and one in twenty buffers lives for up to a quarter of the trace.
+  SyntheticHeapTrace(int num_buffers, bool uniform) : builder_("trace") {
+    std::minstd_rand0 generator(42);
+    std::vector<std::vector<Call>> frees(num_buffers + 1);
+    for (int i = 0; i < num_buffers; ++i) {
+      auto constant = builder_.AddInstruction(
+          HloInstruction::CreateConstant(LiteralUtil::CreateR0<float>(1.0)));
+      buffers_.push_back(
+          absl::make_unique<HloValue>(i, constant, ShapeIndex{}));
+      int64 size = 4096;
+      int lifetime = 2;
+      if (!uniform) {
+        size = int64{1} << (generator() % 14);
+        size *= 1 + generator() % 7;
+        size += generator() % 64;
+        lifetime = generator() % 20 == 0
+                       ? 1 + generator() % (num_buffers / 4 + 1)
+                       : 1 + generator() % 6;
+      }
+      for (const Call& call : frees[i]) {
+        calls_.push_back(call);
+      }
+      calls_.push_back(Call{/*alloc=*/true, buffers_.back().get(), size});
+      frees[std::min(num_buffers, i + lifetime)].push_back(
+          Call{/*alloc=*/false, buffers_.back().get(), size});
+    }
+    for (const Call& call : frees[num_buffers]) {
+      calls_.push_back(call);
+    }
+  }
+
+  void Run(HeapAlgorithm* heap) const {
+    for (const Call& call : calls_) {
+      if (call.alloc) {
+        heap->Alloc(call.buffer, call.size);
+      } else {
+        heap->Free(call.buffer, call.size);
+      }
+    }
+  }
+
+ private:
+  struct Call {
+    bool alloc;
+    const BufferValue* buffer;
+    int64 size;
+  };
+
+  HloComputation::Builder builder_;
+  std::vector<std::unique_ptr<BufferValue>> buffers_;
+  std::vector<Call> calls_;
+};
+
+// Runs 'make_heap()' on a synthetic trace of 'num_buffers' buffers, and
+// reports the heap size it finds in the label of the benchmark.
+template <typename MakeHeap>
+void BenchmarkHeapAlgorithm(int num_iters, int num_buffers, bool uniform,
+                            MakeHeap make_heap) {
+  tensorflow::testing::StopTiming();
+  SyntheticHeapTrace trace(num_buffers, uniform);
+  int64 heap_size = 0;
+  for (int i = 0; i < num_iters; ++i) {
+    std::unique_ptr<HeapAlgorithm> heap = make_heap();
+    tensorflow::testing::StartTiming();
+    trace.Run(heap.get());
+    heap_size = heap->Finish().heap_size;
+    tensorflow::testing::StopTiming();
+  }
+  tensorflow::testing::SetLabel(absl::StrCat("heap_size=", heap_size));
+}
+
+std::unique_ptr<HeapAlgorithm> MakeLazyBestFitHeap() {
+  return absl::make_unique<DecreasingSizeRunsHeap>(
+      absl::make_unique<LazyBestFitHeap>(/*alignment=*/64));
+}
+
+std::unique_ptr<HeapAlgorithm> MakeGlobalDecreasingSizeBestFitHeap() {
+  return absl::make_unique<GlobalDecreasingSizeBestFitHeap>(/*alignment=*/64);
+}
+
+std::unique_ptr<HeapAlgorithm> MakeGlobalMemoryPressureBestFitHeap() {
+  return absl::make_unique<GlobalMemoryPressureBestFitHeap>(/*alignment=*/64);
+}
+
+void BM_LazyBestFitHeapUniform(int num_iters, int num_buffers) {
+  BenchmarkHeapAlgorithm(num_iters, num_buffers, /*uniform=*/true,
+                         MakeLazyBestFitHeap);
+}
+
+void BM_LazyBestFitHeapRandom(int num_iters, int num_buffers) {
+  BenchmarkHeapAlgorithm(num_iters, num_buffers, /*uniform=*/false,
+                         MakeLazyBestFitHeap);
+}
+
+void BM_GlobalDecreasingSizeBestFitHeapUniform(int num_iters,
+                                               int num_buffers) {
+  BenchmarkHeapAlgorithm(num_iters, num_buffers, /*uniform=*/true,
+                         MakeGlobalDecreasingSizeBestFitHeap);
+}
+
+void BM_GlobalDecreasingSizeBestFitHeapRandom(int num_iters,
+                                              int num_buffers) {
+  BenchmarkHeapAlgorithm(num_iters, num_buffers, /*uniform=*/false,
+                         MakeGlobalDecreasingSizeBestFitHeap);
+}
+
+void BM_GlobalMemoryPressureBestFitHeapUniform(int num_iters,
+                                               int num_buffers) {
+  BenchmarkHeapAlgorithm(num_iters, num_buffers, /*uniform=*/true,
+                         MakeGlobalMemoryPressureBestFitHeap);
+}
+
+void BM_GlobalMemoryPressureBestFitHeapRandom(int num_iters,
+                                              int num_buffers) {
+  BenchmarkHeapAlgorithm(num_iters, num_buffers, /*uniform=*/false,
+                         MakeGlobalMemoryPressureBestFitHeap);
+}
+
+BENCHMARK(BM_LazyBestFitHeapUniform)->Arg(1000)->Arg(10000)->Arg(100000);
+BENCHMARK(BM_LazyBestFitHeapRandom)->Arg(1000)->Arg(10000)->Arg(100000);
+BENCHMARK(BM_GlobalDecreasingSizeBestFitHeapUniform)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000);
+BENCHMARK(BM_GlobalDecreasingSizeBestFitHeapRandom)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000);
+BENCHMARK(BM_GlobalMemoryPressureBestFitHeapUniform)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000);
+BENCHMARK(BM_GlobalMemoryPressureBestFitHeapRandom)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000);
+
 }  // namespace
 }  // namespace xla
@@ -68,6 +68,7 @@ StatusOr<bool> HloConstantFolding::Run(HloModule* module) {
   // retains the behavior from before while loop support in HloEvaluator and may
   // be revised.
   auto evaluator = absl::make_unique<HloEvaluator>(/*max_loop_iterations=*/0);
+  evaluator->set_thread_pool(thread_pool_);
 
   XLA_VLOG_LINES(2,
                  "HloConstantFolding::Run(), before:\n" + module->ToString());
@@ -30,6 +30,14 @@ class HloConstantFolding : public HloModulePass {
   // Run constant folding operations on the given module. Returns whether the
   // module was changed (constant expressions folded).
   StatusOr<bool> Run(HloModule* module) override;
+
+  // Evaluates large constant expressions on 'thread_pool'.
+  void set_thread_pool(tensorflow::thread::ThreadPool* thread_pool) override {
+    thread_pool_ = thread_pool;
+  }
+
+ private:
+  tensorflow::thread::ThreadPool* thread_pool_ = nullptr;
 };
 
 }  // namespace xla
@@ -36,34 +36,46 @@ limitations under the License.
 namespace xla {
 
 StatusOr<bool> HloDCE::Run(HloModule* module) {
-  bool changed = false;
-
   VLOG(2) << "Before dce:";
   XLA_VLOG_LINES(2, module->ToString());
 
-  for (auto* computation : module->MakeComputationPostOrder()) {
-    // Remove any dead roots and their dead transitive operands. Collect them
-    // into a separate list first to avoid problems with iterating through the
-    // computation's instruction while simultaneously removing instructions.
-    std::vector<HloInstruction*> dead_roots;
-    for (auto* instruction : computation->instructions()) {
-      if (instruction != computation->root_instruction() &&
-          instruction->user_count() == 0 &&
-          computation->IsRemovable(instruction) &&
-          !instruction->HasSideEffect()) {
-        dead_roots.push_back(instruction);
-      }
-    }
+  TF_ASSIGN_OR_RETURN(bool changed, HloComputationPass::Run(module));
 
-    for (HloInstruction* dead_root : dead_roots) {
-      VLOG(1) << "Removing dead root " << dead_root->ToString()
-              << " and it's unused operands";
-      TF_RETURN_IF_ERROR(
-          computation->RemoveInstructionAndUnusedOperands(dead_root));
-      changed = true;
+  VLOG(2) << "After dce:";
+  XLA_VLOG_LINES(2, module->ToString());
+
+  return changed;
+}
+
+StatusOr<bool> HloDCE::RunOnComputation(HloComputation* computation) {
+  bool changed = false;
+
+  // Remove any dead roots and their dead transitive operands. Collect them
+  // into a separate list first to avoid problems with iterating through the
+  // computation's instruction while simultaneously removing instructions.
+  std::vector<HloInstruction*> dead_roots;
+  for (auto* instruction : computation->instructions()) {
+    if (instruction != computation->root_instruction() &&
+        instruction->user_count() == 0 &&
+        computation->IsRemovable(instruction) &&
+        !instruction->HasSideEffect()) {
+      dead_roots.push_back(instruction);
     }
   }
 
+  for (HloInstruction* dead_root : dead_roots) {
+    VLOG(1) << "Removing dead root " << dead_root->ToString()
+            << " and it's unused operands";
+    TF_RETURN_IF_ERROR(
+        computation->RemoveInstructionAndUnusedOperands(dead_root));
+    changed = true;
+  }
+  return changed;
+}
+
+StatusOr<bool> HloDCE::RunOnModuleAfterComputations(HloModule* module) {
+  bool changed = false;
+
   // Now DCE HloComputations.  First, collect the computations that are
   // referenced by some remaining instruction.
   absl::flat_hash_set<HloComputation*> live_computations;
@@ -85,10 +97,6 @@ StatusOr<bool> HloDCE::Run(HloModule* module) {
       changed = true;
     }
   }
-
-  VLOG(2) << "After dce:";
-  XLA_VLOG_LINES(2, module->ToString());
-
   return changed;
 }
 
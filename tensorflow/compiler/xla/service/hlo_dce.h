@@ -33,7 +33,7 @@ namespace xla {
 //
 // This pass does not remove dead parameter instructions, as parameter
 // instructions cannot be deleted.
-class HloDCE : public HloModulePass {
+class HloDCE : public HloComputationPass {
  public:
   ~HloDCE() override {}
   absl::string_view name() const override { return "dce"; }
@@ -41,6 +41,17 @@ class HloDCE : public HloModulePass {
   // Run the pass on the given module. Returns whether the module was changed
   // (instructions were removed).
   StatusOr<bool> Run(HloModule* module) override;
+
+ protected:
+  // Removes the dead instructions of 'computation'.
+  StatusOr<bool> RunOnComputation(HloComputation* computation) override;
+
+  std::vector<HloComputation*> ComputationsToRun(HloModule* module) override {
+    return module->MakeComputationPostOrder();
+  }
+
+  // Removes the dead computations of 'module'.
+  StatusOr<bool> RunOnModuleAfterComputations(HloModule* module) override;
 };
 
 }  // namespace xla
@@ -46,6 +46,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/compiler/xla/window_util.h"
 #include "tensorflow/core/lib/core/bitmap.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/logging.h"
@@ -1679,6 +1680,81 @@ Status HloEvaluator::HandleGather(HloInstruction* gather) {
   return Status::OK();
 }
 
+// Sets '*result' to the broadcast of 'operand' to 'shape' along 'dimensions',
+// as Literal::Broadcast does, if both are laid out row-major and 'dimensions'
+// are increasing. The innermost output dimensions that are either all
+// broadcast over or all contiguous in the operand are then a block that is
+// filled, or copied, at once for each index of the other dimensions. Returns
+// false, and leaves '*result' alone, for other layouts.
+static bool BroadcastRowMajor(const Literal& operand, const Shape& shape,
+                              absl::Span<const int64> dimensions,
+                              Literal* result) {
+  if (!LayoutUtil::IsDenseArray(shape) ||
+      !LayoutUtil::IsDenseArray(operand.shape()) ||
+      !LayoutUtil::IsMonotonicWithDim0Major(shape.layout()) ||
+      !LayoutUtil::IsMonotonicWithDim0Major(operand.shape().layout()) ||
+      !absl::c_is_sorted(dimensions)) {
+    return false;
+  }
+  *result = Literal(shape);
+  if (ShapeUtil::IsZeroElementArray(shape)) {
+    return true;
+  }
+
+  // The stride in the operand, in elements, of each output dimension, which
+  // is 0 for the dimensions it is broadcast over.
+  const int64 rank = shape.rank();
+  std::vector<int64> source_strides(rank, 0);
+  int64 stride = 1;
+  for (int64 i = dimensions.size() - 1; i >= 0; --i) {
+    source_strides[dimensions[i]] = stride;
+    stride *= operand.shape().dimensions(i);
+  }
+
+  // The output dimensions [inner_begin, rank) make up a block of block_size
+  // elements.
+  const bool block_from_operand = rank > 0 && source_strides[rank - 1] != 0;
+  int64 inner_begin = rank;
+  int64 block_size = 1;
+  while (inner_begin > 0 &&
+         (block_from_operand ? source_strides[inner_begin - 1] == block_size
+                             : source_strides[inner_begin - 1] == 0)) {
+    --inner_begin;
+    block_size *= shape.dimensions(inner_begin);
+  }
+
+  const int64 element_bytes =
+      ShapeUtil::ByteSizeOfPrimitiveType(shape.element_type());
+  const int64 block_bytes = block_size * element_bytes;
+  const int64 num_blocks = ShapeUtil::ElementsIn(shape) / block_size;
+  const char* source_data = static_cast<const char*>(operand.untyped_data());
+  char* dest = static_cast<char*>(result->untyped_data());
+  std::vector<int64> outer_index(inner_begin, 0);
+  int64 source_index = 0;
+  for (int64 block = 0; block < num_blocks; ++block, dest += block_bytes) {
+    const char* source = source_data + source_index * element_bytes;
+    if (block_from_operand) {
+      memcpy(dest, source, block_bytes);
+    } else {
+      // Repeats the element, doubling what is filled at each step.
+      memcpy(dest, source, element_bytes);
+      for (int64 filled = element_bytes; filled < block_bytes; filled *= 2) {
+        memcpy(dest + filled, dest, std::min(filled, block_bytes - filled));
+      }
+    }
+    // Moves to the next index of the outer dimensions, in row-major order.
+    for (int64 i = inner_begin - 1; i >= 0; --i) {
+      source_index += source_strides[i];
+      if (++outer_index[i] < shape.dimensions(i)) {
+        break;
+      }
+      source_index -= source_strides[i] * shape.dimensions(i);
+      outer_index[i] = 0;
+    }
+  }
+  return true;
+}
+
 Status HloEvaluator::HandleBroadcast(HloInstruction* broadcast) {
   const Literal& operand = GetEvaluatedLiteralFor(broadcast->operand(0));
 
@@ -1698,6 +1774,12 @@ Status HloEvaluator::HandleBroadcast(HloInstruction* broadcast) {
         broadcast->ToString());
   }
 
+  Literal result;
+  if (BroadcastRowMajor(operand, broadcast->shape(), broadcast->dimensions(),
+                        &result)) {
+    evaluated_[broadcast] = std::move(result);
+    return Status::OK();
+  }
   TF_ASSIGN_OR_RETURN(
       evaluated_[broadcast],
       operand.Broadcast(broadcast->shape(), broadcast->dimensions()));
@@ -2226,6 +2308,40 @@ static StatusOr<bool> GenerateReduceOutputElement(
   return true;
 }
 
+// Returns true if 'reduce' reduces a single array with a reducer that applies
+// one arithmetic operation to its parameters in order, which the typed
+// visitors evaluate without calling the reducer for each element.
+static bool IsElementwiseReduce(const HloReduceInstruction* reduce) {
+  if (reduce->inputs().size() != 1) {
+    return false;
+  }
+  const Shape& operand_shape = reduce->inputs()[0]->shape();
+  const PrimitiveType type = reduce->shape().element_type();
+  if (operand_shape.rank() == 0 || operand_shape.element_type() != type ||
+      reduce->init_values()[0]->shape().element_type() != type) {
+    return false;
+  }
+  const HloComputation* function = reduce->to_apply();
+  const HloInstruction* root = function->root_instruction();
+  if (function->num_parameters() != 2 ||
+      function->instruction_count() != 3 ||
+      root->shape().element_type() != type ||
+      root->operand(0) != function->parameter_instruction(0) ||
+      root->operand(1) != function->parameter_instruction(1)) {
+    return false;
+  }
+  switch (root->opcode()) {
+    case HloOpcode::kAdd:
+    case HloOpcode::kMultiply:
+      return true;
+    case HloOpcode::kMaximum:
+    case HloOpcode::kMinimum:
+      return !primitive_util::IsComplexType(type);
+    default:
+      return false;
+  }
+}
+
 Status HloEvaluator::HandleReduce(HloInstruction* instr) {
   HloReduceInstruction* reduce = Cast<HloReduceInstruction>(instr);
   int64 num_args = reduce->inputs().size();
@@ -2246,6 +2362,11 @@ Status HloEvaluator::HandleReduce(HloInstruction* instr) {
       << " but is inferred to be: "
       << ShapeUtil::HumanString(inferred_return_shape);
 
+  if (IsElementwiseReduce(reduce)) {
+    return typed_visitors_[reduce->shape().element_type()]->HandleReduce(
+        reduce);
+  }
+
   absl::InlinedVector<const Literal*, 1> input_args(num_args);
   absl::InlinedVector<const Literal*, 1> init_values(num_args);
   for (int64 i = 0; i < num_args; ++i) {
@@ -2360,6 +2481,32 @@ Status HloEvaluator::Postprocess(HloInstruction* hlo) {
   return Status::OK();
 }
 
+void HloEvaluator::ForEachElementRange(
+    int64 num_elements,
+    const std::function<void(int64 begin, int64 end)>& body) const {
+  // Below this many elements, handing work to threads costs more than doing
+  // it here.
+  constexpr int64 kMinElementsForThreadPool = 1 << 16;
+  if (thread_pool_ == nullptr || num_elements < kMinElementsForThreadPool) {
+    body(0, num_elements);
+    return;
+  }
+  // Splits the elements in a few blocks per thread, to even out the load.
+  const int64 num_blocks = std::min<int64>(
+      4 * thread_pool_->NumThreads(),
+      CeilOfRatio<int64>(num_elements, kMinElementsForThreadPool / 4));
+  const int64 block_size = CeilOfRatio(num_elements, num_blocks);
+  tensorflow::BlockingCounter counter(num_blocks);
+  for (int64 block = 0; block < num_blocks; ++block) {
+    thread_pool_->Schedule([&, block] {
+      body(block * block_size,
+           std::min(num_elements, (block + 1) * block_size));
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+}
+
 namespace {
 template <typename T>
 std::unique_ptr<Array2D<T>> MatmulArray2DImpl(
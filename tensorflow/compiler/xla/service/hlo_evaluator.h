@@ -33,6 +33,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/statusor.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/compiler/xla/xla_data.pb.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/macros.h"
 
 namespace xla {
@@ -134,6 +135,12 @@ class HloEvaluator : public DfsHloVisitorWithDefault {
   // Enable the fast path for certain operations like dot or convolution.
   void set_use_fast_path(bool value) { use_fast_path_ = value; }
 
+  // Evaluates large elementwise operations on 'thread_pool', if not null.
+  // 'thread_pool' must outlive the evaluations.
+  void set_thread_pool(tensorflow::thread::ThreadPool* thread_pool) {
+    thread_pool_ = thread_pool;
+  }
+
   // Handles evaluation of a custom-call op.
   // Operand literals are provided in |operands| and implementations must
   // populate |output| before returning.
@@ -306,16 +313,40 @@ class HloEvaluator : public DfsHloVisitorWithDefault {
   bool use_fast_path_ = false;
 
  private:
-  template <typename ReturnT, typename NativeT>
-  static StatusOr<Literal> ElementWiseUnaryOpImpl(
-      HloInstruction* instruction,
-      const std::function<ReturnT(NativeT)>& unary_op,
-      const Literal& operand_literal) {
+  // Returns true if 'literal' is laid out as 'shape', so that an elementwise
+  // operation with result 'shape' can go over its elements in memory order.
+  static bool HasLayoutOf(const Literal& literal, const Shape& shape) {
+    return Layout::Equal().MinorToMajorOnly()(literal.shape().layout(),
+                                              shape.layout());
+  }
+
+  // Calls 'body' on disjoint ranges of elements that cover [0, num_elements),
+  // on thread_pool_ if there is one and there are enough elements for threads
+  // to pay off.
+  void ForEachElementRange(
+      int64 num_elements,
+      const std::function<void(int64 begin, int64 end)>& body) const;
+
+  template <typename ReturnT, typename NativeT, typename UnaryOp>
+  StatusOr<Literal> ElementWiseUnaryOpImpl(HloInstruction* instruction,
+                                           const UnaryOp& unary_op,
+                                           const Literal& operand_literal) {
     const auto shape = instruction->shape();
     const auto* operand = instruction->operand(0);
     TF_RET_CHECK(ShapeUtil::SameDimensions(shape, operand->shape()));
 
     Literal result(shape);
+    if (HasLayoutOf(operand_literal, shape)) {
+      ReturnT* result_data = result.data<ReturnT>().data();
+      const NativeT* operand_data = operand_literal.data<NativeT>().data();
+      ForEachElementRange(ShapeUtil::ElementsIn(shape),
+                          [&](int64 begin, int64 end) {
+                            for (int64 i = begin; i < end; ++i) {
+                              result_data[i] = unary_op(operand_data[i]);
+                            }
+                          });
+      return std::move(result);
+    }
     TF_RETURN_IF_ERROR(
         result.Populate<ReturnT>([&](absl::Span<const int64> multi_index) {
           return unary_op(operand_literal.Get<NativeT>(multi_index));
@@ -344,6 +375,9 @@ class HloEvaluator : public DfsHloVisitorWithDefault {
   // returns the dynamic dimension size of its operand.
   DynamicDimensionInference* dynamic_dimension_inference_ = nullptr;
 
+  // Thread pool for large elementwise operations, not owned.
+  tensorflow::thread::ThreadPool* thread_pool_ = nullptr;
+
   // Optional handler for custom_call ops.
   std::function<StatusOr<Literal>(HloInstruction* custom_call,
                                   absl::Span<const Literal*> operands)>
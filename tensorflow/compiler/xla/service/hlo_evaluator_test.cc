@@ -23,12 +23,14 @@ limitations under the License.
 
 #include "absl/memory/memory.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/substitute.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 #include "tensorflow/compiler/xla/literal.h"
 #include "tensorflow/compiler/xla/reference_util.h"
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
 #include "tensorflow/compiler/xla/service/hlo_element_type_converter.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/status.h"
 #include "tensorflow/compiler/xla/status_macros.h"
@@ -42,6 +44,8 @@ limitations under the License.
 #include "tensorflow/compiler/xla/xla_data.pb.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/platform/types.h"
@@ -4356,5 +4360,195 @@ TEST_F(HloEvaluatorTest, ZeroSizedIotaWithHugeDimension) {
   EXPECT_THAT(actual_literal.data<float>(), ::testing::IsEmpty());
 }
 
+// Evaluates an elementwise expression, reductions and a dot on operands laid
+// out as their results, which the evaluator goes over in memory order, and
+// with other layouts, and with reducers that it runs for each element.
+TEST_F(HloEvaluatorTest, ContiguousFastPathsMatchGeneralEvaluation) {
+  const char* const kModuleTemplate = R"(
+  HloModule test
+
+  add {
+    lhs = s32[] parameter(0)
+    rhs = s32[] parameter(1)
+    ROOT add = s32[] add($0)
+  }
+
+  max {
+    lhs = s32[] parameter(0)
+    rhs = s32[] parameter(1)
+    ROOT max = s32[] maximum($0)
+  }
+
+  ENTRY main {
+    a = s32[32,24]{1,0} iota(), iota_dimension=1
+    b = s32[32,24]{$1} iota(), iota_dimension=0
+    sum = s32[32,24]{1,0} add(a, b)
+    product = s32[32,24]{1,0} multiply(sum, a)
+    three = s32[] constant(3)
+    low = s32[32,24]{1,0} broadcast(three), dimensions={}
+    limit = s32[] constant(500)
+    high = s32[32,24]{1,0} broadcast(limit), dimensions={}
+    clamp = s32[32,24]{1,0} clamp(low, product, high)
+    zero = s32[] constant(0)
+    rows = s32[32]{0} reduce(clamp, zero), dimensions={1}, to_apply=add
+    columns = s32[24]{0} reduce(clamp, zero), dimensions={0}, to_apply=max
+    c = s32[24,16]{$1} iota(), iota_dimension=1
+    dot = s32[32,16]{1,0} dot(clamp, c), lhs_contracting_dims={1},
+      rhs_contracting_dims={0}
+    ROOT tuple = (s32[32]{0}, s32[24]{0}, s32[32,16]{1,0}) tuple(rows, columns,
+      dot)
+  })";
+
+  TF_ASSERT_OK_AND_ASSIGN(
+      m_, ParseAndReturnVerifiedModule(
+              absl::Substitute(kModuleTemplate, "lhs, rhs", "1,0")));
+  HloEvaluator evaluator;
+  TF_ASSERT_OK_AND_ASSIGN(Literal contiguous,
+                          evaluator.Evaluate(*m_->entry_computation(), {}));
+  TF_ASSERT_OK_AND_ASSIGN(
+      m_, ParseAndReturnVerifiedModule(
+              absl::Substitute(kModuleTemplate, "rhs, lhs", "0,1")));
+  TF_ASSERT_OK_AND_ASSIGN(Literal general,
+                          evaluator.Evaluate(*m_->entry_computation(), {}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(general, contiguous));
+}
+
+// Evaluates broadcasts to row-major results, which the evaluator fills a
+// block at a time, and to column-major ones, which it fills element by element.
+TEST_F(HloEvaluatorTest, RowMajorBroadcastsMatchGeneralEvaluation) {
+  const char* const kModuleTemplate = R"(
+  HloModule test
+
+  ENTRY main {
+    matrix = s32[3,4]{1,0} constant({{0, 1, 2, 3}, {4, 5, 6, 7},
+      {8, 9, 10, 11}})
+    vector = s32[4]{0} constant({1, 2, 3, 4})
+    scalar = s32[] constant(7)
+    inner = s32[2,3,4]{$0} broadcast(matrix), dimensions={1,2}
+    outer = s32[3,4,5]{$0} broadcast(matrix), dimensions={0,1}
+    middle = s32[3,5,4]{$0} broadcast(matrix), dimensions={0,2}
+    vector.broadcast = s32[2,4,3]{$0} broadcast(vector), dimensions={1}
+    scalar.broadcast = s32[2,3,4]{$0} broadcast(scalar), dimensions={}
+    transposed = s32[4,3]{$1} broadcast(matrix), dimensions={1,0}
+    empty = s32[0,4]{$1} broadcast(vector), dimensions={1}
+    ROOT tuple = (s32[2,3,4]{$0}, s32[3,4,5]{$0}, s32[3,5,4]{$0},
+      s32[2,4,3]{$0}, s32[2,3,4]{$0}, s32[4,3]{$1}, s32[0,4]{$1})
+      tuple(inner, outer, middle, vector.broadcast, scalar.broadcast,
+      transposed, empty)
+  })";
+
+  TF_ASSERT_OK_AND_ASSIGN(
+      m_, ParseAndReturnVerifiedModule(
+              absl::Substitute(kModuleTemplate, "2,1,0", "1,0")));
+  HloEvaluator evaluator;
+  TF_ASSERT_OK_AND_ASSIGN(Literal row_major,
+                          evaluator.Evaluate(*m_->entry_computation(), {}));
+  TF_ASSERT_OK_AND_ASSIGN(
+      m_, ParseAndReturnVerifiedModule(
+              absl::Substitute(kModuleTemplate, "0,1,2", "0,1")));
+  TF_ASSERT_OK_AND_ASSIGN(Literal general,
+                          evaluator.Evaluate(*m_->entry_computation(), {}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(general, row_major));
+  EXPECT_EQ(row_major.Get<int32>({1, 2, 3}, /*shape_index=*/{0}), 11);
+  EXPECT_EQ(row_major.Get<int32>({2, 1, 4}, /*shape_index=*/{1}), 9);
+  EXPECT_EQ(row_major.Get<int32>({1, 4, 2}, /*shape_index=*/{2}), 6);
+  EXPECT_EQ(row_major.Get<int32>({1, 3, 2}, /*shape_index=*/{3}), 4);
+  EXPECT_EQ(row_major.Get<int32>({1, 2, 3}, /*shape_index=*/{4}), 7);
+}
+
+TEST_F(HloEvaluatorTest, DoesVectorMatrixDot) {
+  constexpr absl::string_view hlo_text = R"(
+  HloModule test
+
+  ENTRY main {
+    lhs = f32[3] constant({1, 2, 3})
+    rhs = f32[3,2] constant({{1, 2}, {3, 4}, {5, 6}})
+    ROOT dot = f32[2]{0} dot(lhs, rhs), lhs_contracting_dims={0},
+      rhs_contracting_dims={0}
+  })";
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  HloEvaluator evaluator;
+  TF_ASSERT_OK_AND_ASSIGN(Literal result,
+                          evaluator.Evaluate(*m_->entry_computation(), {}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(LiteralUtil::CreateR1<float>({22, 28}),
+                                     result));
+}
+
+// Large operations are split over the threads of the evaluator's thread pool,
+// which does not change their results.
+TEST_F(HloEvaluatorTest, ThreadPoolDoesNotChangeResults) {
+  constexpr absl::string_view hlo_text = R"(
+  HloModule test
+
+  ENTRY main {
+    a = f32[512,256] iota(), iota_dimension=0
+    b = f32[512,256] iota(), iota_dimension=1
+    sine = f32[512,256] sine(a)
+    product = f32[512,256] multiply(sine, b)
+    c = f32[256,384] iota(), iota_dimension=0
+    cosine = f32[256,384] cosine(c)
+    ROOT dot = f32[512,384] dot(product, cosine), lhs_contracting_dims={1},
+      rhs_contracting_dims={0}
+  })";
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  HloEvaluator evaluator;
+  TF_ASSERT_OK_AND_ASSIGN(Literal expected,
+                          evaluator.Evaluate(*m_->entry_computation(), {}));
+  tensorflow::thread::ThreadPool thread_pool(tensorflow::Env::Default(),
+                                             "test", /*num_threads=*/4);
+  evaluator.set_thread_pool(&thread_pool);
+  TF_ASSERT_OK_AND_ASSIGN(Literal actual,
+                          evaluator.Evaluate(*m_->entry_computation(), {}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(expected, actual));
+}
+
+// Evaluates a large elementwise expression, reduction and dot, as constant
+// folding does for the constant expressions of a model, with 'num_threads'
+// threads.
+void BM_EvaluateLargeExpression(int num_iters, int num_threads) {
+  tensorflow::testing::StopTiming();
+  constexpr absl::string_view hlo_text = R"(
+  HloModule test
+
+  add {
+    lhs = f32[] parameter(0)
+    rhs = f32[] parameter(1)
+    ROOT add = f32[] add(lhs, rhs)
+  }
+
+  ENTRY main {
+    a = f32[1024,1024] iota(), iota_dimension=0
+    b = f32[1024,1024] iota(), iota_dimension=1
+    sum = f32[1024,1024] add(a, b)
+    tanh = f32[1024,1024] tanh(sum)
+    zero = f32[] constant(0)
+    reduce = f32[1024] reduce(tanh, zero), dimensions={1}, to_apply=add
+    c = f32[1024,256] iota(), iota_dimension=1
+    dot = f32[1024,256] dot(tanh, c), lhs_contracting_dims={1},
+      rhs_contracting_dims={0}
+    ROOT tuple = (f32[1024], f32[1024,256]) tuple(reduce, dot)
+  })";
+  HloModuleConfig config;
+  config.set_debug_options(GetDebugOptionsFromFlags());
+  std::unique_ptr<HloModule> module =
+      ParseHloString(hlo_text, config).ValueOrDie();
+  std::unique_ptr<tensorflow::thread::ThreadPool> thread_pool;
+  HloEvaluator evaluator;
+  if (num_threads > 1) {
+    thread_pool = absl::make_unique<tensorflow::thread::ThreadPool>(
+        tensorflow::Env::Default(), "benchmark", num_threads);
+    evaluator.set_thread_pool(thread_pool.get());
+  }
+
+  tensorflow::testing::UseRealTime();
+  tensorflow::testing::StartTiming();
+  for (int i = 0; i < num_iters; ++i) {
+    evaluator.Evaluate(*module->entry_computation(), {}).ConsumeValueOrDie();
+  }
+  tensorflow::testing::StopTiming();
+}
+
+BENCHMARK(BM_EvaluateLargeExpression)->Arg(1)->Arg(4)->Arg(16);
+
 }  // namespace
 }  // namespace xla
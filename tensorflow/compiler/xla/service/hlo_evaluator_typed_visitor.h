@@ -119,32 +119,6 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
  public:
   explicit HloEvaluatorTypedVisitor(HloEvaluator* p) : parent_(p) {}
 
-  // The following higher-order functions convert a function with ElementwiseT
-  // to a function with ReturnT.
-  std::function<ReturnT(ReturnT)> ConvertUnaryFunction(
-      const std::function<ElementwiseT(ElementwiseT)>& unary_op) {
-    return [&unary_op](ReturnT arg) {
-      return static_cast<ReturnT>(unary_op(static_cast<ElementwiseT>(arg)));
-    };
-  }
-  std::function<ReturnT(ReturnT, ReturnT)> ConvertBinaryFunction(
-      const std::function<ElementwiseT(ElementwiseT, ElementwiseT)>&
-          binary_op) {
-    return [&binary_op](ReturnT arg1, ReturnT arg2) {
-      return static_cast<ReturnT>(binary_op(static_cast<ElementwiseT>(arg1),
-                                            static_cast<ElementwiseT>(arg2)));
-    };
-  }
-  std::function<ReturnT(ReturnT, ReturnT, ReturnT)> ConvertTernaryFunction(
-      const std::function<ElementwiseT(ElementwiseT, ElementwiseT,
-                                       ElementwiseT)>& ternary_op) {
-    return [&ternary_op](ReturnT arg1, ReturnT arg2, ReturnT arg3) {
-      return static_cast<ReturnT>(ternary_op(static_cast<ElementwiseT>(arg1),
-                                             static_cast<ElementwiseT>(arg2),
-                                             static_cast<ElementwiseT>(arg3)));
-    };
-  }
-
   Status DefaultAction(HloInstruction* hlo_instruction) override {
     return Unimplemented("unhandled HLO ops for HloEvaluator: %s.",
                          HloOpcodeString(hlo_instruction->opcode()));
@@ -180,8 +154,8 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
         parent_->GetEvaluatedLiteralFor(abs->operand(0));
     TF_ASSIGN_OR_RETURN(
         parent_->evaluated_[abs],
-        (HloEvaluator::ElementWiseUnaryOpImpl<typename NativeT::value_type,
-                                              NativeT>(
+        (parent_->ElementWiseUnaryOpImpl<typename NativeT::value_type,
+                                          NativeT>(
             abs, [](NativeT elem_operand) { return std::abs(elem_operand); },
             operand_literal)));
 
@@ -920,15 +894,18 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
                                     std::is_integral<NativeT>::value>::type* =
                 nullptr>
   Status HandleClamp(HloInstruction* clamp) {
-    std::function<ElementwiseT(ElementwiseT, ElementwiseT, ElementwiseT)>
-        clamp_op = [](ElementwiseT low, ElementwiseT value, ElementwiseT high) {
-          return static_cast<ElementwiseT>(
-              std::min(high, std::max(value, low)));
-        };
+    auto clamp_op = [](ElementwiseT low, ElementwiseT value,
+                       ElementwiseT high) {
+      return static_cast<ElementwiseT>(std::min(high, std::max(value, low)));
+    };
     TF_ASSIGN_OR_RETURN(
         parent_->evaluated_[clamp],
-        ElementwiseTernaryOp(clamp,
-                             std::move(ConvertTernaryFunction(clamp_op))));
+        (ElementwiseTernaryOp<ReturnT, ReturnT, ReturnT>(
+            clamp, [&clamp_op](ReturnT low, ReturnT value, ReturnT high) {
+              return clamp_op(static_cast<ElementwiseT>(low),
+                              static_cast<ElementwiseT>(value),
+                              static_cast<ElementwiseT>(high));
+            })));
     return Status::OK();
   }
 
@@ -937,18 +914,22 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
                                     !std::is_integral<NativeT>::value>::type* =
                 nullptr>
   Status HandleClamp(HloInstruction* clamp) {
-    std::function<ElementwiseT(ElementwiseT, ElementwiseT, ElementwiseT)>
-        clamp_op = [](ElementwiseT low, ElementwiseT value, ElementwiseT high) {
-          if (std::isnan(low) || std::isnan(high) || std::isnan(value)) {
-            return static_cast<ElementwiseT>(NAN);
-          }
-          return static_cast<ElementwiseT>(
-              std::min<NativeT>(high, std::max<NativeT>(value, low)));
-        };
+    auto clamp_op = [](ElementwiseT low, ElementwiseT value,
+                       ElementwiseT high) {
+      if (std::isnan(low) || std::isnan(high) || std::isnan(value)) {
+        return static_cast<ElementwiseT>(NAN);
+      }
+      return static_cast<ElementwiseT>(
+          std::min<NativeT>(high, std::max<NativeT>(value, low)));
+    };
     TF_ASSIGN_OR_RETURN(
         parent_->evaluated_[clamp],
-        ElementwiseTernaryOp(clamp,
-                             std::move(ConvertTernaryFunction(clamp_op))));
+        (ElementwiseTernaryOp<ReturnT, ReturnT, ReturnT>(
+            clamp, [&clamp_op](ReturnT low, ReturnT value, ReturnT high) {
+              return clamp_op(static_cast<ElementwiseT>(low),
+                              static_cast<ElementwiseT>(value),
+                              static_cast<ElementwiseT>(high));
+            })));
     return Status::OK();
   }
 
@@ -966,15 +947,12 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
   Status HandleSelect(HloInstruction* select) override {
     CHECK(!ShapeUtil::IsScalar(select->operand(0)->shape()));
     CHECK(select->shape().IsArray());
-    std::function<ReturnT(bool, ReturnT, ReturnT)> select_op =
-        [](bool pred, ReturnT on_true, ReturnT on_false) {
-          if (pred) {
-            return on_true;
-          }
-          return on_false;
-        };
-    TF_ASSIGN_OR_RETURN(parent_->evaluated_[select],
-                        ElementwiseTernaryOp(select, std::move(select_op)));
+    auto select_op = [](bool pred, ReturnT on_true, ReturnT on_false) {
+      return pred ? on_true : on_false;
+    };
+    TF_ASSIGN_OR_RETURN(
+        parent_->evaluated_[select],
+        (ElementwiseTernaryOp<bool, ReturnT, ReturnT>(select, select_op)));
     return Status::OK();
   }
 
@@ -1203,14 +1181,284 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
     return Status::OK();
   }
 
+  // Evaluates a reduce of a single array, whose reducer is a single binary
+  // operation of its two parameters in order; HloEvaluator::HandleReduce
+  // handles other reduces itself. Accumulates the elements that go into each
+  // output element in the order the general implementation does, so the
+  // results are the same, but without running the reducer per element.
+  Status HandleReduce(HloInstruction* reduce) override {
+    switch (reduce->to_apply()->root_instruction()->opcode()) {
+      case HloOpcode::kAdd:
+        return HandleReduceAdd<ElementwiseT>(reduce);
+      case HloOpcode::kMultiply:
+        return ReduceInMemoryOrder<ReturnT>(
+            reduce, static_cast<ReturnT>(GetReduceInitValue(reduce)),
+            [](ReturnT accumulator, ReturnT elem) {
+              return static_cast<ReturnT>(
+                  ElementwiseT(ToArithmeticSafeType(
+                                   static_cast<ElementwiseT>(accumulator)) *
+                               ToArithmeticSafeType(
+                                   static_cast<ElementwiseT>(elem))));
+            });
+      case HloOpcode::kMaximum:
+        return HandleReduceMaximum<ElementwiseT>(reduce);
+      case HloOpcode::kMinimum:
+        return HandleReduceMinimum<ElementwiseT>(reduce);
+      default:
+        return DefaultAction(reduce);
+    }
+  }
+
+  // Floating point sums are accumulated in double.
+  template <typename NativeT, typename std::enable_if<std::is_floating_point<
+                                  NativeT>::value>::type* = nullptr>
+  Status HandleReduceAdd(HloInstruction* reduce) {
+    const ElementwiseT init_value =
+        static_cast<ElementwiseT>(GetReduceInitValue(reduce));
+    return ReduceInMemoryOrder<double>(
+        reduce, static_cast<double>(init_value),
+        [](double accumulator, ReturnT elem) {
+          return accumulator +
+                 static_cast<double>(static_cast<ElementwiseT>(elem));
+        });
+  }
+
+  template <typename NativeT, typename std::enable_if<!std::is_floating_point<
+                                  NativeT>::value>::type* = nullptr>
+  Status HandleReduceAdd(HloInstruction* reduce) {
+    return ReduceInMemoryOrder<ReturnT>(
+        reduce, GetReduceInitValue(reduce),
+        [](ReturnT accumulator, ReturnT elem) {
+          return static_cast<ReturnT>(ElementwiseT(
+              ToArithmeticSafeType(static_cast<ElementwiseT>(accumulator)) +
+              ToArithmeticSafeType(static_cast<ElementwiseT>(elem))));
+        });
+  }
+
+  template <typename NativeT,
+            typename std::enable_if<std::is_integral<NativeT>::value>::type* =
+                nullptr>
+  Status HandleReduceMaximum(HloInstruction* reduce) {
+    return ReduceInMemoryOrder<ReturnT>(
+        reduce, GetReduceInitValue(reduce),
+        [](ReturnT accumulator, ReturnT elem) {
+          return static_cast<ReturnT>(std::max(
+              static_cast<ElementwiseT>(accumulator),
+              static_cast<ElementwiseT>(elem)));
+        });
+  }
+
+  template <typename NativeT, typename std::enable_if<std::is_floating_point<
+                                  NativeT>::value>::type* = nullptr>
+  Status HandleReduceMaximum(HloInstruction* reduce) {
+    return ReduceInMemoryOrder<ReturnT>(
+        reduce, GetReduceInitValue(reduce),
+        [](ReturnT accumulator, ReturnT elem) {
+          const ElementwiseT lhs = static_cast<ElementwiseT>(accumulator);
+          const ElementwiseT rhs = static_cast<ElementwiseT>(elem);
+          return static_cast<ReturnT>(
+              ((lhs >= rhs) || std::isnan(lhs)) ? lhs : rhs);
+        });
+  }
+
+  template <
+      typename NativeT,
+      typename std::enable_if<is_complex_t<NativeT>::value>::type* = nullptr>
+  Status HandleReduceMaximum(HloInstruction* reduce) {
+    return UnsupportedTypeError(reduce);
+  }
+
+  template <typename NativeT,
+            typename std::enable_if<std::is_integral<NativeT>::value>::type* =
+                nullptr>
+  Status HandleReduceMinimum(HloInstruction* reduce) {
+    return ReduceInMemoryOrder<ReturnT>(
+        reduce, GetReduceInitValue(reduce),
+        [](ReturnT accumulator, ReturnT elem) {
+          return static_cast<ReturnT>(std::min(
+              static_cast<ElementwiseT>(accumulator),
+              static_cast<ElementwiseT>(elem)));
+        });
+  }
+
+  template <typename NativeT, typename std::enable_if<std::is_floating_point<
+                                  NativeT>::value>::type* = nullptr>
+  Status HandleReduceMinimum(HloInstruction* reduce) {
+    return ReduceInMemoryOrder<ReturnT>(
+        reduce, GetReduceInitValue(reduce),
+        [](ReturnT accumulator, ReturnT elem) {
+          const ElementwiseT lhs = static_cast<ElementwiseT>(accumulator);
+          const ElementwiseT rhs = static_cast<ElementwiseT>(elem);
+          return static_cast<ReturnT>(
+              ((lhs <= rhs) || std::isnan(lhs)) ? lhs : rhs);
+        });
+  }
+
+  template <
+      typename NativeT,
+      typename std::enable_if<is_complex_t<NativeT>::value>::type* = nullptr>
+  Status HandleReduceMinimum(HloInstruction* reduce) {
+    return UnsupportedTypeError(reduce);
+  }
+
+  ReturnT GetReduceInitValue(HloInstruction* reduce) {
+    return parent_->GetEvaluatedLiteralFor(reduce->operand(1)).Get<ReturnT>({});
+  }
+
+  // Reduces the operand of 'reduce' by going over it in memory order, and
+  // folding each element into the accumulator of its output element with
+  // 'reduce_op', which takes an AccumulatorT and a ReturnT.
+  template <typename AccumulatorT, typename ReduceOp>
+  Status ReduceInMemoryOrder(HloInstruction* reduce, AccumulatorT init_value,
+                             const ReduceOp& reduce_op) {
+    const Literal& operand =
+        parent_->GetEvaluatedLiteralFor(reduce->operand(0));
+    const Shape& operand_shape = operand.shape();
+    const int64 rank = operand_shape.rank();
+    TF_RET_CHECK(rank > 0);
+    Literal result(reduce->shape());
+
+    // The stride in the result of each operand dimension, or 0 if it is
+    // reduced. The dimensions of the result are the ones that are not.
+    std::vector<int64> result_strides(rank, 0);
+    std::vector<int64> result_to_operand_dimension;
+    for (int64 i = 0; i < rank; ++i) {
+      if (!absl::c_linear_search(reduce->dimensions(), i)) {
+        result_to_operand_dimension.push_back(i);
+      }
+    }
+    int64 stride = 1;
+    for (int64 dimension : LayoutUtil::MinorToMajor(result.shape())) {
+      result_strides[result_to_operand_dimension[dimension]] = stride;
+      stride *= result.shape().dimensions(dimension);
+    }
+
+    std::vector<AccumulatorT> accumulators(
+        ShapeUtil::ElementsIn(result.shape()), init_value);
+    const ReturnT* operand_data = operand.data<ReturnT>().data();
+    absl::Span<const int64> minor_to_major =
+        LayoutUtil::MinorToMajor(operand_shape);
+    const int64 minor_size = operand_shape.dimensions(minor_to_major[0]);
+    const int64 minor_stride = result_strides[minor_to_major[0]];
+    const int64 num_elements = ShapeUtil::ElementsIn(operand_shape);
+    std::vector<int64> index(rank, 0);
+    int64 result_offset = 0;
+    for (int64 offset = 0; offset < num_elements; offset += minor_size) {
+      AccumulatorT* accumulator = accumulators.data() + result_offset;
+      const ReturnT* elems = operand_data + offset;
+      if (minor_stride == 0) {
+        AccumulatorT value = *accumulator;
+        for (int64 i = 0; i < minor_size; ++i) {
+          value = reduce_op(value, elems[i]);
+        }
+        *accumulator = value;
+      } else {
+        for (int64 i = 0; i < minor_size; ++i) {
+          accumulator[i * minor_stride] =
+              reduce_op(accumulator[i * minor_stride], elems[i]);
+        }
+      }
+      // Steps to the next row of the minor dimension.
+      for (int64 i = 1; i < rank; ++i) {
+        const int64 dimension = minor_to_major[i];
+        result_offset += result_strides[dimension];
+        if (++index[dimension] < operand_shape.dimensions(dimension)) {
+          break;
+        }
+        result_offset -=
+            result_strides[dimension] * operand_shape.dimensions(dimension);
+        index[dimension] = 0;
+      }
+    }
+
+    absl::Span<ReturnT> result_data = result.data<ReturnT>();
+    for (int64 i = 0; i < accumulators.size(); ++i) {
+      result_data[i] = static_cast<ReturnT>(accumulators[i]);
+    }
+    parent_->evaluated_[reduce] = std::move(result);
+    return Status::OK();
+  }
+
   Status HandleDot(HloInstruction* dot) override {
     if (dot->dot_dimension_numbers().rhs_contracting_dimensions_size() == 1 &&
         parent_->use_fast_path_) {
       return HandleDot<ReturnT>(dot);
     }
+    if (IsRowMajorMatrixDot(dot)) {
+      return HandleRowMajorMatrixDot(dot);
+    }
     return HandleDotSlowPath(dot);
   }
 
+  // Returns true if 'dot' multiplies a vector or row major matrix by another,
+  // contracting the minor dimension of the lhs with the major one of the rhs.
+  bool IsRowMajorMatrixDot(HloInstruction* dot) {
+    const auto& dnums = dot->dot_dimension_numbers();
+    const Shape& lhs_shape =
+        parent_->GetEvaluatedLiteralFor(dot->operand(0)).shape();
+    const Shape& rhs_shape =
+        parent_->GetEvaluatedLiteralFor(dot->operand(1)).shape();
+    return dnums.lhs_batch_dimensions_size() == 0 &&
+           dnums.lhs_contracting_dimensions_size() == 1 &&
+           dnums.rhs_contracting_dimensions_size() == 1 &&
+           (lhs_shape.rank() == 1 || lhs_shape.rank() == 2) &&
+           (rhs_shape.rank() == 1 || rhs_shape.rank() == 2) &&
+           dnums.lhs_contracting_dimensions(0) == lhs_shape.rank() - 1 &&
+           dnums.rhs_contracting_dimensions(0) == 0 &&
+           LayoutUtil::IsMonotonicWithDim0Major(lhs_shape.layout()) &&
+           LayoutUtil::IsMonotonicWithDim0Major(rhs_shape.layout());
+  }
+
+  // Computes each row of the result by adding up the rows of the rhs scaled
+  // by the elements of the row of the lhs, so that the inner loop goes over
+  // contiguous elements. Each result element adds up the same products in the
+  // same order as HandleDotSlowPath does.
+  Status HandleRowMajorMatrixDot(HloInstruction* dot) {
+    const Literal& lhs_literal =
+        parent_->GetEvaluatedLiteralFor(dot->operand(0));
+    const Literal& rhs_literal =
+        parent_->GetEvaluatedLiteralFor(dot->operand(1));
+    const Shape& lhs_shape = lhs_literal.shape();
+    const Shape& rhs_shape = rhs_literal.shape();
+    const int64 m = lhs_shape.rank() == 2 ? lhs_shape.dimensions(0) : 1;
+    const int64 k = rhs_shape.dimensions(0);
+    const int64 n = rhs_shape.rank() == 2 ? rhs_shape.dimensions(1) : 1;
+    TF_RET_CHECK(lhs_shape.dimensions(lhs_shape.rank() - 1) == k);
+
+    // The result is produced in the default layout, and Postprocess lays it
+    // out as the dot requires.
+    Shape result_shape = dot->shape();
+    LayoutUtil::SetToDefaultLayout(&result_shape);
+    Literal result(result_shape);
+    const ReturnT* lhs_data = lhs_literal.data<ReturnT>().data();
+    const ReturnT* rhs_data = rhs_literal.data<ReturnT>().data();
+    ReturnT* result_data = result.data<ReturnT>().data();
+    parent_->ForEachElementRange(m * n, [&](int64 begin, int64 end) {
+      std::unique_ptr<ElementwiseT[]> row(new ElementwiseT[n]);
+      while (begin < end) {
+        const int64 i = begin / n;
+        const int64 column_begin = begin % n;
+        const int64 column_end = std::min(n, column_begin + (end - begin));
+        std::fill(row.get() + column_begin, row.get() + column_end,
+                  static_cast<ElementwiseT>(0));
+        for (int64 p = 0; p < k; ++p) {
+          const ElementwiseT lhs_elem =
+              static_cast<ElementwiseT>(lhs_data[i * k + p]);
+          const ReturnT* rhs_row = rhs_data + p * n;
+          for (int64 j = column_begin; j < column_end; ++j) {
+            row[j] += lhs_elem * static_cast<ElementwiseT>(rhs_row[j]);
+          }
+        }
+        for (int64 j = column_begin; j < column_end; ++j) {
+          result_data[i * n + j] = static_cast<ReturnT>(row[j]);
+        }
+        begin += column_end - column_begin;
+      }
+    });
+    parent_->evaluated_[dot] = std::move(result);
+    return Status::OK();
+  }
+
   template <typename NativeT, typename std::enable_if<std::is_same<
                                   NativeT, float>::value>::type* = nullptr>
   Status HandleDot(HloInstruction* dot) {
@@ -2769,23 +3017,30 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
     return std::move(result);
   }
 
-  StatusOr<Literal> ElementWiseUnaryOp(
-      HloInstruction* instruction,
-      const std::function<ElementwiseT(ElementwiseT)>& unary_op) {
+  // The elementwise operations below compute in ElementwiseT. When the
+  // operands are laid out as the result, they go over the elements in memory
+  // order, in loops that the compiler can vectorize.
+  template <typename UnaryOp>
+  StatusOr<Literal> ElementWiseUnaryOp(HloInstruction* instruction,
+                                       const UnaryOp& unary_op) {
     const Literal& operand_literal =
         parent_->GetEvaluatedLiteralFor(instruction->operand(0));
     TF_ASSIGN_OR_RETURN(
         auto result_literal,
-        (HloEvaluator::ElementWiseUnaryOpImpl<ReturnT, ReturnT>(
-            instruction, ConvertUnaryFunction(unary_op), operand_literal)));
+        (parent_->ElementWiseUnaryOpImpl<ReturnT, ReturnT>(
+            instruction,
+            [&unary_op](ReturnT operand) {
+              return static_cast<ReturnT>(static_cast<ElementwiseT>(
+                  unary_op(static_cast<ElementwiseT>(operand))));
+            },
+            operand_literal)));
 
     return std::move(result_literal);
   }
 
-  StatusOr<Literal> ElementWiseBinaryOp(
-      HloInstruction* instruction,
-      const std::function<ElementwiseT(ElementwiseT, ElementwiseT)>&
-          binary_op) {
+  template <typename BinaryOp>
+  StatusOr<Literal> ElementWiseBinaryOp(HloInstruction* instruction,
+                                        const BinaryOp& binary_op) {
     const auto shape = instruction->shape();
     const auto* lhs = instruction->operand(0);
     const auto* rhs = instruction->operand(1);
@@ -2797,19 +3052,39 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
 
     Literal result(shape);
 
+    auto converted_op = [&binary_op](ReturnT lhs_elem, ReturnT rhs_elem) {
+      return static_cast<ReturnT>(static_cast<ElementwiseT>(
+          binary_op(static_cast<ElementwiseT>(lhs_elem),
+                    static_cast<ElementwiseT>(rhs_elem))));
+    };
+    if (HloEvaluator::HasLayoutOf(lhs_literal, shape) &&
+        HloEvaluator::HasLayoutOf(rhs_literal, shape)) {
+      ReturnT* result_data = result.data<ReturnT>().data();
+      const ReturnT* lhs_data = lhs_literal.data<ReturnT>().data();
+      const ReturnT* rhs_data = rhs_literal.data<ReturnT>().data();
+      parent_->ForEachElementRange(
+          ShapeUtil::ElementsIn(shape), [&](int64 begin, int64 end) {
+            for (int64 i = begin; i < end; ++i) {
+              result_data[i] = converted_op(lhs_data[i], rhs_data[i]);
+            }
+          });
+      return std::move(result);
+    }
+
     TF_RETURN_IF_ERROR(
         result.Populate<ReturnT>([&](absl::Span<const int64> multi_index) {
-          return ConvertBinaryFunction(binary_op)(
-              lhs_literal.Get<ReturnT>(multi_index),
-              rhs_literal.Get<ReturnT>(multi_index));
+          return converted_op(lhs_literal.Get<ReturnT>(multi_index),
+                              rhs_literal.Get<ReturnT>(multi_index));
         }));
     return std::move(result);
   }
 
-  template <typename LhsType, typename RhsType, typename EhsType>
-  StatusOr<Literal> ElementwiseTernaryOp(
-      HloInstruction* instruction,
-      const std::function<ReturnT(LhsType, RhsType, EhsType)>& ternary_op) {
+  // Computes 'ternary_op' on operands whose elements are of types LhsType,
+  // RhsType and EhsType, converting its result to ReturnT.
+  template <typename LhsType, typename RhsType, typename EhsType,
+            typename TernaryOp>
+  StatusOr<Literal> ElementwiseTernaryOp(HloInstruction* instruction,
+                                         const TernaryOp& ternary_op) {
     const auto shape = instruction->shape();
     const auto* lhs = instruction->operand(0);
     const auto* rhs = instruction->operand(1);
@@ -2824,11 +3099,29 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
 
     Literal result(shape);
 
+    if (HloEvaluator::HasLayoutOf(lhs_literal, shape) &&
+        HloEvaluator::HasLayoutOf(rhs_literal, shape) &&
+        HloEvaluator::HasLayoutOf(ehs_literal, shape)) {
+      ReturnT* result_data = result.data<ReturnT>().data();
+      const LhsType* lhs_data = lhs_literal.data<LhsType>().data();
+      const RhsType* rhs_data = rhs_literal.data<RhsType>().data();
+      const EhsType* ehs_data = ehs_literal.data<EhsType>().data();
+      parent_->ForEachElementRange(
+          ShapeUtil::ElementsIn(shape), [&](int64 begin, int64 end) {
+            for (int64 i = begin; i < end; ++i) {
+              result_data[i] = static_cast<ReturnT>(
+                  ternary_op(lhs_data[i], rhs_data[i], ehs_data[i]));
+            }
+          });
+      return std::move(result);
+    }
+
     TF_RETURN_IF_ERROR(
         result.Populate<ReturnT>([&](absl::Span<const int64> multi_index) {
-          return ternary_op(lhs_literal.Get<LhsType>(multi_index),
-                            rhs_literal.Get<RhsType>(multi_index),
-                            ehs_literal.Get<EhsType>(multi_index));
+          return static_cast<ReturnT>(
+              ternary_op(lhs_literal.Get<LhsType>(multi_index),
+                         rhs_literal.Get<RhsType>(multi_index),
+                         ehs_literal.Get<EhsType>(multi_index)));
         }));
 
     return std::move(result);
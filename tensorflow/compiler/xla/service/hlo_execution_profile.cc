@@ -140,4 +140,14 @@ uint64 HloExecutionProfile::GetCyclesTakenBy(const HloInstruction& hlo) const {
   return profile_counters_[hlo_profile_index_map_.GetProfileIndexFor(hlo)];
 }
 
+HloExecutionProfileData HloExecutionProfile::ToProto() const {
+  HloExecutionProfileData hlo_execution_profile_data;
+  *hlo_execution_profile_data.mutable_printer_data() =
+      hlo_profile_printer_data_;
+  for (const auto& counter : profile_counters_) {
+    hlo_execution_profile_data.add_profile_counters(counter);
+  }
+  return hlo_execution_profile_data;
+}
+
 }  // namespace xla
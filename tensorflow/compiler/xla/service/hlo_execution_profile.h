@@ -21,6 +21,7 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/map_util.h"
 #include "tensorflow/compiler/xla/service/hlo_cost_analysis.h"
+#include "tensorflow/compiler/xla/service/hlo_execution_profile_data.pb.h"
 #include "tensorflow/compiler/xla/service/hlo_profile_printer.h"
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/core/platform/stream_executor_no_cuda.h"
@@ -146,6 +147,10 @@ class HloExecutionProfile {
                            device_description.clock_rate_ghz());
   }
 
+  // Returns the profile counters together with the printer data that
+  // attributes them to computations and instructions, e.g. to save them.
+  HloExecutionProfileData ToProto() const;
+
   std::vector<int64>* mutable_profile_counters() { return &profile_counters_; }
   const std::vector<int64>& profile_counters() const {
     return profile_counters_;
@@ -71,6 +71,13 @@ TEST_F(HloExecutionProfileTest, Basic) {
                                          dot_instruction->name())),
                     ContainsRegex(StrCat(add_cycles, R"(\b.*%)",
                                          add_instruction->name()))));
+
+  HloExecutionProfileData profile_data = execution_profile.ToProto();
+  EXPECT_EQ(profile_data.profile_counters_size(),
+            static_cast<int>(profile_index_map.total_count()));
+  EXPECT_EQ(profile_data.profile_counters(
+                profile_index_map.GetProfileIndexFor(*dot_instruction)),
+            dot_cycles);
 }
 }  // namespace
 }  // namespace xla
@@ -15,7 +15,9 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 
+#include <algorithm>
 #include <iterator>
+#include <map>
 #include <set>
 #include <sstream>
 #include <unordered_map>
@@ -31,6 +33,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/hlo_schedule.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
 #include "tensorflow/core/platform/types.h"
 
@@ -48,6 +51,15 @@ Status HloModule::set_schedule(HloSchedule schedule) {
   return Status::OK();
 }
 
+namespace {
+
+// The computations added to the module by the run of
+// RunOnComputationsInParallel on this thread.
+thread_local std::vector<HloComputation*>* computations_added_by_this_thread =
+    nullptr;
+
+}  // namespace
+
 HloComputation* HloModule::AddComputationInternal(
     std::unique_ptr<HloComputation> computation, bool is_entry,
     bool uniquify_identifiers) {
@@ -65,6 +77,24 @@ HloComputation* HloModule::AddComputationInternal(
         entry_computation_->root_instruction()->shape());
   }
 
+  if (running_in_parallel_) {
+    // RunOnComputationsInParallel gives the computation and its instructions
+    // their final names and ids.
+    CHECK(!is_entry);
+    CHECK(uniquify_identifiers);
+    tensorflow::mutex_lock lock(parallel_mutex_);
+    for (auto* instruction : computation->instructions()) {
+      instruction->SetUniqueId(NewUniqueInstructionId());
+    }
+    computation->SetUniqueId(computation->root_instruction()->unique_id());
+    computation->set_parent(this);
+    computations_.push_back(std::move(computation));
+    if (computations_added_by_this_thread != nullptr) {
+      computations_added_by_this_thread->push_back(computations_.back().get());
+    }
+    return computations_.back().get();
+  }
+
   if (uniquify_identifiers) {
     computation->UniquifyName(&computation_name_uniquer_);
     for (auto* instruction : computation->instructions()) {
@@ -107,6 +137,8 @@ HloComputation* HloModule::AddEntryComputation(
 }
 
 Status HloModule::RemoveEmbeddedComputation(HloComputation* to_remove) {
+  TF_RET_CHECK(!running_in_parallel_)
+      << "Computations cannot be removed in RunOnComputationsInParallel";
   auto it = absl::c_find_if(
       computations_, [&to_remove](const std::unique_ptr<HloComputation>& comp) {
         return comp.get() == to_remove;
@@ -116,6 +148,124 @@ Status HloModule::RemoveEmbeddedComputation(HloComputation* to_remove) {
   return Status::OK();
 }
 
+void HloModule::UniquifyAddedInstruction(HloInstruction* instruction) {
+  if (running_in_parallel_) {
+    // RunOnComputationsInParallel gives the instruction its final name and id.
+    tensorflow::mutex_lock lock(parallel_mutex_);
+    instruction->SetUniqueId(NewUniqueInstructionId());
+    return;
+  }
+  instruction->UniquifyName(&instruction_name_uniquer_);
+  instruction->SetUniqueId(NewUniqueInstructionId());
+}
+
+StatusOr<bool> HloModule::RunOnComputationsInParallel(
+    absl::Span<HloComputation* const> computations,
+    const std::function<StatusOr<bool>(HloComputation*)>& fn,
+    tensorflow::thread::ThreadPool* thread_pool) {
+  CHECK(!running_in_parallel_);
+  // Group the computations by their height in the call graph, so that
+  // computations of the same height do not call each other.
+  absl::flat_hash_map<const HloComputation*, int64> heights;
+  for (const HloComputation* computation : MakeComputationPostOrder()) {
+    int64 height = 0;
+    for (const HloInstruction* instruction : computation->instructions()) {
+      for (const HloComputation* callee : instruction->called_computations()) {
+        height = std::max(height, heights.at(callee) + 1);
+      }
+    }
+    heights[computation] = height;
+  }
+  std::map<int64, std::vector<int64>> computations_by_height;
+  for (int64 i = 0; i < computations.size(); ++i) {
+    computations_by_height[heights.at(computations[i])].push_back(i);
+  }
+
+  const int first_added_id = next_unique_id_;
+  std::vector<StatusOr<bool>> results(computations.size(), false);
+  std::vector<std::vector<HloComputation*>> added_computations(
+      computations.size());
+  running_in_parallel_ = true;
+  for (const auto& height_and_indices : computations_by_height) {
+    const std::vector<int64>& indices = height_and_indices.second;
+    tensorflow::BlockingCounter counter(indices.size());
+    for (int64 i : indices) {
+      thread_pool->Schedule([&, i] {
+        std::vector<HloComputation*>* const outer_added_computations =
+            computations_added_by_this_thread;
+        computations_added_by_this_thread = &added_computations[i];
+        results[i] = fn(computations[i]);
+        computations_added_by_this_thread = outer_added_computations;
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+    if (absl::c_any_of(indices, [&](int64 i) { return !results[i].ok(); })) {
+      break;
+    }
+  }
+  running_in_parallel_ = false;
+
+  // Move the added computations to the end of the module in order.
+  absl::flat_hash_map<HloComputation*, std::unique_ptr<HloComputation>>
+      added_computation_storage;
+  for (const std::vector<HloComputation*>& added : added_computations) {
+    for (HloComputation* computation : added) {
+      added_computation_storage[computation];
+    }
+  }
+  auto added_begin = std::stable_partition(
+      computations_.begin(), computations_.end(),
+      [&](const std::unique_ptr<HloComputation>& computation) {
+        return !added_computation_storage.contains(computation.get());
+      });
+  for (auto it = added_begin; it != computations_.end(); ++it) {
+    HloComputation* computation = it->get();
+    added_computation_storage[computation] = std::move(*it);
+  }
+  computations_.erase(added_begin, computations_.end());
+
+  // Give the added instructions and computations their final names and ids,
+  // in order. The provisional ids of the instructions added to a computation
+  // are in the order in which they were added.
+  next_unique_id_ = first_added_id;
+  auto uniquify_added_instructions = [&](HloComputation* computation,
+                                         bool all_added) {
+    std::vector<HloInstruction*> added_instructions;
+    for (HloInstruction* instruction : computation->instructions()) {
+      if (all_added || instruction->unique_id() >= first_added_id) {
+        added_instructions.push_back(instruction);
+      }
+    }
+    absl::c_sort(added_instructions,
+                 [](const HloInstruction* a, const HloInstruction* b) {
+                   return a->unique_id() < b->unique_id();
+                 });
+    for (HloInstruction* instruction : added_instructions) {
+      instruction->ClearUniqueIdInternal();
+      UniquifyAddedInstruction(instruction);
+    }
+  };
+  for (int64 i = 0; i < computations.size(); ++i) {
+    uniquify_added_instructions(computations[i], /*all_added=*/false);
+    for (HloComputation* computation : added_computations[i]) {
+      computation->UniquifyName(&computation_name_uniquer_);
+      uniquify_added_instructions(computation, /*all_added=*/true);
+      computation->ClearUniqueIdInternal();
+      computation->SetUniqueId(computation->root_instruction()->unique_id());
+      computations_.push_back(
+          std::move(added_computation_storage.at(computation)));
+    }
+  }
+
+  bool changed = false;
+  for (const StatusOr<bool>& result : results) {
+    TF_RETURN_IF_ERROR(result.status());
+    changed |= result.ValueOrDie();
+  }
+  return changed;
+}
+
 HloComputation* HloModule::AddEmbeddedComputation(
     std::unique_ptr<HloComputation> computation) {
   return AddComputationInternal(std::move(computation), /*is_entry=*/false,
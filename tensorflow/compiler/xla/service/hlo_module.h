@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_COMPILER_XLA_SERVICE_HLO_MODULE_H_
 
 #include <atomic>
+#include <functional>
 #include <list>
 #include <memory>
 #include <random>
@@ -38,6 +39,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/hlo_schedule.h"
 #include "tensorflow/compiler/xla/service/name_uniquer.h"
 #include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/iterator_range.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/mutex.h"
@@ -235,6 +237,26 @@ class HloModule {
     return result;
   }
 
+  // Gives an instruction that is added to a computation of this module a
+  // unique name and id.
+  void UniquifyAddedInstruction(HloInstruction* instruction);
+
+  // Runs 'fn' on each of 'computations' on 'thread_pool', and returns whether
+  // any of the runs returned true. 'fn' runs on a computation only after it has
+  // finished on all the computations it calls, and does not run on two
+  // computations at the same time if one calls the other.
+  //
+  // 'fn' may change the computation it runs on and add embedded computations
+  // to the module, but must not change, remove or add instructions to any
+  // other computation. The instructions and computations 'fn' adds are given
+  // unique ids and names, and the computations are added to the module, in
+  // the order of 'computations' and then in the order in which they were
+  // added, so that the result does not depend on how the runs interleave.
+  StatusOr<bool> RunOnComputationsInParallel(
+      absl::Span<HloComputation* const> computations,
+      const std::function<StatusOr<bool>(HloComputation*)>& fn,
+      tensorflow::thread::ThreadPool* thread_pool);
+
   // input_output_alias_config indicates the list of aliased buffers that are
   // expected from the module.
   HloInputOutputAliasConfig& input_output_alias_config() {
@@ -306,6 +328,12 @@ class HloModule {
   NameUniquer instruction_name_uniquer_{/*separator=*/"."};
   int next_unique_id_ = 0;
 
+  // True while RunOnComputationsInParallel runs. Instructions and
+  // computations added meanwhile only get provisional ids, under
+  // parallel_mutex_, and no unique names.
+  bool running_in_parallel_ = false;
+  tensorflow::mutex parallel_mutex_;
+
   // Used to keep track of the next unique module id that should be assigned.
   static std::atomic<int> next_unique_module_id_;
   // A unique id to label modules with.
@@ -0,0 +1,43 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+
+namespace xla {
+
+StatusOr<bool> HloComputationPass::Run(HloModule* module) {
+  const std::vector<HloComputation*> computations = ComputationsToRun(module);
+  bool changed = false;
+  if (thread_pool_ != nullptr && computations.size() > 1) {
+    TF_ASSIGN_OR_RETURN(
+        changed, module->RunOnComputationsInParallel(
+                     computations,
+                     [this](HloComputation* computation) {
+                       return RunOnComputation(computation);
+                     },
+                     thread_pool_));
+  } else {
+    for (HloComputation* computation : computations) {
+      TF_ASSIGN_OR_RETURN(bool computation_changed,
+                          RunOnComputation(computation));
+      changed |= computation_changed;
+    }
+  }
+  TF_ASSIGN_OR_RETURN(bool module_changed,
+                      RunOnModuleAfterComputations(module));
+  return changed || module_changed;
+}
+
+}  // namespace xla
@@ -21,6 +21,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/status_macros.h"
 #include "tensorflow/compiler/xla/statusor.h"
 #include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/macros.h"
 
 namespace xla {
@@ -43,6 +44,10 @@ class HloPassInterface {
   virtual StatusOr<bool> RunOnModuleGroup(HloModuleGroup* module_group) = 0;
 
   virtual bool IsPassPipeline() { return false; }
+
+  // Gives the pass a thread pool to run on, for passes that can run parts of
+  // themselves in parallel. 'thread_pool' must outlive the runs of the pass.
+  virtual void set_thread_pool(tensorflow::thread::ThreadPool* thread_pool) {}
 };
 
 // Base class for passes which are module-scoped.
@@ -68,6 +73,46 @@ class HloModulePass : public HloPassInterface {
   virtual void UpdateLayout(Shape* shape) {}
 };
 
+// Base class for passes which run on each computation of a module on its own.
+// When run on a computation, such a pass may change that computation and add
+// embedded computations to the module. It may look at the computations called
+// by the computation, after the pass has run on them, but must not look at or
+// change any other computation.
+//
+// Given a thread pool, the pass runs on computations that don't call each
+// other in parallel, see HloModule::RunOnComputationsInParallel. The result
+// is the same on any number of threads, and only differs from the result
+// without a thread pool in the names and ids of added instructions.
+class HloComputationPass : public HloModulePass {
+ public:
+  // Runs the pass on the computations of 'module' returned by
+  // ComputationsToRun, then runs RunOnModuleAfterComputations.
+  StatusOr<bool> Run(HloModule* module) override;
+
+  void set_thread_pool(tensorflow::thread::ThreadPool* thread_pool) override {
+    thread_pool_ = thread_pool;
+  }
+
+ protected:
+  // Runs the pass on 'computation'. Returns whether it modified the module.
+  virtual StatusOr<bool> RunOnComputation(HloComputation* computation) = 0;
+
+  // Returns the computations of 'module' to run the pass on, callees before
+  // callers. Defaults to the non-fusion computations.
+  virtual std::vector<HloComputation*> ComputationsToRun(HloModule* module) {
+    return module->MakeNonfusionComputations();
+  }
+
+  // Runs the part of the pass that looks at the whole module, after it has run
+  // on each computation. Returns whether it modified the module.
+  virtual StatusOr<bool> RunOnModuleAfterComputations(HloModule* module) {
+    return false;
+  }
+
+ private:
+  tensorflow::thread::ThreadPool* thread_pool_ = nullptr;
+};
+
 // Base class for passes which are module-group scoped. These passes cannot run
 // on an HLO module.
 class HloModuleGroupPass : public HloPassInterface {
@@ -15,13 +15,25 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/hlo_pass_pipeline.h"
 
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/service/algebraic_simplifier.h"
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_cse.h"
+#include "tensorflow/compiler/xla/service/hlo_dce.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/service/hlo_parser.h"
 #include "tensorflow/compiler/xla/tests/hlo_test_base.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace xla {
 namespace {
@@ -255,5 +267,148 @@ ENTRY main {
       ::testing::HasSubstr("Module group pass cannot be run on a module"));
 }
 
+// A computation pass which replaces the root of each computation by a call
+// to a new computation that negates it.
+class NegateRootPass : public HloComputationPass {
+  absl::string_view name() const override { return "negate-root"; }
+
+  StatusOr<bool> RunOnComputation(HloComputation* computation) override {
+    HloInstruction* root = computation->root_instruction();
+    HloComputation::Builder builder("negate");
+    HloInstruction* parameter = builder.AddInstruction(
+        HloInstruction::CreateParameter(0, root->shape(), "x"));
+    builder.AddInstruction(HloInstruction::CreateUnary(
+        root->shape(), HloOpcode::kNegate, parameter));
+    HloComputation* negate =
+        computation->parent()->AddEmbeddedComputation(builder.Build());
+    computation->set_root_instruction(computation->AddInstruction(
+        HloInstruction::CreateCall(root->shape(), {root}, negate)));
+    return true;
+  }
+};
+
+// Returns a module whose entry computation sums the results of calls to
+// 'num_computations' computations with simplifiable and common
+// subexpressions.
+string ManyComputationsModule(int num_computations) {
+  std::vector<string> computations;
+  std::vector<string> calls;
+  for (int i = 0; i < num_computations; ++i) {
+    computations.push_back(absl::StrFormat(
+        R"(computation.%1$d {
+  p.%1$d = f32[8] parameter(0)
+  zero.%1$d = f32[] constant(0)
+  zeros.%1$d = f32[8] broadcast(zero.%1$d), dimensions={}
+  add.%1$d = f32[8] add(p.%1$d, zeros.%1$d)
+  exp.%1$d.0 = f32[8] exponential(add.%1$d)
+  exp.%1$d.1 = f32[8] exponential(add.%1$d)
+  log.%1$d = f32[8] log(exp.%1$d.1)
+  ROOT multiply.%1$d = f32[8] multiply(exp.%1$d.0, exp.%1$d.1)
+}
+)",
+        i));
+    calls.push_back(absl::StrFormat(
+        "  call.%d = f32[8] call(x), to_apply=computation.%d\n", i, i));
+    calls.push_back(i == 0 ? "  sum.0 = f32[8] add(x, call.0)\n"
+                           : absl::StrFormat(
+                                 "  sum.%d = f32[8] add(sum.%d, call.%d)\n",
+                                 i, i - 1, i));
+  }
+  return absl::StrCat(
+      "HloModule many_computations\n\n", absl::StrJoin(computations, "\n"),
+      "\nENTRY main {\n  x = f32[8] parameter(0)\n", absl::StrJoin(calls, ""),
+      "  ROOT root = f32[8] negate(sum.", num_computations - 1, ")\n}\n");
+}
+
+TEST_F(HloPassPipelineTest, ParallelComputationPassIsDeterministic) {
+  const string module_str = ManyComputationsModule(16);
+  string expected;
+  for (int num_threads : {1, 2, 8}) {
+    TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<VerifiedHloModule> module,
+                            ParseAndReturnVerifiedModule(module_str));
+    tensorflow::thread::ThreadPool thread_pool(tensorflow::Env::Default(),
+                                               "parallel_passes", num_threads);
+    HloPassPipeline pipeline(TestName());
+    pipeline.AddPass<NegateRootPass>();
+    pipeline.set_thread_pool(&thread_pool);
+    TF_ASSERT_OK_AND_ASSIGN(bool changed, pipeline.Run(module.get()));
+    EXPECT_TRUE(changed);
+    TF_EXPECT_OK(
+        module->CheckUniqueNamesAndIdsForComputationsAndInstructions());
+    // The entry computation and each called computation got a negate
+    // computation.
+    EXPECT_EQ(module->computation_count(), 2 * (16 + 1));
+    if (expected.empty()) {
+      expected = module->ToString();
+    } else {
+      EXPECT_EQ(module->ToString(), expected);
+    }
+  }
+}
+
+TEST_F(HloPassPipelineTest, ParallelComputationPassesMatchSequentialRun) {
+  const string module_str = ManyComputationsModule(8);
+  auto run_pipeline =
+      [&](tensorflow::thread::ThreadPool* thread_pool) -> StatusOr<string> {
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<VerifiedHloModule> module,
+                        ParseAndReturnVerifiedModule(module_str));
+    HloPassPipeline pipeline(TestName());
+    pipeline.AddPass<NegateRootPass>();
+    pipeline.AddPass<AlgebraicSimplifier>(AlgebraicSimplifierOptions(
+        [](const Shape&, const Shape&) { return false; }));
+    pipeline.AddPass<HloCSE>(/*is_layout_sensitive=*/false);
+    pipeline.AddPass<HloDCE>();
+    if (thread_pool != nullptr) {
+      pipeline.set_thread_pool(thread_pool);
+    }
+    TF_RETURN_IF_ERROR(pipeline.Run(module.get()).status());
+    TF_RETURN_IF_ERROR(
+        module->CheckUniqueNamesAndIdsForComputationsAndInstructions());
+    return module->entry_computation()->ToString(HloPrintOptions::Canonical());
+  };
+
+  TF_ASSERT_OK_AND_ASSIGN(string sequential, run_pipeline(nullptr));
+  tensorflow::thread::ThreadPool thread_pool(tensorflow::Env::Default(),
+                                             "parallel_passes", 4);
+  TF_ASSERT_OK_AND_ASSIGN(string parallel, run_pipeline(&thread_pool));
+  EXPECT_EQ(sequential, parallel);
+}
+
+// Runs algebraic simplification, CSE and DCE on a module with
+// 'num_computations' called computations, on 'num_threads' threads, or
+// without a thread pool if 'num_threads' is 0.
+void BM_ComputationPasses(int num_iters, int num_computations,
+                          int num_threads) {
+  tensorflow::testing::StopTiming();
+  const string module_str = ManyComputationsModule(num_computations);
+  std::unique_ptr<tensorflow::thread::ThreadPool> thread_pool;
+  if (num_threads > 0) {
+    thread_pool = absl::make_unique<tensorflow::thread::ThreadPool>(
+        tensorflow::Env::Default(), "parallel_passes", num_threads);
+  }
+  for (int i = 0; i < num_iters; ++i) {
+    std::unique_ptr<HloModule> module =
+        ParseHloString(module_str).ConsumeValueOrDie();
+    HloPassPipeline pipeline("computation-passes");
+    pipeline.AddPass<AlgebraicSimplifier>(AlgebraicSimplifierOptions(
+        [](const Shape&, const Shape&) { return false; }));
+    pipeline.AddPass<HloCSE>(/*is_layout_sensitive=*/false);
+    pipeline.AddPass<HloDCE>();
+    pipeline.set_thread_pool(thread_pool.get());
+
+    tensorflow::testing::StartTiming();
+    TF_CHECK_OK(pipeline.Run(module.get()).status());
+    tensorflow::testing::StopTiming();
+  }
+  tensorflow::testing::SetLabel(
+      num_threads > 0 ? absl::StrCat(num_threads, " threads") : "sequential");
+}
+
+BENCHMARK(BM_ComputationPasses)
+    ->ArgPair(64, 0)
+    ->ArgPair(64, 8)
+    ->ArgPair(1024, 0)
+    ->ArgPair(1024, 8);
+
 }  // namespace
 }  // namespace xla
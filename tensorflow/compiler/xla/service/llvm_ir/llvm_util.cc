@@ -583,7 +583,8 @@ static Status CreateAndWriteStringToFile(const string& directory_name,
 }
 
 void DumpIrIfEnabled(const HloModule& hlo_module,
-                     const llvm::Module& llvm_module, bool optimized) {
+                     const llvm::Module& llvm_module, bool optimized,
+                     absl::string_view filename_suffix) {
   const auto& debug_opts = hlo_module.config().debug_options();
   if (!DumpingEnabledForHloModule(hlo_module)) {
     return;
@@ -591,7 +592,8 @@ void DumpIrIfEnabled(const HloModule& hlo_module,
   // We can end up compiling different modules with the same name when using
   // XlaJitCompiledCpuFunction::Compile.  Avoid overwriting IR files previously
   // dumped from the same process in such cases.
-  string suffix = absl::StrCat("ir-", optimized ? "with" : "no", "-opt");
+  string suffix =
+      absl::StrCat("ir-", optimized ? "with" : "no", "-opt", filename_suffix);
   DumpToFileInDirOrStdout(hlo_module, absl::StrCat(suffix, ".ll"),
                           DumpModuleToString(llvm_module));
 
@@ -278,9 +278,11 @@ std::map<int, llvm::MDNode*> MergeMetadata(
 //
 // A sanitized version of `hlo_module_name` is incorporated into the file name.
 // If `optimized` is true then a suffix of "-with-opt.ll" is used, else a suffix
-// of "-no-opt.ll" is used.
+// of "-no-opt.ll" is used. `filename_suffix`, if any, is added before ".ll",
+// to tell apart the parts of a module that is compiled in several parts.
 void DumpIrIfEnabled(const HloModule& hlo_module,
-                     const llvm::Module& llvm_module, bool optimized);
+                     const llvm::Module& llvm_module, bool optimized,
+                     absl::string_view filename_suffix = "");
 
 llvm::Function* CreateCpuFunction(llvm::FunctionType* function_type,
                                   llvm::GlobalValue::LinkageTypes linkage,
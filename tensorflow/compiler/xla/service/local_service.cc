@@ -175,9 +175,9 @@ StatusOr<std::unique_ptr<Executable>> LocalService::CompileExecutable(
       se::StreamExecutor * executor,
       execute_backend_->stream_executor(build_options.device_ordinal()));
 
-  return BuildExecutable(proto, std::move(module_config),
-                         execute_backend_.get(), executor,
-                         build_options.device_allocator());
+  return BuildOrLoadExecutable(proto, std::move(module_config),
+                               execute_backend_.get(), executor,
+                               build_options.device_allocator());
 }
 
 StatusOr<int> LocalService::ReplicaNumberToDeviceOrdinal(int replica_number) {
@@ -23,6 +23,7 @@ limitations under the License.
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/types/optional.h"
 #include "tensorflow/compiler/xla/debug_options_flags.h"
 #include "tensorflow/compiler/xla/execution_options_util.h"
 #include "tensorflow/compiler/xla/layout_util.h"
@@ -811,6 +812,61 @@ StatusOr<std::unique_ptr<Executable>> Service::BuildExecutable(
   return std::move(executable);
 }
 
+StatusOr<std::unique_ptr<Executable>> Service::BuildOrLoadExecutable(
+    const HloModuleProto& module_proto,
+    std::unique_ptr<HloModuleConfig> module_config, Backend* backend,
+    se::StreamExecutor* executor, se::DeviceMemoryAllocator* device_allocator) {
+  const string cache_dir =
+      module_config->debug_options().xla_persistent_cache_dir();
+  absl::optional<string> key;
+  if (!cache_dir.empty()) {
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<HloModule> module,
+                        CreateModuleFromProto(module_proto, *module_config));
+    key = CompilationCache::PersistentKey(*module, backend->platform()->Name());
+  }
+
+  if (key.has_value()) {
+    StatusOr<string> serialized =
+        compilation_cache_.LookUpPersistent(cache_dir, *key);
+    if (serialized.ok()) {
+      StatusOr<std::unique_ptr<Executable>> executable =
+          backend->compiler()->DeserializeExecutable(
+              serialized.ValueOrDie(), *module_config, executor);
+      if (executable.ok()) {
+        VLOG(1) << "loaded " << module_proto.name()
+                << " from the persistent compilation cache";
+        return executable;
+      }
+      LOG(WARNING) << "Failed to load " << module_proto.name()
+                   << " from the persistent compilation cache: "
+                   << executable.status();
+    } else if (serialized.status().code() != tensorflow::error::NOT_FOUND) {
+      LOG(WARNING) << "Failed to read " << module_proto.name()
+                   << " from the persistent compilation cache: "
+                   << serialized.status();
+    }
+  }
+
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<Executable> executable,
+      BuildExecutable(module_proto, std::move(module_config), backend,
+                      executor, device_allocator));
+
+  if (key.has_value()) {
+    StatusOr<string> serialized =
+        backend->compiler()->SerializeExecutable(*executable);
+    Status status = serialized.ok()
+                        ? compilation_cache_.InsertPersistent(
+                              cache_dir, *key, serialized.ValueOrDie())
+                        : serialized.status();
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to store " << module_proto.name()
+                   << " in the persistent compilation cache: " << status;
+    }
+  }
+  return std::move(executable);
+}
+
 Status Service::Compile(const CompileRequest* arg, CompileResponse* result) {
   VLOG(1) << "running compile request";
   if (!arg->has_computation()) {
@@ -841,10 +897,9 @@ Status Service::Compile(const CompileRequest* arg, CompileResponse* result) {
 
   TF_ASSIGN_OR_RETURN(
       std::unique_ptr<Executable> executable,
-      BuildExecutable(arg->computation(), std::move(module_config),
-                      execute_backend_.get(),
-                      execute_backend_->default_stream_executor(),
-                      /*device_allocator=*/nullptr));
+      BuildOrLoadExecutable(arg->computation(), std::move(module_config),
+                            execute_backend_.get(),
+                            execute_backend_->default_stream_executor()));
 
   *result->mutable_handle() = compilation_cache_.Insert(std::move(executable));
 
@@ -236,6 +236,16 @@ class Service : public ServiceInterface {
       se::StreamExecutor* executor,
       se::DeviceMemoryAllocator* device_allocator = nullptr);
 
+  // Same as BuildExecutable() above, but if the module config has an
+  // xla_persistent_cache_dir, loads the executable from the persistent tier of
+  // compilation_cache_ instead if it is there, and stores it there otherwise.
+  // Failing to load or store it is not an error.
+  StatusOr<std::unique_ptr<Executable>> BuildOrLoadExecutable(
+      const HloModuleProto& module_proto,
+      std::unique_ptr<HloModuleConfig> module_config, Backend* backend,
+      se::StreamExecutor* executor,
+      se::DeviceMemoryAllocator* device_allocator = nullptr);
+
   // Same as BuildExecutable() above, but builds a list of Executables for the
   // given computations that may interact with each other.
   StatusOr<std::vector<std::unique_ptr<Executable>>> BuildExecutables(
@@ -26,8 +26,9 @@ namespace {
 
 class TrivialCrossReplicaSumTest : public HloTestBase {};
 
-// Currently the CPU and GPU backends only support CrossReplicaSum with one
-// replica.  But we can at least check this.
+// These tests run a single replica, where CrossReplicaSum is the identity.
+// Multiple replicas are tested by replicated_all_reduce_test and
+// multi_device_all_reduce_test.
 
 XLA_TEST_F(TrivialCrossReplicaSumTest, OneOperand) {
   const char* module_str = R"(
@@ -0,0 +1,187 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/debug_options_flags.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/service/computation_placer.h"
+#include "tensorflow/compiler/xla/service/hlo_module_config.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/service/hlo_runner.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/test.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/tests/test_macros.h"
+#include "tensorflow/compiler/xla/tests/test_utils.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+// Tests and benchmarks models made of independent towers, whose towers the
+// CPU backend runs concurrently with the xla_cpu_inter_op_parallelism backend
+// option.
+
+namespace xla {
+namespace {
+
+// Returns a module with 'num_towers' towers of two dense layers of 'width'
+// units, which all read the same [batch, width] input, and whose outputs are
+// concatenated.
+string BranchyModule(int num_towers, int batch, int width) {
+  std::vector<string> parameters;
+  std::vector<string> towers;
+  std::vector<string> outputs;
+  for (int i = 0; i < num_towers; ++i) {
+    parameters.push_back(absl::StrCat("  w", i, " = f32[", width, ",", width,
+                                      "] parameter(", i + 1, ")"));
+    const string shape = absl::StrCat("f32[", batch, ",", width, "]");
+    towers.push_back(absl::StrCat(
+        "  dot", i, ".0 = ", shape, " dot(x, w", i,
+        "), lhs_contracting_dims={1}, rhs_contracting_dims={0}\n",
+        "  tanh", i, ".0 = ", shape, " tanh(dot", i, ".0)\n",
+        "  dot", i, ".1 = ", shape, " dot(tanh", i, ".0, w", i,
+        "), lhs_contracting_dims={1}, rhs_contracting_dims={0}\n",
+        "  tanh", i, ".1 = ", shape, " tanh(dot", i, ".1)"));
+    outputs.push_back(absl::StrCat("tanh", i, ".1"));
+  }
+  return absl::StrCat(
+      "HloModule branchy\n\nENTRY main {\n  x = f32[", batch, ",", width,
+      "] parameter(0)\n", absl::StrJoin(parameters, "\n"), "\n",
+      absl::StrJoin(towers, "\n"), "\n  ROOT concatenate = f32[", batch, ",",
+      num_towers * width, "] concatenate(", absl::StrJoin(outputs, ", "),
+      "), dimensions={1}\n}\n");
+}
+
+class InterOpParallelismTest : public HloTestBase {
+ protected:
+  DebugOptions GetDebugOptionsForTest() override {
+    DebugOptions debug_options = HloTestBase::GetDebugOptionsForTest();
+    (*debug_options.mutable_xla_backend_extra_options())
+        ["xla_cpu_inter_op_parallelism"] = "";
+    return debug_options;
+  }
+};
+
+XLA_TEST_F(InterOpParallelismTest, SmallTowers) {
+  EXPECT_TRUE(RunAndCompare(BranchyModule(4, 8, 32), ErrorSpec{1e-4, 1e-4}));
+}
+
+XLA_TEST_F(InterOpParallelismTest, ManyTowers) {
+  EXPECT_TRUE(RunAndCompare(BranchyModule(16, 4, 16), ErrorSpec{1e-4, 1e-4}));
+}
+
+XLA_TEST_F(InterOpParallelismTest, LargeTowers) {
+  EXPECT_TRUE(
+      RunAndCompare(BranchyModule(2, 64, 256), ErrorSpec{1e-3, 1e-3}));
+}
+
+XLA_TEST_F(InterOpParallelismTest, TowersOfDifferentCost) {
+  const char* const kModule = R"(
+    HloModule uneven
+
+    ENTRY main {
+      p0 = f32[16,16] parameter(0)
+      p1 = f32[64,64] parameter(1)
+      p2 = f32[16,16] parameter(2)
+      exp0 = f32[16,16] exponential(p0)
+      neg0 = f32[16,16] negate(exp0)
+      dot1 = f32[64,64] dot(p1, p1), lhs_contracting_dims={1},
+        rhs_contracting_dims={0}
+      tanh1 = f32[64,64] tanh(dot1)
+      sine2 = f32[16,16] sine(p2)
+      log2 = f32[16,16] log(p0)
+      add2 = f32[16,16] add(sine2, log2)
+      ROOT tuple = (f32[16,16], f32[64,64], f32[16,16]) tuple(neg0, tanh1,
+        add2)
+    }
+  )";
+  EXPECT_TRUE(RunAndCompare(kModule, ErrorSpec{1e-4, 1e-4}));
+}
+
+// Runs a branchy module with 'num_towers' towers of 'width' units per
+// iteration, with or without inter-op parallelism.
+void BM_BranchyModel(int num_iters, int num_towers, int width,
+                     bool inter_op_parallelism) {
+  tensorflow::testing::StopTiming();
+
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().ValueOrDie();
+  HloRunner runner(platform);
+  DebugOptions debug_options = GetDebugOptionsFromFlags();
+  if (inter_op_parallelism) {
+    (*debug_options.mutable_xla_backend_extra_options())
+        ["xla_cpu_inter_op_parallelism"] = "";
+  }
+  HloModuleConfig config;
+  config.set_debug_options(debug_options);
+  auto module =
+      ParseHloString(BranchyModule(num_towers, /*batch=*/16, width), config)
+          .ValueOrDie();
+  std::vector<Literal> arguments =
+      MakeFakeArguments(module.get()).ValueOrDie();
+  DeviceAssignment device_assignment =
+      runner.backend()
+          .computation_placer()
+          ->AssignDevices(/*replica_count=*/1, /*computation_count=*/1)
+          .ValueOrDie();
+  std::unique_ptr<Executable> executable =
+      runner.CreateExecutable(std::move(module), /*run_hlo_passes=*/true)
+          .ValueOrDie();
+
+  HloRunner::ReplicatedExecuteOptions options;
+  options.num_replicas = 1;
+  for (const Literal& argument : arguments) {
+    options.arguments.push_back(&argument);
+  }
+
+  // Warm up.
+  TF_CHECK_OK(runner.ExecuteReplicated(executable.get(), options,
+                                       &device_assignment)
+                  .status());
+
+  tensorflow::testing::UseRealTime();
+  tensorflow::testing::StartTiming();
+  for (int i = 0; i < num_iters; ++i) {
+    TF_CHECK_OK(runner.ExecuteReplicated(executable.get(), options,
+                                         &device_assignment)
+                    .status());
+  }
+}
+
+void BM_BranchyModelSequential(int num_iters, int num_towers, int width) {
+  BM_BranchyModel(num_iters, num_towers, width,
+                  /*inter_op_parallelism=*/false);
+}
+
+void BM_BranchyModelInterOp(int num_iters, int num_towers, int width) {
+  BM_BranchyModel(num_iters, num_towers, width,
+                  /*inter_op_parallelism=*/true);
+}
+
+BENCHMARK(BM_BranchyModelSequential)
+    ->ArgPair(4, 32)
+    ->ArgPair(8, 64)
+    ->ArgPair(16, 32)
+    ->ArgPair(4, 512);
+BENCHMARK(BM_BranchyModelInterOp)
+    ->ArgPair(4, 32)
+    ->ArgPair(8, 64)
+    ->ArgPair(16, 32)
+    ->ArgPair(4, 512);
+
+}  // namespace
+}  // namespace xla
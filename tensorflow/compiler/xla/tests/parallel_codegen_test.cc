@@ -0,0 +1,196 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/debug_options_flags.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/service/hlo_module_config.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/service/hlo_runner.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/test.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/tests/literal_test_util.h"
+#include "tensorflow/compiler/xla/tests/test_macros.h"
+#include "tensorflow/compiler/xla/tests/test_utils.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+// Tests and benchmarks compiling modules whose LLVM IR the CPU backend splits
+// and compiles in parallel with the xla_cpu_parallel_codegen backend option.
+
+namespace xla {
+namespace {
+
+// Returns a module with 'num_layers' large elementwise layers, which the CPU
+// backend runs as parallel tasks, each of which is a function of its own.
+string LayeredModule(int num_layers, int size) {
+  const string shape = absl::StrCat("f32[", size, ",", size, "]");
+  std::vector<string> layers;
+  string previous = "p0";
+  for (int i = 0; i < num_layers; ++i) {
+    layers.push_back(absl::StrCat(
+        "  mul", i, " = ", shape, " multiply(", previous, ", p1)\n",
+        "  tanh", i, " = ", shape, " tanh(mul", i, ")\n",
+        "  exp", i, " = ", shape, " exponential(tanh", i, ")\n",
+        "  layer", i, " = ", shape, " subtract(exp", i, ", ", previous, ")"));
+    previous = absl::StrCat("layer", i);
+  }
+  return absl::StrCat("HloModule layered\n\nENTRY main {\n  p0 = ", shape,
+                      " parameter(0)\n  p1 = ", shape, " parameter(1)\n",
+                      absl::StrJoin(layers, "\n"), "\n  ROOT root = ", shape,
+                      " negate(", previous, ")\n}\n");
+}
+
+class ParallelCodegenTest : public HloTestBase {
+ protected:
+  // Runs 'hlo_text' compiled with and without parallel code generation, and
+  // expects the results to be the same, bit for bit.
+  void RunAndCompareWithSequentialCodegen(const string& hlo_text) {
+    HloModuleConfig config = GetModuleConfigForTest();
+    std::unique_ptr<HloModule> sequential_module =
+        ParseAndReturnVerifiedModule(hlo_text, config).ValueOrDie();
+    DebugOptions debug_options = config.debug_options();
+    (*debug_options.mutable_xla_backend_extra_options())
+        ["xla_cpu_parallel_codegen"] = "4";
+    config.set_debug_options(debug_options);
+    std::unique_ptr<HloModule> parallel_module =
+        ParseAndReturnVerifiedModule(hlo_text, config).ValueOrDie();
+
+    std::vector<Literal> arguments =
+        MakeFakeArguments(sequential_module.get()).ValueOrDie();
+    std::vector<Literal*> argument_ptrs;
+    for (Literal& argument : arguments) {
+      argument_ptrs.push_back(&argument);
+    }
+    Literal expected =
+        ExecuteAndTransfer(std::move(sequential_module), argument_ptrs);
+    Literal actual =
+        ExecuteAndTransfer(std::move(parallel_module), argument_ptrs);
+    EXPECT_TRUE(LiteralTestUtil::Equal(expected, actual));
+  }
+};
+
+XLA_TEST_F(ParallelCodegenTest, ParallelTasks) {
+  RunAndCompareWithSequentialCodegen(LayeredModule(8, 256));
+}
+
+XLA_TEST_F(ParallelCodegenTest, SmallModule) {
+  RunAndCompareWithSequentialCodegen(LayeredModule(1, 4));
+}
+
+XLA_TEST_F(ParallelCodegenTest, ReductionsAndConstants) {
+  const char* const kModule = R"(
+    HloModule reductions
+
+    add {
+      lhs = f32[] parameter(0)
+      rhs = f32[] parameter(1)
+      ROOT add = f32[] add(lhs, rhs)
+    }
+
+    max {
+      lhs = f32[] parameter(0)
+      rhs = f32[] parameter(1)
+      ROOT max = f32[] maximum(lhs, rhs)
+    }
+
+    ENTRY main {
+      p0 = f32[512,512] parameter(0)
+      constant = f32[4] constant({1, 2, 3, 4})
+      broadcast = f32[512,512,4] broadcast(constant), dimensions={2}
+      p0.broadcast = f32[512,512,4] broadcast(p0), dimensions={0,1}
+      mul = f32[512,512,4] multiply(broadcast, p0.broadcast)
+      tanh = f32[512,512,4] tanh(mul)
+      zero = f32[] constant(0)
+      sum = f32[512] reduce(tanh, zero), dimensions={1,2}, to_apply=add
+      lowest = f32[] constant(-inf)
+      max = f32[4] reduce(tanh, lowest), dimensions={0,1}, to_apply=max
+      ROOT tuple = (f32[512], f32[4]) tuple(sum, max)
+    }
+  )";
+  RunAndCompareWithSequentialCodegen(kModule);
+}
+
+XLA_TEST_F(ParallelCodegenTest, WhileLoop) {
+  const char* const kModule = R"(
+    HloModule while_loop
+
+    condition {
+      state = (s32[], f32[256,256]) parameter(0)
+      i = s32[] get-tuple-element(state), index=0
+      limit = s32[] constant(5)
+      ROOT less-than = pred[] compare(i, limit), direction=LT
+    }
+
+    body {
+      state = (s32[], f32[256,256]) parameter(0)
+      i = s32[] get-tuple-element(state), index=0
+      one = s32[] constant(1)
+      next_i = s32[] add(i, one)
+      x = f32[256,256] get-tuple-element(state), index=1
+      sine = f32[256,256] sine(x)
+      exp = f32[256,256] exponential(sine)
+      ROOT tuple = (s32[], f32[256,256]) tuple(next_i, exp)
+    }
+
+    ENTRY main {
+      p0 = f32[256,256] parameter(0)
+      zero = s32[] constant(0)
+      init = (s32[], f32[256,256]) tuple(zero, p0)
+      while = (s32[], f32[256,256]) while(init), condition=condition,
+        body=body
+      ROOT result = f32[256,256] get-tuple-element(while), index=1
+    }
+  )";
+  RunAndCompareWithSequentialCodegen(kModule);
+}
+
+// Compiles a layered module with 'num_layers' layers per iteration, with
+// code generation split over 'num_threads' threads.
+void BM_CompileLayeredModule(int num_iters, int num_layers, int num_threads) {
+  tensorflow::testing::StopTiming();
+
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().ValueOrDie();
+  HloRunner runner(platform);
+  DebugOptions debug_options = GetDebugOptionsFromFlags();
+  (*debug_options.mutable_xla_backend_extra_options())
+      ["xla_cpu_parallel_codegen"] = absl::StrCat(num_threads);
+  HloModuleConfig config;
+  config.set_debug_options(debug_options);
+  const string hlo_text = LayeredModule(num_layers, /*size=*/256);
+
+  tensorflow::testing::UseRealTime();
+  for (int i = 0; i < num_iters; ++i) {
+    auto module = ParseHloString(hlo_text, config).ValueOrDie();
+    tensorflow::testing::StartTiming();
+    TF_CHECK_OK(
+        runner.CreateExecutable(std::move(module), /*run_hlo_passes=*/true)
+            .status());
+    tensorflow::testing::StopTiming();
+  }
+}
+
+BENCHMARK(BM_CompileLayeredModule)
+    ->ArgPair(16, 1)
+    ->ArgPair(16, 8)
+    ->ArgPair(64, 1)
+    ->ArgPair(64, 8);
+
+}  // namespace
+}  // namespace xla
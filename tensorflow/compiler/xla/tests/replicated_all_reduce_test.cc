@@ -0,0 +1,297 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/service/ar_crs_combiner.h"
+#include "tensorflow/compiler/xla/service/computation_placer.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/service/hlo_runner.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/test.h"
+#include "tensorflow/compiler/xla/test_helpers.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/tests/test_macros.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+// Tests all-reduce across several replicas of the same module running on one
+// host. On CPU, every replica runs on its own host device and the replicas
+// reduce through shared memory. Multi-GPU all-reduce is covered by
+// multi_device_all_reduce_test.
+
+namespace xla {
+namespace {
+
+// Returns a module that all-reduces its f32[num_elems] parameter with `op`
+// `iterations` times in a while loop.
+string AllReduceLoopModule(int64 num_elems, int64 iterations,
+                           const string& op) {
+  const char* kTemplate = R"(
+    HloModule all_reduce_loop
+
+    reduce {
+      x = f32[] parameter(0)
+      y = f32[] parameter(1)
+      ROOT r = f32[] OP(x, y)
+    }
+
+    cond {
+      p = (s32[], f32[NUM_ELEMS]) parameter(0)
+      i = s32[] get-tuple-element(p), index=0
+      limit = s32[] constant(ITERATIONS)
+      ROOT lt = pred[] compare(i, limit), direction=LT
+    }
+
+    body {
+      p = (s32[], f32[NUM_ELEMS]) parameter(0)
+      i = s32[] get-tuple-element(p), index=0
+      x = f32[NUM_ELEMS] get-tuple-element(p), index=1
+      one = s32[] constant(1)
+      next = s32[] add(i, one)
+      crs = f32[NUM_ELEMS] all-reduce(x), to_apply=reduce
+      ROOT t = (s32[], f32[NUM_ELEMS]) tuple(next, crs)
+    }
+
+    ENTRY test_computation {
+      x = f32[NUM_ELEMS] parameter(0)
+      zero = s32[] constant(0)
+      init = (s32[], f32[NUM_ELEMS]) tuple(zero, x)
+      w = (s32[], f32[NUM_ELEMS]) while(init), condition=cond, body=body
+      ROOT result = f32[NUM_ELEMS] get-tuple-element(w), index=1
+    }
+  )";
+  return absl::StrReplaceAll(kTemplate,
+                             {{"NUM_ELEMS", absl::StrCat(num_elems)},
+                              {"ITERATIONS", absl::StrCat(iterations)},
+                              {"OP", op}});
+}
+
+class ReplicatedAllReduceTest : public HloTestBase {
+ protected:
+  HloModuleConfig ConfigWithReplicas(int64 replica_count) {
+    HloModuleConfig config = GetModuleConfigForTest();
+    config.set_replica_count(replica_count);
+    return config;
+  }
+};
+
+XLA_TEST_F(ReplicatedAllReduceTest, TwoReplicasOneOperand) {
+  const char* module_str = R"(
+  HloModule test
+
+  add {
+    x = f32[] parameter(0)
+    y = f32[] parameter(1)
+    ROOT add = f32[] add(x, y)
+  }
+
+  ENTRY test_computation {
+    p = f32[3] parameter(0)
+    ROOT crs = f32[3] all-reduce(p), to_apply=add
+  })";
+  auto module =
+      ParseHloString(module_str, ConfigWithReplicas(2)).ValueOrDie();
+  auto literal = LiteralUtil::CreateR1<float>({1, 2, 3});
+  TF_ASSERT_OK_AND_ASSIGN(std::vector<Literal> results,
+                          ExecuteReplicated(std::move(module), {&literal},
+                                            /*num_replicas=*/2,
+                                            /*use_threads=*/true));
+  auto expected = LiteralUtil::CreateR1<float>({2, 4, 6});
+  EXPECT_EQ(expected, results[0]);
+  EXPECT_EQ(expected, results[1]);
+}
+
+XLA_TEST_F(ReplicatedAllReduceTest, FourReplicasMultipleOperands) {
+  const char* module_str = R"(
+  HloModule test
+
+  add {
+    x = s32[] parameter(0)
+    y = s32[] parameter(1)
+    ROOT add = s32[] add(x, y)
+  }
+
+  ENTRY test_computation {
+    p0 = s32[1000] parameter(0)
+    p1 = s32[2] parameter(1)
+    ROOT crs = (s32[1000], s32[2]) all-reduce(p0, p1), to_apply=add
+  })";
+  auto module =
+      ParseHloString(module_str, ConfigWithReplicas(4)).ValueOrDie();
+  std::vector<int32> input0(1000);
+  absl::c_iota(input0, -500);
+  auto literal0 = LiteralUtil::CreateR1<int32>(input0);
+  auto literal1 = LiteralUtil::CreateR1<int32>({7, -7});
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<Literal> results,
+      ExecuteReplicated(std::move(module), {&literal0, &literal1},
+                        /*num_replicas=*/4, /*use_threads=*/true));
+  std::vector<int32> expected0(1000);
+  absl::c_transform(input0, expected0.begin(), [](int32 x) { return 4 * x; });
+  auto expected_literal0 = LiteralUtil::CreateR1<int32>(expected0);
+  auto expected_literal1 = LiteralUtil::CreateR1<int32>({28, -28});
+  auto expected =
+      LiteralUtil::MakeTuple({&expected_literal0, &expected_literal1});
+  for (const Literal& result : results) {
+    EXPECT_EQ(expected, result);
+  }
+}
+
+// Runs the same all-reduce many times, which reuses its rendezvous.
+XLA_TEST_F(ReplicatedAllReduceTest, AllReduceInWhileLoop) {
+  auto module = ParseHloString(AllReduceLoopModule(/*num_elems=*/100,
+                                                   /*iterations=*/10, "add"),
+                               ConfigWithReplicas(2))
+                    .ValueOrDie();
+  std::vector<float> input(100, 1.0f);
+  auto literal = LiteralUtil::CreateR1<float>(input);
+  TF_ASSERT_OK_AND_ASSIGN(std::vector<Literal> results,
+                          ExecuteReplicated(std::move(module), {&literal},
+                                            /*num_replicas=*/2,
+                                            /*use_threads=*/true));
+  auto expected =
+      LiteralUtil::CreateR1<float>(std::vector<float>(100, 1 << 10));
+  EXPECT_EQ(expected, results[0]);
+  EXPECT_EQ(expected, results[1]);
+}
+
+XLA_TEST_F(ReplicatedAllReduceTest, NonDefaultDeviceAssignment) {
+  DeviceAssignment device_assignment(/*replica_count=*/2,
+                                     /*computation_count=*/1);
+  device_assignment(0, 0) = 1;
+  device_assignment(1, 0) = 0;
+  auto module = ParseHloString(AllReduceLoopModule(/*num_elems=*/3,
+                                                   /*iterations=*/1, "add"),
+                               ConfigWithReplicas(2))
+                    .ValueOrDie();
+  auto literal = LiteralUtil::CreateR1<float>({1, 2, 3});
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::vector<Literal> results,
+      ExecuteReplicated(std::move(module), {&literal}, /*num_replicas=*/2,
+                        &device_assignment, /*run_hlo_passes=*/true,
+                        /*use_threads=*/true));
+  auto expected = LiteralUtil::CreateR1<float>({2, 4, 6});
+  EXPECT_EQ(expected, results[0]);
+  EXPECT_EQ(expected, results[1]);
+}
+
+// The cross-module all-reduce has one replica per group, so it is the
+// identity, and the cross-replica all-reduce sums over the replicas. The
+// all-core all-reduce that ArCrsCombiner forms from the pair must compute the
+// same result.
+XLA_TEST_F(ReplicatedAllReduceTest, ArCrsCombinedAllReduce) {
+  const char* module_str = R"(
+  HloModule test
+
+  add {
+    x = f32[] parameter(0)
+    y = f32[] parameter(1)
+    ROOT add = f32[] add(x, y)
+  }
+
+  ENTRY test_computation {
+    p = f32[4] parameter(0)
+    ar = f32[4] all-reduce(p), replica_groups={{0},{1}}, all_reduce_id=1,
+      to_apply=add
+    two = f32[] constant(2)
+    twos = f32[4] broadcast(two), dimensions={}
+    mul = f32[4] multiply(ar, twos)
+    ROOT crs = f32[4] all-reduce(mul), replica_groups={{0,1}}, to_apply=add
+  })";
+  auto literal = LiteralUtil::CreateR1<float>({1, 2, 3, 4});
+  auto expected = LiteralUtil::CreateR1<float>({4, 8, 12, 16});
+  for (bool combine : {false, true}) {
+    SCOPED_TRACE(absl::StrCat("combine=", combine));
+    auto module =
+        ParseHloString(module_str, ConfigWithReplicas(2)).ValueOrDie();
+    if (combine) {
+      ArCrsCombiner combiner(/*num_spatial_partitions=*/1);
+      TF_ASSERT_OK_AND_ASSIGN(bool changed, combiner.Run(module.get()));
+      EXPECT_TRUE(changed);
+    }
+    TF_ASSERT_OK_AND_ASSIGN(std::vector<Literal> results,
+                            ExecuteReplicated(std::move(module), {&literal},
+                                              /*num_replicas=*/2,
+                                              /*use_threads=*/true));
+    EXPECT_EQ(expected, results[0]);
+    EXPECT_EQ(expected, results[1]);
+  }
+}
+
+// Runs 100 all-reduces of `num_elems` floats across `num_replicas` replicas
+// per iteration. The loop amortizes the argument and result transfers of
+// HloRunner::ExecuteReplicated.
+void BM_AllReduce(int num_iters, int num_replicas, int num_elems) {
+  tensorflow::testing::StopTiming();
+  const int64 kAllReducesPerRun = 100;
+
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().ValueOrDie();
+  HloRunner runner(platform);
+  HloModuleConfig config;
+  config.set_replica_count(num_replicas);
+  auto module = ParseHloString(AllReduceLoopModule(num_elems,
+                                                   kAllReducesPerRun, "add"),
+                               config)
+                    .ValueOrDie();
+  DeviceAssignment device_assignment =
+      runner.backend()
+          .computation_placer()
+          ->AssignDevices(num_replicas, /*computation_count=*/1)
+          .ValueOrDie();
+  std::unique_ptr<Executable> executable =
+      runner.CreateExecutable(std::move(module), /*run_hlo_passes=*/true)
+          .ValueOrDie();
+
+  // Values that stay finite under repeated summation.
+  auto literal =
+      LiteralUtil::CreateR1<float>(std::vector<float>(num_elems, 0.0f));
+  HloRunner::ReplicatedExecuteOptions options;
+  options.num_replicas = num_replicas;
+  options.arguments.push_back(&literal);
+  options.use_threads = true;
+
+  // Warm up.
+  TF_CHECK_OK(runner.ExecuteReplicated(executable.get(), options,
+                                       &device_assignment)
+                  .status());
+
+  tensorflow::testing::BytesProcessed(static_cast<int64>(num_iters) *
+                                      kAllReducesPerRun * num_replicas *
+                                      num_elems * sizeof(float));
+  tensorflow::testing::UseRealTime();
+  tensorflow::testing::StartTiming();
+  for (int i = 0; i < num_iters; ++i) {
+    TF_CHECK_OK(runner.ExecuteReplicated(executable.get(), options,
+                                         &device_assignment)
+                    .status());
+  }
+}
+BENCHMARK(BM_AllReduce)
+    ->ArgPair(2, 1 << 10)
+    ->ArgPair(2, 1 << 20)
+    ->ArgPair(4, 1 << 10)
+    ->ArgPair(4, 1 << 20)
+    ->ArgPair(8, 1 << 20);
+
+}  // namespace
+}  // namespace xla
@@ -0,0 +1,235 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/service/computation_placer.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/service/hlo_runner.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/test.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/tests/test_macros.h"
+#include "tensorflow/compiler/xla/tests/test_utils.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+// Tests sorts of many short rows and of a few long rows, with and without
+// values, which take different paths through the CPU sort runtime: rows are
+// sorted concurrently, a long row is sorted by a parallel merge sort, and
+// integer keys without values are radix sorted.
+
+namespace xla {
+namespace {
+
+// Returns a module that sorts its [rows, row_length] parameter(s) along
+// dimension 1. `keys_type` is the element type of the keys. If `with_values`
+// is true, the sort also permutes an s32 values array.
+string SortModule(int64 rows, int64 row_length, const string& keys_type,
+                  const string& direction, bool with_values) {
+  const char* kKeysTemplate = R"(
+    HloModule sort
+
+    compare {
+      p.0.lhs = KEYS[] parameter(0)
+      p.0.rhs = KEYS[] parameter(1)
+      ROOT cmp = pred[] compare(p.0.lhs, p.0.rhs), direction=DIRECTION
+    }
+
+    ENTRY main {
+      keys = KEYS[ROWS,ROW_LENGTH] parameter(0)
+      ROOT sort = KEYS[ROWS,ROW_LENGTH] sort(keys), dimensions={1},
+        to_apply=compare
+    }
+  )";
+  const char* kKeyValueTemplate = R"(
+    HloModule sort
+
+    compare {
+      p.0.lhs = KEYS[] parameter(0)
+      p.0.rhs = KEYS[] parameter(1)
+      p.1.lhs = s32[] parameter(2)
+      p.1.rhs = s32[] parameter(3)
+      ROOT cmp = pred[] compare(p.0.lhs, p.0.rhs), direction=DIRECTION
+    }
+
+    ENTRY main {
+      keys = KEYS[ROWS,ROW_LENGTH] parameter(0)
+      values = s32[ROWS,ROW_LENGTH] parameter(1)
+      ROOT sort = (KEYS[ROWS,ROW_LENGTH], s32[ROWS,ROW_LENGTH])
+        sort(keys, values), dimensions={1}, to_apply=compare, is_stable=true
+    }
+  )";
+  return absl::StrReplaceAll(
+      with_values ? kKeyValueTemplate : kKeysTemplate,
+      {{"KEYS", keys_type},
+       {"DIRECTION", direction},
+       {"ROWS", absl::StrCat(rows)},
+       {"ROW_LENGTH", absl::StrCat(row_length)}});
+}
+
+class SortTest : public HloTestBase {};
+
+XLA_TEST_F(SortTest, IntegerKeysManyRows) {
+  EXPECT_TRUE(RunAndCompare(SortModule(512, 100, "s32", "LT", false),
+                            absl::nullopt));
+}
+
+XLA_TEST_F(SortTest, IntegerKeysDescendingLongRow) {
+  EXPECT_TRUE(RunAndCompare(SortModule(1, 100000, "s64", "GT", false),
+                            absl::nullopt));
+}
+
+XLA_TEST_F(SortTest, UnsignedByteKeysLongRows) {
+  EXPECT_TRUE(RunAndCompare(SortModule(2, 70000, "u8", "LT", false),
+                            absl::nullopt));
+}
+
+XLA_TEST_F(SortTest, SwappedComparatorOperands) {
+  const char* kModule = R"(
+    HloModule sort
+
+    compare {
+      p.0.lhs = s16[] parameter(0)
+      p.0.rhs = s16[] parameter(1)
+      ROOT cmp = pred[] compare(p.0.rhs, p.0.lhs), direction=LT
+    }
+
+    ENTRY main {
+      keys = s16[3,5,700] parameter(0)
+      ROOT sort = s16[3,5,700] sort(keys), dimensions={1}, to_apply=compare
+    }
+  )";
+  EXPECT_TRUE(RunAndCompare(kModule, absl::nullopt));
+}
+
+XLA_TEST_F(SortTest, KeyValueManyRows) {
+  EXPECT_TRUE(RunAndCompare(SortModule(1024, 64, "f32", "LT", true),
+                            absl::nullopt));
+}
+
+XLA_TEST_F(SortTest, KeyValueLongRow) {
+  EXPECT_TRUE(RunAndCompare(SortModule(1, 100000, "f32", "GT", true),
+                            absl::nullopt));
+}
+
+XLA_TEST_F(SortTest, StableKeyValueWithDuplicateKeys) {
+  const char* kModule = R"(
+    HloModule sort
+
+    compare {
+      p.0.lhs = s32[] parameter(0)
+      p.0.rhs = s32[] parameter(1)
+      p.1.lhs = s32[] parameter(2)
+      p.1.rhs = s32[] parameter(3)
+      ROOT cmp = pred[] compare(p.0.lhs, p.0.rhs), direction=LT
+    }
+
+    ENTRY main {
+      keys = s32[100000] parameter(0)
+      values = s32[100000] iota(), iota_dimension=0
+      ROOT sort = (s32[100000], s32[100000]) sort(keys, values),
+        dimensions={0}, to_apply=compare, is_stable=true
+    }
+  )";
+  const int64 kLength = 100000;
+  std::vector<int32> keys(kLength);
+  for (int64 i = 0; i < kLength; ++i) {
+    keys[i] = (i * 7919) % 10;
+  }
+  auto module = ParseAndReturnVerifiedModule(kModule).ValueOrDie();
+  Literal keys_literal = LiteralUtil::CreateR1<int32>(keys);
+  Literal result = ExecuteAndTransfer(std::move(module), {&keys_literal});
+  std::vector<Literal> elements = result.DecomposeTuple();
+  for (int64 i = 1; i < kLength; ++i) {
+    const int32 prev_key = elements[0].Get<int32>({i - 1});
+    const int32 key = elements[0].Get<int32>({i});
+    ASSERT_LE(prev_key, key) << "at " << i;
+    if (prev_key == key) {
+      ASSERT_LT(elements[1].Get<int32>({i - 1}), elements[1].Get<int32>({i}))
+          << "at " << i;
+    }
+  }
+}
+
+// Sorts a [rows, row_length] array per iteration, with a stable key-value
+// sort of f32 keys and s32 values, or a key-only sort of s32 keys.
+void BM_Sort(int num_iters, int rows, int row_length, bool with_values) {
+  tensorflow::testing::StopTiming();
+
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().ValueOrDie();
+  HloRunner runner(platform);
+  auto module = ParseHloString(SortModule(rows, row_length,
+                                          with_values ? "f32" : "s32", "LT",
+                                          with_values))
+                    .ValueOrDie();
+  std::vector<Literal> arguments =
+      MakeFakeArguments(module.get()).ValueOrDie();
+  DeviceAssignment device_assignment =
+      runner.backend()
+          .computation_placer()
+          ->AssignDevices(/*replica_count=*/1, /*computation_count=*/1)
+          .ValueOrDie();
+  std::unique_ptr<Executable> executable =
+      runner.CreateExecutable(std::move(module), /*run_hlo_passes=*/true)
+          .ValueOrDie();
+
+  HloRunner::ReplicatedExecuteOptions options;
+  options.num_replicas = 1;
+  for (const Literal& argument : arguments) {
+    options.arguments.push_back(&argument);
+  }
+
+  // Warm up.
+  TF_CHECK_OK(runner.ExecuteReplicated(executable.get(), options,
+                                       &device_assignment)
+                  .status());
+
+  tensorflow::testing::ItemsProcessed(static_cast<int64>(num_iters) * rows *
+                                      row_length);
+  tensorflow::testing::UseRealTime();
+  tensorflow::testing::StartTiming();
+  for (int i = 0; i < num_iters; ++i) {
+    TF_CHECK_OK(runner.ExecuteReplicated(executable.get(), options,
+                                         &device_assignment)
+                    .status());
+  }
+}
+
+void BM_KeyValueSort(int num_iters, int rows, int row_length) {
+  BM_Sort(num_iters, rows, row_length, /*with_values=*/true);
+}
+
+void BM_IntegerKeySort(int num_iters, int rows, int row_length) {
+  BM_Sort(num_iters, rows, row_length, /*with_values=*/false);
+}
+
+BENCHMARK(BM_KeyValueSort)
+    ->ArgPair(1 << 12, 1 << 8)
+    ->ArgPair(1 << 6, 1 << 14)
+    ->ArgPair(1, 1 << 20);
+BENCHMARK(BM_IntegerKeySort)
+    ->ArgPair(1 << 12, 1 << 8)
+    ->ArgPair(1 << 6, 1 << 14)
+    ->ArgPair(1, 1 << 20);
+
+}  // namespace
+}  // namespace xla
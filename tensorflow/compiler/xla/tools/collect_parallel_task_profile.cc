@@ -0,0 +1,266 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Usage: collect_parallel_task_profile --output_dir=DIR [--num_runs=N]
+//            [--report_speedup] hlo_text_file*
+//
+// Runs each HLO module on the CPU backend with HLO profiling enabled and
+// without parallel task assignment, and writes the profile counters averaged
+// over the runs as a binary HloExecutionProfileData proto to
+// DIR/<module name>.profile.pb. Compiling the module with
+//
+//   --xla_backend_extra_options=xla_cpu_parallel_task_profile=<that file>
+//
+// makes the CPU ParallelTaskAssigner choose parallel task counts from the
+// measured cycles of each instruction instead of from HloCostAnalysis.
+//
+// With --report_speedup, the module is also compiled once with the static
+// cost model and once with the profile, and both are timed on the same fake
+// arguments. The output format is:
+//
+// file_path: module_name :: static <us> us, profile-guided <us> us, <x>x
+
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/debug_options_flags.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/service/executable.h"
+#include "tensorflow/compiler/xla/service/hlo_execution_profile.h"
+#include "tensorflow/compiler/xla/service/hlo_module_config.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/service/hlo_runner.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/service/service_executable_run_options.h"
+#include "tensorflow/compiler/xla/status_macros.h"
+#include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/compiler/xla/tests/test_utils.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+namespace xla {
+namespace tools {
+namespace {
+
+// Command-line opts to this tool. See main() for descriptions of these
+// fields.
+struct Options {
+  string output_dir;
+  int num_runs = 10;
+  bool report_speedup = false;
+};
+
+// Parses the HLO text in 'path' into a module for 'debug_options'. A
+// positive 'intra_op_parallelism_threads' bounds the parallel task counts.
+StatusOr<std::unique_ptr<HloModule>> LoadModule(
+    const string& path, const DebugOptions& debug_options,
+    int intra_op_parallelism_threads) {
+  string hlo_text;
+  TF_RETURN_IF_ERROR(tensorflow::ReadFileToString(tensorflow::Env::Default(),
+                                                  path, &hlo_text));
+  HloModuleConfig config;
+  config.set_debug_options(debug_options);
+  config.set_intra_op_parallelism_threads(intra_op_parallelism_threads);
+  return ParseHloString(hlo_text, config);
+}
+
+// Runs 'executable' on 'arguments' once to warm up and then 'num_runs' times,
+// and returns the mean wall time of a run in microseconds. If 'profile' is not
+// null, it receives the mean HLO profile counters of the timed runs.
+StatusOr<double> TimeExecutable(HloRunner* runner, Executable* executable,
+                                absl::Span<const Literal> arguments,
+                                int num_runs, HloExecutionProfile* profile) {
+  Backend& backend = runner->backend();
+  std::vector<ScopedShapedBuffer> argument_buffers;
+  std::vector<const ShapedBuffer*> argument_pointers;
+  argument_buffers.reserve(arguments.size());
+  for (const Literal& argument : arguments) {
+    TF_ASSIGN_OR_RETURN(ScopedShapedBuffer buffer,
+                        runner->TransferLiteralToDevice(argument));
+    argument_buffers.push_back(std::move(buffer));
+    argument_pointers.push_back(&argument_buffers.back());
+  }
+
+  se::Stream stream(backend.default_stream_executor());
+  stream.Init();
+  ExecutableRunOptions run_options;
+  run_options.set_device_ordinal(backend.default_device_ordinal());
+  run_options.set_stream(&stream);
+  run_options.set_allocator(backend.memory_allocator());
+  run_options.set_intra_op_thread_pool(
+      backend.eigen_intra_op_thread_pool_device());
+  ServiceExecutableRunOptions service_run_options(run_options,
+                                                  backend.StreamBorrower());
+
+  uint64 total_micros = 0;
+  for (int run = 0; run <= num_runs; ++run) {
+    std::unique_ptr<HloExecutionProfile> run_profile;
+    if (profile != nullptr) {
+      run_profile = absl::make_unique<HloExecutionProfile>(
+          &executable->hlo_profile_printer_data(),
+          &executable->hlo_profile_index_map());
+    }
+    const uint64 start_micros = tensorflow::Env::Default()->NowMicros();
+    TF_RETURN_IF_ERROR(executable
+                           ->ExecuteOnStream(&service_run_options,
+                                             argument_pointers,
+                                             run_profile.get())
+                           .status());
+    TF_RETURN_IF_ERROR(stream.BlockHostUntilDone());
+    if (run == 0) {
+      continue;  // Warm-up run.
+    }
+    total_micros += tensorflow::Env::Default()->NowMicros() - start_micros;
+    if (profile != nullptr) {
+      std::vector<int64>& counters = *profile->mutable_profile_counters();
+      for (int64 i = 0; i < counters.size(); ++i) {
+        counters[i] += run_profile->profile_counters()[i];
+      }
+    }
+  }
+  if (profile != nullptr) {
+    for (int64& counter : *profile->mutable_profile_counters()) {
+      counter /= num_runs;
+    }
+  }
+  return static_cast<double>(total_micros) / num_runs;
+}
+
+// Profiles the module in 'path', writes the profile to opts.output_dir and
+// returns its path.
+StatusOr<string> CollectProfile(const string& path, HloRunner* runner,
+                                const Options& opts) {
+  DebugOptions debug_options = GetDebugOptionsFromFlags();
+  debug_options.set_xla_hlo_profile(true);
+  // A single thread keeps ParallelTaskAssigner from outlining instructions,
+  // so that the counters measure their sequential cost.
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<HloModule> module,
+                      LoadModule(path, debug_options,
+                                 /*intra_op_parallelism_threads=*/1));
+  TF_ASSIGN_OR_RETURN(std::vector<Literal> arguments,
+                      MakeFakeArguments(module.get()));
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<Executable> executable,
+      runner->CreateExecutable(std::move(module), /*run_hlo_passes=*/true));
+  TF_RET_CHECK(executable->hlo_profiling_enabled());
+
+  HloExecutionProfile profile(&executable->hlo_profile_printer_data(),
+                              &executable->hlo_profile_index_map());
+  TF_RETURN_IF_ERROR(TimeExecutable(runner, executable.get(), arguments,
+                                    opts.num_runs, &profile)
+                         .status());
+  const string profile_path = tensorflow::io::JoinPath(
+      opts.output_dir, executable->module().name() + ".profile.pb");
+  TF_RETURN_IF_ERROR(tensorflow::WriteBinaryProto(
+      tensorflow::Env::Default(), profile_path, profile.ToProto()));
+  return profile_path;
+}
+
+// Times the module in 'path' compiled with the static cost model and with
+// the profile in 'profile_path', and prints both times.
+Status ReportSpeedup(const string& path, const string& profile_path,
+                     HloRunner* runner, const Options& opts) {
+  const DebugOptions static_debug_options = GetDebugOptionsFromFlags();
+  DebugOptions profile_debug_options = static_debug_options;
+  (*profile_debug_options.mutable_xla_backend_extra_options())
+      ["xla_cpu_parallel_task_profile"] = profile_path;
+
+  std::vector<Literal> arguments;
+  string module_name;
+  double micros[2];
+  const DebugOptions* debug_options[2] = {&static_debug_options,
+                                          &profile_debug_options};
+  for (int i = 0; i < 2; ++i) {
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<HloModule> module,
+                        LoadModule(path, *debug_options[i],
+                                   /*intra_op_parallelism_threads=*/-1));
+    if (arguments.empty()) {
+      TF_ASSIGN_OR_RETURN(arguments, MakeFakeArguments(module.get()));
+    }
+    module_name = module->name();
+    TF_ASSIGN_OR_RETURN(
+        std::unique_ptr<Executable> executable,
+        runner->CreateExecutable(std::move(module), /*run_hlo_passes=*/true));
+    TF_ASSIGN_OR_RETURN(micros[i],
+                        TimeExecutable(runner, executable.get(), arguments,
+                                       opts.num_runs, /*profile=*/nullptr));
+  }
+  fprintf(stdout, "%s: %s :: static %.1f us, profile-guided %.1f us, %.2fx\n",
+          path.c_str(), module_name.c_str(), micros[0], micros[1],
+          micros[0] / micros[1]);
+  return Status::OK();
+}
+
+int RealMain(absl::Span<char* const> args, const Options& opts) {
+  se::Platform* platform = PlatformUtil::GetPlatform("cpu").ValueOrDie();
+  HloRunner runner(platform);
+  int exit_status = EXIT_SUCCESS;
+  for (const char* arg : args) {
+    StatusOr<string> profile_path = CollectProfile(arg, &runner, opts);
+    if (!profile_path.ok()) {
+      fprintf(stderr, "%s: error: %s\n", arg,
+              profile_path.status().ToString().c_str());
+      exit_status = EXIT_FAILURE;
+      continue;
+    }
+    LOG(INFO) << arg << ": wrote " << profile_path.ValueOrDie();
+    if (opts.report_speedup) {
+      Status status =
+          ReportSpeedup(arg, profile_path.ValueOrDie(), &runner, opts);
+      if (!status.ok()) {
+        fprintf(stderr, "%s: error: %s\n", arg, status.ToString().c_str());
+        exit_status = EXIT_FAILURE;
+      }
+    }
+  }
+  return exit_status;
+}
+
+}  // namespace
+}  // namespace tools
+}  // namespace xla
+
+int main(int argc, char** argv) {
+  xla::tools::Options opts;
+  std::vector<tensorflow::Flag> flag_list = {
+      tensorflow::Flag("output_dir", &opts.output_dir,
+                       "Directory to write the profiles to"),
+      tensorflow::Flag("num_runs", &opts.num_runs,
+                       "Number of timed runs of each module"),
+      tensorflow::Flag("report_speedup", &opts.report_speedup,
+                       "Time each module with the static cost model and with "
+                       "the collected profile, and print the speedup"),
+  };
+  xla::AppendDebugOptionsFlags(&flag_list);
+  xla::string usage = tensorflow::Flags::Usage(argv[0], flag_list);
+  bool parse_ok = tensorflow::Flags::Parse(&argc, argv, flag_list);
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  if (argc < 2 || !parse_ok || opts.output_dir.empty() || opts.num_runs < 1) {
+    LOG(QFATAL) << usage;
+  }
+
+  absl::Span<char* const> args(argv, argc);
+  args.remove_prefix(1);  // Pop off the binary name, argv[0]
+  return xla::tools::RealMain(args, opts);
+}
@@ -282,6 +282,11 @@ Status Unavailable(const absl::FormatSpec<Args...>& format,
       tensorflow::errors::Unavailable(absl::StrFormat(format, args...)));
 }
 template <typename... Args>
+Status DataLoss(const absl::FormatSpec<Args...>& format, const Args&... args) {
+  return WithLogBacktrace(
+      tensorflow::errors::DataLoss(absl::StrFormat(format, args...)));
+}
+template <typename... Args>
 Status Unknown(const absl::FormatSpec<Args...>& format, const Args&... args) {
   return WithLogBacktrace(
       tensorflow::errors::Unknown(absl::StrFormat(format, args...)));
@@ -64,6 +64,11 @@ string GetCollectiveName(const CollectiveParams* cp, bool nccl) {
     case REDUCTION_COLLECTIVE: {
       if (nccl) {
         return "NcclReduce";
+      } else if (cp->group.num_tasks > 1 &&
+                 cp->group.group_size > cp->group.num_tasks) {
+        // Reduce within each task before going over the network, unless
+        // every task has a single device and the hierarchy would be flat.
+        return "HierarchicalReduce";
       } else {
         return "RingReduce";
       }
@@ -15,10 +15,20 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/eager/eager_executor.h"
 
+#include "tensorflow/core/util/env_var.h"
+
 namespace tensorflow {
 
 EagerNode::EagerNode(tensorflow::uint64 id) : id(id) {}
 
+tensorflow::Status EagerNode::RunBatch(const std::vector<EagerNode*>& rest) {
+  TF_RETURN_IF_ERROR(Run());
+  for (EagerNode* node : rest) {
+    TF_RETURN_IF_ERROR(node->Run());
+  }
+  return tensorflow::Status::OK();
+}
+
 EagerExecutor::~EagerExecutor() {
   tensorflow::mutex_lock l(node_queue_mutex_);
   thread_done_ = true;
@@ -33,6 +43,11 @@ tensorflow::uint64 EagerExecutor::NextId() {
 void EagerExecutor::EnableAsync() {
   tensorflow::mutex_lock l(node_queue_mutex_);
   if (thread_ == nullptr) {
+    tensorflow::Status s = tensorflow::ReadInt64FromEnvVar(
+        "TF_EAGER_EXECUTOR_MAX_BATCH_SIZE", 64, &max_batch_size_);
+    if (!s.ok()) {
+      LOG(ERROR) << s.error_message();
+    }
     thread_.reset(tensorflow::Env::Default()->StartThread(
         tensorflow::ThreadOptions(), "eager_async_executor",
         std::bind(&EagerExecutor::Run, this)));
@@ -55,9 +70,9 @@ void EagerExecutor::Add(EagerNode* node) {
       delete node;
       return;
     }
-    node_queue_.push(node);
+    node_queue_.push_back(node);
   } else {
-    node_queue_.push(node);
+    node_queue_.push_back(node);
     nodes_pending_.notify_all();
   }
 }
@@ -109,38 +124,61 @@ tensorflow::Status EagerExecutor::status() {
 
 void EagerExecutor::Run() {
   while (true) {
-    std::unique_ptr<EagerNode> curr_node;
+    // The nodes are owned by `node_queue_` until they are popped below.
+    std::vector<EagerNode*> batch;
     {
       tensorflow::mutex_lock l(node_queue_mutex_);
       while (node_queue_.empty() || !status_.ok()) {
         if (thread_done_) return;
         nodes_pending_.wait(l);
       }
-      curr_node.reset(node_queue_.front());
+      batch.push_back(node_queue_.front());
+      const void* batch_key = batch.front()->BatchKey();
+      if (batch_key != nullptr) {
+        for (auto it = node_queue_.begin() + 1;
+             it != node_queue_.end() &&
+             static_cast<int64>(batch.size()) < max_batch_size_ &&
+             (*it)->BatchKey() == batch_key;
+             ++it) {
+          batch.push_back(*it);
+        }
+      }
+    }
+    tensorflow::Status status;
+    if (batch.size() == 1) {
+      status = batch.front()->Run();
+    } else {
+      status = batch.front()->RunBatch(
+          std::vector<EagerNode*>(batch.begin() + 1, batch.end()));
     }
-    tensorflow::Status status = curr_node->Run();
     const bool ok = status.ok();
+    const tensorflow::uint64 last_node_id = batch.back()->id;
     tensorflow::mutex_lock l(node_queue_mutex_);
-    node_queue_.pop();
+    for (EagerNode* node : batch) {
+      DCHECK_EQ(node, node_queue_.front());
+      node_queue_.pop_front();
+      delete node;
+    }
     if (!ok) {
       status_ = status;
       // TODO(agarwal): mark all affected handles as corrupted before clearing
       // this queue.
       // We remove any pending ops so that we don't try to execute them if
       // ClearError is called.
-      for (int i = 0; i < node_queue_.size(); ++i) {
-        delete node_queue_.front();
-        node_queue_.pop();
+      for (EagerNode* node : node_queue_) {
+        delete node;
       }
+      node_queue_.clear();
     }
     if (!node_done_notifications_.empty()) {
-      tensorflow::uint64 node_id = curr_node->id;
       // Note that we notify all waiting threads in case an error has occurred.
       // These calling threads are responsible for checking status_ before
       // proceeding.
-      const auto range = ok ? node_done_notifications_.equal_range(node_id)
-                            : make_pair(node_done_notifications_.begin(),
-                                        node_done_notifications_.end());
+      const auto range =
+          ok ? make_pair(node_done_notifications_.begin(),
+                         node_done_notifications_.upper_bound(last_node_id))
+             : make_pair(node_done_notifications_.begin(),
+                         node_done_notifications_.end());
       for (auto it = range.first; it != range.second; ++it) {
         it->second->notify_all();
       }
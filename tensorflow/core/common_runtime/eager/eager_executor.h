@@ -17,9 +17,9 @@ limitations under the License.
 
 #include <algorithm>
 #include <cstddef>
+#include <deque>
 #include <map>
 #include <memory>
-#include <queue>
 #include <string>
 #include <thread>
 #include <vector>
@@ -50,6 +50,17 @@ class EagerNode {
   // execution is done.
   virtual Status Run() = 0;
 
+  // Nodes that can be executed more cheaply together than one at a time (e.g.
+  // remote ops that can share a single RPC) return a non-null key here.
+  // EagerExecutor batches consecutive queued nodes with equal keys and runs
+  // them with a single call to RunBatch on the first node of the batch.
+  virtual const void* BatchKey() const { return nullptr; }
+
+  // Runs this node followed by `rest`, all of which have the same BatchKey()
+  // as this node, and blocks till the execution is done. The default
+  // implementation runs the nodes one by one, stopping at the first error.
+  virtual Status RunBatch(const std::vector<EagerNode*>& rest);
+
   // An id unique to the TFE_Context under which this node is created. Allocated
   // monotonically.
   const uint64 id;
@@ -99,6 +110,10 @@ class EagerExecutor {
   // thread_done_ is set to true. If any errors are encontered, these are set
   // inside `status_`. The loop blocks anytime there are no pending nodes, or if
   // `status_` is not ok.
+  //
+  // Up to `max_batch_size_` consecutive nodes with the same non-null
+  // BatchKey() are run together; nodes that are added while a batch is
+  // running are picked up by the next batch.
   void Run();
 
   Status WaitImpl(bool wait_all, uint64 node_id);
@@ -108,8 +123,14 @@ class EagerExecutor {
   // Used to signal that some EagerNodes are pending execution.
   condition_variable nodes_pending_ GUARDED_BY(node_queue_mutex_);
 
-  // Queue of pending EagerNodes.
-  std::queue<EagerNode*> node_queue_ GUARDED_BY(node_queue_mutex_);
+  // Queue of pending EagerNodes. Nodes stay in the queue until they are done
+  // executing.
+  std::deque<EagerNode*> node_queue_ GUARDED_BY(node_queue_mutex_);
+
+  // Maximum number of nodes run by a single RunBatch call. Read from the
+  // TF_EAGER_EXECUTOR_MAX_BATCH_SIZE environment variable; 1 disables
+  // batching.
+  int64 max_batch_size_ GUARDED_BY(node_queue_mutex_) = 64;
 
   // `status_` is set based on any errors raised during execution of a
   // EagerNode.  It remains set until ClearError is called.
@@ -0,0 +1,402 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_reducer.h"
+
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/common_runtime/ring_reducer.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/gtl/cleanup.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/profiler/lib/traceme.h"
+
+// Set true for greater intelligibility of debug mode log messages.
+#define READABLE_KEYS false
+
+namespace tensorflow {
+
+namespace {
+// Data movement phases, used to disambiguate BufRendezvous keys.
+constexpr int kReducePhase = 0;
+constexpr int kBroadcastPhase = 1;
+
+// Key to be used for BufRendezvous by HierarchicalReducer.
+string HierarchicalReduceBufKey(const string& exec_key, int phase, int src_idx,
+                                int dst_idx) {
+  if (READABLE_KEYS) {
+    return strings::StrCat("hierarchical_reduce(", exec_key, "):phase(", phase,
+                           "):src(", src_idx, "):dst(", dst_idx, ")");
+  } else {
+    return strings::StrCat(exec_key, ":", phase, ":", src_idx, ":", dst_idx);
+  }
+}
+
+// Collects the status of a fixed number of asynchronous actions.
+class PendingActions {
+ public:
+  explicit PendingActions(int count) : counter_(count) {}
+
+  StatusCallback Callback() {
+    return [this](const Status& s) {
+      {
+        mutex_lock l(mu_);
+        status_.Update(s);
+      }
+      counter_.DecrementCount();
+    };
+  }
+
+  Status Wait() {
+    counter_.Wait();
+    mutex_lock l(mu_);
+    return status_;
+  }
+
+ private:
+  BlockingCounter counter_;
+  mutex mu_;
+  Status status_ GUARDED_BY(mu_);
+};
+
+// Ranks of the children of `rank` in a binary tree over `size` devices rooted
+// at rank 0.
+std::vector<int> TreeChildren(int rank, int size) {
+  std::vector<int> children;
+  for (int child = 2 * rank + 1; child <= 2 * rank + 2 && child < size;
+       ++child) {
+    children.push_back(child);
+  }
+  return children;
+}
+
+int TreeParent(int rank) { return rank == 0 ? -1 : (rank - 1) / 2; }
+}  // namespace
+
+HierarchicalReducer::HierarchicalReducer()
+    : col_ctx_(nullptr), col_params_(nullptr), done_(nullptr) {}
+
+Status HierarchicalReducer::InitializeCollectiveParams(
+    CollectiveParams* col_params) {
+  CHECK_EQ(col_params->instance.type, REDUCTION_COLLECTIVE);
+  CHECK_EQ(col_params->instance.impl_details.collective_name,
+           "HierarchicalReduce");
+  const string& device_name =
+      col_params->instance.device_names[col_params->default_rank];
+  // Precondition: device_names must be sorted so that all devices in the
+  // same task are adjacent.
+  auto& perms = col_params->instance.impl_details.subdiv_permutations;
+  perms.clear();
+  col_params->subdiv_rank.clear();
+  const string* prior_task_name = nullptr;
+  for (int di = 0; di < col_params->group.group_size; ++di) {
+    if (prior_task_name == nullptr ||
+        col_params->instance.task_names[di] != *prior_task_name) {
+      perms.emplace_back();
+      col_params->subdiv_rank.push_back(-1);
+      prior_task_name = &col_params->instance.task_names[di];
+    }
+    if (col_params->instance.device_names[di] == device_name) {
+      col_params->subdiv_rank.back() = static_cast<int>(perms.back().size());
+    }
+    perms.back().push_back(di);
+  }
+  if (static_cast<int>(perms.size()) != col_params->group.num_tasks) {
+    return errors::Internal("Expected ", col_params->group.num_tasks,
+                            " tasks in HierarchicalReduce but found ",
+                            perms.size(),
+                            "; device names must be sorted by task.");
+  }
+  VLOG(2) << collective_util::SubdivPermDebugString(*col_params);
+  return Status::OK();
+}
+
+Status HierarchicalReducer::InitializeCollectiveContext(
+    CollectiveContext* col_ctx) {
+  CHECK(col_ctx->dev_mgr);
+  col_ctx_ = col_ctx;
+  col_params_ = &col_ctx->col_params;
+  return collective_util::InitializeDeviceAndLocality(
+      col_ctx->dev_mgr, col_ctx->device_name, &col_ctx->device,
+      &col_ctx->device_locality);
+}
+
+/* static */
+void HierarchicalReducer::InitializeLeaderRingParams(
+    const CollectiveParams& cp, int task, CollectiveParams* ring_params) {
+  const auto& perms = cp.instance.impl_details.subdiv_permutations;
+  const int num_tasks = static_cast<int>(perms.size());
+  ring_params->name = cp.name;
+  ring_params->group.group_key = cp.group.group_key;
+  ring_params->group.group_size = num_tasks;
+  ring_params->group.device_type = cp.group.device_type;
+  ring_params->group.num_tasks = num_tasks;
+  ring_params->instance.instance_key = cp.instance.instance_key;
+  ring_params->instance.type = REDUCTION_COLLECTIVE;
+  ring_params->instance.data_type = cp.instance.data_type;
+  ring_params->instance.shape = cp.instance.shape;
+  ring_params->instance.same_num_devices_per_task = true;
+  ring_params->instance.impl_details.collective_name = "RingReduce";
+  ring_params->instance.device_names.clear();
+  ring_params->instance.task_names.clear();
+  ring_params->instance.num_devices_per_task.clear();
+  ring_params->task.is_local.clear();
+  for (int ti = 0; ti < num_tasks; ++ti) {
+    const int leader = perms[ti][0];
+    ring_params->instance.device_names.push_back(
+        cp.instance.device_names[leader]);
+    ring_params->instance.task_names.push_back(cp.instance.task_names[leader]);
+    ring_params->instance.num_devices_per_task[cp.instance.task_names[leader]] =
+        1;
+    ring_params->task.is_local.push_back(cp.task.is_local[leader]);
+  }
+  ring_params->default_rank = task;
+}
+
+void HierarchicalReducer::Run(StatusCallback done) {
+  CHECK(col_ctx_);
+  CHECK(col_params_);
+  done_ = std::move(done);
+
+  // Find the subdiv, i.e. the task, this device belongs to.
+  int subdiv = -1;
+  for (int sdi = 0; sdi < col_params_->subdiv_rank.size(); ++sdi) {
+    if (col_params_->subdiv_rank[sdi] >= 0) subdiv = sdi;
+  }
+  if (subdiv < 0) {
+    done_(errors::Internal("Device ", col_ctx_->device_name,
+                           " does not belong to any HierarchicalReduce task"));
+    return;
+  }
+  const bool is_leader = col_params_->subdiv_rank[subdiv] == 0;
+  VLOG(1) << "HierarchicalReducer::Run device=" << col_ctx_->device_name
+          << " subdiv=" << subdiv
+          << " rank=" << col_params_->subdiv_rank[subdiv];
+
+  Status status;
+  // Start by copying input to output if they're not already the same, i.e. if
+  // we're not computing in-place on the input tensor.
+  if ((col_ctx_->input != col_ctx_->output) &&
+      (DMAHelper::base(col_ctx_->input) != DMAHelper::base(col_ctx_->output))) {
+    profiler::TraceMe activity("MemCpyAsync", profiler::TraceMeLevel::kInfo);
+    Notification note;
+    CollectiveRemoteAccessLocal::MemCpyAsync(
+        col_ctx_->op_ctx->input_device_context(0),
+        col_ctx_->op_ctx->op_device_context(), col_ctx_->device,
+        col_ctx_->device, col_ctx_->op_ctx->input_alloc_attr(0),
+        col_ctx_->op_ctx->output_alloc_attr(0), col_ctx_->input,
+        col_ctx_->output, 0 /*dev_to_dev_stream_index*/,
+        [&note, &status](const Status& s) {
+          status.Update(s);
+          note.Notify();
+        });
+    note.WaitForNotification();
+  }
+
+  if (status.ok()) status = ReduceWithinTask(subdiv);
+  if (status.ok() && is_leader) {
+    if (col_params_->group.num_tasks > 1) status = ReduceAcrossTasks(subdiv);
+    if (status.ok()) status = ApplyFinalOp();
+  }
+  if (status.ok()) status = BroadcastWithinTask(subdiv);
+  if (!status.ok()) {
+    // Cancel the outstanding transfers of the other devices, which would
+    // otherwise wait forever for this one.
+    col_ctx_->col_exec->StartAbort(status);
+  }
+  VLOG(2) << "device=" << col_ctx_->device_name << " return status " << status;
+  done_(status);
+}
+
+Status HierarchicalReducer::ReduceWithinTask(int subdiv) {
+  profiler::TraceMe activity("ReduceWithinTask", profiler::TraceMeLevel::kInfo);
+  const std::vector<int>& perm =
+      col_params_->instance.impl_details.subdiv_permutations[subdiv];
+  const int my_rank = col_params_->subdiv_rank[subdiv];
+  const std::vector<int> children =
+      TreeChildren(my_rank, static_cast<int>(perm.size()));
+
+  // Receive the partial reductions of all children concurrently, then merge
+  // them into the output.
+  if (!children.empty()) {
+    Allocator* allocator = col_ctx_->device->GetAllocator(
+        col_ctx_->op_ctx->output_alloc_attr(0));
+    std::vector<Tensor> partials;
+    partials.reserve(children.size());
+    PendingActions recvs(static_cast<int>(children.size()));
+    for (int child : children) {
+      partials.emplace_back(allocator, col_ctx_->output->dtype(),
+                            col_ctx_->output->shape());
+      DispatchRecv(kReducePhase, perm[child], &partials.back(),
+                   recvs.Callback());
+    }
+    TF_RETURN_IF_ERROR(recvs.Wait());
+    for (Tensor& partial : partials) {
+      TF_RETURN_IF_ERROR(collective_util::ComputeBinOp(
+          col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+          col_params_->merge_op.get(), col_ctx_->output, &partial));
+    }
+  }
+
+  const int parent = TreeParent(my_rank);
+  if (parent >= 0) {
+    PendingActions send(1);
+    DispatchSend(kReducePhase, perm[parent], col_ctx_->output,
+                 send.Callback());
+    TF_RETURN_IF_ERROR(send.Wait());
+  }
+  return Status::OK();
+}
+
+Status HierarchicalReducer::ReduceAcrossTasks(int subdiv) {
+  profiler::TraceMe activity("ReduceAcrossTasks",
+                             profiler::TraceMeLevel::kInfo);
+  CollectiveParams ring_params;
+  InitializeLeaderRingParams(*col_params_, subdiv, &ring_params);
+  // The ring borrows this op's merge_op; it is released again below so that
+  // it is not deleted twice.  No final_op is set because it must be applied
+  // with the size of the whole group, not the number of tasks.
+  ring_params.merge_op.reset(col_params_->merge_op.get());
+  auto release_merge_op =
+      gtl::MakeCleanup([&ring_params] { ring_params.merge_op.release(); });
+
+  CollectiveImplementationInterface* resolver = nullptr;
+  TF_RETURN_IF_ERROR(
+      CollectiveRegistry::LookupParamResolverInstance("RingReduce", &resolver));
+  TF_RETURN_IF_ERROR(resolver->InitializeCollectiveParams(&ring_params));
+
+  // The ring runs in place on the output, using its own exec_key so that its
+  // BufRendezvous keys cannot collide with the intra-task phases.
+  RingReducer ring;
+  CollectiveContext ring_ctx(col_ctx_->col_exec, col_ctx_->dev_mgr,
+                             col_ctx_->op_ctx, col_ctx_->op_params,
+                             ring_params,
+                             strings::StrCat(col_ctx_->exec_key, ":leaders"),
+                             col_ctx_->step_id, col_ctx_->output,
+                             col_ctx_->output);
+  // This resolves the same device as our own InitializeCollectiveContext, so
+  // it cannot fail; RingReducer must be Run once constructed.
+  TF_CHECK_OK(ring.InitializeCollectiveContext(&ring_ctx));
+  Status status;
+  ring.Run([&status](const Status& s) { status = s; });
+  return status;
+}
+
+Status HierarchicalReducer::ApplyFinalOp() {
+  if (!col_params_->final_op) return Status::OK();
+  // Build a scalar holding the group size, of the output's dtype.
+  std::unique_ptr<CollectiveAdapter> ca(MakeCollectiveAdapter(
+      col_ctx_->output, 1,
+      col_ctx_->device->GetAllocator(col_ctx_->op_ctx->output_alloc_attr(0))));
+  Tensor group_size_val = ca->Scalar(col_params_->group.group_size);
+  Tensor group_size_tensor = group_size_val;
+  if (col_params_->group.device_type != "CPU") {
+    group_size_tensor = ca->Scalar(
+        col_ctx_->device->GetAllocator(col_ctx_->op_ctx->input_alloc_attr(0)),
+        AllocationAttributes());
+  }
+  ca->ConsumeFinalValue(col_ctx_->output);
+  if (col_params_->group.device_type != "CPU") {
+    Notification note;
+    Status status;
+    col_ctx_->op_ctx->op_device_context()->CopyCPUTensorToDevice(
+        &group_size_val, col_ctx_->device, &group_size_tensor,
+        [&note, &status](const Status& s) {
+          status = s;
+          note.Notify();
+        });
+    note.WaitForNotification();
+    TF_RETURN_IF_ERROR(status);
+  }
+  return collective_util::ComputeBinOp(
+      col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+      col_params_->final_op.get(), col_ctx_->output, &group_size_tensor);
+}
+
+Status HierarchicalReducer::BroadcastWithinTask(int subdiv) {
+  profiler::TraceMe activity("BroadcastWithinTask",
+                             profiler::TraceMeLevel::kInfo);
+  const std::vector<int>& perm =
+      col_params_->instance.impl_details.subdiv_permutations[subdiv];
+  const int my_rank = col_params_->subdiv_rank[subdiv];
+
+  const int parent = TreeParent(my_rank);
+  if (parent >= 0) {
+    PendingActions recv(1);
+    DispatchRecv(kBroadcastPhase, perm[parent], col_ctx_->output,
+                 recv.Callback());
+    TF_RETURN_IF_ERROR(recv.Wait());
+  }
+
+  const std::vector<int> children =
+      TreeChildren(my_rank, static_cast<int>(perm.size()));
+  PendingActions sends(static_cast<int>(children.size()));
+  for (int child : children) {
+    DispatchSend(kBroadcastPhase, perm[child], col_ctx_->output,
+                 sends.Callback());
+  }
+  return sends.Wait();
+}
+
+void HierarchicalReducer::DispatchSend(int phase, int dst_idx,
+                                       const Tensor* src_tensor,
+                                       const StatusCallback& done) {
+  string send_buf_key = HierarchicalReduceBufKey(
+      col_ctx_->exec_key, phase, col_params_->default_rank, dst_idx);
+  VLOG(3) << "DispatchSend " << send_buf_key << " from_device "
+          << col_ctx_->device_name << " to_device "
+          << col_params_->instance.device_names[dst_idx];
+  col_ctx_->col_exec->PostToPeer(col_params_->instance.device_names[dst_idx],
+                                 col_params_->instance.task_names[dst_idx],
+                                 send_buf_key, col_ctx_->device,
+                                 col_ctx_->op_ctx->op_device_context(),
+                                 col_ctx_->op_ctx->output_alloc_attr(0),
+                                 src_tensor, col_ctx_->device_locality, done);
+}
+
+void HierarchicalReducer::DispatchRecv(int phase, int src_idx,
+                                       Tensor* dst_tensor,
+                                       const StatusCallback& done) {
+  string recv_buf_key = HierarchicalReduceBufKey(
+      col_ctx_->exec_key, phase, src_idx, col_params_->default_rank);
+  VLOG(3) << "DispatchRecv " << recv_buf_key << " from_device "
+          << col_params_->instance.device_names[src_idx] << " to_device "
+          << col_ctx_->device_name;
+  col_ctx_->col_exec->RecvFromPeer(
+      col_params_->instance.device_names[src_idx],
+      col_params_->instance.task_names[src_idx],
+      col_params_->task.is_local[src_idx], recv_buf_key, col_ctx_->device,
+      col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->output_alloc_attr(0), dst_tensor,
+      col_ctx_->device_locality, 0 /*stream_index*/, done);
+}
+
+REGISTER_COLLECTIVE(HierarchicalReduce, HierarchicalReducer);
+
+}  // namespace tensorflow
@@ -0,0 +1,96 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
+
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/framework/collective.h"
+
+namespace tensorflow {
+
+// Hierarchical implementation of collective all-reduce.
+//
+// Devices are grouped by task.  The devices of each task first reduce their
+// values onto the first device of the task (the task leader) along a binary
+// tree.  The task leaders then all-reduce across tasks with a RingReducer,
+// and finally each leader broadcasts the result back to the devices of its
+// task along the same binary tree.  Only one device per task takes part in
+// inter-task communication, so each task sends and receives about 2x the
+// tensor size over the network regardless of how many devices it has.
+class HierarchicalReducer : public CollectiveImplementationInterface {
+ public:
+  HierarchicalReducer();
+  ~HierarchicalReducer() override = default;
+
+  // Establishes one subdiv per task, comprising all devices of that task in
+  // default rank order.  The device at rank 0 of each subdiv is the task
+  // leader.  A device that does not belong to a subdiv has subdiv_rank -1.
+  Status InitializeCollectiveParams(CollectiveParams* col_params) override;
+
+  // Initializes members of CollectiveContext not yet initialized, i.e. device
+  // and device_locality.  Also saves the CollectiveContext in this object.
+  Status InitializeCollectiveContext(CollectiveContext* col_ctx) override;
+
+  // No-op for hierarchical reducer.
+  Status InitializeCollectiveGroupRuntimeDetails(
+      CollGroupRuntimeDetails*) override {
+    return Status::OK();
+  }
+
+  // Begins async execution of the hierarchical all-reduce.
+  // Must be called in a blockable thread.
+  void Run(StatusCallback done) override;
+
+  // Populates `ring_params` with the parameters of the inter-task ring
+  // all-reduce among task leaders, as seen by the leader of `task`.  `cp` must
+  // have been initialized by InitializeCollectiveParams.  The merge and final
+  // ops are not set.
+  static void InitializeLeaderRingParams(const CollectiveParams& cp, int task,
+                                         CollectiveParams* ring_params);
+
+ private:
+  // Reduces the values of the devices in `subdiv` onto the task leader.
+  Status ReduceWithinTask(int subdiv);
+
+  // All-reduces the task leaders' values.  Must only be called on a leader.
+  Status ReduceAcrossTasks(int subdiv);
+
+  // Applies `final_op` to the fully reduced value.
+  Status ApplyFinalOp();
+
+  // Broadcasts the task leader's value to the devices in `subdiv`.
+  Status BroadcastWithinTask(int subdiv);
+
+  // Sends `src_tensor` asynchronously from this device to the device at
+  // default rank `dst_idx` in the given `phase`.  Calls `done` upon completion.
+  void DispatchSend(int phase, int dst_idx, const Tensor* src_tensor,
+                    const StatusCallback& done);
+
+  // Receives a tensor into `dst_tensor` at this device from the device at
+  // default rank `src_idx` in the given `phase`.  Calls `done` upon
+  // completion.
+  void DispatchRecv(int phase, int src_idx, Tensor* dst_tensor,
+                    const StatusCallback& done);
+
+  CollectiveContext* col_ctx_;          // Not owned
+  const CollectiveParams* col_params_;  // Not owned
+  StatusCallback done_;
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
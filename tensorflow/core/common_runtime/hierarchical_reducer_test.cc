@@ -0,0 +1,460 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_reducer.h"
+
+#include <memory>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/device_resolver_local.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/common_runtime/test_collective_executor_mgr.h"
+#include "tensorflow/core/common_runtime/threadpool_device.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+static int64 kStepId = 123;
+
+// Wraps CollectiveRemoteAccessLocal with the ability to return an
+// error status to the N'th action.
+class FailTestRMA : public CollectiveRemoteAccessLocal {
+ public:
+  FailTestRMA(const DeviceMgr* dev_mgr, DeviceResolverInterface* dev_resolver,
+              int64 step_id, int fail_after)
+      : CollectiveRemoteAccessLocal(dev_mgr, dev_resolver, step_id),
+        fail_after_(fail_after) {}
+
+  bool MaybeFail(const StatusCallback& done) {
+    bool fail_now = false;
+    {
+      mutex_lock l(mu_);
+      if (fail_after_ > 0) {
+        fail_now = (--fail_after_ == 0);
+      }
+    }
+    if (fail_now) {
+      done(errors::Internal("Deliberate failure"));
+      return true;
+    }
+    return false;
+  }
+
+  void RecvFromPeer(const string& peer_device, const string& peer_task,
+                    bool peer_is_local, const string& key, Device* to_device,
+                    DeviceContext* to_device_ctx,
+                    const AllocatorAttributes& to_alloc_attr, Tensor* to_tensor,
+                    const DeviceLocality& client_locality,
+                    int dev_to_dev_stream_index,
+                    const StatusCallback& done) override {
+    if (MaybeFail(done)) return;
+    CollectiveRemoteAccessLocal::RecvFromPeer(
+        peer_device, peer_task, peer_is_local, key, to_device, to_device_ctx,
+        to_alloc_attr, to_tensor, client_locality, dev_to_dev_stream_index,
+        done);
+  }
+
+  void PostToPeer(const string& peer_device, const string& peer_task,
+                  const string& key, Device* from_device,
+                  DeviceContext* from_device_ctx,
+                  const AllocatorAttributes& from_alloc_attr,
+                  const Tensor* from_tensor,
+                  const DeviceLocality& client_locality,
+                  const StatusCallback& done) override {
+    if (MaybeFail(done)) return;
+    CollectiveRemoteAccessLocal::PostToPeer(
+        peer_device, peer_task, key, from_device, from_device_ctx,
+        from_alloc_attr, from_tensor, client_locality, done);
+  }
+
+  mutex mu_;
+  int fail_after_ GUARDED_BY(mu_);
+};
+
+std::unique_ptr<OpKernel> GetKernel(const NodeDef& node, DeviceBase* device) {
+  Status status;
+  std::unique_ptr<OpKernel> k = CreateOpKernel(
+      DEVICE_CPU, device, device->GetAllocator(AllocatorAttributes()), node,
+      TF_GRAPH_DEF_VERSION, &status);
+  TF_CHECK_OK(status);
+  return k;
+}
+
+std::unique_ptr<OpKernel> GetBinOp(const string& op, DeviceBase* device) {
+  NodeDef node_def;
+  NodeDefBuilder builder(strings::StrCat(op, "_node"), op);
+  TF_CHECK_OK(builder.Attr("T", DT_FLOAT)
+                  .Input(FakeInput(DT_FLOAT))
+                  .Input(FakeInput(DT_FLOAT))
+                  .Finalize(&node_def));
+  return GetKernel(node_def, device);
+}
+
+// Runs an all-reduce of float tensors over CPU devices that are spread across
+// `num_tasks` simulated tasks of one process, with either "RingReduce" or
+// "HierarchicalReduce".  All data movement goes through
+// CollectiveRemoteAccessLocal, i.e. a loopback of the inter-task transport.
+class ReduceHarness {
+ public:
+  ReduceHarness(const string& collective_name, int num_tasks,
+                int num_devices_per_task, int tensor_len, int fail_after)
+      : tensor_len_(tensor_len) {
+    std::vector<std::unique_ptr<Device>> devices;
+    SessionOptions sess_opts;
+    sess_opts.env = Env::Default();
+    Bytes mem_limit(4 << 20);
+    DeviceLocality dev_locality;
+    for (int ti = 0; ti < num_tasks; ++ti) {
+      const string task_name =
+          strings::StrCat("/job:worker/replica:0/task:", ti);
+      for (int di = 0; di < num_devices_per_task; ++di) {
+        const string dev_name = strings::StrCat(task_name, "/cpu:", di);
+        devices.push_back(absl::make_unique<ThreadPoolDevice>(
+            sess_opts, dev_name, mem_limit, dev_locality, cpu_allocator()));
+        col_params_.instance.device_names.push_back(dev_name);
+        col_params_.instance.task_names.push_back(task_name);
+        // This test runs in a single process so is_local is always true.
+        col_params_.task.is_local.push_back(true);
+      }
+    }
+    dev_mgr_ = absl::make_unique<DeviceMgr>(std::move(devices));
+    dev_resolver_ = absl::make_unique<DeviceResolverLocal>(dev_mgr_.get());
+    rma_ = new FailTestRMA(dev_mgr_.get(), dev_resolver_.get(), kStepId,
+                           fail_after);
+    col_exec_ = new BaseCollectiveExecutor(&col_exec_mgr_, rma_, kStepId,
+                                           dev_mgr_.get(), &gpu_ring_order_);
+
+    col_params_.name = "test_collective";
+    col_params_.group.group_key = 5;
+    col_params_.group.device_type = DEVICE_CPU;
+    col_params_.group.group_size = num_tasks * num_devices_per_task;
+    col_params_.group.num_tasks = num_tasks;
+    col_params_.instance.instance_key = 17;
+    col_params_.instance.type = REDUCTION_COLLECTIVE;
+    col_params_.instance.impl_details.collective_name = collective_name;
+    col_params_.instance.data_type = DT_FLOAT;
+    col_params_.instance.shape = TensorShape({tensor_len});
+
+    for (int rank = 0; rank < col_params_.group.group_size; ++rank) {
+      instances_.push_back(absl::make_unique<DeviceInstance>(rank, this));
+    }
+  }
+
+  ~ReduceHarness() {
+    instances_.clear();
+    col_exec_->Unref();
+  }
+
+  // Sets the input of device `rank` to rank * 10 + i at index i, runs one
+  // all-reduce on every device concurrently and waits for all to finish.
+  void Run() {
+    for (auto& instance : instances_) instance->InitTensor();
+    BlockingCounter done(static_cast<int>(instances_.size()));
+    for (auto& instance : instances_) {
+      DeviceInstance* di = instance.get();
+      SchedClosure([di, &done] {
+        di->DoReduce();
+        done.DecrementCount();
+      });
+    }
+    done.Wait();
+    ++iteration_;
+  }
+
+  // Checks that every device computed the mean of all inputs.
+  void ExpectMean() {
+    const int group_size = col_params_.group.group_size;
+    for (auto& instance : instances_) {
+      TF_ASSERT_OK(instance->status_);
+      auto actual = instance->tensor_.flat<float>();
+      for (int i = 0; i < tensor_len_; ++i) {
+        float expected = 0;
+        for (int rank = 0; rank < group_size; ++rank) {
+          expected += rank * 10 + i;
+        }
+        EXPECT_FLOAT_EQ(expected / group_size, actual(i))
+            << "Mismatch at device " << instance->rank_ << " index " << i;
+      }
+    }
+  }
+
+  void ExpectAllFailed() {
+    for (auto& instance : instances_) {
+      EXPECT_FALSE(instance->status_.ok())
+          << "device " << instance->rank_ << " succeeded";
+    }
+  }
+
+ private:
+  class DeviceInstance {
+   public:
+    DeviceInstance(int rank, ReduceHarness* parent)
+        : parent_(parent), rank_(rank) {
+      const CollectiveParams& cp = parent_->col_params_;
+      TF_CHECK_OK(parent_->dev_mgr_->LookupDevice(
+          cp.instance.device_names[rank], &device_));
+      col_params_.name = cp.name;
+      col_params_.group = cp.group;
+      col_params_.instance = cp.instance;
+      col_params_.task = cp.task;
+      col_params_.default_rank = rank;
+      // Each device initializes its own params, as the param resolver would.
+      CollectiveImplementationInterface* resolver = nullptr;
+      TF_CHECK_OK(CollectiveRegistry::LookupParamResolverInstance(
+          cp.instance.impl_details.collective_name, &resolver));
+      TF_CHECK_OK(resolver->InitializeCollectiveParams(&col_params_));
+      col_params_.merge_op = GetBinOp("Add", device_);
+      col_params_.final_op = GetBinOp("Div", device_);
+    }
+
+    void InitTensor() {
+      tensor_ = Tensor(device_->GetAllocator(AllocatorAttributes()), DT_FLOAT,
+                       TensorShape({parent_->tensor_len_}));
+      auto flat = tensor_.flat<float>();
+      for (int i = 0; i < parent_->tensor_len_; ++i) {
+        flat(i) = rank_ * 10 + i;
+      }
+    }
+
+    void DoReduce() {
+      // Prepare an OpKernelContext.
+      OpKernelContext::Params op_params;
+      op_params.step_id = kStepId;
+      op_params.device = device_;
+      gtl::InlinedVector<TensorValue, 4> inputs;
+      inputs.push_back(TensorValue(&tensor_));
+      op_params.inputs = &inputs;
+      gtl::InlinedVector<AllocatorAttributes, 4> input_aa(
+          {AllocatorAttributes()});
+      op_params.input_alloc_attrs = &input_aa;
+      DeviceContext* dev_ctx = new DeviceContext;
+      gtl::InlinedVector<DeviceContext*, 4> input_dc({dev_ctx});
+      op_params.input_device_contexts = &input_dc;
+      op_params.op_device_context = dev_ctx;
+      int forward_from = 0;
+      op_params.forward_from_array = &forward_from;
+      AllocatorAttributes generic_alloc_attr;
+      op_params.output_attr_array = &generic_alloc_attr;
+      std::unique_ptr<OpKernel> op = GetCollectiveReduce();
+      op_params.op_kernel = op.get();
+      OpKernelContext ctx(&op_params, 1);
+
+      // We never actually execute the kernel, so we need to do the output
+      // allocation it would do, ourselves.
+      Tensor* output_tensor_ptr = nullptr;
+      TF_CHECK_OK(ctx.forward_input_or_allocate_output({0}, 0, tensor_.shape(),
+                                                       &output_tensor_ptr));
+
+      const string exec_key = strings::StrCat(
+          col_params_.instance.instance_key, ":", parent_->iteration_, ":0");
+      CollectiveImplementationInterface* impl = nullptr;
+      TF_CHECK_OK(CollectiveRegistry::Lookup(
+          col_params_.instance.impl_details.collective_name, &impl));
+      std::unique_ptr<CollectiveImplementationInterface> impl_owner(impl);
+      CollectiveContext col_ctx(parent_->col_exec_, parent_->dev_mgr_.get(),
+                                &ctx, &op_params, col_params_, exec_key,
+                                kStepId, &tensor_, &tensor_);
+      TF_CHECK_OK(impl->InitializeCollectiveContext(&col_ctx));
+      impl->Run([this](Status s) { status_ = s; });
+      if (status_.ok()) {
+        CHECK(tensor_.CopyFrom(*ctx.mutable_output(0), tensor_.shape()));
+      }
+      dev_ctx->Unref();
+    }
+
+    std::unique_ptr<OpKernel> GetCollectiveReduce() {
+      NodeDef node_def;
+      NodeDefBuilder builder(strings::StrCat("collective_reduce_", rank_),
+                             "CollectiveReduce");
+      TF_CHECK_OK(
+          builder.Attr("T", DT_FLOAT)
+              .Attr("merge_op", "Add")
+              .Attr("final_op", "Div")
+              .Attr("group_size", col_params_.group.group_size)
+              .Attr("group_key", col_params_.group.group_key)
+              .Attr("instance_key", col_params_.instance.instance_key)
+              .Attr("subdiv_offsets",
+                    col_params_.instance.impl_details.subdiv_offsets)
+              .Input(FakeInput(DT_FLOAT))
+              .Finalize(&node_def));
+      return GetKernel(node_def, device_);
+    }
+
+    ReduceHarness* parent_;
+    const int rank_;
+    Device* device_;
+    CollectiveParams col_params_;
+    Tensor tensor_;
+    Status status_;
+  };
+
+  const int tensor_len_;
+  int iteration_ = 0;
+  TestCollectiveExecutorMgr col_exec_mgr_;
+  CollectiveExecutor* col_exec_;
+  CollectiveRemoteAccessLocal* rma_;  // Owned by col_exec_
+  std::unique_ptr<DeviceResolverLocal> dev_resolver_;
+  std::unique_ptr<DeviceMgr> dev_mgr_;
+  string gpu_ring_order_;
+  CollectiveParams col_params_;
+  std::vector<std::unique_ptr<DeviceInstance>> instances_;
+};
+
+CollectiveParams SetUpCollectiveParams(int num_devs_per_task, int num_tasks,
+                                       int default_rank) {
+  CollectiveParams cp;
+  const int kNumDevs = num_devs_per_task * num_tasks;
+  cp.group.group_key = 1;
+  cp.group.group_size = kNumDevs;
+  cp.group.device_type = DeviceType("GPU");
+  cp.group.num_tasks = num_tasks;
+  cp.instance.instance_key = 3;
+  cp.instance.type = REDUCTION_COLLECTIVE;
+  cp.instance.data_type = DataType(DT_FLOAT);
+  cp.instance.shape = TensorShape({kNumDevs});
+  cp.instance.impl_details.collective_name = "HierarchicalReduce";
+  for (int i = 0; i < kNumDevs; ++i) {
+    int task_id = i / num_devs_per_task;
+    int dev_id = i % num_devs_per_task;
+    string task_name = strings::StrCat("/job:worker/replica:0/task:", task_id);
+    string device_name = strings::StrCat(task_name, "/device:GPU:", dev_id);
+    cp.instance.task_names.push_back(task_name);
+    cp.instance.device_names.push_back(device_name);
+    cp.task.is_local.push_back(task_id == default_rank / num_devs_per_task);
+  }
+  cp.default_rank = default_rank;
+  return cp;
+}
+
+TEST(HierarchicalReducerTest, InitializeParams) {
+  CollectiveParams cp = SetUpCollectiveParams(4, 3, /*default_rank=*/5);
+  HierarchicalReducer reducer;
+  TF_ASSERT_OK(reducer.InitializeCollectiveParams(&cp));
+  EXPECT_EQ(std::vector<std::vector<int>>(
+                {{0, 1, 2, 3}, {4, 5, 6, 7}, {8, 9, 10, 11}}),
+            cp.instance.impl_details.subdiv_permutations);
+  EXPECT_EQ(std::vector<int>({-1, 1, -1}), cp.subdiv_rank);
+}
+
+TEST(HierarchicalReducerTest, InitializeLeaderRingParams) {
+  CollectiveParams cp = SetUpCollectiveParams(4, 3, /*default_rank=*/4);
+  HierarchicalReducer reducer;
+  TF_ASSERT_OK(reducer.InitializeCollectiveParams(&cp));
+  CollectiveParams ring_params;
+  HierarchicalReducer::InitializeLeaderRingParams(cp, 1, &ring_params);
+  EXPECT_EQ(3, ring_params.group.group_size);
+  EXPECT_EQ(3, ring_params.group.num_tasks);
+  EXPECT_EQ(1, ring_params.default_rank);
+  EXPECT_EQ("RingReduce", ring_params.instance.impl_details.collective_name);
+  EXPECT_EQ(std::vector<string>({"/job:worker/replica:0/task:0/device:GPU:0",
+                                 "/job:worker/replica:0/task:1/device:GPU:0",
+                                 "/job:worker/replica:0/task:2/device:GPU:0"}),
+            ring_params.instance.device_names);
+  EXPECT_EQ(std::vector<bool>({false, true, false}), ring_params.task.is_local);
+}
+
+TEST(HierarchicalReducerTest, UnsortedDevicesAreRejected) {
+  CollectiveParams cp = SetUpCollectiveParams(2, 2, /*default_rank=*/0);
+  std::swap(cp.instance.task_names[1], cp.instance.task_names[2]);
+  std::swap(cp.instance.device_names[1], cp.instance.device_names[2]);
+  HierarchicalReducer reducer;
+  EXPECT_FALSE(reducer.InitializeCollectiveParams(&cp).ok());
+}
+
+// Tasks, devices per task, tensor length.
+class HierarchicalReducerRunTest
+    : public ::testing::TestWithParam<std::tuple<int, int, int>> {};
+
+TEST_P(HierarchicalReducerRunTest, ComputesMean) {
+  ReduceHarness harness("HierarchicalReduce", std::get<0>(GetParam()),
+                        std::get<1>(GetParam()), std::get<2>(GetParam()),
+                        /*fail_after=*/0);
+  harness.Run();
+  harness.ExpectMean();
+  // Running again with the same devices must not reuse stale buffers.
+  harness.Run();
+  harness.ExpectMean();
+}
+
+INSTANTIATE_TEST_CASE_P(HierarchicalReducerRun, HierarchicalReducerRunTest,
+                        ::testing::Values(std::make_tuple(1, 1, 4),
+                                          std::make_tuple(1, 5, 17),
+                                          std::make_tuple(2, 1, 8),
+                                          std::make_tuple(2, 2, 1),
+                                          std::make_tuple(2, 4, 1001),
+                                          std::make_tuple(3, 3, 4095),
+                                          std::make_tuple(4, 8, 9408)));
+
+TEST(HierarchicalReducerTest, FailureAbortsAllDevices) {
+  for (int fail_after : {1, 7, 15}) {
+    ReduceHarness harness("HierarchicalReduce", 2, 4, 1001, fail_after);
+    harness.Run();
+    harness.ExpectAllFailed();
+  }
+}
+
+// Compares flat ring all-reduce with hierarchical all-reduce across simulated
+// tasks connected through the local loopback transport.
+static void BM_AllReduce(int iters, const string& collective_name,
+                         int num_tasks, int num_devices_per_task,
+                         int tensor_len) {
+  testing::StopTiming();
+  ReduceHarness harness(collective_name, num_tasks, num_devices_per_task,
+                        tensor_len, /*fail_after=*/0);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    harness.Run();
+  }
+  testing::StopTiming();
+  testing::BytesProcessed(static_cast<int64>(iters) * num_tasks *
+                          num_devices_per_task * tensor_len * sizeof(float));
+}
+
+static void BM_RingReduce(int iters, int num_tasks, int tensor_len) {
+  BM_AllReduce(iters, "RingReduce", num_tasks, 4, tensor_len);
+}
+static void BM_HierarchicalReduce(int iters, int num_tasks, int tensor_len) {
+  BM_AllReduce(iters, "HierarchicalReduce", num_tasks, 4, tensor_len);
+}
+BENCHMARK(BM_RingReduce)
+    ->ArgPair(2, 1 << 10)
+    ->ArgPair(2, 1 << 18)
+    ->ArgPair(4, 1 << 10)
+    ->ArgPair(4, 1 << 18);
+BENCHMARK(BM_HierarchicalReduce)
+    ->ArgPair(2, 1 << 10)
+    ->ArgPair(2, 1 << 18)
+    ->ArgPair(4, 1 << 10)
+    ->ArgPair(4, 1 << 18);
+
+}  // namespace
+}  // namespace tensorflow
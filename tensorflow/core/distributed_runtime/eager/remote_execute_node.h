@@ -16,6 +16,9 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_EAGER_REMOTE_EXECUTE_NODE_H_
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_EAGER_REMOTE_EXECUTE_NODE_H_
 
+#include <algorithm>
+#include <vector>
+
 #include "tensorflow/core/common_runtime/eager/eager_executor.h"
 #include "tensorflow/core/common_runtime/eager/tensor_handle.h"
 #include "tensorflow/core/distributed_runtime/eager/eager_client.h"
@@ -26,6 +29,17 @@ namespace eager {
 
 // EnqueueNode is an implementation of EagerNode which enqueues an operation
 // via RPC in a remote EagerService.
+//
+// Consecutive RemoteExecuteNodes that talk to the same EagerClient are sent to
+// the remote EagerService in a single EnqueueRequest by EagerExecutor (see
+// EagerNode::RunBatch). The remote service executes the queued items in order
+// and returns one QueueResponse per item, which are handed back to the
+// individual nodes' callbacks.
+//
+// Batches are not pipelined: the next batch is only sent once the response to
+// the previous one arrives, since the service handles concurrent
+// EnqueueRequests independently and could run a later one first. Nodes queued
+// in the meantime make up the next batch.
 class RemoteExecuteNode : public tensorflow::EagerNode {
  public:
   RemoteExecuteNode(
@@ -75,6 +89,73 @@ class RemoteExecuteNode : public tensorflow::EagerNode {
     return status;
   }
 
+  const void* BatchKey() const override { return eager_client_; }
+
+  tensorflow::Status RunBatch(const std::vector<EagerNode*>& rest) override {
+    // All nodes in a batch share `eager_client_`, but other kinds of nodes may
+    // use it as their BatchKey() too, and nodes may still target different
+    // remote contexts if the context was reset in between.
+    std::vector<RemoteExecuteNode*> nodes;
+    nodes.reserve(rest.size() + 1);
+    nodes.push_back(this);
+    for (EagerNode* node : rest) {
+      auto* remote_node = dynamic_cast<RemoteExecuteNode*>(node);
+      if (remote_node == nullptr ||
+          remote_node->request_->context_id() != request_->context_id()) {
+        return EagerNode::RunBatch(rest);
+      }
+      nodes.push_back(remote_node);
+    }
+
+    EnqueueRequest request;
+    request.set_context_id(request_->context_id());
+    std::vector<int> num_items;
+    num_items.reserve(nodes.size());
+    for (RemoteExecuteNode* node : nodes) {
+      num_items.push_back(node->request_->queue_size());
+      for (auto& item : *node->request_->mutable_queue()) {
+        request.add_queue()->Swap(&item);
+      }
+    }
+
+    EnqueueResponse response;
+    Status status;
+    Notification n;
+    eager_client_->EnqueueAsync(&request, &response,
+                                [&n, &status](const tensorflow::Status& s) {
+                                  status.Update(s);
+                                  n.Notify();
+                                });
+    n.WaitForNotification();
+
+    // On error the remote service stops after adding the response of the
+    // failing item, so the items before it are known to have run, and the
+    // nodes made only of those succeeded. If the response was dropped, as the
+    // RPC layer does on errors, no node is known to have succeeded, and all of
+    // them are told about the error.
+    const int num_done =
+        status.ok() ? response.queue_response_size()
+                    : std::max(response.queue_response_size() - 1, 0);
+    int offset = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      const bool done = offset + num_items[i] <= num_done;
+      if (!nodes[i]->done_callback_) {
+        offset += num_items[i];
+        continue;
+      }
+      EnqueueResponse node_response;
+      for (int j = 0;
+           j < num_items[i] && offset < response.queue_response_size();
+           ++j, ++offset) {
+        node_response.add_queue_response()->Swap(
+            response.mutable_queue_response(offset));
+      }
+      nodes[i]->done_callback_(done ? Status::OK() : status, node_response);
+    }
+
+    return status;
+  }
+
  private:
   std::unique_ptr<EnqueueRequest> request_;
   EagerClient* eager_client_;  // Not owned, and must outlive this node.
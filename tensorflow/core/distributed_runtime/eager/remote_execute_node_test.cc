@@ -0,0 +1,308 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/eager/remote_execute_node.h"
+
+#include <stdlib.h>
+
+#include <map>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/distributed_runtime/eager/eager_service_impl.h"
+#include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
+#include "tensorflow/core/distributed_runtime/session_mgr.h"
+#include "tensorflow/core/distributed_runtime/worker_env.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/protobuf/eager_service.pb.h"
+
+namespace tensorflow {
+namespace eager {
+namespace {
+
+const char* const kDevice = "/job:localhost/replica:0/task:0/device:CPU:0";
+
+// An EagerClient that calls directly into an in-process EagerServiceImpl, and
+// records the number of items in each EnqueueRequest it sees.
+class LocalEagerClient : public EagerClient {
+ public:
+  explicit LocalEagerClient(EagerServiceImpl* service) : service_(service) {}
+
+#define CLIENT_METHOD(method)                                            \
+  void method##Async(const method##Request* request,                     \
+                     method##Response* response, StatusCallback done)    \
+      override {                                                         \
+    done(service_->method(request, response));                          \
+  }
+
+  CLIENT_METHOD(CreateContext);
+  CLIENT_METHOD(WaitQueueDone);
+  CLIENT_METHOD(KeepAlive);
+  CLIENT_METHOD(CloseContext);
+  CLIENT_METHOD(RegisterFunction);
+  CLIENT_METHOD(SendTensor);
+
+#undef CLIENT_METHOD
+
+  void EnqueueAsync(const EnqueueRequest* request, EnqueueResponse* response,
+                    StatusCallback done) override {
+    Notification* gate = nullptr;
+    {
+      mutex_lock l(mu_);
+      enqueue_sizes_.push_back(request->queue_size());
+      std::swap(gate, gate_);
+    }
+    if (gate != nullptr) gate->WaitForNotification();
+    done(service_->Enqueue(request, response));
+  }
+
+  // Blocks the next EnqueueAsync call until `gate` is notified.
+  void BlockNextEnqueue(Notification* gate) {
+    mutex_lock l(mu_);
+    gate_ = gate;
+  }
+
+  std::vector<int> enqueue_sizes() {
+    mutex_lock l(mu_);
+    return enqueue_sizes_;
+  }
+
+ private:
+  EagerServiceImpl* const service_;
+  mutex mu_;
+  Notification* gate_ GUARDED_BY(mu_) = nullptr;
+  std::vector<int> enqueue_sizes_ GUARDED_BY(mu_);
+};
+
+// An in-process eager server with a single CPU device.
+class LocalEagerServer {
+ public:
+  LocalEagerServer()
+      : rendezvous_mgr_(&worker_env_),
+        session_mgr_(new SessionMgr(
+            &worker_env_, kDevice, std::unique_ptr<WorkerCacheInterface>(),
+            [](const ServerDef& server_def,
+               WorkerCacheInterface** worker_cache) {
+              *worker_cache = nullptr;
+              return Status::OK();
+            })) {
+    worker_env_.env = Env::Default();
+    worker_env_.rendezvous_mgr = &rendezvous_mgr_;
+    worker_env_.session_mgr = session_mgr_.get();
+    device_mgr_ = absl::make_unique<DeviceMgr>(
+        DeviceFactory::NewDevice("CPU", {}, kDevice));
+    worker_env_.local_devices = device_mgr_->ListDevices();
+    worker_env_.device_mgr = device_mgr_.get();
+
+    service_ = absl::make_unique<EagerServiceImpl>(&worker_env_);
+    client_ = absl::make_unique<LocalEagerClient>(service_.get());
+
+    CreateContextRequest request;
+    request.mutable_server_def()->set_job_name("localhost");
+    request.mutable_server_def()->set_task_index(0);
+    request.set_rendezvous_id(random::New64());
+    CreateContextResponse response;
+    TF_CHECK_OK(service_->CreateContext(&request, &response));
+    context_id_ = response.context_id();
+  }
+
+  ~LocalEagerServer() {
+    CloseContextRequest request;
+    request.set_context_id(context_id_);
+    CloseContextResponse response;
+    TF_CHECK_OK(service_->CloseContext(&request, &response));
+  }
+
+  LocalEagerClient* client() { return client_.get(); }
+  uint64 context_id() const { return context_id_; }
+
+ private:
+  WorkerEnv worker_env_;
+  tensorflow::RpcRendezvousMgr rendezvous_mgr_;
+  std::unique_ptr<SessionMgr> session_mgr_;
+  std::unique_ptr<DeviceMgr> device_mgr_;
+  std::unique_ptr<EagerServiceImpl> service_;
+  std::unique_ptr<LocalEagerClient> client_;
+  uint64 context_id_;
+};
+
+// Returns a request that creates a scalar float constant with id `op_id`, or
+// runs a nonexistent op if `valid` is false.
+std::unique_ptr<EnqueueRequest> ConstRequest(uint64 context_id, int64 op_id,
+                                             bool valid = true) {
+  auto request = absl::make_unique<EnqueueRequest>();
+  request->set_context_id(context_id);
+  Operation* operation = request->add_queue()->mutable_operation();
+  operation->set_id(op_id);
+  operation->set_name(valid ? "Const" : "NoSuchOp");
+  operation->set_device(kDevice);
+  AttrValue dtype;
+  dtype.set_type(DT_FLOAT);
+  (*operation->mutable_attrs())["dtype"] = dtype;
+  AttrValue value;
+  Tensor(static_cast<float>(op_id))
+      .AsProtoTensorContent(value.mutable_tensor());
+  (*operation->mutable_attrs())["value"] = value;
+  return request;
+}
+
+class RemoteExecuteNodeTest : public ::testing::Test {
+ protected:
+  // Adds a node that runs a constant op and records its response.
+  void AddConstNode(int64 op_id, bool valid = true) {
+    executor_.Add(new RemoteExecuteNode(
+        executor_.NextId(), ConstRequest(server_.context_id(), op_id, valid),
+        server_.client(), {},
+        [this, op_id](const Status& status, const EnqueueResponse& response) {
+          mutex_lock l(mu_);
+          if (status.ok()) {
+            num_outputs_[op_id] = response.queue_response(0).shape_size();
+          } else {
+            errors_.push_back(op_id);
+          }
+        }));
+  }
+
+  LocalEagerServer server_;
+  EagerExecutor executor_;
+  mutex mu_;
+  std::map<int64, int> num_outputs_ GUARDED_BY(mu_);
+  std::vector<int64> errors_ GUARDED_BY(mu_);
+};
+
+TEST_F(RemoteExecuteNodeTest, BatchesQueuedNodes) {
+  executor_.EnableAsync();
+  Notification gate;
+  server_.client()->BlockNextEnqueue(&gate);
+  // The first node blocks in its RPC, so the remaining ones pile up in the
+  // queue and are sent together.
+  for (int64 op_id = 1; op_id <= 10; ++op_id) {
+    AddConstNode(op_id);
+  }
+  gate.Notify();
+  TF_ASSERT_OK(executor_.WaitForAllPendingNodes());
+
+  EXPECT_EQ(std::vector<int>({1, 9}), server_.client()->enqueue_sizes());
+  mutex_lock l(mu_);
+  EXPECT_TRUE(errors_.empty());
+  ASSERT_EQ(10, num_outputs_.size());
+  for (const auto& entry : num_outputs_) {
+    EXPECT_EQ(1, entry.second) << "op " << entry.first;
+  }
+}
+
+TEST_F(RemoteExecuteNodeTest, ErrorInBatchIsPropagated) {
+  executor_.EnableAsync();
+  Notification gate;
+  server_.client()->BlockNextEnqueue(&gate);
+  AddConstNode(1);
+  AddConstNode(2);
+  AddConstNode(3, /*valid=*/false);
+  AddConstNode(4);
+  gate.Notify();
+  EXPECT_FALSE(executor_.WaitForAllPendingNodes().ok());
+  EXPECT_FALSE(executor_.status().ok());
+
+  {
+    mutex_lock l(mu_);
+    EXPECT_EQ(1, num_outputs_.count(1));
+    // The node that ran before the failing one in the batch succeeded, and
+    // the ones from the failing one on see the error.
+    EXPECT_EQ(1, num_outputs_.count(2));
+    EXPECT_EQ(std::vector<int64>({3, 4}), errors_);
+  }
+
+  // The executor accepts new nodes once the error is cleared.
+  executor_.ClearError();
+  AddConstNode(5);
+  TF_EXPECT_OK(executor_.WaitForAllPendingNodes());
+  mutex_lock l(mu_);
+  EXPECT_EQ(1, num_outputs_.count(5));
+}
+
+// A node that uses the same BatchKey() as RemoteExecuteNodes, but is not one.
+class OtherNode : public EagerNode {
+ public:
+  OtherNode(uint64 id, EagerClient* eager_client, bool* ran)
+      : EagerNode(id), eager_client_(eager_client), ran_(ran) {}
+
+  Status Run() override {
+    *ran_ = true;
+    return Status::OK();
+  }
+
+  const void* BatchKey() const override { return eager_client_; }
+
+ private:
+  EagerClient* const eager_client_;
+  bool* const ran_;
+};
+
+TEST_F(RemoteExecuteNodeTest, OtherNodesAreNotBatched) {
+  executor_.EnableAsync();
+  Notification gate;
+  server_.client()->BlockNextEnqueue(&gate);
+  AddConstNode(1);
+  AddConstNode(2);
+  bool ran = false;
+  executor_.Add(new OtherNode(executor_.NextId(), server_.client(), &ran));
+  AddConstNode(3);
+  gate.Notify();
+  TF_ASSERT_OK(executor_.WaitForAllPendingNodes());
+
+  // The batch of the last three nodes falls back to running them one by one.
+  EXPECT_EQ(std::vector<int>({1, 1, 1}), server_.client()->enqueue_sizes());
+  EXPECT_TRUE(ran);
+  mutex_lock l(mu_);
+  EXPECT_TRUE(errors_.empty());
+  EXPECT_EQ(3, num_outputs_.size());
+}
+
+// Measures the rate at which an async EagerExecutor runs remote ops against an
+// in-process eager server, with up to `max_batch_size` ops per RPC.
+static void BM_RemoteExecute(int iters, int max_batch_size) {
+  testing::StopTiming();
+  // EagerExecutor reads the batch size when async execution is enabled.
+  setenv("TF_EAGER_EXECUTOR_MAX_BATCH_SIZE",
+         strings::StrCat(max_batch_size).c_str(), 1);
+  LocalEagerServer server;
+  EagerExecutor executor;
+  executor.EnableAsync();
+  unsetenv("TF_EAGER_EXECUTOR_MAX_BATCH_SIZE");
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    executor.Add(new RemoteExecuteNode(executor.NextId(),
+                                       ConstRequest(server.context_id(), i),
+                                       server.client()));
+  }
+  TF_CHECK_OK(executor.WaitForAllPendingNodes());
+  testing::StopTiming();
+  testing::ItemsProcessed(static_cast<int64>(iters));
+}
+BENCHMARK(BM_RemoteExecute)->Arg(1)->Arg(16)->Arg(64);
+
+}  // namespace
+}  // namespace eager
+}  // namespace tensorflow
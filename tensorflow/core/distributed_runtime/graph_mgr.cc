@@ -43,6 +43,8 @@ limitations under the License.
 #include "tensorflow/core/graph/graph_partition.h"
 #include "tensorflow/core/graph/validate.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
@@ -64,10 +66,16 @@ GraphMgr::GraphMgr(const WorkerEnv* worker_env, DeviceMgr* device_mgr)
   if (!status.ok()) {
     LOG(ERROR) << status.error_message();
   }
+  status =
+      ReadInt64FromEnvVar("TF_GRAPH_MGR_CACHE_SIZE", 32, &cache_capacity_);
+  if (!status.ok()) {
+    LOG(ERROR) << status.error_message();
+  }
 }
 
 GraphMgr::~GraphMgr() {
   for (auto p : table_) p.second->Unref();
+  for (auto p : cache_) p.second.first->Unref();
 }
 
 GraphMgr::Item::~Item() {
@@ -290,6 +298,51 @@ Status GraphMgr::InitItem(const string& handle, const GraphDef& gdef,
   return Status::OK();
 }
 
+Fprint128 GraphMgr::CacheKey(const string& handle, const GraphDef& gdef,
+                             WorkerSession* session,
+                             const GraphOptions& graph_options,
+                             int64 collective_graph_key,
+                             DistributedFunctionLibraryRuntime* cluster_flr) {
+  // The executors capture `session` and `cluster_flr`, so graphs registered
+  // with different ones must not share an item.
+  string buf = strings::StrCat(handle, ";", collective_graph_key, ";",
+                               reinterpret_cast<uintptr_t>(session), ";",
+                               reinterpret_cast<uintptr_t>(cluster_flr), ";");
+  string serialized;
+  SerializeToStringDeterministic(graph_options, &serialized);
+  strings::StrAppend(&buf, serialized.size(), ";", serialized);
+  serialized.clear();
+  SerializeToStringDeterministic(gdef, &serialized);
+  strings::StrAppend(&buf, serialized);
+  return Fingerprint128(buf);
+}
+
+GraphMgr::Item* GraphMgr::LookupCachedItem(const Fprint128& key) {
+  auto iter = cache_.find(key);
+  if (iter == cache_.end()) return nullptr;
+  cache_lru_.splice(cache_lru_.begin(), cache_lru_, iter->second.second);
+  Item* item = iter->second.first;
+  item->Ref();
+  return item;
+}
+
+std::vector<GraphMgr::Item*> GraphMgr::AddCachedItem(const Fprint128& key,
+                                                     Item* item) {
+  std::vector<Item*> evicted;
+  // A concurrent registration of the same graph may have won the race.
+  if (cache_.count(key) > 0) return evicted;
+  item->Ref();
+  cache_lru_.push_front(key);
+  cache_.emplace(key, CacheEntry(item, cache_lru_.begin()));
+  while (static_cast<int64>(cache_.size()) > cache_capacity_) {
+    auto iter = cache_.find(cache_lru_.back());
+    evicted.push_back(iter->second.first);
+    cache_.erase(iter);
+    cache_lru_.pop_back();
+  }
+  return evicted;
+}
+
 Status GraphMgr::Register(const string& handle, const GraphDef& gdef,
                           WorkerSession* session,
                           const GraphOptions& graph_options,
@@ -297,19 +350,42 @@ Status GraphMgr::Register(const string& handle, const GraphDef& gdef,
                           int64 collective_graph_key,
                           DistributedFunctionLibraryRuntime* cluster_flr,
                           string* graph_handle) {
-  Item* item = new Item;
-  Status s = InitItem(handle, gdef, session, graph_options, debug_options,
-                      collective_graph_key, cluster_flr, item);
-  if (!s.ok()) {
-    item->Unref();
-    return s;
+  // tfdbg decorates and publishes the graph on every registration, so graphs
+  // with debug watches are never cached.
+  const bool use_cache = cache_capacity_ > 0 &&
+                         debug_options.debug_tensor_watch_opts().empty();
+  Fprint128 key = {0, 0};
+  Item* item = nullptr;
+  if (use_cache) {
+    key = CacheKey(handle, gdef, session, graph_options, collective_graph_key,
+                   cluster_flr);
+    mutex_lock l(mu_);
+    item = LookupCachedItem(key);
+  }
+
+  if (item == nullptr) {
+    item = new Item;
+    Status s = InitItem(handle, gdef, session, graph_options, debug_options,
+                        collective_graph_key, cluster_flr, item);
+    if (!s.ok()) {
+      item->Unref();
+      return s;
+    }
+    if (use_cache) {
+      std::vector<Item*> evicted;
+      {
+        mutex_lock l(mu_);
+        evicted = AddCachedItem(key, item);
+      }
+      for (Item* evicted_item : evicted) evicted_item->Unref();
+    }
   }
 
   // Inserts one item into table_.
   {
     mutex_lock l(mu_);
     *graph_handle = strings::Printf("%016llx", ++next_id_);
-    item->handle = *graph_handle;
+    if (item->handle.empty()) item->handle = *graph_handle;
     CHECK(table_.insert({*graph_handle, item}).second);
   }
   return Status::OK();
@@ -341,6 +417,11 @@ Status GraphMgr::DeregisterAll() {
       items.push_back(entry.second);
     }
     table_.clear();
+    for (const auto& entry : cache_) {
+      items.push_back(entry.second.first);
+    }
+    cache_.clear();
+    cache_lru_.clear();
   }
   for (auto item : items) {
     item->Unref();
@@ -16,7 +16,9 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_GRAPH_MGR_H_
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_GRAPH_MGR_H_
 
+#include <list>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "tensorflow/core/common_runtime/costmodel_manager.h"
@@ -29,6 +31,7 @@ limitations under the License.
 #include "tensorflow/core/framework/cost_graph.pb.h"
 #include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
@@ -57,6 +60,12 @@ struct WorkerSession;
 //
 // Multiple threads can call GraphMgr methods concurrently.
 //
+// Registering a graph that is identical to a recently registered one (same
+// GraphDef, options, session and collective key) reuses the already
+// partitioned and initialized executors instead of building them again. The
+// number of cached graphs is bounded by the TF_GRAPH_MGR_CACHE_SIZE
+// environment variable (default 32); 0 disables the cache.
+//
 // E.g.,
 //   GraphMgr gmgr(worker_env);
 //   string handle;
@@ -74,6 +83,9 @@ class GraphMgr {
 
   // Registers a graph. Fills in "handle". The registered graph retains a
   // reference to cluster_flr to do cross process function calls.
+  //
+  // If an identical graph is in the registration cache, the returned handle
+  // shares its executors.
   Status Register(const string& handle, const GraphDef& gdef,
                   WorkerSession* session, const GraphOptions& graph_options,
                   const DebugOptions& debug_options, int64 collective_graph_key,
@@ -101,7 +113,7 @@ class GraphMgr {
   // Deregisters a graph.
   Status Deregister(const string& handle);
 
-  // Deregister all graphs.
+  // Deregister all graphs. Also drops the registration cache.
   Status DeregisterAll();
 
  private:
@@ -162,6 +174,32 @@ class GraphMgr {
   // mechanism to gc these graphs.
   std::unordered_map<string, Item*> table_;
 
+  // Registration cache, keyed by a fingerprint of the arguments to Register.
+  // Each cached item holds one reference, and the least recently registered
+  // item is evicted once the cache holds more than `cache_capacity_` items.
+  int64 cache_capacity_ = 32;
+  std::list<Fprint128> cache_lru_ GUARDED_BY(mu_);
+  typedef std::pair<Item*, std::list<Fprint128>::iterator> CacheEntry;
+  std::unordered_map<Fprint128, CacheEntry, Fprint128Hasher> cache_
+      GUARDED_BY(mu_);
+
+  // Returns the registration cache key of the given Register arguments.
+  static Fprint128 CacheKey(const string& handle, const GraphDef& gdef,
+                            WorkerSession* session,
+                            const GraphOptions& graph_options,
+                            int64 collective_graph_key,
+                            DistributedFunctionLibraryRuntime* cluster_flr);
+
+  // Looks up `key` in the registration cache. On a hit, returns the cached
+  // item with an additional reference, and nullptr otherwise.
+  Item* LookupCachedItem(const Fprint128& key) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Adds `item` to the registration cache under `key`, evicting the least
+  // recently used entries if the cache is full. Returns the evicted items,
+  // which the caller must unref outside of `mu_`.
+  std::vector<Item*> AddCachedItem(const Fprint128& key, Item* item)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   void StartParallelExecutors(const string& handle, int64 step_id, Item* item,
                               Rendezvous* rendezvous,
                               CollectiveExecutor::Handle* ce_handle,
@@ -0,0 +1,158 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/graph_mgr.h"
+
+#include <stdlib.h>
+
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/default_device.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+const char* const kDevice = "/job:localhost/replica:0/task:0/device:CPU:0";
+
+// Returns a graph that computes x + x, with `x` a constant of `size` floats.
+GraphDef MakeGraphDef(int size) {
+  Graph graph(OpRegistry::Global());
+  Tensor x(DT_FLOAT, TensorShape({size}));
+  test::FillIota<float>(&x, 0.0f);
+  Node* node = test::graph::Constant(&graph, x, "x");
+  test::graph::Add(&graph, node, node);
+  GraphDef gdef;
+  test::graph::ToGraphDef(&graph, &gdef);
+  graph::SetDefaultDevice(kDevice, &gdef);
+  return gdef;
+}
+
+// Owns the devices and threads a GraphMgr needs to register graphs.
+class GraphMgrEnv {
+ public:
+  explicit GraphMgrEnv(int64 cache_size) {
+    std::vector<std::unique_ptr<Device>> devices;
+    TF_CHECK_OK(DeviceFactory::AddDevices(
+        SessionOptions(), "/job:localhost/replica:0/task:0", &devices));
+    device_mgr_.reset(new DeviceMgr(std::move(devices)));
+    pool_.reset(new thread::ThreadPool(Env::Default(), "graph_mgr_test", 2));
+    worker_env_.env = Env::Default();
+    worker_env_.device_mgr = device_mgr_.get();
+    worker_env_.compute_pool = pool_.get();
+    // GraphMgr reads the cache size when it is constructed.
+    setenv("TF_GRAPH_MGR_CACHE_SIZE", strings::StrCat(cache_size).c_str(), 1);
+    graph_mgr_.reset(new GraphMgr(&worker_env_, device_mgr_.get()));
+    unsetenv("TF_GRAPH_MGR_CACHE_SIZE");
+  }
+
+  Status Register(const GraphDef& gdef, string* graph_handle) {
+    return graph_mgr_->Register("session", gdef, /*session=*/nullptr,
+                                GraphOptions(), DebugOptions(),
+                                /*collective_graph_key=*/0,
+                                /*cluster_flr=*/nullptr, graph_handle);
+  }
+
+  GraphMgr* graph_mgr() { return graph_mgr_.get(); }
+
+ private:
+  std::unique_ptr<DeviceMgr> device_mgr_;
+  std::unique_ptr<thread::ThreadPool> pool_;
+  WorkerEnv worker_env_;
+  std::unique_ptr<GraphMgr> graph_mgr_;
+};
+
+TEST(GraphMgrTest, IdenticalGraphsGetDistinctHandles) {
+  for (int64 cache_size : {0, 1, 32}) {
+    GraphMgrEnv env(cache_size);
+    const GraphDef gdef = MakeGraphDef(4);
+    string handle_a;
+    string handle_b;
+    TF_ASSERT_OK(env.Register(gdef, &handle_a));
+    TF_ASSERT_OK(env.Register(gdef, &handle_b));
+    EXPECT_NE(handle_a, handle_b);
+
+    // Deregistering one handle must not affect the other.
+    TF_EXPECT_OK(env.graph_mgr()->Deregister(handle_a));
+    EXPECT_TRUE(errors::IsAborted(env.graph_mgr()->Deregister(handle_a)));
+    TF_EXPECT_OK(env.graph_mgr()->Deregister(handle_b));
+  }
+}
+
+TEST(GraphMgrTest, CacheEviction) {
+  GraphMgrEnv env(/*cache_size=*/1);
+  std::vector<string> handles;
+  // Alternating between two graphs with a single-entry cache evicts on every
+  // registration.
+  for (int i = 0; i < 6; ++i) {
+    string handle;
+    TF_ASSERT_OK(env.Register(MakeGraphDef(1 + i % 2), &handle));
+    handles.push_back(handle);
+  }
+  for (const string& handle : handles) {
+    TF_EXPECT_OK(env.graph_mgr()->Deregister(handle));
+  }
+}
+
+TEST(GraphMgrTest, ReregisterAfterDeregisterAll) {
+  GraphMgrEnv env(/*cache_size=*/32);
+  const GraphDef gdef = MakeGraphDef(4);
+  string handle;
+  TF_ASSERT_OK(env.Register(gdef, &handle));
+  TF_ASSERT_OK(env.graph_mgr()->DeregisterAll());
+  EXPECT_TRUE(errors::IsAborted(env.graph_mgr()->Deregister(handle)));
+  TF_ASSERT_OK(env.Register(gdef, &handle));
+  TF_EXPECT_OK(env.graph_mgr()->Deregister(handle));
+}
+
+TEST(GraphMgrTest, InvalidGraphIsNotCached) {
+  GraphMgrEnv env(/*cache_size=*/32);
+  GraphDef gdef = MakeGraphDef(4);
+  gdef.mutable_node(0)->clear_device();
+  string handle;
+  EXPECT_FALSE(env.Register(gdef, &handle).ok());
+  EXPECT_FALSE(env.Register(gdef, &handle).ok());
+}
+
+// Registers the same graph repeatedly, as the master does when it sees a new
+// feed/fetch signature that partitions identically.
+static void BM_RegisterGraph(int iters, int cache_size, int graph_size) {
+  testing::StopTiming();
+  GraphMgrEnv env(cache_size);
+  const GraphDef gdef = MakeGraphDef(graph_size);
+  string handle;
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    TF_CHECK_OK(env.Register(gdef, &handle));
+    TF_CHECK_OK(env.graph_mgr()->Deregister(handle));
+  }
+  testing::StopTiming();
+}
+BENCHMARK(BM_RegisterGraph)
+    ->ArgPair(0, 16)
+    ->ArgPair(32, 16)
+    ->ArgPair(0, 4096)
+    ->ArgPair(32, 4096);
+
+}  // namespace
+}  // namespace tensorflow
@@ -198,6 +198,20 @@ Status LocalMaster::ReleaseCallable(CallOptions* call_options,
   return ret;
 }
 
+Status LocalMaster::GetStepTrace(CallOptions* call_options,
+                                 const GetStepTraceRequest* request,
+                                 GetStepTraceResponse* response) {
+  Notification n;
+  Status ret;
+  master_impl_->GetStepTrace(request, response, [&n, &ret](const Status& s) {
+    ret.Update(s);
+    n.Notify();
+  });
+  TF_RETURN_IF_ERROR(
+      WaitForNotification(call_options, default_timeout_in_ms_, &n));
+  return ret;
+}
+
 namespace {
 mutex* get_local_master_registry_lock() {
   static mutex local_master_registry_lock(LINKER_INITIALIZED);
@@ -80,6 +80,9 @@ class LocalMaster : public MasterInterface {
   Status ReleaseCallable(CallOptions* call_options,
                          const ReleaseCallableRequest* request,
                          ReleaseCallableResponse* response) override;
+  Status GetStepTrace(CallOptions* call_options,
+                      const GetStepTraceRequest* request,
+                      GetStepTraceResponse* response) override;
 
   // Registers the mapping from the given `target` to the given `master`.
   //
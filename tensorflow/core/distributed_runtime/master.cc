@@ -738,4 +738,16 @@ void Master::ReleaseCallable(const ReleaseCallableRequest* req,
       std::move(done)));
 }
 
+void Master::GetStepTrace(const GetStepTraceRequest* req,
+                          GetStepTraceResponse* resp, MyClosure done) {
+  auto session = FindMasterSession(req->session_handle());
+  if (session == nullptr) {
+    done(errors::Aborted("Session ", req->session_handle(), " is not found."));
+    return;
+  }
+  Status s = session->GetStepTrace(*req, resp);
+  session->Unref();
+  done(s);
+}
+
 }  // end namespace tensorflow
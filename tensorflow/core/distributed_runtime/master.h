@@ -68,6 +68,8 @@ class Master {
                    RunCallableResponse* resp, MyClosure done);
   void ReleaseCallable(const ReleaseCallableRequest* req,
                        ReleaseCallableResponse* resp, MyClosure done);
+  void GetStepTrace(const GetStepTraceRequest* req, GetStepTraceResponse* resp,
+                    MyClosure done);
 
  private:
   typedef Master ME;
@@ -102,6 +102,13 @@ class MasterInterface {
                                  const ReleaseCallableRequest* request,
                                  ReleaseCallableResponse* response) = 0;
 
+  virtual Status GetStepTrace(CallOptions* call_options,
+                              const GetStepTraceRequest* request,
+                              GetStepTraceResponse* response) {
+    return errors::Unimplemented(
+        "GetStepTrace not implemented for this master");
+  }
+
  protected:
   // NOTE: This should only be called by implementations of this
   // interface whose CreateRunStepResponse() method returns a
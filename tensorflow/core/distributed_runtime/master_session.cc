@@ -54,10 +54,13 @@ limitations under the License.
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/tracing.h"
+#include "tensorflow/core/profiler/lib/traceme.h"
 #include "tensorflow/core/public/session_options.h"
 
 namespace tensorflow {
 
+class RunManyGraphs;
+
 // MasterSession wraps ClientGraph in a reference counted object.
 // This way, MasterSession can clear up the cache mapping Run requests to
 // compiled graphs while the compiled graph is still being used.
@@ -322,6 +325,11 @@ class MasterSession::ReffedClientGraph : public core::RefCounted {
       const ClientRequestType& req, ClientResponseType* resp,
       CancellationManager* cm, bool is_last_partial_run);
 
+  // Appends the RunGraph timings of `calls` and the events returned by the
+  // workers to `pss->step_trace`.
+  void CollectStepTrace(int64 step_id, RunManyGraphs* calls,
+                        PerStepState* pss);
+
   // Deregisters the partitions on the workers.  Called in the
   // destructor and does not wait for the rpc completion.
   void DeregisterPartitions();
@@ -503,13 +511,20 @@ class RunManyGraphs {
     CallOptions opts;
     std::unique_ptr<MutableRunGraphRequestWrapper> req;
     std::unique_ptr<MutableRunGraphResponseWrapper> resp;
+    // When the call was issued and when its response arrived.
+    int64 start_micros = 0;
+    int64 end_micros = 0;
+    uint64 trace_activity_id = 0;
   };
   Call* get(int index) { return &calls_[index]; }
 
   // When the index-th call is done, updates the overall status.
   void WhenDone(int index, const std::string& worker_name, const Status& s) {
     TRACEPRINTF("Partition %d %s", index, s.ToString().c_str());
-    auto resp = get(index)->resp.get();
+    Call* call = get(index);
+    call->end_micros = Env::Default()->NowMicros();
+    profiler::TraceMe::ActivityEnd(call->trace_activity_id);
+    auto resp = call->resp.get();
     if (resp->status_code() != error::Code::OK) {
       // resp->status_code will only be non-OK if s.ok().
       mutex_lock l(mu_);
@@ -598,6 +613,27 @@ struct RunCallableResponseWrapper {
 };
 }  // namespace
 
+void MasterSession::ReffedClientGraph::CollectStepTrace(int64 step_id,
+                                                        RunManyGraphs* calls,
+                                                        PerStepState* pss) {
+  StepTrace* trace = &pss->step_trace;
+  trace->set_step_id(step_id);
+  const int num = partitions_.size();
+  for (int i = 0; i < num; ++i) {
+    RunManyGraphs::Call* call = calls->get(i);
+    StepTraceEvent* event = trace->add_event();
+    event->set_type(StepTraceEvent::RUN_GRAPH);
+    event->set_task(partitions_[i].name);
+    event->set_partition(i);
+    event->set_start_micros(call->start_micros);
+    event->set_end_micros(call->end_micros);
+    for (StepTraceEvent& worker_event :
+         *call->resp->mutable_step_trace_events()) {
+      trace->add_event()->Swap(&worker_event);
+    }
+  }
+}
+
 template <class FetchListType, class ClientRequestType,
           class ClientResponseType>
 Status MasterSession::ReffedClientGraph::RunPartitionsHelper(
@@ -623,6 +659,9 @@ Status MasterSession::ReffedClientGraph::RunPartitionsHelper(
   if (pss->collect_partition_graphs) {
     exec_opts.set_record_partition_graphs(true);
   }
+  if (pss->collect_step_trace) {
+    exec_opts.set_record_step_trace(true);
+  }
   if (pss->collect_costs || pss->collect_timeline) {
     pss->step_stats.resize(partitions_.size());
   }
@@ -697,6 +736,10 @@ Status MasterSession::ReffedClientGraph::RunPartitionsHelper(
     const Part& part = partitions_[i];
     RunManyGraphs::Call* call = calls.get(i);
     TRACEPRINTF("Partition %d %s", i, part.name.c_str());
+    call->trace_activity_id = profiler::TraceMe::ActivityStart(
+        strings::StrCat("RunGraph#", part.name),
+        profiler::TraceMeLevel::kInfo);
+    call->start_micros = Env::Default()->NowMicros();
     part.worker->RunGraphAsync(&call->opts, call->req.get(), call->resp.get(),
                                std::bind(&RunManyGraphs::WhenDone, &calls, i,
                                          part.name, std::placeholders::_1));
@@ -716,6 +759,9 @@ Status MasterSession::ReffedClientGraph::RunPartitionsHelper(
   }
   calls.Wait();
   call_opts->ClearCancelCallback();
+  if (pss->collect_step_trace) {
+    CollectStepTrace(step_id, &calls, pss);
+  }
   if (success) {
     cm->DeregisterCallback(token);
   } else {
@@ -1201,7 +1247,8 @@ MasterSession::MasterSession(
       stats_publisher_factory_(std::move(stats_publisher_factory)),
       graph_version_(0),
       run_graphs_(5),
-      partial_run_graphs_(5) {
+      partial_run_graphs_(5),
+      step_traces_(static_cast<int>(StepTraceCapacityFromEnv())) {
   UpdateLastAccessTime();
   CHECK(devices_) << "device_set was null!";
 
@@ -1830,6 +1877,7 @@ void MasterSession::FillPerStepState(MasterSession::ReffedClientGraph* rcg,
       build_cost_model_every > 0 &&
       ((count + 1 - build_cost_model_after) % build_cost_model_every == 0);
   out_pss->collect_partition_graphs = run_options.output_partition_graphs();
+  out_pss->collect_step_trace = step_traces_.capacity() > 0;
 
   *out_ph = rcg->GetProfileHandler(step_id, count, run_options);
   if (*out_ph) {
@@ -1868,6 +1916,9 @@ Status MasterSession::PostRunCleanup(MasterSession::ReffedClientGraph* rcg,
       }
     }
   }
+  if (pss->step_trace.event_size() > 0) {
+    step_traces_.Add(std::move(pss->step_trace));
+  }
   Ref();
   rcg->Ref();
   rcg->CleanupPartitionsAsync(step_id, [this, rcg](const Status& s) {
@@ -2038,6 +2089,25 @@ Status MasterSession::ReleaseCallable(const ReleaseCallableRequest& req,
   return Status::OK();
 }
 
+Status MasterSession::GetStepTrace(const GetStepTraceRequest& req,
+                                   GetStepTraceResponse* resp) const {
+  if (step_traces_.capacity() == 0) {
+    return errors::FailedPrecondition(
+        "Step tracing is disabled (TF_STEP_TRACE_CAPACITY=0).");
+  }
+  if (req.step_id() != 0) {
+    // Only adds the trace to the response if the step is retained.
+    StepTrace trace;
+    if (!step_traces_.Get(req.step_id(), &trace)) {
+      return errors::NotFound("No trace retained for step ", req.step_id());
+    }
+    resp->add_step_trace()->Swap(&trace);
+    return Status::OK();
+  }
+  step_traces_.GetRecent(req.max_steps(), resp->mutable_step_trace());
+  return Status::OK();
+}
+
 Status MasterSession::Close() {
   {
     mutex_lock l(mu_);
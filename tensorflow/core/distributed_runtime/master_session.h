@@ -26,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/distributed_runtime/call_options.h"
 #include "tensorflow/core/distributed_runtime/master_env.h"
 #include "tensorflow/core/distributed_runtime/message_wrappers.h"
+#include "tensorflow/core/distributed_runtime/step_trace.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/types.h"
@@ -99,6 +100,9 @@ class MasterSession : public core::RefCounted {
   Status ReleaseCallable(const ReleaseCallableRequest& req,
                          ReleaseCallableResponse* resp);
 
+  Status GetStepTrace(const GetStepTraceRequest& req,
+                      GetStepTraceResponse* resp) const;
+
   // Close this session and delete "*this". Returns OK if all known
   // states are cleanup successfully.
   //
@@ -165,11 +169,13 @@ class MasterSession : public core::RefCounted {
     bool collect_rpcs = false;
     bool collect_partition_graphs = false;
     bool report_tensor_allocations_upon_oom = false;
+    bool collect_step_trace = false;
     Microseconds start_micros = Microseconds(0);
     Microseconds end_micros = Microseconds(0);
     std::vector<StepStats> step_stats;  // per partition
     StepStats rpc_stats;                // for RPC layer
     CostGraphDef cost_graph;
+    StepTrace step_trace;
   };
 
   struct RunState {
@@ -210,6 +216,9 @@ class MasterSession : public core::RefCounted {
   // Used to cancel running steps on Close().
   CancellationManager cancellation_manager_;
 
+  // Traces of the most recent steps run in this session.
+  StepTraceRing step_traces_;
+
   // Private dtor. The client must call Close().
   virtual ~MasterSession();
 
@@ -672,6 +672,11 @@ void InMemoryRunGraphResponse::AddPartitionGraph(
   partition_graphs_.push_back(partition_graph);
 }
 
+protobuf::RepeatedPtrField<StepTraceEvent>*
+InMemoryRunGraphResponse::mutable_step_trace_events() {
+  return &step_trace_events_;
+}
+
 size_t OwnedProtoRunGraphResponse::num_recvs() const {
   return response_.recv_size();
 }
@@ -739,6 +744,11 @@ void OwnedProtoRunGraphResponse::AddPartitionGraph(
   *graph_def = partition_graph;
 }
 
+protobuf::RepeatedPtrField<StepTraceEvent>*
+OwnedProtoRunGraphResponse::mutable_step_trace_events() {
+  return response_.mutable_step_trace_event();
+}
+
 NonOwnedProtoRunGraphResponse::NonOwnedProtoRunGraphResponse(
     RunGraphResponse* response)
     : response_(response) {}
@@ -812,6 +822,11 @@ void NonOwnedProtoRunGraphResponse::AddPartitionGraph(
   *graph_def = partition_graph;
 }
 
+protobuf::RepeatedPtrField<StepTraceEvent>*
+NonOwnedProtoRunGraphResponse::mutable_step_trace_events() {
+  return response_->mutable_step_trace_event();
+}
+
 MutableRunStepResponseWrapper::~MutableRunStepResponseWrapper() {}
 
 size_t InMemoryRunStepResponse::num_tensors() const { return tensors_.size(); }
@@ -25,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/protobuf/config.pb.h"
 #include "tensorflow/core/protobuf/master.pb.h"
+#include "tensorflow/core/protobuf/step_trace.pb.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
 
 namespace tensorflow {
@@ -494,6 +495,10 @@ class MutableRunGraphResponseWrapper {
   virtual GraphDef* mutable_partition_graph(size_t i) = 0;
   virtual void AddPartitionGraph(const GraphDef& partition_graph) = 0;
 
+  // Timing events recorded by the worker for the master's step trace.
+  virtual protobuf::RepeatedPtrField<StepTraceEvent>*
+  mutable_step_trace_events() = 0;
+
   // Returned status if requested.
   virtual errors::Code status_code() const = 0;
   virtual const string& status_error_message() const = 0;
@@ -528,6 +533,8 @@ class InMemoryRunGraphResponse : public MutableRunGraphResponseWrapper {
   size_t num_partition_graphs() const override;
   GraphDef* mutable_partition_graph(size_t i) override;
   void AddPartitionGraph(const GraphDef& partition_graph) override;
+  protobuf::RepeatedPtrField<StepTraceEvent>* mutable_step_trace_events()
+      override;
   errors::Code status_code() const override;
   const string& status_error_message() const override;
   void set_status(const Status& status) override;
@@ -542,6 +549,7 @@ class InMemoryRunGraphResponse : public MutableRunGraphResponseWrapper {
   StepStats step_stats_;
   CostGraphDef cost_graph_;
   std::vector<GraphDef> partition_graphs_;
+  protobuf::RepeatedPtrField<StepTraceEvent> step_trace_events_;
   // Store the code and message separately so that they can be updated
   // independently by setters.
   Status status_;
@@ -561,6 +569,8 @@ class OwnedProtoRunGraphResponse : public MutableRunGraphResponseWrapper {
   size_t num_partition_graphs() const override;
   GraphDef* mutable_partition_graph(size_t i) override;
   void AddPartitionGraph(const GraphDef& partition_graph) override;
+  protobuf::RepeatedPtrField<StepTraceEvent>* mutable_step_trace_events()
+      override;
   errors::Code status_code() const override;
   const string& status_error_message() const override;
   void set_status(const Status& status) override;
@@ -588,6 +598,8 @@ class NonOwnedProtoRunGraphResponse : public MutableRunGraphResponseWrapper {
   size_t num_partition_graphs() const override;
   GraphDef* mutable_partition_graph(size_t i) override;
   void AddPartitionGraph(const GraphDef& partition_graph) override;
+  protobuf::RepeatedPtrField<StepTraceEvent>* mutable_step_trace_events()
+      override;
   errors::Code status_code() const override;
   const string& status_error_message() const override;
   void set_status(const Status& status) override;
@@ -116,6 +116,7 @@ class GrpcMasterService : public AsyncServiceInterface {
       ENQUEUE_REQUEST(RunCallable, true);
     }
     ENQUEUE_REQUEST(ReleaseCallable, false);
+    ENQUEUE_REQUEST(GetStepTrace, false);
 
     void* tag;
     bool ok;
@@ -281,6 +282,16 @@ class GrpcMasterService : public AsyncServiceInterface {
     ENQUEUE_REQUEST(ReleaseCallable, false);
   }
 
+  // RPC handler for fetching recent step traces.
+  void GetStepTraceHandler(
+      MasterCall<GetStepTraceRequest, GetStepTraceResponse>* call) {
+    master_impl_->GetStepTrace(&call->request, &call->response,
+                               [call](const Status& status) {
+                                 call->SendResponse(ToGrpcStatus(status));
+                               });
+    ENQUEUE_REQUEST(GetStepTrace, false);
+  }
+
 #undef ENQUEUE_REQUEST
 
   // Start tracing, including the ID attached to the RPC.
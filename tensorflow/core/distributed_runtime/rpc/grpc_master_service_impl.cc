@@ -39,6 +39,7 @@ static const char* grpcMasterService_method_names[] = {
     "/tensorflow.MasterService/MakeCallable",
     "/tensorflow.MasterService/RunCallable",
     "/tensorflow.MasterService/ReleaseCallable",
+    "/tensorflow.MasterService/GetStepTrace",
 };
 
 std::unique_ptr<MasterService::Stub> MasterService::NewStub(
@@ -74,7 +75,10 @@ MasterService::Stub::Stub(
                              ::grpc::internal::RpcMethod::NORMAL_RPC, channel),
       rpcmethod_ReleaseCallable_(grpcMasterService_method_names[9],
                                  ::grpc::internal::RpcMethod::NORMAL_RPC,
-                                 channel) {}
+                                 channel),
+      rpcmethod_GetStepTrace_(grpcMasterService_method_names[10],
+                              ::grpc::internal::RpcMethod::NORMAL_RPC,
+                              channel) {}
 
 ::grpc::Status MasterService::Stub::CreateSession(
     ::grpc::ClientContext* context, const CreateSessionRequest& request,
@@ -146,6 +150,13 @@ MasterService::Stub::Stub(
       channel_.get(), rpcmethod_ReleaseCallable_, context, request, response);
 }
 
+::grpc::Status MasterService::Stub::GetStepTrace(
+    ::grpc::ClientContext* context, const GetStepTraceRequest& request,
+    GetStepTraceResponse* response) {
+  return ::grpc::internal::BlockingUnaryCall(
+      channel_.get(), rpcmethod_GetStepTrace_, context, request, response);
+}
+
 MasterService::AsyncService::AsyncService() {
   int method_len = sizeof(grpcMasterService_method_names) / 
                     sizeof(grpcMasterService_method_names[0]);
@@ -70,6 +70,9 @@ class MasterService final {
     virtual ::grpc::Status ReleaseCallable(
         ::grpc::ClientContext* context, const ReleaseCallableRequest& request,
         ReleaseCallableResponse* response) = 0;
+    virtual ::grpc::Status GetStepTrace(::grpc::ClientContext* context,
+                                        const GetStepTraceRequest& request,
+                                        GetStepTraceResponse* response) = 0;
   };
   class Stub final : public StubInterface {
    public:
@@ -104,6 +107,9 @@ class MasterService final {
     ::grpc::Status ReleaseCallable(::grpc::ClientContext* context,
                                    const ReleaseCallableRequest& request,
                                    ReleaseCallableResponse* response) override;
+    ::grpc::Status GetStepTrace(::grpc::ClientContext* context,
+                                const GetStepTraceRequest& request,
+                                GetStepTraceResponse* response) override;
 
    private:
     std::shared_ptr< ::grpc::ChannelInterface> channel_;
@@ -117,6 +123,7 @@ class MasterService final {
     const ::grpc::internal::RpcMethod rpcmethod_MakeCallable_;
     const ::grpc::internal::RpcMethod rpcmethod_RunCallable_;
     const ::grpc::internal::RpcMethod rpcmethod_ReleaseCallable_;
+    const ::grpc::internal::RpcMethod rpcmethod_GetStepTrace_;
   };
   static std::unique_ptr<Stub> NewStub(
       const std::shared_ptr< ::grpc::ChannelInterface>& channel,
@@ -206,6 +213,14 @@ class MasterService final {
       ::grpc::Service::RequestAsyncUnary(9, context, request, response,
                                          new_call_cq, notification_cq, tag);
     }
+    void RequestGetStepTrace(
+        ::grpc::ServerContext* context, GetStepTraceRequest* request,
+        ::grpc::ServerAsyncResponseWriter<GetStepTraceResponse>* response,
+        ::grpc::CompletionQueue* new_call_cq,
+        ::grpc::ServerCompletionQueue* notification_cq, void* tag) {
+      ::grpc::Service::RequestAsyncUnary(10, context, request, response,
+                                         new_call_cq, notification_cq, tag);
+    }
   };
 };
 
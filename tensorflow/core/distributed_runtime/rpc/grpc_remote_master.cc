@@ -109,6 +109,13 @@ class GrpcRemoteMaster : public MasterInterface {
                          &MasterServiceStub::ReleaseCallable);
   }
 
+  Status GetStepTrace(CallOptions* call_options,
+                      const GetStepTraceRequest* request,
+                      GetStepTraceResponse* response) override {
+    return CallWithRetry(call_options, request, response,
+                         &MasterServiceStub::GetStepTrace);
+  }
+
  private:
   // Start tracing, attaching a unique ID to both the trace and the RPC.
   profiler::TraceMe* NewTraceRpc(StringPiece name, ::grpc::ClientContext* ctx) {
@@ -44,6 +44,7 @@ limitations under the License.
 #include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
 #include "tensorflow/core/distributed_runtime/rpc_collective_executor_mgr.h"
 #include "tensorflow/core/distributed_runtime/server_lib.h"
+#include "tensorflow/core/distributed_runtime/step_trace.h"
 #include "tensorflow/core/distributed_runtime/worker_cache_wrapper.h"
 #include "tensorflow/core/distributed_runtime/worker_env.h"
 #include "tensorflow/core/framework/op.h"
@@ -104,6 +105,8 @@ GrpcServer::~GrpcServer() {
     delete worker_env_.device_mgr;
   }
 
+  delete worker_env_.step_trace_collector;
+
   // Do not delete (as these are not owned by the server):
   // - master_env_.env
   // - worker_env_.env
@@ -169,6 +172,9 @@ Status GrpcServer::Init(const GrpcServerOptions& opts) {
   worker_env_.rendezvous_mgr = opts.rendezvous_mgr_func == nullptr
                                    ? new RpcRendezvousMgr(&worker_env_)
                                    : opts.rendezvous_mgr_func(&worker_env_);
+  if (StepTraceCapacityFromEnv() > 0) {
+    worker_env_.step_trace_collector = new StepTraceCollector;
+  }
   string unused;
   string default_worker_name;
   if (!DeviceNameUtils::SplitDeviceName(master_env_.local_devices[0]->name(),
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
 
+#include <algorithm>
 #include <unordered_set>
 
 #include "tensorflow/core/common_runtime/device.h"
@@ -22,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/distributed_runtime/request_id.h"
+#include "tensorflow/core/distributed_runtime/step_trace.h"
 #include "tensorflow/core/distributed_runtime/tensor_coding.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
 #include "tensorflow/core/distributed_runtime/worker_interface.h"
@@ -37,6 +39,8 @@ namespace tensorflow {
 
 namespace {
 
+class RpcRecvTensorCall;
+
 class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  public:
   RpcRemoteRendezvous(const WorkerEnv* env, int64 step_id)
@@ -50,6 +54,10 @@ class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  private:
   ~RpcRemoteRendezvous() override {}
 
+  // Records the wait and transfer time of a completed `call` in the worker's
+  // step trace, if enabled.
+  void RecordStepTrace(const RpcRecvTensorCall* call);
+
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRemoteRendezvous);
 };
 
@@ -79,6 +87,8 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
 
     alloc_attrs_ = AllocatorAttributes();
     dst_device_ = nullptr;
+    start_micros_ = 0;
+    end_micros_ = 0;
     // We don't clear opts_ and assume that Init will set up the state for
     // opts_ appropriately.
     req_.Clear();
@@ -126,6 +136,10 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
 
   bool is_dead() const { return resp_.metadata().is_dead(); }
 
+  // When the RecvTensor call was issued and when it completed.
+  int64 start_micros() const { return start_micros_; }
+  int64 end_micros() const { return end_micros_; }
+
   Device* dst_device() const { return dst_device_; }
   const Rendezvous::Args& recv_args() const { return recv_args_; }
   const Rendezvous::DoneCallback& done() const { return done_; }
@@ -141,6 +155,7 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
         [this](std::function<void()> recv_done,
                // Begin unbound arguments.
                const Status& s) {
+          end_micros_ = Env::Default()->NowMicros();
           if (!s.ok()) {
             mutex_lock l(mu_);
             status_.Update(s);
@@ -148,6 +163,7 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
           recv_done();
         },
         std::move(recv_done), _1);
+    start_micros_ = Env::Default()->NowMicros();
     wi_->RecvTensorAsync(&opts_, &req_, &resp_, std::move(cb));
   }
 
@@ -161,6 +177,8 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
   TensorResponse resp_;
   Rendezvous::Args recv_args_;
   Rendezvous::DoneCallback done_;
+  int64 start_micros_ = 0;
+  int64 end_micros_ = 0;
 
   mutable mutex mu_;
   Status status_ GUARDED_BY(mu_);
@@ -275,6 +293,9 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
     // If StartAbort was called prior to DeregisterCall, then the
     // current status should be bad.
     Status s = call->status();
+    if (s.ok()) {
+      RecordStepTrace(call);
+    }
     // NOTE: `*session()` can potentially be deleted before we return from
     // `call->done()(...)`, so we must release the worker before calling the
     // callback.
@@ -285,6 +306,39 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
   });
 }
 
+void RpcRemoteRendezvous::RecordStepTrace(const RpcRecvTensorCall* call) {
+  StepTraceCollector* collector = env_->step_trace_collector;
+  if (collector == nullptr) return;
+
+  const int64 start_micros = call->start_micros();
+  const int64 end_micros = call->end_micros();
+  // `send_start_micros` is taken on the sender when the tensor became
+  // available. As in the RPC logger, clamp it to the local interval so that
+  // clock skew between the two tasks cannot break causality.
+  int64 send_start_micros = start_micros;
+  if (call->resp_.metadata().send_start_micros()) {
+    send_start_micros = std::max(
+        start_micros,
+        static_cast<int64>(call->resp_.metadata().send_start_micros()));
+    send_start_micros = std::min(send_start_micros, end_micros);
+  }
+
+  StepTraceEvent event;
+  event.set_task(session()->worker_name);
+  event.set_partition(-1);
+  event.set_detail(call->req_.rendezvous_key());
+  if (send_start_micros > start_micros) {
+    event.set_type(StepTraceEvent::RECV_TENSOR_WAIT);
+    event.set_start_micros(start_micros);
+    event.set_end_micros(send_start_micros);
+    collector->Record(step_id_, event);
+  }
+  event.set_type(StepTraceEvent::RECV_TENSOR_TRANSFER);
+  event.set_start_micros(send_start_micros);
+  event.set_end_micros(end_micros);
+  collector->Record(step_id_, std::move(event));
+}
+
 }  // namespace
 
 RpcRendezvousMgr::RpcRendezvousMgr(const WorkerEnv* env)
@@ -0,0 +1,122 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/step_trace.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+
+int64 StepTraceCapacityFromEnv() {
+  static const int64 capacity = []() {
+    int64 value;
+    Status s = ReadInt64FromEnvVar("TF_STEP_TRACE_CAPACITY",
+                                   /*default_val=*/128, &value);
+    if (!s.ok() || value < 0) {
+      LOG(WARNING) << "Ignoring invalid TF_STEP_TRACE_CAPACITY: " << s;
+      value = 128;
+    }
+    return value;
+  }();
+  return capacity;
+}
+
+StepTraceCollector::StepTraceCollector(int max_events_per_step,
+                                       int max_pending_steps)
+    : max_events_per_step_(max_events_per_step),
+      max_pending_steps_(max_pending_steps) {}
+
+void StepTraceCollector::Record(int64 step_id, StepTraceEvent event) {
+  mutex_lock l(mu_);
+  auto it = pending_.find(step_id);
+  if (it == pending_.end()) {
+    if (static_cast<int>(pending_.size()) >= max_pending_steps_) {
+      VLOG(1) << "Dropping step trace event for step " << step_id
+              << ": too many pending steps.";
+      return;
+    }
+    it = pending_.emplace(step_id, std::vector<StepTraceEvent>()).first;
+  }
+  if (static_cast<int>(it->second.size()) < max_events_per_step_) {
+    it->second.push_back(std::move(event));
+  }
+}
+
+void StepTraceCollector::Extract(
+    int64 step_id, protobuf::RepeatedPtrField<StepTraceEvent>* out) {
+  std::vector<StepTraceEvent> events;
+  {
+    mutex_lock l(mu_);
+    auto it = pending_.find(step_id);
+    if (it == pending_.end()) return;
+    events.swap(it->second);
+    pending_.erase(it);
+  }
+  out->Reserve(out->size() + events.size());
+  for (StepTraceEvent& event : events) {
+    out->Add()->Swap(&event);
+  }
+}
+
+void StepTraceCollector::Cleanup(int64 step_id) {
+  mutex_lock l(mu_);
+  pending_.erase(step_id);
+}
+
+StepTraceRing::StepTraceRing(int capacity) : capacity_(capacity) {
+  traces_.reserve(std::max(capacity_, 0));
+}
+
+void StepTraceRing::Add(StepTrace trace) {
+  if (capacity_ <= 0) return;
+  mutex_lock l(mu_);
+  if (static_cast<int>(traces_.size()) < capacity_) {
+    traces_.push_back(std::move(trace));
+  } else {
+    traces_[next_index_].Swap(&trace);
+  }
+  next_index_ = (next_index_ + 1) % capacity_;
+}
+
+bool StepTraceRing::Get(int64 step_id, StepTrace* out) const {
+  mutex_lock l(mu_);
+  for (const StepTrace& trace : traces_) {
+    if (trace.step_id() == step_id) {
+      *out = trace;
+      return true;
+    }
+  }
+  return false;
+}
+
+void StepTraceRing::GetRecent(
+    int max_steps, protobuf::RepeatedPtrField<StepTrace>* out) const {
+  mutex_lock l(mu_);
+  const int num_traces = traces_.size();
+  const int n = (max_steps > 0 && max_steps < num_traces) ? max_steps
+                                                            : num_traces;
+  // While the ring is filling up, `next_index_ == num_traces` and the oldest
+  // trace is at index 0; afterwards the oldest trace is at `next_index_`.
+  const int oldest = (num_traces < capacity_) ? 0 : next_index_;
+  for (int i = num_traces - n; i < num_traces; ++i) {
+    *out->Add() = traces_[(oldest + i) % num_traces];
+  }
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,107 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_STEP_TRACE_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_STEP_TRACE_H_
+
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/step_trace.pb.h"
+
+namespace tensorflow {
+
+// Returns the number of step traces retained by each master session, as
+// configured by the TF_STEP_TRACE_CAPACITY environment variable. A value of
+// zero disables step tracing.
+int64 StepTraceCapacityFromEnv();
+
+// StepTraceCollector buffers the StepTraceEvents that a worker records for a
+// step (e.g. RecvTensor waits and transfers) until they are returned to the
+// master in a RunGraphResponse. Thread safe.
+//
+// Events of a step are handed out exactly once: if several partitions of the
+// same step run on this worker, each RunGraph call takes the events recorded
+// up to its completion.
+class StepTraceCollector {
+ public:
+  // At most `max_events_per_step` events are buffered per step, and at most
+  // `max_pending_steps` steps may have buffered events; further events are
+  // dropped so that a misbehaving client cannot grow the buffer unboundedly.
+  explicit StepTraceCollector(int max_events_per_step = 4096,
+                              int max_pending_steps = 1024);
+
+  // Buffers `event` for `step_id`.
+  void Record(int64 step_id, StepTraceEvent event);
+
+  // Moves all events buffered for `step_id` to the end of `out`.
+  void Extract(int64 step_id, protobuf::RepeatedPtrField<StepTraceEvent>* out);
+
+  // Discards all events buffered for `step_id`.
+  void Cleanup(int64 step_id);
+
+ private:
+  const int max_events_per_step_;
+  const int max_pending_steps_;
+
+  mutex mu_;
+  std::unordered_map<int64, std::vector<StepTraceEvent>> pending_
+      GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StepTraceCollector);
+};
+
+// StepTraceRing retains the StepTraces of the most recent `capacity` steps.
+// When the ring is full, adding a trace evicts the oldest one. Thread safe.
+class StepTraceRing {
+ public:
+  explicit StepTraceRing(int capacity);
+
+  int capacity() const { return capacity_; }
+
+  // Adds `trace`, evicting the oldest trace if the ring is full. No-op if
+  // the capacity is zero.
+  void Add(StepTrace trace);
+
+  // Copies the trace of `step_id` to `*out`. Returns false if the step is not
+  // (or no longer) retained.
+  bool Get(int64 step_id, StepTrace* out) const;
+
+  // Appends the most recent `max_steps` traces (or all retained traces if
+  // `max_steps` is not positive) to `out`, from oldest to newest.
+  void GetRecent(int max_steps,
+                 protobuf::RepeatedPtrField<StepTrace>* out) const;
+
+ private:
+  const int capacity_;
+
+  mutable mutex mu_;
+  // Grows up to `capacity_` entries, then is used as a circular buffer.
+  std::vector<StepTrace> traces_ GUARDED_BY(mu_);
+  // Index in `traces_` of the slot that the next trace is written to; once
+  // the ring is full this is also the oldest trace.
+  int next_index_ GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StepTraceRing);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_STEP_TRACE_H_
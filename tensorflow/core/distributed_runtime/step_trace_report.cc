@@ -0,0 +1,161 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/step_trace_report.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+
+namespace tensorflow {
+
+namespace {
+
+int64 Duration(const StepTraceEvent& event) {
+  return std::max<int64>(0, event.end_micros() - event.start_micros());
+}
+
+// Returns the total length of the union of `intervals`.
+int64 UnionLength(std::vector<std::pair<int64, int64>> intervals) {
+  std::sort(intervals.begin(), intervals.end());
+  int64 total = 0;
+  int64 cur_start = 0;
+  int64 cur_end = 0;
+  bool open = false;
+  for (const auto& interval : intervals) {
+    if (!open || interval.first > cur_end) {
+      if (open) total += cur_end - cur_start;
+      cur_start = interval.first;
+      cur_end = interval.second;
+      open = true;
+    } else {
+      cur_end = std::max(cur_end, interval.second);
+    }
+  }
+  if (open) total += cur_end - cur_start;
+  return total;
+}
+
+}  // namespace
+
+Status SummarizeStepTrace(const StepTrace& trace, int max_slowest_recvs,
+                          StepTraceSummary* summary) {
+  *summary = StepTraceSummary();
+  summary->step_id = trace.step_id();
+
+  const StepTraceEvent* critical = nullptr;
+  int64 first_issue = 0;
+  for (const StepTraceEvent& event : trace.event()) {
+    if (event.type() != StepTraceEvent::RUN_GRAPH) continue;
+    if (critical == nullptr || event.start_micros() < first_issue) {
+      first_issue = event.start_micros();
+    }
+    if (critical == nullptr || event.end_micros() > critical->end_micros()) {
+      critical = &event;
+    }
+  }
+  if (critical == nullptr) {
+    return errors::InvalidArgument("Step ", trace.step_id(),
+                                   " has no RunGraph events.");
+  }
+  summary->step_micros =
+      std::max<int64>(0, critical->end_micros() - first_issue);
+  summary->critical_task = critical->task();
+  summary->critical_partition = critical->partition();
+  summary->critical_run_graph_micros = Duration(*critical);
+
+  std::vector<std::pair<int64, int64>> waits;
+  std::vector<std::pair<int64, int64>> transfers;
+  std::vector<const StepTraceEvent*> recvs;
+  for (const StepTraceEvent& event : trace.event()) {
+    if (event.task() != summary->critical_task) continue;
+    if (event.type() == StepTraceEvent::RECV_TENSOR_WAIT) {
+      waits.emplace_back(event.start_micros(), event.end_micros());
+    } else if (event.type() == StepTraceEvent::RECV_TENSOR_TRANSFER) {
+      transfers.emplace_back(event.start_micros(), event.end_micros());
+    } else {
+      continue;
+    }
+    recvs.push_back(&event);
+  }
+  summary->critical_recv_wait_micros = UnionLength(std::move(waits));
+  summary->critical_recv_transfer_micros = UnionLength(std::move(transfers));
+
+  const int num_slowest =
+      std::min(static_cast<int>(recvs.size()), std::max(max_slowest_recvs, 0));
+  std::partial_sort(recvs.begin(), recvs.begin() + num_slowest, recvs.end(),
+                    [](const StepTraceEvent* a, const StepTraceEvent* b) {
+                      return Duration(*a) > Duration(*b);
+                    });
+  summary->slowest_recvs.reserve(num_slowest);
+  for (int i = 0; i < num_slowest; ++i) {
+    summary->slowest_recvs.push_back(*recvs[i]);
+  }
+  return Status::OK();
+}
+
+string StepTraceReport(const std::vector<StepTraceSummary>& summaries) {
+  string report;
+  // Per critical task: number of steps and total critical RunGraph time.
+  std::map<string, std::pair<int, int64>> by_task;
+  for (const StepTraceSummary& s : summaries) {
+    strings::StrAppend(
+        &report,
+        strings::Printf("step %lld: %lld us, critical partition %d on %s "
+                        "(RunGraph %lld us, recv wait %lld us, "
+                        "recv transfer %lld us)\n",
+                        static_cast<long long>(s.step_id),
+                        static_cast<long long>(s.step_micros),
+                        s.critical_partition, s.critical_task.c_str(),
+                        static_cast<long long>(s.critical_run_graph_micros),
+                        static_cast<long long>(s.critical_recv_wait_micros),
+                        static_cast<long long>(
+                            s.critical_recv_transfer_micros)));
+    for (const StepTraceEvent& event : s.slowest_recvs) {
+      strings::StrAppend(
+          &report, "    ", StepTraceEvent::Type_Name(event.type()), " ",
+          event.end_micros() - event.start_micros(), " us ", event.detail(),
+          "\n");
+    }
+    auto& task = by_task[s.critical_task];
+    ++task.first;
+    task.second += s.critical_run_graph_micros;
+  }
+
+  std::vector<std::pair<string, std::pair<int, int64>>> tasks(by_task.begin(),
+                                                              by_task.end());
+  std::sort(tasks.begin(), tasks.end(),
+            [](const std::pair<string, std::pair<int, int64>>& a,
+               const std::pair<string, std::pair<int, int64>>& b) {
+              return a.second.first > b.second.first;
+            });
+  strings::StrAppend(&report, "Critical tasks:\n");
+  for (const auto& task : tasks) {
+    strings::StrAppend(
+        &report,
+        strings::Printf("  %s: %d of %zu steps, mean RunGraph %lld us\n",
+                        task.first.c_str(), task.second.first,
+                        summaries.size(),
+                        static_cast<long long>(task.second.second /
+                                               task.second.first)));
+  }
+  return report;
+}
+
+}  // namespace tensorflow
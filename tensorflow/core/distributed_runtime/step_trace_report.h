@@ -0,0 +1,65 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_STEP_TRACE_REPORT_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_STEP_TRACE_REPORT_H_
+
+#include <vector>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/step_trace.pb.h"
+
+namespace tensorflow {
+
+// Critical-path summary of a single StepTrace.
+//
+// The step is bounded by the partition whose RunGraph call completes last
+// (the "critical" partition). On the task running that partition, the time
+// blocked on RecvTensor is split into the producer-side wait and the transfer
+// itself; overlapping RecvTensor calls are only counted once.
+struct StepTraceSummary {
+  int64 step_id = 0;
+
+  // From the first RunGraph issue to the last RunGraph completion.
+  int64 step_micros = 0;
+
+  string critical_task;
+  int32 critical_partition = -1;
+  int64 critical_run_graph_micros = 0;
+
+  // Union of the RECV_TENSOR_WAIT and RECV_TENSOR_TRANSFER intervals recorded
+  // on the critical task.
+  int64 critical_recv_wait_micros = 0;
+  int64 critical_recv_transfer_micros = 0;
+
+  // The slowest RecvTensor events on the critical task, slowest first.
+  std::vector<StepTraceEvent> slowest_recvs;
+};
+
+// Computes the critical-path summary of `trace`, keeping at most
+// `max_slowest_recvs` entries in `summary->slowest_recvs`. Returns an error
+// if `trace` contains no RUN_GRAPH event.
+Status SummarizeStepTrace(const StepTrace& trace, int max_slowest_recvs,
+                          StepTraceSummary* summary);
+
+// Returns a human-readable report of `summaries`: one line per step followed
+// by the tasks that were most often on the critical path.
+string StepTraceReport(const std::vector<StepTraceSummary>& summaries);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_STEP_TRACE_REPORT_H_
@@ -0,0 +1,75 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Prints the critical-path contributors of the step traces in a
+// GetStepTraceResponse, as returned by the MasterService.GetStepTrace RPC.
+//
+// Usage:
+//   step_trace_report_main --input=/tmp/step_trace.pb [--top_recvs=5]
+//
+// The input may be a binary or a text-format GetStepTraceResponse.
+
+#include <iostream>
+#include <vector>
+
+#include "tensorflow/core/distributed_runtime/step_trace_report.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/protobuf/master.pb.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+int main(int argc, char* argv[]) {
+  tensorflow::string input;
+  int top_recvs = 5;
+  std::vector<tensorflow::Flag> flag_list = {
+      tensorflow::Flag("input", &input,
+                       "path to a serialized GetStepTraceResponse"),
+      tensorflow::Flag("top_recvs", &top_recvs,
+                       "number of slowest RecvTensor events to print per step"),
+  };
+  tensorflow::string usage = tensorflow::Flags::Usage(argv[0], flag_list);
+  const bool parse_result = tensorflow::Flags::Parse(&argc, argv, flag_list);
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  if (!parse_result || argc != 1 || input.empty()) {
+    std::cerr << usage << std::endl;
+    return -1;
+  }
+
+  tensorflow::GetStepTraceResponse response;
+  tensorflow::Status s = tensorflow::ReadBinaryProto(
+      tensorflow::Env::Default(), input, &response);
+  if (!s.ok()) {
+    s = tensorflow::ReadTextProto(tensorflow::Env::Default(), input,
+                                  &response);
+  }
+  if (!s.ok()) {
+    std::cerr << "ERROR: could not read " << input << ": " << s << std::endl;
+    return -1;
+  }
+
+  std::vector<tensorflow::StepTraceSummary> summaries;
+  for (const tensorflow::StepTrace& trace : response.step_trace()) {
+    tensorflow::StepTraceSummary summary;
+    s = tensorflow::SummarizeStepTrace(trace, top_recvs, &summary);
+    if (!s.ok()) {
+      std::cerr << "Skipping step " << trace.step_id() << ": " << s
+                << std::endl;
+      continue;
+    }
+    summaries.push_back(std::move(summary));
+  }
+  std::cout << tensorflow::StepTraceReport(summaries);
+  return 0;
+}
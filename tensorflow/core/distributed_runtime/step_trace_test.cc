@@ -0,0 +1,193 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/step_trace.h"
+
+#include "tensorflow/core/distributed_runtime/step_trace_report.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+StepTraceEvent MakeEvent(StepTraceEvent::Type type, const string& task,
+                         int64 start_micros, int64 end_micros) {
+  StepTraceEvent event;
+  event.set_type(type);
+  event.set_task(task);
+  event.set_partition(-1);
+  event.set_start_micros(start_micros);
+  event.set_end_micros(end_micros);
+  return event;
+}
+
+StepTrace MakeTrace(int64 step_id) {
+  StepTrace trace;
+  trace.set_step_id(step_id);
+  *trace.add_event() =
+      MakeEvent(StepTraceEvent::RUN_GRAPH, "/job:worker/task:0", 0, 10);
+  return trace;
+}
+
+TEST(StepTraceCollectorTest, ExtractTakesEventsOnce) {
+  StepTraceCollector collector;
+  collector.Record(1, MakeEvent(StepTraceEvent::RECV_TENSOR_WAIT, "a", 0, 1));
+  collector.Record(2, MakeEvent(StepTraceEvent::RECV_TENSOR_WAIT, "a", 0, 2));
+  collector.Record(1, MakeEvent(StepTraceEvent::RECV_TENSOR_WAIT, "a", 1, 3));
+
+  protobuf::RepeatedPtrField<StepTraceEvent> events;
+  collector.Extract(1, &events);
+  ASSERT_EQ(2, events.size());
+  EXPECT_EQ(1, events.Get(0).end_micros());
+  EXPECT_EQ(3, events.Get(1).end_micros());
+
+  events.Clear();
+  collector.Extract(1, &events);
+  EXPECT_EQ(0, events.size());
+
+  collector.Cleanup(2);
+  collector.Extract(2, &events);
+  EXPECT_EQ(0, events.size());
+}
+
+TEST(StepTraceCollectorTest, DropsEventsBeyondLimits) {
+  StepTraceCollector collector(/*max_events_per_step=*/2,
+                               /*max_pending_steps=*/1);
+  for (int i = 0; i < 5; ++i) {
+    collector.Record(1, MakeEvent(StepTraceEvent::RECV_TENSOR_WAIT, "a", i, i));
+  }
+  collector.Record(2, MakeEvent(StepTraceEvent::RECV_TENSOR_WAIT, "a", 0, 0));
+
+  protobuf::RepeatedPtrField<StepTraceEvent> events;
+  collector.Extract(1, &events);
+  EXPECT_EQ(2, events.size());
+  events.Clear();
+  collector.Extract(2, &events);
+  EXPECT_EQ(0, events.size());
+}
+
+TEST(StepTraceRingTest, KeepsMostRecentTraces) {
+  StepTraceRing ring(3);
+  for (int64 step_id = 1; step_id <= 5; ++step_id) {
+    ring.Add(MakeTrace(step_id));
+  }
+
+  StepTrace trace;
+  EXPECT_FALSE(ring.Get(2, &trace));
+  EXPECT_TRUE(ring.Get(4, &trace));
+  EXPECT_EQ(4, trace.step_id());
+
+  protobuf::RepeatedPtrField<StepTrace> recent;
+  ring.GetRecent(0, &recent);
+  ASSERT_EQ(3, recent.size());
+  EXPECT_EQ(3, recent.Get(0).step_id());
+  EXPECT_EQ(4, recent.Get(1).step_id());
+  EXPECT_EQ(5, recent.Get(2).step_id());
+
+  recent.Clear();
+  ring.GetRecent(2, &recent);
+  ASSERT_EQ(2, recent.size());
+  EXPECT_EQ(4, recent.Get(0).step_id());
+  EXPECT_EQ(5, recent.Get(1).step_id());
+}
+
+TEST(StepTraceRingTest, PartiallyFilled) {
+  StepTraceRing ring(4);
+  ring.Add(MakeTrace(7));
+  ring.Add(MakeTrace(8));
+
+  protobuf::RepeatedPtrField<StepTrace> recent;
+  ring.GetRecent(0, &recent);
+  ASSERT_EQ(2, recent.size());
+  EXPECT_EQ(7, recent.Get(0).step_id());
+  EXPECT_EQ(8, recent.Get(1).step_id());
+}
+
+TEST(StepTraceRingTest, ZeroCapacity) {
+  StepTraceRing ring(0);
+  ring.Add(MakeTrace(1));
+  StepTrace trace;
+  EXPECT_FALSE(ring.Get(1, &trace));
+}
+
+TEST(StepTraceReportTest, FindsCriticalPartition) {
+  const string kFast = "/job:worker/replica:0/task:0";
+  const string kSlow = "/job:worker/replica:0/task:1";
+  StepTrace trace;
+  trace.set_step_id(42);
+  StepTraceEvent* run_fast = trace.add_event();
+  *run_fast = MakeEvent(StepTraceEvent::RUN_GRAPH, kFast, 100, 200);
+  run_fast->set_partition(0);
+  StepTraceEvent* run_slow = trace.add_event();
+  *run_slow = MakeEvent(StepTraceEvent::RUN_GRAPH, kSlow, 110, 500);
+  run_slow->set_partition(1);
+  // Two overlapping recvs on the slow task and one on the fast task.
+  *trace.add_event() =
+      MakeEvent(StepTraceEvent::RECV_TENSOR_WAIT, kSlow, 120, 300);
+  *trace.add_event() =
+      MakeEvent(StepTraceEvent::RECV_TENSOR_TRANSFER, kSlow, 300, 320);
+  *trace.add_event() =
+      MakeEvent(StepTraceEvent::RECV_TENSOR_WAIT, kSlow, 200, 350);
+  *trace.add_event() =
+      MakeEvent(StepTraceEvent::RECV_TENSOR_TRANSFER, kSlow, 350, 360);
+  *trace.add_event() =
+      MakeEvent(StepTraceEvent::RECV_TENSOR_WAIT, kFast, 100, 190);
+
+  StepTraceSummary summary;
+  TF_ASSERT_OK(SummarizeStepTrace(trace, 2, &summary));
+  EXPECT_EQ(42, summary.step_id);
+  EXPECT_EQ(400, summary.step_micros);
+  EXPECT_EQ(kSlow, summary.critical_task);
+  EXPECT_EQ(1, summary.critical_partition);
+  EXPECT_EQ(390, summary.critical_run_graph_micros);
+  EXPECT_EQ(230, summary.critical_recv_wait_micros);
+  EXPECT_EQ(30, summary.critical_recv_transfer_micros);
+  ASSERT_EQ(2, summary.slowest_recvs.size());
+  EXPECT_EQ(120, summary.slowest_recvs[0].start_micros());
+  EXPECT_EQ(200, summary.slowest_recvs[1].start_micros());
+
+  const string report = StepTraceReport({summary});
+  EXPECT_TRUE(str_util::StrContains(report, "step 42: 400 us"));
+  EXPECT_TRUE(str_util::StrContains(report, kSlow));
+}
+
+TEST(StepTraceReportTest, NoRunGraphEvents) {
+  StepTrace trace;
+  *trace.add_event() =
+      MakeEvent(StepTraceEvent::RECV_TENSOR_WAIT, "a", 100, 190);
+  StepTraceSummary summary;
+  EXPECT_FALSE(SummarizeStepTrace(trace, 1, &summary).ok());
+}
+
+static void BM_StepTraceCollectorRecord(int iters) {
+  StepTraceCollector collector;
+  const StepTraceEvent event =
+      MakeEvent(StepTraceEvent::RECV_TENSOR_TRANSFER, "/job:worker/task:0",
+                0, 10);
+  protobuf::RepeatedPtrField<StepTraceEvent> events;
+  for (int i = 0; i < iters; ++i) {
+    collector.Record(i / 64, event);
+    if (i % 64 == 63) {
+      events.Clear();
+      collector.Extract(i / 64, &events);
+    }
+  }
+}
+BENCHMARK(BM_StepTraceCollectorRecord);
+
+}  // namespace
+}  // namespace tensorflow
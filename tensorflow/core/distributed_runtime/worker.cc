@@ -21,6 +21,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/scoped_allocator_mgr.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
 #include "tensorflow/core/distributed_runtime/rendezvous_mgr_interface.h"
+#include "tensorflow/core/distributed_runtime/step_trace.h"
 #include "tensorflow/core/distributed_runtime/tensor_coding.h"
 #include "tensorflow/core/distributed_runtime/worker_session.h"
 #include "tensorflow/core/platform/tracing.h"
@@ -213,11 +214,13 @@ void Worker::DoRunGraph(CallOptions* opts, RunGraphRequestWrapper* request,
     done(errors::Aborted("Call was aborted"));
     return;
   }
+  const bool record_step_trace = request->exec_opts().record_step_trace();
   session->graph_mgr->ExecuteAsync(
       request->graph_handle(), step_id, session.get(), request->exec_opts(),
       collector, response, cm, in,
       [this, step_id, response, session, cm, out, token, collector,
-       profiler_session, opts, done](const Status& status) {
+       profiler_session, record_step_trace, opts,
+       done](const Status& status) {
         Status s = status;
         if (s.ok()) {
           s = session->graph_mgr->RecvOutputs(step_id, out);
@@ -241,6 +244,11 @@ void Worker::DoRunGraph(CallOptions* opts, RunGraphRequestWrapper* request,
           }
         }
 
+        if (record_step_trace && env_->step_trace_collector) {
+          env_->step_trace_collector->Extract(
+              step_id, response->mutable_step_trace_events());
+        }
+
         if (collector) collector->Finalize();
         delete collector;
         delete profiler_session;
@@ -345,6 +353,9 @@ void Worker::CleanupGraphAsync(const CleanupGraphRequest* request,
                                StatusCallback done) {
   const int64 step_id = request->step_id();
   env_->rendezvous_mgr->Cleanup(step_id);
+  if (env_->step_trace_collector) {
+    env_->step_trace_collector->Cleanup(step_id);
+  }
   if (env_->collective_executor_mgr) {
     env_->collective_executor_mgr->Cleanup(step_id);
   }
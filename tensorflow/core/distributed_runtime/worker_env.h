@@ -31,6 +31,7 @@ class DeviceMgr;
 class Env;
 class RendezvousMgrInterface;
 class SessionMgr;
+class StepTraceCollector;
 
 // The worker environment class, which holds a bag of pointers to
 // per-worker singletons.
@@ -64,6 +65,11 @@ struct WorkerEnv {
 
   // A pool of threads for scheduling compute work.
   thread::ThreadPool* compute_pool = nullptr;
+
+  // Buffers per-step timing events (e.g. RecvTensor waits) until they are
+  // returned to the master. May be null, in which case no events are
+  // recorded.
+  StepTraceCollector* step_trace_collector = nullptr;
 };
 
 }  // end namespace tensorflow
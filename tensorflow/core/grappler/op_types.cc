@@ -235,6 +235,8 @@ bool IsExit(const NodeDef& node) {
 
 bool IsExp(const NodeDef& node) { return node.op() == "Exp"; }
 
+bool IsExpandDims(const NodeDef& node) { return node.op() == "ExpandDims"; }
+
 bool IsFakeParam(const NodeDef& node) { return node.op() == "FakeParam"; }
 
 bool IsFill(const NodeDef& node) { return node.op() == "Fill"; }
@@ -255,6 +257,8 @@ bool IsFusedBatchNormGrad(const NodeDef& node) {
          op == "FusedBatchNormGradV3";
 }
 
+bool IsGatherV2(const NodeDef& node) { return node.op() == "GatherV2"; }
+
 bool IsGreater(const NodeDef& node) { return node.op() == "Greater"; }
 
 bool IsGreaterEqual(const NodeDef& node) { return node.op() == "GreaterEqual"; }
@@ -426,6 +430,10 @@ bool IsRelu6Grad(const NodeDef& node) { return node.op() == "Relu6Grad"; }
 
 bool IsReshape(const NodeDef& node) { return (node.op() == "Reshape"); }
 
+bool IsResizeBilinear(const NodeDef& node) {
+  return node.op() == "ResizeBilinear";
+}
+
 bool IsRestore(const NodeDef& node) {
   return (node.op() == "Restore" || node.op() == "RestoreV2" ||
           node.op() == "RestoreSlice");
@@ -0,0 +1,387 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/collective_bucketing_optimizer.h"
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/grappler/utils/frame.h"
+#include "tensorflow/core/grappler/utils/topological_sort.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+constexpr int64 kDefaultBucketBytes = 4 << 20;
+
+// The CollectiveReduce nodes, one per device, that share an instance_key.
+struct CollectiveInstance {
+  int64 instance_key = 0;
+  // Attributes and devices that must match for two instances to be bucketed
+  // together.
+  string signature;
+  DataType dtype = DT_INVALID;
+  std::vector<int32> dims;
+  int64 num_elements = -1;
+  int64 bytes = 0;
+  // Rank of the instance in topological order, by its first node.
+  int rank = 0;
+  // Highest rank of any instance that an input of one of our nodes depends on,
+  // or -1 if there is none.
+  int input_ancestor = -1;
+  bool eligible = true;
+  // Sorted by device once all nodes have been collected.
+  std::vector<NodeDef*> nodes;
+};
+
+// Returns the attributes of a CollectiveReduce node that must match for it to
+// share a bucket, or an empty string if the node cannot be bucketed.
+string AttrSignature(const NodeDef& node) {
+  DataType dtype;
+  int group_size;
+  int group_key;
+  string merge_op;
+  string final_op;
+  std::vector<int32> subdiv_offsets;
+  if (!GetNodeAttr(node, "T", &dtype).ok() ||
+      !GetNodeAttr(node, "group_size", &group_size).ok() ||
+      !GetNodeAttr(node, "group_key", &group_key).ok() ||
+      !GetNodeAttr(node, "merge_op", &merge_op).ok() ||
+      !GetNodeAttr(node, "final_op", &final_op).ok() ||
+      !GetNodeAttr(node, "subdiv_offsets", &subdiv_offsets).ok()) {
+    return "";
+  }
+  // Explicit ordering between collectives would not survive the rewrite.
+  std::vector<int32> wait_for;
+  if (GetNodeAttr(node, "wait_for", &wait_for).ok() && !wait_for.empty()) {
+    return "";
+  }
+  return strings::StrCat(DataTypeString(dtype), ";", group_key, ";",
+                         group_size, ";", merge_op, ";", final_op, ";",
+                         str_util::Join(subdiv_offsets, ","));
+}
+
+class BucketRewriter {
+ public:
+  explicit BucketRewriter(GraphDef* graph) : graph_(graph) {
+    for (const NodeDef& node : graph->node()) names_.insert(node.name());
+  }
+
+  // Replaces the nodes of `bucket` placed on the `device_index`-th device of
+  // the bucket with a single CollectiveReduce of their concatenation.
+  void Rewrite(const std::vector<CollectiveInstance*>& bucket,
+               int device_index) {
+    const NodeDef& first = *bucket[0]->nodes[device_index];
+    const string& device = first.device();
+    const DataType dtype = bucket[0]->dtype;
+    const string prefix = strings::StrCat(first.name(), "/CollectiveBucket");
+
+    const NodeDef* flat_shape =
+        AddInt32Const(strings::StrCat(prefix, "/flat_shape"), device, {-1},
+                      /*scalar=*/false);
+    const NodeDef* axis = AddInt32Const(strings::StrCat(prefix, "/axis"),
+                                        device, {0}, /*scalar=*/true);
+
+    NodeDef* concat = AddNode(strings::StrCat(prefix, "/concat"), "ConcatV2",
+                              device);
+    std::vector<int32> sizes;
+    std::vector<string> control_inputs;
+    for (int i = 0; i < bucket.size(); ++i) {
+      const NodeDef& member = *bucket[i]->nodes[device_index];
+      NodeDef* flatten = AddNode(strings::StrCat(prefix, "/flatten_", i),
+                                 "Reshape", device);
+      flatten->add_input(member.input(0));
+      flatten->add_input(flat_shape->name());
+      SetTypeAttr("T", dtype, flatten);
+      SetTypeAttr("Tshape", DT_INT32, flatten);
+      concat->add_input(flatten->name());
+      for (int j = 1; j < member.input_size(); ++j) {
+        if (IsControlInput(member.input(j))) {
+          control_inputs.push_back(member.input(j));
+        }
+      }
+      sizes.push_back(static_cast<int32>(bucket[i]->num_elements));
+    }
+    concat->add_input(axis->name());
+    for (const string& control_input : control_inputs) {
+      concat->add_input(control_input);
+    }
+    DedupControlInputs(concat);
+    (*concat->mutable_attr())["N"].set_i(bucket.size());
+    SetTypeAttr("T", dtype, concat);
+    SetTypeAttr("Tidx", DT_INT32, concat);
+
+    // The bucket takes over the first member's instance_key, which is free
+    // once that member has been rewritten.
+    NodeDef* reduce = graph_->add_node();
+    *reduce = first;
+    reduce->set_name(UniqueName(strings::StrCat(prefix, "/reduce")));
+    reduce->clear_input();
+    reduce->add_input(concat->name());
+
+    const NodeDef* split_sizes = AddInt32Const(
+        strings::StrCat(prefix, "/split_sizes"), device, sizes,
+        /*scalar=*/false);
+    NodeDef* split =
+        AddNode(strings::StrCat(prefix, "/split"), "SplitV", device);
+    split->add_input(reduce->name());
+    split->add_input(split_sizes->name());
+    split->add_input(axis->name());
+    (*split->mutable_attr())["num_split"].set_i(bucket.size());
+    SetTypeAttr("T", dtype, split);
+    SetTypeAttr("Tlen", DT_INT32, split);
+
+    for (int i = 0; i < bucket.size(); ++i) {
+      NodeDef* member = bucket[i]->nodes[device_index];
+      const NodeDef* shape = AddInt32Const(
+          strings::StrCat(member->name(), "/CollectiveBucket/shape"), device,
+          bucket[i]->dims, /*scalar=*/false);
+      member->set_op("Reshape");
+      member->clear_input();
+      member->add_input(strings::StrCat(split->name(), ":", i));
+      member->add_input(shape->name());
+      member->clear_attr();
+      SetTypeAttr("T", dtype, member);
+      SetTypeAttr("Tshape", DT_INT32, member);
+    }
+  }
+
+ private:
+  string UniqueName(const string& base) {
+    string name = base;
+    for (int i = 1; !names_.insert(name).second; ++i) {
+      name = strings::StrCat(base, "_", i);
+    }
+    return name;
+  }
+
+  NodeDef* AddNode(const string& name, const string& op,
+                   const string& device) {
+    NodeDef* node = graph_->add_node();
+    node->set_name(UniqueName(name));
+    node->set_op(op);
+    node->set_device(device);
+    return node;
+  }
+
+  NodeDef* AddInt32Const(const string& name, const string& device,
+                         const std::vector<int32>& values, bool scalar) {
+    NodeDef* node = AddNode(name, "Const", device);
+    SetTypeAttr("dtype", DT_INT32, node);
+    Tensor tensor(DT_INT32, scalar ? TensorShape({})
+                                   : TensorShape({static_cast<int64>(
+                                         values.size())}));
+    for (int i = 0; i < values.size(); ++i) {
+      tensor.flat<int32>()(i) = values[i];
+    }
+    tensor.AsProtoTensorContent(
+        (*node->mutable_attr())["value"].mutable_tensor());
+    return node;
+  }
+
+  static void SetTypeAttr(const string& attr, DataType dtype, NodeDef* node) {
+    (*node->mutable_attr())[attr].set_type(dtype);
+  }
+
+  GraphDef* graph_;
+  std::unordered_set<string> names_;
+};
+
+}  // namespace
+
+CollectiveBucketingOptimizer::CollectiveBucketingOptimizer()
+    : bucket_bytes_(kDefaultBucketBytes) {}
+
+CollectiveBucketingOptimizer::CollectiveBucketingOptimizer(
+    RewriterConfig::Toggle opt_level, const CollectiveBucketingOptions& opts)
+    : bucket_bytes_(opts.bucket_bytes() > 0 ? opts.bucket_bytes()
+                                            : kDefaultBucketBytes) {}
+
+Status CollectiveBucketingOptimizer::Optimize(Cluster* cluster,
+                                              const GrapplerItem& item,
+                                              GraphDef* optimized_graph) {
+  int num_collectives = 0;
+  for (const NodeDef& node : item.graph.node()) {
+    if (node.op() == "CollectiveReduce") ++num_collectives;
+  }
+  if (num_collectives < 2) {
+    return errors::Aborted("Nothing to do.");
+  }
+
+  *optimized_graph = item.graph;
+  GraphProperties properties(item);
+  TF_RETURN_IF_ERROR(properties.InferStatically(/*assume_valid_feeds=*/false));
+  FrameView frame_view;
+  TF_RETURN_IF_ERROR(frame_view.InferFromGraph(*optimized_graph));
+  std::vector<const NodeDef*> topo_order;
+  TF_RETURN_IF_ERROR(ComputeTopologicalOrder(*optimized_graph, &topo_order));
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+
+  std::unordered_map<string, NodeDef*> nodes_by_name;
+  for (NodeDef& node : *optimized_graph->mutable_node()) {
+    nodes_by_name[node.name()] = &node;
+  }
+
+  // Group the CollectiveReduce nodes into instances, ranked by the position
+  // of their first node in topological order.
+  std::map<int64, CollectiveInstance> instances;
+  std::vector<CollectiveInstance*> ranked;
+  std::unordered_map<const NodeDef*, CollectiveInstance*> instance_of;
+  for (const NodeDef* node : topo_order) {
+    if (node->op() != "CollectiveReduce") continue;
+    int64 instance_key;
+    if (!GetNodeAttr(*node, "instance_key", &instance_key).ok()) continue;
+    auto inserted = instances.emplace(instance_key, CollectiveInstance());
+    CollectiveInstance* instance = &inserted.first->second;
+    if (inserted.second) {
+      instance->instance_key = instance_key;
+      instance->rank = ranked.size();
+      instance->signature = AttrSignature(*node);
+      ranked.push_back(instance);
+    }
+    instance->nodes.push_back(nodes_by_name[node->name()]);
+    instance_of[node] = instance;
+
+    if (instance->signature.empty() ||
+        AttrSignature(*node) != instance->signature ||
+        node->input_size() == 0 || IsControlInput(node->input(0)) ||
+        frame_view.IsInFrame(*node) || nodes_to_preserve.count(node->name()) ||
+        !properties.HasOutputProperties(node->name())) {
+      instance->eligible = false;
+      continue;
+    }
+    const OpInfo::TensorProperties& output =
+        properties.GetOutputProperties(node->name())[0];
+    const PartialTensorShape shape(output.shape());
+    if (!shape.IsFullyDefined() ||
+        (instance->num_elements >= 0 &&
+         shape.num_elements() != instance->num_elements)) {
+      instance->eligible = false;
+      continue;
+    }
+    instance->dtype = output.dtype();
+    instance->num_elements = shape.num_elements();
+    instance->dims.assign(shape.dim_sizes().begin(), shape.dim_sizes().end());
+  }
+
+  for (CollectiveInstance* instance : ranked) {
+    if (!instance->eligible) continue;
+    std::sort(instance->nodes.begin(), instance->nodes.end(),
+              [](const NodeDef* a, const NodeDef* b) {
+                return a->device() < b->device();
+              });
+    std::vector<string> devices;
+    for (const NodeDef* node : instance->nodes) {
+      if (!devices.empty() && devices.back() == node->device()) {
+        instance->eligible = false;
+      }
+      devices.push_back(node->device());
+    }
+    instance->bytes = instance->num_elements * DataTypeSize(instance->dtype);
+    if (instance->bytes >= bucket_bytes_) instance->eligible = false;
+    strings::StrAppend(&instance->signature, ";",
+                       str_util::Join(devices, ","));
+  }
+
+  // Propagate, in topological order, the highest rank of any instance each
+  // node depends on.
+  std::unordered_map<string, int> ancestor;
+  for (const NodeDef* node : topo_order) {
+    int rank = -1;
+    for (const string& input : node->input()) {
+      auto it = ancestor.find(NodeName(input));
+      if (it != ancestor.end()) rank = std::max(rank, it->second);
+    }
+    auto it = instance_of.find(node);
+    if (it != instance_of.end()) {
+      CollectiveInstance* instance = it->second;
+      instance->input_ancestor = std::max(instance->input_ancestor, rank);
+      rank = std::max(rank, instance->rank);
+    }
+    if (rank >= 0) ancestor[node->name()] = rank;
+  }
+
+  // Fill one open bucket per signature in rank order. A bucket is closed when
+  // the next instance would overflow it, or depends on an instance ranked at
+  // or after the start of the bucket. The latter keeps every dependency
+  // between buckets pointing from an earlier to a later starting rank, so the
+  // rewritten graph is acyclic.
+  struct OpenBucket {
+    int start_rank;
+    int64 bytes;
+    std::vector<CollectiveInstance*> members;
+  };
+  std::map<string, OpenBucket> open_buckets;
+  std::vector<std::vector<CollectiveInstance*>> buckets;
+  auto close_bucket = [&](std::map<string, OpenBucket>::iterator it) {
+    if (it->second.members.size() > 1) {
+      buckets.push_back(std::move(it->second.members));
+    }
+    open_buckets.erase(it);
+  };
+  for (CollectiveInstance* instance : ranked) {
+    if (!instance->eligible) continue;
+    auto it = open_buckets.find(instance->signature);
+    if (it != open_buckets.end() &&
+        (it->second.bytes + instance->bytes > bucket_bytes_ ||
+         instance->input_ancestor >= it->second.start_rank)) {
+      close_bucket(it);
+      it = open_buckets.end();
+    }
+    if (it == open_buckets.end()) {
+      it = open_buckets
+               .emplace(instance->signature,
+                        OpenBucket{instance->rank, 0, {}})
+               .first;
+    }
+    it->second.bytes += instance->bytes;
+    it->second.members.push_back(instance);
+  }
+  while (!open_buckets.empty()) close_bucket(open_buckets.begin());
+
+  if (buckets.empty()) {
+    return errors::Aborted("Nothing to do.");
+  }
+  BucketRewriter rewriter(optimized_graph);
+  for (const auto& bucket : buckets) {
+    VLOG(2) << "Bucketing " << bucket.size()
+            << " CollectiveReduce instances starting at instance_key "
+            << bucket[0]->instance_key;
+    for (int d = 0; d < bucket[0]->nodes.size(); ++d) {
+      rewriter.Rewrite(bucket, d);
+    }
+  }
+  return Status::OK();
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
@@ -0,0 +1,62 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_COLLECTIVE_BUCKETING_OPTIMIZER_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_COLLECTIVE_BUCKETING_OPTIMIZER_H_
+
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Packs small CollectiveReduce ops into size-bounded buckets.
+//
+// CollectiveReduce instances (the nodes, one per device, sharing an
+// instance_key) with identical attributes and devices are visited in
+// topological order, which for gradients is the order backprop produces them,
+// and appended to a bucket until it would exceed the byte limit. On every
+// device, the members of a bucket are then flattened and concatenated, reduced
+// by a single CollectiveReduce that reuses the first member's instance_key,
+// and split back into the original shapes. The reduction of a bucket is thus
+// issued as soon as its last member is computed.
+//
+// Every rewritten member keeps its name, now a Reshape of the bucket output,
+// so that consumers need not be updated. A member is never added to a bucket
+// whose earlier members it depends on, so the rewrite cannot create cycles.
+class CollectiveBucketingOptimizer : public GraphOptimizer {
+ public:
+  CollectiveBucketingOptimizer();
+  CollectiveBucketingOptimizer(RewriterConfig::Toggle opt_level,
+                               const CollectiveBucketingOptions& opts);
+
+  ~CollectiveBucketingOptimizer() override {}
+
+  string name() const override { return "collective_bucketing_optimizer"; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimized_graph, double result) override {}
+
+ private:
+  int64 bucket_bytes_;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_COLLECTIVE_BUCKETING_OPTIMIZER_H_
@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/remapper.h"
 
 #include "absl/container/flat_hash_set.h"
+#include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
 #include "tensorflow/core/grappler/graph_view.h"
@@ -42,10 +43,19 @@ namespace grappler {
 //
 // Both Conv2D and MatMul implemented as Tensor contraction (on CPU), so all the
 // patterns are "ContractionWith...".
+//
+// GatherV2 + ... -> _FusedEmbeddingLookupSparse:
+//   (1) GatherV2 + [Mul] + SparseSegment{Sum,Mean,SqrtN}
+//
+// DecodeAndCropJpeg + ... -> _DecodeAndCropAndResizeJpeg (AGGRESSIVE only):
+//   (1) DecodeAndCropJpeg + ExpandDims + ResizeBilinear
 namespace {
 
 constexpr char kFusedConv2D[] = "_FusedConv2D";
 constexpr char kFusedMatMul[] = "_FusedMatMul";
+constexpr char kFusedEmbeddingLookupSparse[] = "_FusedEmbeddingLookupSparse";
+constexpr char kDecodeAndCropJpeg[] = "DecodeAndCropJpeg";
+constexpr char kDecodeAndCropAndResizeJpeg[] = "_DecodeAndCropAndResizeJpeg";
 
 constexpr char kDataFormat[] = "data_format";
 constexpr char kIsTraining[] = "is_training";
@@ -149,6 +159,36 @@ struct ContractionWithBatchNormAndActivation {
   float epsilon = 0.0;
 };
 
+// GatherV2 of embedding rows, optionally weighted with a Mul, reduced by a
+// SparseSegment{Sum,Mean,SqrtN}.
+struct EmbeddingLookupSparse {
+  EmbeddingLookupSparse() = default;
+  EmbeddingLookupSparse(const NodeDef* gather, const NodeDef* mul,
+                        int weights_port, const NodeDef* segment_reduction)
+      : gather(gather),
+        mul(mul),
+        weights_port(weights_port),
+        segment_reduction(segment_reduction) {}
+
+  const NodeDef* gather = nullptr;
+  const NodeDef* mul = nullptr;  // nullptr if the rows are not weighted
+  int weights_port = -1;         // Mul input holding the weights
+  const NodeDef* segment_reduction = nullptr;
+};
+
+// DecodeAndCropJpeg of a single image, batched with ExpandDims and resized
+// with ResizeBilinear, as tf.image.resize_images does for 3-D images.
+struct DecodeAndCropAndResizeJpeg {
+  DecodeAndCropAndResizeJpeg() = default;
+  DecodeAndCropAndResizeJpeg(const NodeDef* decode, const NodeDef* expand_dims,
+                             const NodeDef* resize)
+      : decode(decode), expand_dims(expand_dims), resize(resize) {}
+
+  const NodeDef* decode = nullptr;
+  const NodeDef* expand_dims = nullptr;
+  const NodeDef* resize = nullptr;
+};
+
 bool IsInPreserveSet(const RemapperContext& ctx, const NodeDef* node) {
   return ctx.nodes_to_preserve.count(node->name()) > 0;
 }
@@ -532,6 +572,180 @@ bool FindFusedBatchNorm(const RemapperContext& ctx, const NodeDef* node,
   return true;
 }
 
+// Returns the combiner of the fused embedding lookup matching the given
+// SparseSegment reduction, or nullptr if the node is not one.
+const char* EmbeddingCombiner(const NodeDef& node) {
+  if (node.op() == "SparseSegmentSum") return "sum";
+  if (node.op() == "SparseSegmentMean") return "mean";
+  if (node.op() == "SparseSegmentSqrtN") return "sqrtn";
+  return nullptr;
+}
+
+bool IsEmbeddingLookupSparseCandidate(const NodeDef& node) {
+  if (EmbeddingCombiner(node) == nullptr || !NodeIsOnCpu(&node)) return false;
+  const DataType dtype = GetDataTypeFromAttr(node, "T");
+  if (dtype != DT_FLOAT && dtype != DT_DOUBLE) return false;
+  // Only int32 indices are supported by the CPU kernels.
+  const DataType index_type = GetDataTypeFromAttr(node, "Tidx");
+  return index_type == DT_INT32 || index_type == DT_INVALID;
+}
+
+// Returns true if the gathered rows of `gather` can be scaled by `weights` in
+// the fused kernel, i.e. the Mul broadcasts one weight per gathered row. The
+// number of weights must be known to be the number of gathered rows, since
+// the fused kernel reads one weight per row without the Mul's shape checks.
+bool IsRowWeights(const RemapperContext& ctx, const NodeDef* gather,
+                  const OpInfo::TensorProperties& weights) {
+  const auto& gather_props =
+      ctx.graph_properties.GetOutputProperties(gather->name());
+  if (gather_props.empty()) return false;
+  const TensorShapeProto& rows_shape = gather_props[0].shape();
+  const TensorShapeProto& weights_shape = weights.shape();
+  if (Rank(rows_shape) < 1 || Rank(weights_shape) != Rank(rows_shape)) {
+    return false;
+  }
+  // Unknown dimensions are -1, and symbolic ones, which are equal if they are
+  // the same, are less than -1.
+  const int64 num_rows = rows_shape.dim(0).size();
+  if (num_rows == -1 || weights_shape.dim(0).size() != num_rows) {
+    return false;
+  }
+  for (int d = 1; d < weights_shape.dim_size(); ++d) {
+    if (weights_shape.dim(d).size() != 1) return false;
+  }
+  return true;
+}
+
+bool FindEmbeddingLookupSparse(const RemapperContext& ctx,
+                               const NodeDef* segment_reduction,
+                               EmbeddingLookupSparse* matched) {
+  // Root of the pattern must be a SparseSegment reduction on CPU.
+  if (segment_reduction == nullptr ||
+      !IsEmbeddingLookupSparseCandidate(*segment_reduction) ||
+      HasControlFaninOrFanout(ctx.graph_view, segment_reduction))
+    return false;
+
+  // Its data is either the gathered rows, or the gathered rows times weights.
+  const auto data = ctx.graph_view.GetRegularFanin(
+      GraphView::InputPort(segment_reduction, 0));
+  if (data.node == nullptr || data.port_id != 0) return false;
+
+  const NodeDef* mul = nullptr;
+  const NodeDef* gather = nullptr;
+  int weights_port = -1;
+  if (IsMul(*data.node)) {
+    mul = data.node;
+    if (!HaveSameDataType(mul, segment_reduction) ||
+        HasControlFaninOrFanout(ctx.graph_view, mul) ||
+        !HasSingleFanoutNode(ctx.graph_view, mul) ||
+        IsInPreserveSet(ctx, mul))
+      return false;
+    for (int port = 0; port < 2 && gather == nullptr; ++port) {
+      const auto fanin =
+          ctx.graph_view.GetRegularFanin(GraphView::InputPort(mul, port));
+      if (fanin.node != nullptr && IsGatherV2(*fanin.node)) {
+        gather = fanin.node;
+        weights_port = 1 - port;
+      }
+    }
+  } else if (IsGatherV2(*data.node)) {
+    gather = data.node;
+  }
+  if (gather == nullptr ||
+      GetDataTypeFromAttr(*gather, "Tparams") !=
+          GetDataTypeFromAttr(*segment_reduction, "T") ||
+      HasControlFaninOrFanout(ctx.graph_view, gather) ||
+      !HasSingleFanoutNode(ctx.graph_view, gather) ||
+      IsInPreserveSet(ctx, gather) || !NodeIsOnCpu(gather))
+    return false;
+
+  // The gather must select whole rows: batch_dims = 0, axis = 0 and a vector
+  // of ids.
+  const auto& gather_attr = gather->attr();
+  if (gather_attr.count("batch_dims") > 0 &&
+      gather_attr.at("batch_dims").i() != 0)
+    return false;
+  const auto& gather_props =
+      ctx.graph_properties.GetInputProperties(gather->name());
+  if (gather_props.size() != 3 || Rank(gather_props[1].shape()) != 1 ||
+      !gather_props[2].has_value())
+    return false;
+  Tensor axis;
+  if (!axis.FromProto(gather_props[2].value()) || axis.NumElements() != 1)
+    return false;
+  const int64 axis_value = axis.dtype() == DT_INT32
+                               ? axis.flat<int32>()(0)
+                               : axis.flat<int64>()(0);
+  if (axis_value != 0) return false;
+
+  if (mul != nullptr) {
+    const auto& mul_props =
+        ctx.graph_properties.GetInputProperties(mul->name());
+    if (mul_props.size() != 2 ||
+        !IsRowWeights(ctx, gather, mul_props[weights_port]))
+      return false;
+  }
+
+  // We successfully found a GatherV2+[Mul]+SparseSegment reduction pattern.
+  *matched = EmbeddingLookupSparse(gather, mul, weights_port,
+                                   segment_reduction);
+  return true;
+}
+
+// Returns true if `node` is a Const holding the single value `value`.
+bool IsConstantScalarValue(const NodeDef* node, int64 value) {
+  if (node == nullptr || !IsConstant(*node)) return false;
+  Tensor tensor;
+  if (!tensor.FromProto(node->attr().at("value").tensor()) ||
+      tensor.NumElements() != 1)
+    return false;
+  if (tensor.dtype() == DT_INT32) return tensor.flat<int32>()(0) == value;
+  if (tensor.dtype() == DT_INT64) return tensor.flat<int64>()(0) == value;
+  return false;
+}
+
+bool FindDecodeAndCropAndResizeJpeg(const RemapperContext& ctx,
+                                    const NodeDef* resize,
+                                    DecodeAndCropAndResizeJpeg* matched) {
+  // Root of the pattern must be a ResizeBilinear of uint8 images on CPU.
+  if (resize == nullptr || !IsResizeBilinear(*resize) ||
+      !NodeIsOnCpu(resize) || !HasDataType(resize, DT_UINT8) ||
+      HasControlFaninOrFanout(ctx.graph_view, resize))
+    return false;
+
+  // Its input is the decoded image, expanded into a batch of one.
+  const auto expand_dims =
+      ctx.graph_view.GetRegularFanin(GraphView::InputPort(resize, 0));
+  if (expand_dims.node == nullptr || !IsExpandDims(*expand_dims.node) ||
+      HasControlFaninOrFanout(ctx.graph_view, expand_dims.node) ||
+      !HasSingleFanoutNode(ctx.graph_view, expand_dims.node) ||
+      IsInPreserveSet(ctx, expand_dims.node))
+    return false;
+  const auto axis = ctx.graph_view.GetRegularFanin(
+      GraphView::InputPort(expand_dims.node, 1));
+  if (!IsConstantScalarValue(axis.node, 0)) return false;
+
+  // The image is decoded at full scale; a DecodeAndCropJpeg with its own
+  // ratio is left alone.
+  const auto decode = ctx.graph_view.GetRegularFanin(
+      GraphView::InputPort(expand_dims.node, 0));
+  if (decode.node == nullptr || decode.node->op() != kDecodeAndCropJpeg ||
+      !NodeIsOnCpu(decode.node) ||
+      HasControlFaninOrFanout(ctx.graph_view, decode.node) ||
+      !HasSingleFanoutNode(ctx.graph_view, decode.node) ||
+      IsInPreserveSet(ctx, decode.node))
+    return false;
+  const auto& decode_attr = decode.node->attr();
+  if (decode_attr.count("ratio") > 0 && decode_attr.at("ratio").i() != 1)
+    return false;
+
+  // We successfully found a DecodeAndCropJpeg+ExpandDims+ResizeBilinear
+  // pattern.
+  *matched =
+      DecodeAndCropAndResizeJpeg(decode.node, expand_dims.node, resize);
+  return true;
+}
+
 void CopyConv2DAttributes(const NodeDef* conv2d, NodeDef* fused_conv2d) {
   DCHECK(IsConv2D(*conv2d)) << "Input node must be a Conv2D";
 
@@ -729,6 +943,72 @@ void AddFusedConv2DNode(
   invalidated_nodes->insert(matched.contraction);
 }
 
+void AddFusedEmbeddingLookupSparseNode(
+    const EmbeddingLookupSparse& matched, GraphDef* optimized_graph,
+    absl::flat_hash_set<const NodeDef*>* invalidated_nodes) {
+  const NodeDef* segment_reduction = matched.segment_reduction;
+  VLOG(2) << "Fuse GatherV2 with " << segment_reduction->op() << ":"
+          << " segment_reduction=" << segment_reduction->name()
+          << " mul=" << (matched.mul ? matched.mul->name() : "<none>")
+          << " gather=" << matched.gather->name();
+
+  NodeDef* fused_op = optimized_graph->add_node();
+  fused_op->set_name(segment_reduction->name());
+  fused_op->set_op(kFusedEmbeddingLookupSparse);
+  fused_op->set_device(segment_reduction->device());
+  fused_op->add_input(matched.gather->input(0));     // 0: params
+  fused_op->add_input(matched.gather->input(1));     // 1: ids
+  fused_op->add_input(segment_reduction->input(1));  // 2: indices
+  fused_op->add_input(segment_reduction->input(2));  // 3: segment_ids
+  if (matched.mul != nullptr) {
+    fused_op->add_input(matched.mul->input(matched.weights_port));  // weights
+  }
+
+  auto* attr = fused_op->mutable_attr();
+  (*attr)["T"] = segment_reduction->attr().at("T");
+  (*attr)["Tids"] = matched.gather->attr().at("Tindices");
+  SetAttrValue(matched.mul != nullptr ? 1 : 0, &(*attr)["num_weights"]);
+  SetAttrValue(EmbeddingCombiner(*segment_reduction), &(*attr)["combiner"]);
+
+  invalidated_nodes->insert(segment_reduction);
+  if (matched.mul != nullptr) invalidated_nodes->insert(matched.mul);
+  invalidated_nodes->insert(matched.gather);
+}
+
+void AddDecodeAndCropAndResizeJpegNode(
+    const DecodeAndCropAndResizeJpeg& matched, GraphDef* optimized_graph,
+    absl::flat_hash_set<const NodeDef*>* invalidated_nodes) {
+  const NodeDef* resize = matched.resize;
+  VLOG(2) << "Fuse " << kDecodeAndCropJpeg << " with ResizeBilinear:"
+          << " resize=" << resize->name()
+          << " expand_dims=" << matched.expand_dims->name()
+          << " decode=" << matched.decode->name();
+
+  NodeDef* fused_op = optimized_graph->add_node();
+  fused_op->set_name(resize->name());
+  fused_op->set_op(kDecodeAndCropAndResizeJpeg);
+  fused_op->set_device(resize->device());
+  fused_op->add_input(matched.decode->input(0));  // 0: contents
+  fused_op->add_input(matched.decode->input(1));  // 1: crop_window
+  fused_op->add_input(resize->input(1));          // 2: size
+
+  auto* attr = fused_op->mutable_attr();
+  const auto& decode_attr = matched.decode->attr();
+  for (const char* name : {"channels", "fancy_upscaling",
+                           "try_recover_truncated", "acceptable_fraction",
+                           "dct_method"}) {
+    if (decode_attr.count(name) > 0) (*attr)[name] = decode_attr.at(name);
+  }
+  const auto& resize_attr = resize->attr();
+  for (const char* name : {"align_corners", "half_pixel_centers"}) {
+    if (resize_attr.count(name) > 0) (*attr)[name] = resize_attr.at(name);
+  }
+
+  invalidated_nodes->insert(resize);
+  invalidated_nodes->insert(matched.expand_dims);
+  invalidated_nodes->insert(matched.decode);
+}
+
 void AddBatchNormNodes(const FusedBatchNorm& matched,
                        GraphDef* optimized_graph) {
   const NodeDef& fused_node = *matched.fused_batch_norm;
@@ -878,6 +1158,8 @@ Status Remapper::Optimize(Cluster* /*cluster*/, const GrapplerItem& item,
   // Supported graph patterns.
   // clang-format off
   FusedBatchNorm                        fused_batch_norm;
+  EmbeddingLookupSparse                 embedding_lookup_sparse;
+  DecodeAndCropAndResizeJpeg            decode_and_crop_and_resize_jpeg;
   ContractionWithBiasAdd                contract_with_bias;
   ContractionWithBiasAddAndActivation   contract_with_bias_and_activation;
 #ifndef INTEL_MKL
@@ -901,9 +1183,9 @@ Status Remapper::Optimize(Cluster* /*cluster*/, const GrapplerItem& item,
   // and Activation nodes that were fused into a Conv2D node.
   absl::flat_hash_set<const NodeDef*> invalidated_nodes;
 
-  // _FusedMatMul and _FusedConv2D kernels do not have registered gradient
-  // function, so we must not perform rewrite if the graph will be
-  // differentiated later.
+  // _FusedMatMul, _FusedConv2D and _FusedEmbeddingLookupSparse kernels do not
+  // have registered gradient function, so we must not perform rewrite if the
+  // graph will be differentiated later.
   bool allow_non_differentiable_rewrites =
       item.optimization_options().allow_non_differentiable_rewrites;
 
@@ -964,11 +1246,35 @@ Status Remapper::Optimize(Cluster* /*cluster*/, const GrapplerItem& item,
 #endif  // !INTEL_MKL
 
     // Infer properties lazily in case they are not needed.
-    if (!ctx.inferred_graph_properties && IsFusedBatchNormCandidate(node)) {
+    if (!ctx.inferred_graph_properties &&
+        (IsFusedBatchNormCandidate(node) ||
+         (allow_non_differentiable_rewrites &&
+          IsEmbeddingLookupSparseCandidate(node)))) {
       TF_RETURN_IF_ERROR(ctx.graph_properties.InferStatically(false));
       ctx.inferred_graph_properties = true;
     }
 
+    // Remap GatherV2+[Mul]+SparseSegment{Sum,Mean,SqrtN} into the
+    // _FusedEmbeddingLookupSparse.
+    if (allow_non_differentiable_rewrites &&
+        FindEmbeddingLookupSparse(ctx, &node, &embedding_lookup_sparse)) {
+      AddFusedEmbeddingLookupSparseNode(embedding_lookup_sparse,
+                                        optimized_graph, &invalidated_nodes);
+      continue;
+    }
+
+    // Remap DecodeAndCropJpeg+ExpandDims+ResizeBilinear into the
+    // _DecodeAndCropAndResizeJpeg. The fused kernel decodes at a reduced DCT
+    // scale when the crop is much larger than the target size, which changes
+    // the resized pixels slightly, so this is only done in aggressive mode.
+    if (opt_level_ == RewriterConfig::AGGRESSIVE &&
+        FindDecodeAndCropAndResizeJpeg(ctx, &node,
+                                       &decode_and_crop_and_resize_jpeg)) {
+      AddDecodeAndCropAndResizeJpegNode(decode_and_crop_and_resize_jpeg,
+                                        optimized_graph, &invalidated_nodes);
+      continue;
+    }
+
     // During inference, most of the inputs to FusedBatchNorm are constant, and
     // we can therefore replace the op with a much cheaper set of primitives.
     if (FindFusedBatchNorm(ctx, &node, &fused_batch_norm)) {
@@ -634,5 +634,214 @@ TEST_F(RemapperTest, FuseConv2DWithSqueezeAndBias) {
   test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-6);
 }
 
+TEST_F(RemapperTest, FuseEmbeddingLookupSparse) {
+  using ::tensorflow::ops::Placeholder;
+
+  for (const string& combiner : {"sum", "mean", "sqrtn"}) {
+    for (const bool weighted : {false, true}) {
+      tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+      auto params = Placeholder(s.WithOpName("params"), DT_FLOAT,
+                                Placeholder::Shape({16, 8}));
+      auto ids =
+          Placeholder(s.WithOpName("ids"), DT_INT64, Placeholder::Shape({6}));
+      auto weights = Placeholder(s.WithOpName("weights"), DT_FLOAT,
+                                 Placeholder::Shape({6, 1}));
+      auto indices = ops::Const(s.WithOpName("indices"), {0, 1, 2, 3, 4, 5});
+      auto segment_ids =
+          ops::Const(s.WithOpName("segment_ids"), {0, 0, 2, 2, 2, 3});
+      auto axis = ops::Const(s.WithOpName("axis"), 0);
+
+      auto gather = ops::GatherV2(s.WithOpName("gather"), params, ids, axis);
+      Output data = gather;
+      if (weighted) data = ops::Mul(s.WithOpName("mul"), weights, gather);
+
+      Output reduction;
+      if (combiner == "sum") {
+        reduction = ops::SparseSegmentSum(s.WithOpName("reduction"), data,
+                                          indices, segment_ids);
+      } else if (combiner == "mean") {
+        reduction = ops::SparseSegmentMean(s.WithOpName("reduction"), data,
+                                           indices, segment_ids);
+      } else {
+        reduction = ops::SparseSegmentSqrtN(s.WithOpName("reduction"), data,
+                                            indices, segment_ids);
+      }
+      auto fetch = ops::Identity(s.WithOpName("fetch"), reduction);
+
+      auto params_t = GenerateRandomTensor<DT_FLOAT>({16, 8});
+      auto weights_t = GenerateRandomTensor<DT_FLOAT>({6, 1});
+      auto ids_t = test::AsTensor<int64>({3, 15, 0, 3, 7, 9});
+
+      GrapplerItem item;
+      item.fetch = {"fetch"};
+      item.feed = {{"params", params_t}, {"ids", ids_t}};
+      if (weighted) item.feed.emplace_back("weights", weights_t);
+      TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+      // Place all nodes on CPU.
+      for (int i = 0; i < item.graph.node_size(); ++i) {
+        item.graph.mutable_node(i)->set_device("/device:CPU:0");
+      }
+
+      Remapper optimizer(RewriterConfig::ON);
+      GraphDef output;
+      TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+      int found = 0;
+      for (const NodeDef& node : output.node()) {
+        EXPECT_NE("gather", node.name());
+        EXPECT_NE("mul", node.name());
+        if (node.name() == "reduction") {
+          EXPECT_EQ("_FusedEmbeddingLookupSparse", node.op());
+          ASSERT_EQ(weighted ? 5 : 4, node.input_size());
+          EXPECT_EQ("params", node.input(0));
+          EXPECT_EQ("ids", node.input(1));
+          EXPECT_EQ("indices", node.input(2));
+          EXPECT_EQ("segment_ids", node.input(3));
+          if (weighted) EXPECT_EQ("weights", node.input(4));
+          EXPECT_EQ(weighted ? 1 : 0, node.attr().at("num_weights").i());
+          EXPECT_EQ(combiner, node.attr().at("combiner").s());
+          found++;
+        }
+      }
+      EXPECT_EQ(1, found);
+
+      auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+      auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+      EXPECT_EQ(1, tensors_expected.size());
+      EXPECT_EQ(1, tensors.size());
+      test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-6);
+    }
+  }
+}
+
+TEST_F(RemapperTest, DoNotFuseEmbeddingLookupSparseWithUnsupportedWeights) {
+  using ::tensorflow::ops::Placeholder;
+
+  for (const PartialTensorShape& weights_shape : {
+           // Weights broadcast along the embedding dimension, not per row.
+           PartialTensorShape({8}),
+           // One weight broadcast over all gathered rows.
+           PartialTensorShape({1, 1}),
+           // Not known to be one weight per gathered row.
+           PartialTensorShape({-1, 1}),
+       }) {
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+    auto params = Placeholder(s.WithOpName("params"), DT_FLOAT,
+                              Placeholder::Shape({16, 8}));
+    auto ids =
+        Placeholder(s.WithOpName("ids"), DT_INT32, Placeholder::Shape({6}));
+    auto weights = Placeholder(s.WithOpName("weights"), DT_FLOAT,
+                               Placeholder::Shape(weights_shape));
+    auto indices = ops::Const(s.WithOpName("indices"), {0, 1, 2, 3, 4, 5});
+    auto segment_ids =
+        ops::Const(s.WithOpName("segment_ids"), {0, 0, 1, 1, 1, 1});
+    auto axis = ops::Const(s.WithOpName("axis"), 0);
+
+    auto gather = ops::GatherV2(s.WithOpName("gather"), params, ids, axis);
+    auto mul = ops::Mul(s.WithOpName("mul"), gather, weights);
+    auto reduction = ops::SparseSegmentSum(s.WithOpName("reduction"), mul,
+                                           indices, segment_ids);
+    auto fetch = ops::Identity(s.WithOpName("fetch"), reduction);
+
+    GrapplerItem item;
+    item.fetch = {"fetch"};
+    TF_CHECK_OK(s.ToGraphDef(&item.graph));
+    for (int i = 0; i < item.graph.node_size(); ++i) {
+      item.graph.mutable_node(i)->set_device("/device:CPU:0");
+    }
+
+    Remapper optimizer(RewriterConfig::ON);
+    GraphDef output;
+    TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+    for (const NodeDef& node : output.node()) {
+      EXPECT_NE("_FusedEmbeddingLookupSparse", node.op())
+          << weights_shape.DebugString();
+    }
+  }
+}
+
+// Builds DecodeAndCropJpeg + ExpandDims + ResizeBilinear on a JPEG encoded
+// from the "image" placeholder, with all nodes placed on CPU.
+GrapplerItem DecodeAndCropAndResizeJpegItem() {
+  using ::tensorflow::ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto image = Placeholder(s.WithOpName("image"), DT_UINT8,
+                           Placeholder::Shape({32, 48, 3}));
+  auto contents = ops::EncodeJpeg(s.WithOpName("contents"), image);
+  auto crop_window = ops::Const(s.WithOpName("crop_window"), {4, 8, 20, 24});
+  auto size = ops::Const(s.WithOpName("size"), {16, 16});
+  auto axis = ops::Const(s.WithOpName("axis"), 0);
+
+  auto decode = ops::DecodeAndCropJpeg(
+      s.WithOpName("decode"), contents, crop_window,
+      ops::DecodeAndCropJpeg::Channels(3));
+  auto expand_dims = ops::ExpandDims(s.WithOpName("expand_dims"), decode, axis);
+  auto resize =
+      ops::ResizeBilinear(s.WithOpName("resize"), expand_dims, size,
+                          ops::ResizeBilinear::HalfPixelCenters(true));
+  auto fetch = ops::Identity(s.WithOpName("fetch"), resize);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+  return item;
+}
+
+TEST_F(RemapperTest, FuseDecodeAndCropAndResizeJpeg) {
+  GrapplerItem item = DecodeAndCropAndResizeJpegItem();
+  auto image_t = GenerateRandomTensor<DT_UINT8>({32, 48, 3});
+  item.feed = {{"image", image_t}};
+
+  Remapper optimizer(RewriterConfig::AGGRESSIVE);
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE("decode", node.name());
+    EXPECT_NE("expand_dims", node.name());
+    if (node.name() == "resize") {
+      EXPECT_EQ("_DecodeAndCropAndResizeJpeg", node.op());
+      ASSERT_EQ(3, node.input_size());
+      EXPECT_EQ("contents", node.input(0));
+      EXPECT_EQ("crop_window", node.input(1));
+      EXPECT_EQ("size", node.input(2));
+      EXPECT_EQ(3, node.attr().at("channels").i());
+      EXPECT_TRUE(node.attr().at("half_pixel_centers").b());
+      found++;
+    }
+  }
+  EXPECT_EQ(1, found);
+
+  // The crop window is smaller than twice the target size, so the image is
+  // decoded at full scale and the fused op matches the original graph.
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  EXPECT_EQ(1, tensors_expected.size());
+  EXPECT_EQ(1, tensors.size());
+  test::ExpectTensorEqual<float>(tensors_expected[0], tensors[0]);
+}
+
+TEST_F(RemapperTest, DoNotFuseDecodeAndCropAndResizeJpegByDefault) {
+  GrapplerItem item = DecodeAndCropAndResizeJpegItem();
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE("_DecodeAndCropAndResizeJpeg", node.op());
+  }
+}
+
 }  // namespace grappler
 }  // namespace tensorflow
@@ -19,8 +19,10 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/crop_and_resize_op.h"
 
+#include <algorithm>
 #include <functional>
 #include <string>
+#include <vector>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/bounds_check.h"
@@ -103,6 +105,13 @@ inline void RunIfBoxIndexIsValid<CPUDevice>(
   }
 }
 
+// Source columns and weight of one crop column, as offsets into an image row.
+struct CachedInterpolation {
+  int64 left;
+  int64 right;
+  float lerp;
+};
+
 }  // namespace
 
 template <typename Device, typename T>
@@ -216,9 +225,24 @@ struct CropAndResize<CPUDevice, T> {
     const int crop_width = crops.dimension(2);
     const int depth = crops.dimension(3);
 
-    // Sharding across boxes.
-    auto CropAndResizePerBox = [&](int start_box, int limit_box) {
-      for (int b = start_box; b < limit_box; ++b) {
+    const bool bilinear = method_name == "bilinear";
+    const int64 row_size = static_cast<int64>(crop_width) * depth;
+    const int64 image_row_size = static_cast<int64>(image_width) * depth;
+    const int64 image_size = image_height * image_row_size;
+
+    // Sharding across the rows of all boxes, so that a few large crops are
+    // spread over the threads as well as many small ones. Unit i is row
+    // i % crop_height of box i / crop_height.
+    auto CropAndResizePerRow = [&](int64 start_row, int64 limit_row) {
+      // Per-column source offsets and weights of the current box, shared by
+      // all of its rows in this shard. For "nearest", `left` is the closest
+      // column. A negative `left` marks a column to extrapolate.
+      std::vector<CachedInterpolation> xs(crop_width);
+      int current_box = -1;
+      for (int64 row = start_row; row < limit_row; ++row) {
+        const int b = row / crop_height;
+        const int y = row % crop_height;
+        float* crop_row = crops.data() + row * row_size;
         const float y1 = boxes(b, 0);
         const float x1 = boxes(b, 1);
         const float y2 = boxes(b, 2);
@@ -233,80 +257,88 @@ struct CropAndResize<CPUDevice, T> {
             (crop_height > 1)
                 ? (y2 - y1) * (image_height - 1) / (crop_height - 1)
                 : 0;
-        const float width_scale =
-            (crop_width > 1) ? (x2 - x1) * (image_width - 1) / (crop_width - 1)
-                             : 0;
-
-        for (int y = 0; y < crop_height; ++y) {
-          const float in_y = (crop_height > 1)
-                                 ? y1 * (image_height - 1) + y * height_scale
-                                 : 0.5 * (y1 + y2) * (image_height - 1);
-          if (in_y < 0 || in_y > image_height - 1) {
-            for (int x = 0; x < crop_width; ++x) {
-              for (int d = 0; d < depth; ++d) {
-                crops(b, y, x, d) = extrapolation_value;
-              }
+        if (b != current_box) {
+          current_box = b;
+          const float width_scale =
+              (crop_width > 1)
+                  ? (x2 - x1) * (image_width - 1) / (crop_width - 1)
+                  : 0;
+          for (int x = 0; x < crop_width; ++x) {
+            const float in_x = (crop_width > 1)
+                                   ? x1 * (image_width - 1) + x * width_scale
+                                   : 0.5 * (x1 + x2) * (image_width - 1);
+            if (in_x < 0 || in_x > image_width - 1) {
+              xs[x].left = -1;
+            } else if (bilinear) {
+              const int left_x_index = floorf(in_x);
+              xs[x].left = left_x_index * depth;
+              xs[x].right = static_cast<int64>(ceilf(in_x)) * depth;
+              xs[x].lerp = in_x - left_x_index;
+            } else {
+              xs[x].left = static_cast<int64>(roundf(in_x)) * depth;
             }
-            continue;
           }
-          if (method_name == "bilinear") {
-            const int top_y_index = floorf(in_y);
-            const int bottom_y_index = ceilf(in_y);
-            const float y_lerp = in_y - top_y_index;
-
-            for (int x = 0; x < crop_width; ++x) {
-              const float in_x = (crop_width > 1)
-                                     ? x1 * (image_width - 1) + x * width_scale
-                                     : 0.5 * (x1 + x2) * (image_width - 1);
-              if (in_x < 0 || in_x > image_width - 1) {
-                for (int d = 0; d < depth; ++d) {
-                  crops(b, y, x, d) = extrapolation_value;
-                }
-                continue;
-              }
-              const int left_x_index = floorf(in_x);
-              const int right_x_index = ceilf(in_x);
-              const float x_lerp = in_x - left_x_index;
+        }
 
-              for (int d = 0; d < depth; ++d) {
-                const float top_left(static_cast<float>(
-                    image(b_in, top_y_index, left_x_index, d)));
-                const float top_right(static_cast<float>(
-                    image(b_in, top_y_index, right_x_index, d)));
-                const float bottom_left(static_cast<float>(
-                    image(b_in, bottom_y_index, left_x_index, d)));
-                const float bottom_right(static_cast<float>(
-                    image(b_in, bottom_y_index, right_x_index, d)));
-                const float top = top_left + (top_right - top_left) * x_lerp;
-                const float bottom =
-                    bottom_left + (bottom_right - bottom_left) * x_lerp;
-                crops(b, y, x, d) = top + (bottom - top) * y_lerp;
-              }
+        const float in_y = (crop_height > 1)
+                               ? y1 * (image_height - 1) + y * height_scale
+                               : 0.5 * (y1 + y2) * (image_height - 1);
+        if (in_y < 0 || in_y > image_height - 1) {
+          std::fill_n(crop_row, row_size, extrapolation_value);
+          continue;
+        }
+        const T* image_b = image.data() + b_in * image_size;
+        if (bilinear) {
+          const int top_y_index = floorf(in_y);
+          const int bottom_y_index = ceilf(in_y);
+          const float y_lerp = in_y - top_y_index;
+          const T* top_row = image_b + top_y_index * image_row_size;
+          const T* bottom_row = image_b + bottom_y_index * image_row_size;
+
+          for (int x = 0; x < crop_width; ++x) {
+            float* crop = crop_row + x * depth;
+            if (xs[x].left < 0) {
+              std::fill_n(crop, depth, extrapolation_value);
+              continue;
             }
-          } else {  // method == "nearest"
-            for (int x = 0; x < crop_width; ++x) {
-              const float in_x = (crop_width > 1)
-                                     ? x1 * (image_width - 1) + x * width_scale
-                                     : 0.5 * (x1 + x2) * (image_width - 1);
-              if (in_x < 0 || in_x > image_width - 1) {
-                for (int d = 0; d < depth; ++d) {
-                  crops(b, y, x, d) = extrapolation_value;
-                }
-                continue;
-              }
-              const int closest_x_index = roundf(in_x);
-              const int closest_y_index = roundf(in_y);
-              for (int d = 0; d < depth; ++d) {
-                crops(b, y, x, d) = static_cast<float>(
-                    image(b_in, closest_y_index, closest_x_index, d));
-              }
+            const T* top_left_ptr = top_row + xs[x].left;
+            const T* top_right_ptr = top_row + xs[x].right;
+            const T* bottom_left_ptr = bottom_row + xs[x].left;
+            const T* bottom_right_ptr = bottom_row + xs[x].right;
+            const float x_lerp = xs[x].lerp;
+            // Depth is contiguous in the image and the crop, so this loop
+            // vectorizes.
+            for (int d = 0; d < depth; ++d) {
+              const float top_left(static_cast<float>(top_left_ptr[d]));
+              const float top_right(static_cast<float>(top_right_ptr[d]));
+              const float bottom_left(static_cast<float>(bottom_left_ptr[d]));
+              const float bottom_right(
+                  static_cast<float>(bottom_right_ptr[d]));
+              const float top = top_left + (top_right - top_left) * x_lerp;
+              const float bottom =
+                  bottom_left + (bottom_right - bottom_left) * x_lerp;
+              crop[d] = top + (bottom - top) * y_lerp;
+            }
+          }
+        } else {  // method == "nearest"
+          const int closest_y_index = roundf(in_y);
+          const T* closest_row = image_b + closest_y_index * image_row_size;
+          for (int x = 0; x < crop_width; ++x) {
+            float* crop = crop_row + x * depth;
+            if (xs[x].left < 0) {
+              std::fill_n(crop, depth, extrapolation_value);
+              continue;
+            }
+            const T* closest = closest_row + xs[x].left;
+            for (int d = 0; d < depth; ++d) {
+              crop[d] = static_cast<float>(closest[d]);
             }
           }
         }
       }
     };
 
-    // A rough estimation of the cost for each cropped box.
+    // A rough estimation of the cost for each cropped pixel.
     double cost_per_pixel =
         depth * (Eigen::TensorOpCost::AddCost<float>() * 6 +
                  Eigen::TensorOpCost::MulCost<float>() * 3 +
@@ -318,12 +350,13 @@ struct CropAndResize<CPUDevice, T> {
                        Eigen::TensorOpCost::AddCost<float>() * 4 +
                        Eigen::TensorOpCost::MulCost<float>() * 4;
     }
-    const double cost_per_box = crop_height * crop_width * cost_per_pixel;
+    const double cost_per_row = crop_width * cost_per_pixel;
 
     const DeviceBase::CpuWorkerThreads& worker_threads =
         *(context->device()->tensorflow_cpu_worker_threads());
-    Shard(worker_threads.num_threads, worker_threads.workers, num_boxes,
-          cost_per_box, CropAndResizePerBox);
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          static_cast<int64>(num_boxes) * crop_height, cost_per_row,
+          CropAndResizePerRow);
 
     return true;
   }
@@ -512,7 +545,7 @@ struct CropAndResizeBackpropImage<CPUDevice, T> {
       }
     };
 
-    // A rough estimation of the cost for each cropped box.
+    // A rough estimation of the cost for each cropped pixel.
     // Including calculation cost in the depth loop and pixel loop.
     const double cost_per_pixel =
         (method_name == "bilinear"
@@ -69,4 +69,54 @@ BM_CropAndResizeDev(cpu, 1, 640, 640, 3, 512, 512);
 BM_CropAndResizeDev(cpu, 1, 640, 640, 1, 512, 512);
 BM_CropAndResizeDev(cpu, 1, 80, 80, 512, 7, 7);
 
+// Crops `num_boxes` boxes spread over a [1, height, width, depth] feature map
+// or image, like the ROI crops of two-stage detectors.
+static Graph* BM_CropAndResizeBoxes(int num_boxes, int width, int height,
+                                    int depth, int crop_height,
+                                    int crop_width) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor in(DT_FLOAT, TensorShape({1, height, width, depth}));
+  in.flat<float>().setRandom();
+  Tensor boxes(DT_FLOAT, TensorShape({num_boxes, 4}));
+  auto boxes_tensor = boxes.matrix<float>();
+  Tensor box_ind(DT_INT32, TensorShape({num_boxes}));
+  auto box_ind_flat = box_ind.flat<int32>();
+  for (int i = 0; i < num_boxes; ++i) {
+    const float offset = 0.5f * (i % 17) / 17;
+    boxes_tensor(i, 0) = offset;
+    boxes_tensor(i, 1) = 0.5f - offset;
+    boxes_tensor(i, 2) = offset + 0.3f;
+    boxes_tensor(i, 3) = 0.9f - offset;
+    box_ind_flat(i) = 0;
+  }
+  Tensor crop_size(DT_INT32, TensorShape({2}));
+  auto crop_size_flat = crop_size.flat<int32>();
+  crop_size_flat(0) = crop_height;
+  crop_size_flat(1) = crop_width;
+  Node* ret;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "CropAndResize")
+                  .Input(test::graph::Constant(g, in))
+                  .Input(test::graph::Constant(g, boxes))
+                  .Input(test::graph::Constant(g, box_ind))
+                  .Input(test::graph::Constant(g, crop_size))
+                  .Finalize(g, &ret));
+  return g;
+}
+
+#define BM_CropAndResizeBoxesDev(DEVICE, N, W, H, D, CH, CW)                \
+  static void BM_CropBoxes_##DEVICE##_##N##_##W##_##H##_##D##_##CH##_##CW(  \
+      int iters) {                                                          \
+    testing::ItemsProcessed(static_cast<int64>(iters) * N * CH * CW * D);   \
+    test::Benchmark(#DEVICE, BM_CropAndResizeBoxes(N, W, H, D, CH, CW))     \
+        .Run(iters);                                                        \
+  }                                                                         \
+  BENCHMARK(BM_CropBoxes_##DEVICE##_##N##_##W##_##H##_##D##_##CH##_##CW);
+
+// Faster R-CNN and Mask R-CNN ROI crops from a stride-16 feature map, and a
+// few large crops of an input image.
+BM_CropAndResizeBoxesDev(cpu, 300, 64, 38, 1024, 14, 14);
+BM_CropAndResizeBoxesDev(cpu, 100, 64, 38, 1024, 7, 7);
+BM_CropAndResizeBoxesDev(cpu, 1000, 64, 38, 256, 14, 14);
+BM_CropAndResizeBoxesDev(cpu, 4, 1024, 600, 3, 300, 300);
+
 }  // namespace tensorflow
@@ -0,0 +1,227 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Implements DecodeAndCropJpeg followed by ResizeBilinear as a single kernel:
+//
+//   DecodeAndCropJpeg(contents, crop_window) -> ExpandDims -> ResizeBilinear
+//
+// When the crop window is at least twice the target size, the JPEG is decoded
+// with libjpeg DCT scaling (1/2, 1/4 or 1/8), so most of the full resolution
+// IDCT and color conversion work is skipped, and only the scaled crop window
+// is resized to the target size. Otherwise the result is the same as the
+// unfused graph. The remapper grappler optimizer rewrites the pattern above
+// into this op.
+//
+// Currently supported only on CPU device.
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <limits>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/bounds_check.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/image_resizer_state.h"
+#include "tensorflow/core/kernels/resize_bilinear_op.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/jpeg/jpeg_mem.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+// Returns the largest libjpeg scaling denominator that still decodes the crop
+// window to at least the target size, so that the resize never upsamples an
+// image that was decoded smaller than necessary.
+int DctScalingRatio(int crop_height, int crop_width, int out_height,
+                    int out_width) {
+  for (int ratio : {8, 4, 2}) {
+    if (crop_height >= static_cast<int64>(out_height) * ratio &&
+        crop_width >= static_cast<int64>(out_width) * ratio) {
+      return ratio;
+    }
+  }
+  return 1;
+}
+
+class DecodeAndCropAndResizeJpegOp : public OpKernel {
+ public:
+  explicit DecodeAndCropAndResizeJpegOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    int channels;
+    OP_REQUIRES_OK(context, context->GetAttr("channels", &channels));
+    OP_REQUIRES(context, channels == 0 || channels == 1 || channels == 3,
+                errors::InvalidArgument(
+                    "channels must be 0, 1, or 3 for JPEG, got ", channels));
+    flags_.components = channels;
+    flags_.crop = true;
+
+    OP_REQUIRES_OK(context, context->GetAttr("fancy_upscaling",
+                                             &flags_.fancy_upscaling));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("try_recover_truncated",
+                                    &flags_.try_recover_truncated_jpeg));
+    OP_REQUIRES_OK(context, context->GetAttr("acceptable_fraction",
+                                             &flags_.min_acceptable_fraction));
+
+    // Same default as DecodeJpeg.
+    flags_.dct_method = JDCT_IFAST;
+    string dct_method;
+    OP_REQUIRES_OK(context, context->GetAttr("dct_method", &dct_method));
+    OP_REQUIRES(
+        context,
+        (dct_method.empty() || dct_method == "INTEGER_FAST" ||
+         dct_method == "INTEGER_ACCURATE"),
+        errors::InvalidArgument("dct_method must be one of "
+                                "{'', 'INTEGER_FAST', 'INTEGER_ACCURATE'}"));
+    if (dct_method == "INTEGER_ACCURATE") {
+      flags_.dct_method = JDCT_ISLOW;
+    }
+
+    OP_REQUIRES_OK(context, context->GetAttr("align_corners", &align_corners_));
+    OP_REQUIRES_OK(context, context->GetAttr("half_pixel_centers",
+                                             &half_pixel_centers_));
+    OP_REQUIRES(context, !(align_corners_ && half_pixel_centers_),
+                errors::InvalidArgument("If half_pixel_centers is True, "
+                                        "align_corners must be False."));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& contents = context->input(0);
+    const Tensor& crop_window = context->input(1);
+    const Tensor& size = context->input(2);
+    OP_REQUIRES(context, TensorShapeUtils::IsScalar(contents.shape()),
+                errors::InvalidArgument("contents must be scalar, got shape ",
+                                        contents.shape().DebugString()));
+    OP_REQUIRES(context,
+                crop_window.dims() == 1 && crop_window.dim_size(0) == 4,
+                errors::InvalidArgument(
+                    "crop_window must be a vector of four elements, got ",
+                    crop_window.shape().DebugString()));
+    OP_REQUIRES(context, size.dims() == 1 && size.dim_size(0) == 2,
+                errors::InvalidArgument(
+                    "size must be a vector of two elements, got ",
+                    size.shape().DebugString()));
+
+    const StringPiece input = contents.scalar<string>()();
+    OP_REQUIRES(context, input.size() <= std::numeric_limits<int>::max(),
+                errors::InvalidArgument("JPEG contents are too large for int: ",
+                                        input.size()));
+
+    const auto size_vec = size.vec<int32>();
+    const int out_height = internal::SubtleMustCopy(size_vec(0));
+    const int out_width = internal::SubtleMustCopy(size_vec(1));
+    OP_REQUIRES(context, out_height > 0 && out_width > 0,
+                errors::InvalidArgument("output dimensions must be positive"));
+
+    int width;
+    int height;
+    int components;
+    OP_REQUIRES(context,
+                jpeg::GetImageInfo(input.data(), input.size(), &width, &height,
+                                   &components),
+                errors::InvalidArgument("Invalid JPEG data, size ",
+                                        input.size()));
+
+    const auto crop_window_vec = crop_window.vec<int32>();
+    const int crop_y = internal::SubtleMustCopy(crop_window_vec(0));
+    const int crop_x = internal::SubtleMustCopy(crop_window_vec(1));
+    const int crop_height = internal::SubtleMustCopy(crop_window_vec(2));
+    const int crop_width = internal::SubtleMustCopy(crop_window_vec(3));
+    OP_REQUIRES(
+        context,
+        crop_height > 0 && crop_width > 0 && crop_y >= 0 && crop_x >= 0 &&
+            crop_y <= height - crop_height && crop_x <= width - crop_width,
+        errors::InvalidArgument("Invalid crop window: y=", crop_y,
+                                ", x=", crop_x, ", h=", crop_height,
+                                ", w=", crop_width, " for image height ",
+                                height, " and width ", width));
+
+    // Use local copy of flags to avoid race condition as the class member is
+    // shared among different invocations.
+    jpeg::UncompressFlags flags = flags_;
+    flags.ratio = DctScalingRatio(crop_height, crop_width, out_height,
+                                  out_width);
+    // libjpeg scales the whole image to ceil(size / ratio). Map the crop
+    // window into the scaled image, rounding it outwards.
+    const int ratio = flags.ratio;
+    const int scaled_height = (height + ratio - 1) / ratio;
+    const int scaled_width = (width + ratio - 1) / ratio;
+    flags.crop_y = crop_y / ratio;
+    flags.crop_x = crop_x / ratio;
+    flags.crop_height =
+        std::min(scaled_height, (crop_y + crop_height + ratio - 1) / ratio) -
+        flags.crop_y;
+    flags.crop_width =
+        std::min(scaled_width, (crop_x + crop_width + ratio - 1) / ratio) -
+        flags.crop_x;
+
+    // Decode the crop window into a temporary, allocated once the size is
+    // known.
+    Tensor decoded;
+    OP_REQUIRES(
+        context,
+        jpeg::Uncompress(
+            input.data(), input.size(), flags, nullptr /* nwarn */,
+            [context, &decoded](int decoded_width, int decoded_height,
+                                int channels) -> uint8* {
+              Status status(context->allocate_temp(
+                  DT_UINT8,
+                  TensorShape({1, decoded_height, decoded_width, channels}),
+                  &decoded));
+              if (!status.ok()) {
+                VLOG(1) << status;
+                context->SetStatus(status);
+                return nullptr;
+              }
+              return decoded.flat<uint8>().data();
+            }),
+        errors::InvalidArgument("Invalid JPEG data or crop window, data size ",
+                                input.size()));
+
+    const Tensor& image = decoded;
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0,
+                                TensorShape({1, out_height, out_width,
+                                             image.dim_size(3)}),
+                                &output));
+    const float height_scale =
+        CalculateResizeScale(image.dim_size(1), out_height, align_corners_);
+    const float width_scale =
+        CalculateResizeScale(image.dim_size(2), out_width, align_corners_);
+    functor::ResizeBilinearCpu<uint8>(
+        context->eigen_device<CPUDevice>(), image.tensor<uint8, 4>(),
+        height_scale, width_scale, half_pixel_centers_,
+        output->tensor<float, 4>());
+  }
+
+ private:
+  jpeg::UncompressFlags flags_;
+  bool align_corners_;
+  bool half_pixel_centers_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("_DecodeAndCropAndResizeJpeg").Device(DEVICE_CPU),
+                        DecodeAndCropAndResizeJpegOp);
+
+}  // namespace
+}  // namespace tensorflow
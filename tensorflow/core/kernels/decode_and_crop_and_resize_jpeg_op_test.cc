@@ -0,0 +1,210 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/jpeg/jpeg_mem.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns a JPEG encoded RGB image whose channels are smooth ramps, so that
+// different decode scales and resampling methods agree closely.
+string EncodedImage(int height, int width) {
+  std::vector<uint8> pixels(height * width * 3);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint8* pixel = &pixels[(y * width + x) * 3];
+      pixel[0] = 255 * x / width;
+      pixel[1] = 255 * y / height;
+      pixel[2] = 255 * (x + y) / (width + height);
+    }
+  }
+  jpeg::CompressFlags flags;
+  flags.format = jpeg::FORMAT_RGB;
+  flags.quality = 95;
+  return jpeg::Compress(pixels.data(), width, height, flags);
+}
+
+// Decodes `contents` at full scale, cropped to the given window.
+std::vector<uint8> DecodeCrop(const string& contents, int crop_y, int crop_x,
+                              int crop_height, int crop_width) {
+  jpeg::UncompressFlags flags;
+  flags.components = 3;
+  flags.dct_method = JDCT_IFAST;
+  flags.crop = true;
+  flags.crop_y = crop_y;
+  flags.crop_x = crop_x;
+  flags.crop_height = crop_height;
+  flags.crop_width = crop_width;
+  int width, height, components;
+  std::unique_ptr<uint8[]> data(jpeg::Uncompress(
+      contents.data(), contents.size(), flags, &width, &height, &components,
+      nullptr /* nwarn */));
+  CHECK(data != nullptr);
+  return std::vector<uint8>(data.get(),
+                            data.get() + width * height * components);
+}
+
+class DecodeAndCropAndResizeJpegOpTest : public OpsTestBase {
+ protected:
+  Status Init(bool half_pixel_centers) {
+    TF_CHECK_OK(NodeDefBuilder("op", "_DecodeAndCropAndResizeJpeg")
+                    .Input(FakeInput(DT_STRING))
+                    .Input(FakeInput(DT_INT32))
+                    .Input(FakeInput(DT_INT32))
+                    .Attr("channels", 3)
+                    .Attr("half_pixel_centers", half_pixel_centers)
+                    .Finalize(node_def()));
+    return InitOp();
+  }
+
+  void AddInputs(const string& contents, const std::vector<int32>& crop_window,
+                 const std::vector<int32>& size) {
+    AddInputFromArray<string>(TensorShape({}), {contents});
+    AddInputFromArray<int32>(TensorShape({4}), crop_window);
+    AddInputFromArray<int32>(TensorShape({2}), size);
+  }
+};
+
+TEST_F(DecodeAndCropAndResizeJpegOpTest, FullScaleMatchesDecodeAndCrop) {
+  TF_ASSERT_OK(Init(false));
+  const string contents = EncodedImage(64, 96);
+  AddInputs(contents, {8, 16, 40, 48}, {40, 48});
+  TF_ASSERT_OK(RunOpKernel());
+
+  // The crop is smaller than twice the target size, so the image is decoded
+  // at full scale and the resize is the identity.
+  const std::vector<uint8> crop = DecodeCrop(contents, 8, 16, 40, 48);
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({1, 40, 48, 3}));
+  for (int i = 0; i < crop.size(); ++i) {
+    expected.flat<float>()(i) = crop[i];
+  }
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(DecodeAndCropAndResizeJpegOpTest, DctScaledDecodeIsCloseToResize) {
+  TF_ASSERT_OK(Init(true));
+  const string contents = EncodedImage(256, 256);
+  AddInputs(contents, {0, 0, 256, 256}, {32, 32});
+  TF_ASSERT_OK(RunOpKernel());
+  const Tensor& output = *GetOutput(0);
+  ASSERT_EQ(TensorShape({1, 32, 32, 3}), output.shape());
+
+  // Each output pixel is decoded from an 8x8 block. For smooth ramps that is
+  // close to bilinear sampling of the full scale image at the block center.
+  const std::vector<uint8> full = DecodeCrop(contents, 0, 0, 256, 256);
+  const auto out = output.tensor<float, 4>();
+  for (int y = 0; y < 32; ++y) {
+    for (int x = 0; x < 32; ++x) {
+      for (int c = 0; c < 3; ++c) {
+        const int in_y = y * 8 + 3;
+        const int in_x = x * 8 + 3;
+        const float expected =
+            0.25f * (full[(in_y * 256 + in_x) * 3 + c] +
+                     full[(in_y * 256 + in_x + 1) * 3 + c] +
+                     full[((in_y + 1) * 256 + in_x) * 3 + c] +
+                     full[((in_y + 1) * 256 + in_x + 1) * 3 + c]);
+        EXPECT_NEAR(expected, out(0, y, x, c), 6.0f)
+            << "y=" << y << " x=" << x << " c=" << c;
+      }
+    }
+  }
+}
+
+TEST_F(DecodeAndCropAndResizeJpegOpTest, InvalidCropWindow) {
+  TF_ASSERT_OK(Init(false));
+  AddInputs(EncodedImage(32, 32), {16, 0, 32, 32}, {8, 8});
+  const Status status = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(status)) << status;
+}
+
+// Decodes a `height`x`width` JPEG, crops its central 80% and resizes it to
+// `size`x`size`, either with the fused op or with the unfused
+// DecodeAndCropJpeg + ExpandDims + ResizeBilinear graph.
+Graph* DecodeCropResizeGraph(bool fused, int height, int width, int size) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor contents(DT_STRING, TensorShape({}));
+  contents.scalar<string>()() = EncodedImage(height, width);
+  const int crop_height = height * 4 / 5;
+  const int crop_width = width * 4 / 5;
+  Tensor crop_window = test::AsTensor<int32>(
+      {(height - crop_height) / 2, (width - crop_width) / 2, crop_height,
+       crop_width});
+  Tensor resize_to = test::AsTensor<int32>({size, size});
+
+  Node* contents_node = test::graph::Constant(g, contents);
+  Node* crop_window_node = test::graph::Constant(g, crop_window);
+  Node* size_node = test::graph::Constant(g, resize_to);
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "_DecodeAndCropAndResizeJpeg")
+                    .Input(contents_node)
+                    .Input(crop_window_node)
+                    .Input(size_node)
+                    .Attr("channels", 3)
+                    .Finalize(g, nullptr /* node */));
+  } else {
+    Node* decode;
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "DecodeAndCropJpeg")
+                    .Input(contents_node)
+                    .Input(crop_window_node)
+                    .Attr("channels", 3)
+                    .Finalize(g, &decode));
+    Node* expand_dims;
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "ExpandDims")
+                    .Input(decode)
+                    .Input(test::graph::Constant(g, test::AsScalar<int32>(0)))
+                    .Finalize(g, &expand_dims));
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "ResizeBilinear")
+                    .Input(expand_dims)
+                    .Input(size_node)
+                    .Finalize(g, nullptr /* node */));
+  }
+  return g;
+}
+
+#define BM_DecodeCropResize(FUSED, H, W, S)                              \
+  static void BM_DecodeCropResize_##FUSED##_##H##_##W##_##S(int iters) { \
+    testing::StopTiming();                                               \
+    testing::ItemsProcessed(iters);                                      \
+    testing::UseRealTime();                                              \
+    Graph* g = DecodeCropResizeGraph(FUSED, H, W, S);                    \
+    testing::StartTiming();                                              \
+    test::Benchmark("cpu", g).Run(iters);                                \
+  }                                                                      \
+  BENCHMARK(BM_DecodeCropResize_##FUSED##_##H##_##W##_##S);
+
+// Items are images, so items/s is the images/sec of the input pipeline stage.
+BM_DecodeCropResize(false, 480, 640, 224);
+BM_DecodeCropResize(true, 480, 640, 224);
+BM_DecodeCropResize(false, 1080, 1920, 224);
+BM_DecodeCropResize(true, 1080, 1920, 224);
+BM_DecodeCropResize(false, 1080, 1920, 300);
+BM_DecodeCropResize(true, 1080, 1920, 300);
+
+}  // namespace
+}  // namespace tensorflow
@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 
 namespace tensorflow {
@@ -81,10 +82,13 @@ class DecodeCSVOp : public OpKernel {
       OP_REQUIRES_OK(ctx, output.allocate(i, records->shape(), &out));
     }
 
+    // Reused across records so that parsing a record does not allocate.
+    std::vector<StringPiece> fields;
+    string scratch;
     for (int64 i = 0; i < records_size; ++i) {
       const StringPiece record(records_t(i));
-      std::vector<string> fields;
-      ExtractFields(ctx, record, &fields);
+      fields.clear();
+      ExtractFields(ctx, record, &fields, &scratch);
       OP_REQUIRES(ctx, fields.size() == out_type_.size(),
                   errors::InvalidArgument("Expect ", out_type_.size(),
                                           " fields but have ", fields.size(),
@@ -184,7 +188,8 @@ class DecodeCSVOp : public OpKernel {
               output[f]->flat<string>()(i) =
                   record_defaults[f].flat<string>()(0);
             } else {
-              output[f]->flat<string>()(i) = fields[f];
+              output[f]->flat<string>()(i).assign(fields[f].data(),
+                                                  fields[f].size());
             }
             break;
           }
@@ -205,8 +210,14 @@ class DecodeCSVOp : public OpKernel {
   bool select_all_cols_;
   string na_value_;
 
+  // Splits `input` into the selected fields. Unquoted fields, and quoted
+  // fields without escaped quotes, are returned as views into `input`. Quoted
+  // fields with escaped quotes are unescaped into `scratch`, which is reserved
+  // up front so that views into it stay valid while `input` is parsed.
   void ExtractFields(OpKernelContext* ctx, StringPiece input,
-                     std::vector<string>* result) {
+                     std::vector<StringPiece>* result, string* scratch) {
+    scratch->clear();
+    scratch->reserve(input.size());
     int64 current_idx = 0;
     int64 num_fields_parsed = 0;
     int64 selector_idx = 0;  // Keep track of index into select_cols
@@ -229,7 +240,8 @@ class DecodeCSVOp : public OpKernel {
         }
 
         // This is the body of the field;
-        string field;
+        StringPiece field;
+        const int64 field_start = current_idx;
         if (!quoted) {
           while (static_cast<size_t>(current_idx) < input.size() &&
                  input[current_idx] != delim_) {
@@ -239,26 +251,39 @@ class DecodeCSVOp : public OpKernel {
                             input[current_idx] != '\r',
                         errors::InvalidArgument(
                             "Unquoted fields cannot have quotes/CRLFs inside"));
-            if (include) field += input[current_idx];
             current_idx++;
           }
+          if (include) {
+            field = input.substr(field_start, current_idx - field_start);
+          }
 
           // Go to next field or the end
           current_idx++;
         } else if (use_quote_delim_) {
+          // Bytes of the field are copied into `scratch` only once the first
+          // escaped quote is seen.
+          const size_t scratch_start = scratch->size();
+          bool escaped = false;
           // Quoted field needs to be ended with '"' and delim or end
           while (
               (static_cast<size_t>(current_idx) < input.size() - 1) &&
               (input[current_idx] != '"' || input[current_idx + 1] != delim_)) {
             if (input[current_idx] != '"') {
-              if (include) field += input[current_idx];
+              if (include && escaped) scratch->push_back(input[current_idx]);
               current_idx++;
             } else {
               OP_REQUIRES(
                   ctx, input[current_idx + 1] == '"',
                   errors::InvalidArgument("Quote inside a string has to be "
                                           "escaped by another quote"));
-              if (include) field += '"';
+              if (include) {
+                if (!escaped) {
+                  scratch->append(input.data() + field_start,
+                                  current_idx - field_start);
+                  escaped = true;
+                }
+                scratch->push_back('"');
+              }
               current_idx += 2;
             }
           }
@@ -272,6 +297,12 @@ class DecodeCSVOp : public OpKernel {
               errors::InvalidArgument("Quoted field has to end with quote "
                                       "followed by delim or end"));
 
+          if (include) {
+            field = escaped ? StringPiece(scratch->data() + scratch_start,
+                                          scratch->size() - scratch_start)
+                            : input.substr(field_start,
+                                           current_idx - field_start);
+          }
           current_idx += 2;
         }
 
@@ -288,7 +319,7 @@ class DecodeCSVOp : public OpKernel {
                                    static_cast<size_t>(num_fields_parsed));
       // Check if the last field is missing
       if (include && input[input.size() - 1] == delim_)
-        result->push_back(string());
+        result->push_back(StringPiece());
     }
   }
 };
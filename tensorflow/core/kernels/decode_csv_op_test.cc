@@ -0,0 +1,119 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class DecodeCSVOpTest : public OpsTestBase {
+ protected:
+  Status Init(const DataTypeVector& out_types,
+              const std::vector<int64>& select_cols = {}) {
+    TF_CHECK_OK(NodeDefBuilder("op", "DecodeCSV")
+                    .Input(FakeInput(DT_STRING))
+                    .Input(FakeInput(out_types))
+                    .Attr("select_cols", select_cols)
+                    .Finalize(node_def()));
+    return InitOp();
+  }
+};
+
+TEST_F(DecodeCSVOpTest, QuotedFields) {
+  TF_ASSERT_OK(Init({DT_STRING, DT_INT64, DT_STRING}));
+  AddInputFromArray<string>(
+      TensorShape({3}),
+      {"\"a,b\",1,plain", "\"say \"\"hi\"\"\",2,\"\"", "x,3,\"\"\"\""});
+  AddInputFromArray<string>(TensorShape({1}), {"default"});
+  AddInputFromArray<int64>(TensorShape({0}), {});
+  AddInputFromArray<string>(TensorShape({1}), {"missing"});
+  TF_ASSERT_OK(RunOpKernel());
+
+  test::ExpectTensorEqual<string>(
+      test::AsTensor<string>({"a,b", "say \"hi\"", "x"}), *GetOutput(0));
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({1, 2, 3}),
+                                 *GetOutput(1));
+  test::ExpectTensorEqual<string>(
+      test::AsTensor<string>({"plain", "missing", "\""}), *GetOutput(2));
+}
+
+TEST_F(DecodeCSVOpTest, MissingLastFieldAndSelectCols) {
+  TF_ASSERT_OK(Init({DT_STRING, DT_STRING}, {1, 3}));
+  AddInputFromArray<string>(TensorShape({2}), {"a,b,c,d", "e,\"f\"\"\",g,"});
+  AddInputFromArray<string>(TensorShape({1}), {"x"});
+  AddInputFromArray<string>(TensorShape({1}), {"y"});
+  TF_ASSERT_OK(RunOpKernel());
+
+  test::ExpectTensorEqual<string>(test::AsTensor<string>({"b", "f\""}),
+                                  *GetOutput(0));
+  test::ExpectTensorEqual<string>(test::AsTensor<string>({"d", "y"}),
+                                  *GetOutput(1));
+}
+
+TEST_F(DecodeCSVOpTest, BadQuote) {
+  TF_ASSERT_OK(Init({DT_STRING}));
+  AddInputFromArray<string>(TensorShape({1}), {"\"a\"b\""});
+  AddInputFromArray<string>(TensorShape({0}), {});
+  EXPECT_FALSE(RunOpKernel().ok());
+}
+
+// Returns `batch_size` records of a typical feature CSV: an id, a few numeric
+// columns and a few categorical string columns, one of them quoted.
+Tensor CsvRecords(int batch_size) {
+  Tensor records(DT_STRING, TensorShape({batch_size}));
+  auto flat = records.flat<string>();
+  for (int i = 0; i < batch_size; ++i) {
+    flat(i) = strings::StrCat(i, ",", i % 97, ",", (i % 13) * 0.25, ",",
+                              "category_", i % 31, ",\"city, ", i % 7,
+                              "\",", i % 5 == 0 ? "" : "tag");
+  }
+  return records;
+}
+
+void BM_DecodeCSV(int iters, int batch_size) {
+  testing::StopTiming();
+  testing::ItemsProcessed(static_cast<int64>(iters) * batch_size);
+  testing::UseRealTime();
+  Graph* g = new Graph(OpRegistry::Global());
+  const Tensor records = CsvRecords(batch_size);
+  std::vector<NodeBuilder::NodeOut> defaults = {
+      test::graph::Constant(g, Tensor(DT_INT64, TensorShape({0}))),
+      test::graph::Constant(g, Tensor(DT_INT64, TensorShape({0}))),
+      test::graph::Constant(g, Tensor(DT_FLOAT, TensorShape({0}))),
+      test::graph::Constant(g, Tensor(DT_STRING, TensorShape({0}))),
+      test::graph::Constant(g, Tensor(DT_STRING, TensorShape({0}))),
+      test::graph::Constant(g, test::AsTensor<string>({""}))};
+  TF_CHECK_OK(NodeBuilder("decode", "DecodeCSV")
+                  .Input(test::graph::Constant(g, records))
+                  .Input(defaults)
+                  .Finalize(g, nullptr /* node */));
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+BENCHMARK(BM_DecodeCSV)->Arg(128)->Arg(1024)->Arg(16384);
+
+}  // namespace
+}  // namespace tensorflow
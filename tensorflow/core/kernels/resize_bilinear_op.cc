@@ -95,162 +95,175 @@ inline void compute_interpolation_weights(const Scaler scaler,
   }
 }
 
-/**
- * Computes the bilinear interpolation from the appropriate 4 float points
- * and the linear interpolation weights.
- */
-inline float compute_lerp(const float top_left, const float top_right,
-                          const float bottom_left, const float bottom_right,
-                          const float x_lerp, const float y_lerp) {
-  const float top = top_left + (top_right - top_left) * x_lerp;
-  const float bottom = bottom_left + (bottom_right - bottom_left) * x_lerp;
-  return top + (bottom - top) * y_lerp;
+// Interpolates one input row along x: out_row[x * channels + c] is the lerp of
+// in_row[xs[x].lower + c] and in_row[xs[x].upper + c] by xs[x].lerp.
+template <typename T>
+inline void interpolate_row(const T* in_row, const CachedInterpolation* xs,
+                            const int64 out_width, const int channels,
+                            float* out_row) {
+  if (channels == 3) {
+    for (int64 x = 0; x < out_width; ++x) {
+      const T* left = in_row + xs[x].lower;
+      const T* right = in_row + xs[x].upper;
+      const float xs_lerp = xs[x].lerp;
+      const float left0(left[0]);
+      const float left1(left[1]);
+      const float left2(left[2]);
+      out_row[0] = left0 + (static_cast<float>(right[0]) - left0) * xs_lerp;
+      out_row[1] = left1 + (static_cast<float>(right[1]) - left1) * xs_lerp;
+      out_row[2] = left2 + (static_cast<float>(right[2]) - left2) * xs_lerp;
+      out_row += 3;
+    }
+  } else {
+    for (int64 x = 0; x < out_width; ++x) {
+      const T* left = in_row + xs[x].lower;
+      const T* right = in_row + xs[x].upper;
+      const float xs_lerp = xs[x].lerp;
+      for (int c = 0; c < channels; ++c) {
+        const float l(left[c]);
+        out_row[c] = l + (static_cast<float>(right[c]) - l) * xs_lerp;
+      }
+      out_row += channels;
+    }
+  }
 }
 
-template <typename T>
-void resize_image(
-    typename TTypes<T, 4>::ConstTensor images, const int batch_size,
-    const int64 in_height, const int64 in_width, const int64 out_height,
-    const int64 out_width, const int channels,
-    const std::vector<CachedInterpolation>& xs,
-    const std::vector<CachedInterpolation>& ys,
-    typename TTypes<float, 4>::Tensor output) TF_ATTRIBUTE_NOINLINE;
+// Resizes output rows [begin, end), where row i is row i % out_height of image
+// i / out_height.
+//
+// Every output row is the y lerp of two input rows that have already been
+// interpolated along x. Those x-interpolated rows are kept in two row buffers,
+// so when upsampling, consecutive output rows that share an input row
+// interpolate it only once, and the y lerp is a contiguous loop over the row
+// that the compiler vectorizes. Each output value is still computed as
+//   top = top_left + (top_right - top_left) * x_lerp
+//   bottom = bottom_left + (bottom_right - bottom_left) * x_lerp
+//   top + (bottom - top) * y_lerp.
 template <typename T>
 void resize_image(typename TTypes<T, 4>::ConstTensor images,
-                  const int batch_size, const int64 in_height,
-                  const int64 in_width, const int64 out_height,
-                  const int64 out_width, const int channels,
-                  const std::vector<CachedInterpolation>& xs_vec,
-                  const std::vector<CachedInterpolation>& ys,
+                  const int64 in_height, const int64 in_width,
+                  const int64 out_height, const int64 out_width,
+                  const int channels, const CachedInterpolation* xs,
+                  const CachedInterpolation* ys, const int64 begin,
+                  const int64 end,
                   typename TTypes<float, 4>::Tensor output) {
   const int64 in_row_size = in_width * channels;
   const int64 in_batch_num_values = in_height * in_row_size;
   const int64 out_row_size = out_width * channels;
 
-  const T* input_b_ptr = images.data();
-  const CachedInterpolation* xs = xs_vec.data();
-
-  if (channels == 3) {
-    float* output_y_ptr = output.data();
-    for (int b = 0; b < batch_size; ++b) {
-      for (int64 y = 0; y < out_height; ++y) {
-        const T* ys_input_lower_ptr = input_b_ptr + ys[y].lower * in_row_size;
-        const T* ys_input_upper_ptr = input_b_ptr + ys[y].upper * in_row_size;
-        const float ys_lerp = ys[y].lerp;
-        for (int64 x = 0; x < out_width; ++x) {
-          const int64 xs_lower = xs[x].lower;
-          const int64 xs_upper = xs[x].upper;
-          const float xs_lerp = xs[x].lerp;
-
-          // Read channel 0.
-          const float top_left0(ys_input_lower_ptr[xs_lower + 0]);
-          const float top_right0(ys_input_lower_ptr[xs_upper + 0]);
-          const float bottom_left0(ys_input_upper_ptr[xs_lower + 0]);
-          const float bottom_right0(ys_input_upper_ptr[xs_upper + 0]);
-
-          // Read channel 1.
-          const float top_left1(ys_input_lower_ptr[xs_lower + 1]);
-          const float top_right1(ys_input_lower_ptr[xs_upper + 1]);
-          const float bottom_left1(ys_input_upper_ptr[xs_lower + 1]);
-          const float bottom_right1(ys_input_upper_ptr[xs_upper + 1]);
-
-          // Read channel 2.
-          const float top_left2(ys_input_lower_ptr[xs_lower + 2]);
-          const float top_right2(ys_input_lower_ptr[xs_upper + 2]);
-          const float bottom_left2(ys_input_upper_ptr[xs_lower + 2]);
-          const float bottom_right2(ys_input_upper_ptr[xs_upper + 2]);
-
-          // Compute output.
-          output_y_ptr[x * channels + 0] =
-              compute_lerp(top_left0, top_right0, bottom_left0, bottom_right0,
-                           xs_lerp, ys_lerp);
-          output_y_ptr[x * channels + 1] =
-              compute_lerp(top_left1, top_right1, bottom_left1, bottom_right1,
-                           xs_lerp, ys_lerp);
-          output_y_ptr[x * channels + 2] =
-              compute_lerp(top_left2, top_right2, bottom_left2, bottom_right2,
-                           xs_lerp, ys_lerp);
-        }
-        output_y_ptr += out_row_size;
-      }
-      input_b_ptr += in_batch_num_values;
-    }
-  } else {
-    float* output_y_ptr = output.data();
-    for (int b = 0; b < batch_size; ++b) {
-      for (int64 y = 0; y < out_height; ++y) {
-        const T* ys_input_lower_ptr = input_b_ptr + ys[y].lower * in_row_size;
-        const T* ys_input_upper_ptr = input_b_ptr + ys[y].upper * in_row_size;
-        const float ys_lerp = ys[y].lerp;
-        for (int64 x = 0; x < out_width; ++x) {
-          auto xs_lower = xs[x].lower;
-          auto xs_upper = xs[x].upper;
-          auto xs_lerp = xs[x].lerp;
-          for (int c = 0; c < channels; ++c) {
-            const float top_left(ys_input_lower_ptr[xs_lower + c]);
-            const float top_right(ys_input_lower_ptr[xs_upper + c]);
-            const float bottom_left(ys_input_upper_ptr[xs_lower + c]);
-            const float bottom_right(ys_input_upper_ptr[xs_upper + c]);
-            output_y_ptr[x * channels + c] =
-                compute_lerp(top_left, top_right, bottom_left, bottom_right,
-                             xs_lerp, ys_lerp);
-          }
-        }
-        output_y_ptr += out_row_size;
-      }
-      input_b_ptr += in_batch_num_values;
+  std::vector<float> buffer(2 * out_row_size);
+  float* rows[2] = {buffer.data(), buffer.data() + out_row_size};
+  // Input rows held by `rows`, as b * in_height + y, or -1 if none.
+  int64 keys[2] = {-1, -1};
+  // Returns input row `key` interpolated along x, computing it into the buffer
+  // that does not hold row `keep` if it is not cached yet.
+  auto get_row = [&](int64 key, int64 keep) -> const float* {
+    if (keys[0] == key) return rows[0];
+    if (keys[1] == key) return rows[1];
+    const int slot = keys[0] == keep ? 1 : 0;
+    const T* in_row = images.data() + (key / in_height) * in_batch_num_values +
+                      (key % in_height) * in_row_size;
+    interpolate_row(in_row, xs, out_width, channels, rows[slot]);
+    keys[slot] = key;
+    return rows[slot];
+  };
+
+  float* output_y_ptr = output.data() + begin * out_row_size;
+  for (int64 i = begin; i < end; ++i) {
+    const int64 b = i / out_height;
+    const int64 y = i % out_height;
+    const int64 lower = b * in_height + ys[y].lower;
+    const int64 upper = b * in_height + ys[y].upper;
+    const float* top = get_row(lower, upper);
+    const float* bottom = get_row(upper, lower);
+    const float ys_lerp = ys[y].lerp;
+    for (int64 j = 0; j < out_row_size; ++j) {
+      output_y_ptr[j] = top[j] + (bottom[j] - top[j]) * ys_lerp;
     }
+    output_y_ptr += out_row_size;
   }
 }
 
 }  // namespace
 
-// Partial specialization of ResizeBilinear functor for a CPUDevice.
 namespace functor {
 template <typename T>
+void ResizeBilinearCpu(const CPUDevice& d,
+                       typename TTypes<T, 4>::ConstTensor images,
+                       const float height_scale, const float width_scale,
+                       const bool half_pixel_centers,
+                       typename TTypes<float, 4>::Tensor output) {
+  const int batch_size = images.dimension(0);
+  const int64 in_height = images.dimension(1);
+  const int64 in_width = images.dimension(2);
+  const int channels = images.dimension(3);
+
+  const int64 out_height = output.dimension(1);
+  const int64 out_width = output.dimension(2);
+
+  // Handle no-op resizes efficiently.
+  if (out_height == in_height && out_width == in_width) {
+    output.device(d) = images.template cast<float>();
+    return;
+  }
+
+  std::vector<CachedInterpolation> ys(out_height + 1);
+  std::vector<CachedInterpolation> xs(out_width + 1);
+
+  if (half_pixel_centers) {
+    compute_interpolation_weights(HalfPixelScaler(), out_height, in_height,
+                                  height_scale, ys.data());
+    compute_interpolation_weights(HalfPixelScaler(), out_width, in_width,
+                                  width_scale, xs.data());
+
+  } else {
+    // Compute the cached interpolation weights on the x and y dimensions.
+    compute_interpolation_weights(LegacyScaler(), out_height, in_height,
+                                  height_scale, ys.data());
+    compute_interpolation_weights(LegacyScaler(), out_width, in_width,
+                                  width_scale, xs.data());
+  }
+  // Scale x interpolation weights to avoid a multiplication during iteration.
+  for (int i = 0; i < xs.size(); ++i) {
+    xs[i].lower *= channels;
+    xs[i].upper *= channels;
+  }
+
+  // Shard over output rows, so that a single large image is resized by all
+  // threads as well as a batch of small ones.
+  const int64 out_row_size = out_width * channels;
+  const Eigen::TensorOpCost cost(
+      /*bytes_loaded=*/2 * out_row_size * sizeof(T),
+      /*bytes_stored=*/out_row_size * sizeof(float),
+      /*compute_cycles=*/out_row_size * 9);
+  d.parallelFor(batch_size * out_height, cost, [&](int64 begin, int64 end) {
+    resize_image<T>(images, in_height, in_width, out_height, out_width,
+                    channels, xs.data(), ys.data(), begin, end, output);
+  });
+}
+
+template void ResizeBilinearCpu<uint8>(const CPUDevice& d,
+                                       TTypes<uint8, 4>::ConstTensor images,
+                                       const float height_scale,
+                                       const float width_scale,
+                                       const bool half_pixel_centers,
+                                       TTypes<float, 4>::Tensor output);
+template void ResizeBilinearCpu<float>(const CPUDevice& d,
+                                       TTypes<float, 4>::ConstTensor images,
+                                       const float height_scale,
+                                       const float width_scale,
+                                       const bool half_pixel_centers,
+                                       TTypes<float, 4>::Tensor output);
+
+// Partial specialization of ResizeBilinear functor for a CPUDevice.
+template <typename T>
 struct ResizeBilinear<CPUDevice, T> {
   void operator()(const CPUDevice& d, typename TTypes<T, 4>::ConstTensor images,
                   const float height_scale, const float width_scale,
                   bool half_pixel_centers,
                   typename TTypes<float, 4>::Tensor output) {
-    const int batch_size = images.dimension(0);
-    const int64 in_height = images.dimension(1);
-    const int64 in_width = images.dimension(2);
-    const int channels = images.dimension(3);
-
-    const int64 out_height = output.dimension(1);
-    const int64 out_width = output.dimension(2);
-
-    // Handle no-op resizes efficiently.
-    if (out_height == in_height && out_width == in_width) {
-      output = images.template cast<float>();
-      return;
-    }
-
-    std::vector<CachedInterpolation> ys(out_height + 1);
-    std::vector<CachedInterpolation> xs(out_width + 1);
-
-    if (half_pixel_centers) {
-      compute_interpolation_weights(HalfPixelScaler(), out_height, in_height,
-                                    height_scale, ys.data());
-      compute_interpolation_weights(HalfPixelScaler(), out_width, in_width,
-                                    width_scale, xs.data());
-
-    } else {
-      // Compute the cached interpolation weights on the x and y dimensions.
-      compute_interpolation_weights(LegacyScaler(), out_height, in_height,
-                                    height_scale, ys.data());
-      compute_interpolation_weights(LegacyScaler(), out_width, in_width,
-                                    width_scale, xs.data());
-    }
-    // Scale x interpolation weights to avoid a multiplication during iteration.
-    for (int i = 0; i < xs.size(); ++i) {
-      xs[i].lower *= channels;
-      xs[i].upper *= channels;
-    }
-
-    resize_image<T>(images, batch_size, in_height, in_width, out_height,
-                    out_width, channels, xs, ys, output);
+    ResizeBilinearCpu<T>(d, images, height_scale, width_scale,
+                         half_pixel_centers, output);
   }
 };
 }  // namespace functor
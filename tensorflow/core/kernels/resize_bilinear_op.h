@@ -20,6 +20,10 @@ limitations under the License.
 #include "tensorflow/core/framework/numeric_types.h"
 #include "tensorflow/core/framework/tensor_types.h"
 
+namespace Eigen {
+struct ThreadPoolDevice;
+}  // end namespace Eigen
+
 namespace tensorflow {
 namespace functor {
 
@@ -31,6 +35,15 @@ struct ResizeBilinear {
                   typename TTypes<float, 4>::Tensor resized_images);
 };
 
+// The CPU implementation of ResizeBilinear, for fused CPU kernels that resize
+// an intermediate image. Defined in resize_bilinear_op.cc for uint8 and float.
+template <typename T>
+void ResizeBilinearCpu(const Eigen::ThreadPoolDevice& d,
+                       typename TTypes<T, 4>::ConstTensor images,
+                       const float height_scale, const float width_scale,
+                       const bool half_pixel_centers,
+                       typename TTypes<float, 4>::Tensor resized_images);
+
 template <typename Device, typename T>
 struct ResizeBilinearGrad {
   void operator()(const Device& d,
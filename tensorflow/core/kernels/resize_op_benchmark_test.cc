@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
@@ -54,4 +55,48 @@ BM_ResizeDev(gpu, ResizeNearestNeighbor, 10, 499, 499);
 BM_ResizeDev(cpu, ResizeBilinear, 10, 499, 499);
 BM_ResizeDev(gpu, ResizeBilinear, 10, 499, 499);
 
+// Resizes a [batches, in_height, in_width, 3] image of type `dtype` to
+// [out_height, out_width], as detection models do on their input images.
+static Graph* BM_ResizeBilinearTo(DataType dtype, int batches, int in_height,
+                                  int in_width, int out_height,
+                                  int out_width) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor in(dtype, TensorShape({batches, in_height, in_width, 3}));
+  if (dtype == DT_UINT8) {
+    in.flat<uint8>().setRandom();
+  } else {
+    in.flat<float>().setRandom();
+  }
+
+  Tensor out_size(DT_INT32, TensorShape({2}));
+  auto out_size_flat = out_size.flat<int32>();
+  out_size_flat(0) = out_height;
+  out_size_flat(1) = out_width;
+
+  Node* ret;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "ResizeBilinear")
+                  .Input(test::graph::Constant(g, in))
+                  .Input(test::graph::Constant(g, out_size))
+                  .Finalize(g, &ret));
+  return g;
+}
+
+#define BM_ResizeBilinearToDev(DEVICE, T, B, IH, IW, OH, OW)              \
+  static void BM_ResizeTo_##DEVICE##_##T##_##B##_##IH##_##IW##_##OH##_##OW( \
+      int iters) {                                                        \
+    testing::ItemsProcessed(static_cast<int64>(iters) * B * OH * OW * 3); \
+    test::Benchmark(#DEVICE,                                              \
+                    BM_ResizeBilinearTo(DataTypeToEnum<T>::value, B, IH,  \
+                                        IW, OH, OW))                      \
+        .Run(iters);                                                      \
+  }                                                                       \
+  BENCHMARK(BM_ResizeTo_##DEVICE##_##T##_##B##_##IH##_##IW##_##OH##_##OW)
+
+// Camera frames downscaled to SSD and Faster R-CNN input sizes.
+BM_ResizeBilinearToDev(cpu, uint8, 1, 1080, 1920, 300, 300);
+BM_ResizeBilinearToDev(cpu, uint8, 1, 1080, 1920, 640, 640);
+BM_ResizeBilinearToDev(cpu, uint8, 8, 480, 640, 300, 300);
+BM_ResizeBilinearToDev(cpu, float, 1, 1080, 1920, 640, 640);
+BM_ResizeBilinearToDev(cpu, float, 1, 600, 1024, 1200, 2048);
+
 }  // namespace tensorflow
@@ -22,6 +22,7 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/segment_reduction_ops.h"
 
+#include <algorithm>
 #include <vector>
 
 #include "third_party/eigen3/Eigen/Core"
@@ -35,7 +36,10 @@ limitations under the License.
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/prefetch.h"
 #include "tensorflow/core/util/util.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 #if GOOGLE_CUDA
 #include "tensorflow/core/common_runtime/gpu/gpu_event_mgr.h"
@@ -693,197 +697,162 @@ class SparseSegmentReductionOpBase : public OpKernel {
                 errors::InvalidArgument("segment ids must be >= 0"));
     auto output_flat = output->flat_outer_dims<T>();
 
-    int64 start = 0, end = 1;
-    // Index from which the output is not initialized.
-    OutputRow uninitialized_index = 0;
-    OutputRow out_index = internal::SubtleMustCopy(segment_vec(start));
-
-    while (true) {
-      // We initialize next_index to 0 to avoid "warning: 'next_index' may be
-      // used uninitialized in this function" in the Mac build (since the
-      // compiler isn't smart enough to realize the code is safe).
-      OutputRow next_index = 0;
-      if (end < num_indices) {
-        next_index = internal::SubtleMustCopy(segment_vec(end));
-        if (out_index == next_index) {
-          ++end;
-          continue;
-        }
-        // We have a new segment here.  Verify that the segment ids are growing.
-        OP_REQUIRES(context, out_index < next_index,
-                    errors::InvalidArgument("segment ids are not increasing"));
-      }
-
-      OP_REQUIRES(
-          context, FastBoundsCheck(out_index, output_rows),
-          errors::InvalidArgument(
-              "Segment id ", out_index, " out of range [0, ", output_rows,
-              "), possibly because 'segment_ids' input is not sorted."));
-
-      // If there is a gap between two indices, we need to set that gap to the
-      // default value.
-      if (out_index > uninitialized_index) {
-        Eigen::DSizes<Eigen::DenseIndex, 2> gap_slice_shape(
-            out_index - uninitialized_index, num_col);
-        Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>, Eigen::Unaligned>
-            gap_slice(&output_flat(uninitialized_index, 0), gap_slice_shape);
-        gap_slice.setConstant(default_value_);
+    // Validate the segment ids and split them into runs of equal ids. Run r
+    // covers indices [run_starts[r], run_starts[r + 1]) and reduces into
+    // output row run_ids[r]. An invalid segment id is only reported if the
+    // runs before it have valid indices, as a serial pass would.
+    std::vector<int64> run_starts;
+    std::vector<OutputRow> run_ids;
+    Status segment_status;
+    OutputRow out_index = internal::SubtleMustCopy(segment_vec(0));
+    run_starts.push_back(0);
+    run_ids.push_back(out_index);
+    for (int64 i = 1; i < num_indices; ++i) {
+      const OutputRow next_index = internal::SubtleMustCopy(segment_vec(i));
+      if (next_index == out_index) continue;
+      // We have a new segment here.  Verify that the segment ids are growing.
+      if (out_index >= next_index) {
+        segment_status =
+            errors::InvalidArgument("segment ids are not increasing");
+        break;
       }
-
-      auto out = output_flat.template chip<0>(out_index);
-      const int bad_offset =
-          Reduce(input_flat, indices_vec, start, end - start, out);
-      OP_REQUIRES(context, bad_offset < 0,
-                  errors::InvalidArgument(
-                      "Bad: indices[", start + bad_offset,
-                      "] == ", indices_vec(start + bad_offset),
-                      " out of range [0, ", input_flat.dimension(0), ")"));
-
-      start = end;
-      ++end;
-      uninitialized_index = out_index + 1;
+      // An out-of-range segment id is reported below.
+      if (!FastBoundsCheck(out_index, output_rows)) break;
       out_index = next_index;
-      if (end > num_indices) break;
+      run_starts.push_back(i);
+      run_ids.push_back(out_index);
+    }
+    if (segment_status.ok() && !FastBoundsCheck(out_index, output_rows)) {
+      segment_status = errors::InvalidArgument(
+          "Segment id ", out_index, " out of range [0, ", output_rows,
+          "), possibly because 'segment_ids' input is not sorted.");
     }
+    // The run with the invalid segment id is not reduced.
+    const int64 num_runs =
+        segment_status.ok() ? run_ids.size() : run_ids.size() - 1;
+    if (segment_status.ok()) {
+      run_starts.push_back(num_indices);
+    }
+
+    // Runs are independent, so shard them across the intra-op pool. Each run
+    // also fills the gap between the previous run's row and its own, so every
+    // output row below the last segment id is written by exactly one shard.
+    mutex mu;
+    int64 bad_position = num_indices;
+    auto work = [&](int64 begin, int64 end) {
+      const int64 prefetch_end = run_starts[end];
+      for (int64 r = begin; r < end; ++r) {
+        const OutputRow uninitialized_index = r == 0 ? 0 : run_ids[r - 1] + 1;
+        if (run_ids[r] > uninitialized_index) {
+          SetToDefault(uninitialized_index, run_ids[r], &output_flat);
+        }
+        const int64 start = run_starts[r];
+        const int64 bad_offset =
+            Reduce(input_flat, indices_vec, start, run_starts[r + 1] - start,
+                   prefetch_end, &output_flat(run_ids[r], 0));
+        if (bad_offset >= 0) {
+          mutex_lock l(mu);
+          bad_position = std::min(bad_position, start + bad_offset);
+          return;
+        }
+      }
+    };
+    const int64 cost_per_run =
+        (num_indices / std::max<int64>(num_runs, 1) + 1) * num_col * sizeof(T);
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_runs,
+          cost_per_run, work);
+    OP_REQUIRES(context, bad_position == num_indices,
+                errors::InvalidArgument(
+                    "Bad: indices[", bad_position,
+                    "] == ", indices_vec(bad_position), " out of range [0, ",
+                    input_flat.dimension(0), ")"));
+    OP_REQUIRES_OK(context, segment_status);
 
     // Fill the gap at the end with the default value.
-    if (uninitialized_index < output_rows) {
-      Eigen::DSizes<Eigen::DenseIndex, 2> gap_slice_shape(
-          output_rows - uninitialized_index, num_col);
-      Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>, Eigen::Unaligned>
-          gap_slice(&output_flat(uninitialized_index, 0), gap_slice_shape);
-      gap_slice.setConstant(default_value_);
+    if (out_index + 1 < output_rows) {
+      SetToDefault(out_index + 1, output_rows, &output_flat);
     }
   }
 
  private:
   typedef int32 Index;
 
-  int64 Reduce(const typename TTypes<T>::ConstMatrix& input_flat,
-               const typename TTypes<Index>::ConstVec& indices_vec, int64 start,
-               int64 num,
-               Eigen::TensorChippingOp<0, typename TTypes<T>::Matrix> out) {
-#define INDEX(n, i)                               \
-  const auto index##n = indices_vec(start + (i)); \
-  if (!FastBoundsCheck(index##n, input_flat.dimension(0))) return (i);
+  // Number of gathered rows to look ahead when issuing prefetches.
+  static constexpr int64 kPrefetchDistance = 8;
 
-#define L(n) input_flat.template chip<0>(index##n)
+  void SetToDefault(int64 begin, int64 end,
+                    typename TTypes<T>::Matrix* output_flat) const {
+    const int64 num_col = output_flat->dimension(1);
+    typename TTypes<T>::UnalignedVec gap(&(*output_flat)(begin, 0),
+                                         (end - begin) * num_col);
+    gap.setConstant(default_value_);
+  }
 
-    if (num == 1) {
-      INDEX(0, 0);
-      out = L(0);
-    } else {
-      int64 r = num % 8;
-      T m(1);
-      if (is_mean_ && (num < 10)) {
-        m = T(num);
-      }
-      if (is_sqrtn_ && (num < 10)) {
-        m = T(sqrt(num));
-      }
-      switch (r) {
-        case 2: {
-          INDEX(0, 0);
-          INDEX(1, 1);
-          out = (L(0) + L(1)) / m;
-          break;
-        }
-        case 3: {
-          INDEX(0, 0);
-          INDEX(1, 1);
-          INDEX(2, 2);
-          out = (L(0) + L(1) + L(2)) / m;
-          break;
-        }
-        case 4: {
-          INDEX(0, 0);
-          INDEX(1, 1);
-          INDEX(2, 2);
-          INDEX(3, 3);
-          out = (L(0) + L(1) + L(2) + L(3)) / m;
-          break;
-        }
-        case 5: {
-          INDEX(0, 0);
-          INDEX(1, 1);
-          INDEX(2, 2);
-          INDEX(3, 3);
-          INDEX(4, 4);
-          out = (L(0) + L(1) + L(2) + L(3) + L(4)) / m;
-          break;
-        }
-        case 6: {
-          INDEX(0, 0);
-          INDEX(1, 1);
-          INDEX(2, 2);
-          INDEX(3, 3);
-          INDEX(4, 4);
-          INDEX(5, 5);
-          out = (L(0) + L(1) + L(2) + L(3) + L(4) + L(5)) / m;
-          break;
-        }
-        case 7: {
-          INDEX(0, 0);
-          INDEX(1, 1);
-          INDEX(2, 2);
-          INDEX(3, 3);
-          INDEX(4, 4);
-          INDEX(5, 5);
-          INDEX(6, 6);
-          out = (L(0) + L(1) + L(2) + L(3) + L(4) + L(5) + L(6)) / m;
-          break;
-        }
-        case 0: {
-          INDEX(0, 0);
-          INDEX(1, 1);
-          INDEX(2, 2);
-          INDEX(3, 3);
-          INDEX(4, 4);
-          INDEX(5, 5);
-          INDEX(6, 6);
-          INDEX(7, 7);
-          out = (L(0) + L(1) + L(2) + L(3) + L(4) + L(5) + L(6) + L(7)) / m;
-          r = 8;
-          break;
-        }
-        case 1: {
-          INDEX(0, 0);
-          INDEX(1, 1);
-          INDEX(2, 2);
-          INDEX(3, 3);
-          INDEX(4, 4);
-          INDEX(5, 5);
-          INDEX(6, 6);
-          INDEX(7, 7);
-          INDEX(8, 8);
-          out = (L(0) + L(1) + L(2) + L(3) + L(4) + L(5) + L(6) + L(7) + L(8)) /
-                m;
-          r = 9;
-          break;
+  // Reduces the rows input_flat(indices_vec(start + i)) for i in [0, num)
+  // into `out_row`, prefetching the row kPrefetchDistance indices ahead as
+  // long as it lies before `prefetch_end`. Returns the offset of the first
+  // out-of-range index, or -1 on success.
+  //
+  // The rows are added in the order the kernel has always added them, so that
+  // results do not change: the first num % 8 of them (8 or 9 if that is 0 or
+  // 1) one after the other, and then the sums of groups of 8.
+  int64 Reduce(const typename TTypes<T>::ConstMatrix& input_flat,
+               const typename TTypes<Index>::ConstVec& indices_vec, int64 start,
+               int64 num, int64 prefetch_end, T* out_row) const {
+    const Index num_rows = input_flat.dimension(0);
+    const int64 num_col = input_flat.dimension(1);
+    const int64 row_bytes = num_col * sizeof(T);
+    // Returns indices_vec(start + i), or -1 if it is out of range.
+    auto checked_index = [&](int64 i) -> Index {
+      const int64 ahead = start + i + kPrefetchDistance;
+      if (ahead < prefetch_end) {
+        const Index next = internal::SubtleMustCopy(indices_vec(ahead));
+        if (FastBoundsCheck(next, num_rows)) {
+          const char* next_row =
+              reinterpret_cast<const char*>(&input_flat(next, 0));
+          for (int64 b = 0; b < row_bytes; b += 64) {
+            port::prefetch<port::PREFETCH_HINT_T0>(next_row + b);
+          }
         }
       }
-      for (; r < num; r += 8) {
-        INDEX(0, r);
-        INDEX(1, r + 1);
-        INDEX(2, r + 2);
-        INDEX(3, r + 3);
-        INDEX(4, r + 4);
-        INDEX(5, r + 5);
-        INDEX(6, r + 6);
-        INDEX(7, r + 7);
-        out += L(0) + L(1) + L(2) + L(3) + L(4) + L(5) + L(6) + L(7);
-      }
-      if (is_mean_ && num >= 10) {
-        out = out / static_cast<T>(num);
+      const Index index = internal::SubtleMustCopy(indices_vec(start + i));
+      return FastBoundsCheck(index, num_rows) ? index : -1;
+    };
+    auto row = [&](Index index) {
+      return typename TTypes<T>::UnalignedConstVec(&input_flat(index, 0),
+                                                   num_col);
+    };
+
+    typename TTypes<T>::UnalignedVec out(out_row, num_col);
+    int64 head = num % 8;
+    if (head < 2) head += 8;
+    head = std::min(head, num);
+    for (int64 i = 0; i < head; ++i) {
+      const Index index = checked_index(i);
+      if (index < 0) return i;
+      if (i == 0) {
+        out = row(index);
+      } else {
+        out += row(index);
       }
-      if (is_sqrtn_ && num >= 10) {
-        out = out / static_cast<T>(sqrt(num));
+    }
+    for (int64 i = head; i < num; i += 8) {
+      Index group[8];
+      for (int64 j = 0; j < 8; ++j) {
+        group[j] = checked_index(i + j);
+        if (group[j] < 0) return i + j;
       }
+      out += row(group[0]) + row(group[1]) + row(group[2]) + row(group[3]) +
+             row(group[4]) + row(group[5]) + row(group[6]) + row(group[7]);
+    }
+    if (is_mean_ && num > 1) {
+      out = out / static_cast<T>(num);
+    }
+    if (is_sqrtn_ && num > 1) {
+      out = out / static_cast<T>(sqrt(num));
     }
-
     return -1;
-#undef L
-#undef INDEX
   }
 
   const bool is_mean_;
@@ -1048,14 +1017,17 @@ class SparseSegmentGradOpBase : public OpKernel {
     OP_REQUIRES(context, last_segment_id_plus_one <= num_segments,
                 errors::InvalidArgument("Invalid number of segments"));
 
-    // Compute scaling factors for input.
+    // Compute scaling factors for input. The segment ids and indices are
+    // copied once so that the sharded pass below reads validated values.
     std::vector<double> scaling(num_segments, 0.0);
+    std::vector<SegmentId> segments(N);
     for (int64 i = 0; i < N; ++i) {
       const SegmentId idx = internal::SubtleMustCopy(segment_vec(i));
       OP_REQUIRES(
           context, FastBoundsCheck(idx, num_segments),
           errors::InvalidArgument("Segment id ", idx, " out of range [0, ",
                                   num_segments, ")."));
+      segments[i] = idx;
       scaling[idx] += 1;
     }
     for (size_t i = 0; i < scaling.size(); ++i) {
@@ -1066,42 +1038,64 @@ class SparseSegmentGradOpBase : public OpKernel {
       }
     }
 
-    auto output_flat = output->flat_outer_dims<T>();
-    output_flat.setZero();
-    std::vector<bool> is_modified(M, false);
-
+    // Group the positions by output row with a stable counting sort, so that
+    // each output row can be accumulated by a single shard in the same order
+    // as a serial scatter would.
+    std::vector<int64> row_starts(M + 1, 0);
+    std::vector<Index> output_indices(N);
     for (int64 i = 0; i < N; ++i) {
       const Index output_idx = internal::SubtleMustCopy(indices_vec(i));
       OP_REQUIRES(context, FastBoundsCheck(output_idx, M),
                   errors::InvalidArgument("Index ", output_idx,
                                           " out of range [0, ", M, ")."));
+      output_indices[i] = output_idx;
+      ++row_starts[output_idx + 1];
+    }
+    for (SegmentId m = 0; m < M; ++m) {
+      row_starts[m + 1] += row_starts[m];
+    }
+    std::vector<int64> positions(N);
+    {
+      std::vector<int64> next(row_starts.begin(), row_starts.end() - 1);
+      for (int64 i = 0; i < N; ++i) {
+        positions[next[output_indices[i]]++] = i;
+      }
+    }
 
-      const SegmentId idx = internal::SubtleMustCopy(segment_vec(i));
-      OP_REQUIRES(
-          context, FastBoundsCheck(idx, num_segments),
-          errors::InvalidArgument("Segment id ", idx, " out of range [0, ",
-                                  num_segments, ")."));
-
-      const T scale = static_cast<T>(scaling[idx]);
-      if (is_modified[output_idx]) {
-        if (scale == 1.0) {
-          output_flat.template chip<0>(output_idx) +=
-              input_flat.template chip<0>(idx);
-        } else {
-          output_flat.template chip<0>(output_idx) +=
-              input_flat.template chip<0>(idx) * scale;
+    auto output_flat = output->flat_outer_dims<T>();
+    const int64 num_col = output_flat.dimension(1);
+    auto work = [&](int64 begin, int64 end) {
+      for (int64 m = begin; m < end; ++m) {
+        typename TTypes<T>::UnalignedVec out(&output_flat(m, 0), num_col);
+        if (row_starts[m] == row_starts[m + 1]) {
+          out.setZero();
+          continue;
         }
-      } else {
-        if (scale == 1.0) {
-          output_flat.template chip<0>(output_idx) =
-              input_flat.template chip<0>(idx);
-        } else {
-          output_flat.template chip<0>(output_idx) =
-              input_flat.template chip<0>(idx) * scale;
+        for (int64 p = row_starts[m]; p < row_starts[m + 1]; ++p) {
+          const SegmentId idx = segments[positions[p]];
+          typename TTypes<T>::UnalignedConstVec row(&input_flat(idx, 0),
+                                                    num_col);
+          const T scale = static_cast<T>(scaling[idx]);
+          if (p == row_starts[m]) {
+            if (scale == T(1)) {
+              out = row;
+            } else {
+              out = row * scale;
+            }
+          } else {
+            if (scale == T(1)) {
+              out += row;
+            } else {
+              out += row * scale;
+            }
+          }
         }
       }
-      is_modified[output_idx] = true;
-    }
+    };
+    const int64 cost_per_row = (N / M + 1) * num_col * sizeof(T);
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, M,
+          cost_per_row, work);
   }
 
  private:
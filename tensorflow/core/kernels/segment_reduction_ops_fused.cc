@@ -0,0 +1,253 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Implements the embedding lookup with a combiner as a single kernel:
+//
+//   GatherV2(params, ids) -> [Mul(weights)] -> SparseSegment{Sum,Mean,SqrtN}
+//
+// The gathered (and weighted) rows are accumulated straight into the output,
+// so the [num_ids, embedding_dim] intermediate of the unfused graph is never
+// materialized. The remapper grappler optimizer rewrites the pattern above
+// into this op.
+//
+// Currently supported only on CPU device.
+
+#define EIGEN_USE_THREADS
+
+#include <cmath>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/bounds_check.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/prefetch.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+template <typename T, typename Tids>
+class FusedEmbeddingLookupSparseOp : public OpKernel {
+ public:
+  explicit FusedEmbeddingLookupSparseOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    int num_weights;
+    OP_REQUIRES_OK(context, context->GetAttr("num_weights", &num_weights));
+    OP_REQUIRES(context, num_weights <= 1,
+                errors::InvalidArgument(
+                    "_FusedEmbeddingLookupSparse supports at most one weights "
+                    "input, got: ",
+                    num_weights));
+    has_weights_ = num_weights == 1;
+
+    string combiner;
+    OP_REQUIRES_OK(context, context->GetAttr("combiner", &combiner));
+    is_mean_ = combiner == "mean";
+    is_sqrtn_ = combiner == "sqrtn";
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& params = context->input(0);
+    const Tensor& ids = context->input(1);
+    const Tensor& indices = context->input(2);
+    const Tensor& segment_ids = context->input(3);
+
+    OP_REQUIRES(context, TensorShapeUtils::IsVectorOrHigher(params.shape()),
+                errors::InvalidArgument("params must be at least 1-D."));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(ids.shape()),
+                errors::InvalidArgument("ids should be a vector."));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(indices.shape()),
+                errors::InvalidArgument("indices should be a vector."));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(segment_ids.shape()),
+                errors::InvalidArgument("segment_ids should be a vector."));
+
+    const int64 num_indices = indices.NumElements();
+    OP_REQUIRES(context, num_indices == segment_ids.NumElements(),
+                errors::InvalidArgument(
+                    "segment_ids and indices should have same size."));
+
+    const int64 num_ids = ids.NumElements();
+    // The weights broadcast against the gathered rows exactly like the Mul in
+    // the unfused graph: one weight per id, or a single weight for all of them.
+    const T* weights = nullptr;
+    bool scalar_weight = false;
+    if (has_weights_) {
+      const Tensor& weights_t = context->input(4);
+      OP_REQUIRES(
+          context, weights_t.dims() == params.dims(),
+          errors::InvalidArgument("weights must have the same rank as params, "
+                                  "got: ",
+                                  weights_t.shape().DebugString()));
+      for (int d = 1; d < weights_t.dims(); ++d) {
+        OP_REQUIRES(context, weights_t.dim_size(d) == 1,
+                    errors::InvalidArgument(
+                        "weights must broadcast along the embedding "
+                        "dimensions, got: ",
+                        weights_t.shape().DebugString()));
+      }
+      scalar_weight = weights_t.NumElements() == 1;
+      OP_REQUIRES(context, scalar_weight || weights_t.dim_size(0) == num_ids,
+                  errors::InvalidArgument(
+                      "weights and ids should have same size, got: ",
+                      weights_t.dim_size(0), " vs. ", num_ids));
+      weights = weights_t.flat<T>().data();
+    }
+
+    auto params_flat = params.flat_outer_dims<T>();
+    const int64 num_params = params_flat.dimension(0);
+    const int64 num_col = params_flat.dimension(1);
+    const auto ids_vec = ids.vec<Tids>();
+    const auto indices_vec = indices.vec<int32>();
+    const auto segment_vec = segment_ids.vec<int32>();
+
+    // Like GatherV2, every id is validated whether or not it is referenced.
+    std::vector<int64> id_rows(num_ids);
+    for (int64 i = 0; i < num_ids; ++i) {
+      const Tids id = internal::SubtleMustCopy(ids_vec(i));
+      OP_REQUIRES(context, FastBoundsCheck(id, num_params),
+                  errors::InvalidArgument("indices[", i, "] = ", id,
+                                          " is not in [0, ", num_params, ")"));
+      id_rows[i] = id;
+    }
+
+    const int32 output_rows =
+        num_indices > 0
+            ? internal::SubtleMustCopy(segment_vec(num_indices - 1)) + 1
+            : 0;
+    OP_REQUIRES(context, output_rows >= 0,
+                errors::InvalidArgument("segment ids must be >= 0"));
+
+    TensorShape output_shape = params.shape();
+    output_shape.set_dim(0, output_rows);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
+    if (num_indices == 0) return;
+    auto output_flat = output->flat_outer_dims<T>();
+
+    // Resolve every position to its params row and weight, and split the
+    // positions into runs of equal segment ids. Run r covers positions
+    // [run_starts[r], run_starts[r + 1]) and reduces into output row
+    // run_ids[r].
+    std::vector<int64> rows(num_indices);
+    std::vector<T> row_weights(has_weights_ ? num_indices : 0);
+    std::vector<int64> run_starts;
+    std::vector<int32> run_ids;
+    for (int64 i = 0; i < num_indices; ++i) {
+      const int32 index = internal::SubtleMustCopy(indices_vec(i));
+      OP_REQUIRES(context, FastBoundsCheck(index, num_ids),
+                  errors::InvalidArgument("Bad: indices[", i, "] == ", index,
+                                          " out of range [0, ", num_ids, ")"));
+      rows[i] = id_rows[index];
+      if (has_weights_) {
+        row_weights[i] = weights[scalar_weight ? 0 : index];
+      }
+
+      const int32 segment_id = internal::SubtleMustCopy(segment_vec(i));
+      if (!run_ids.empty() && segment_id == run_ids.back()) continue;
+      OP_REQUIRES(context, run_ids.empty() || run_ids.back() < segment_id,
+                  errors::InvalidArgument("segment ids are not increasing"));
+      OP_REQUIRES(
+          context, FastBoundsCheck(segment_id, output_rows),
+          errors::InvalidArgument(
+              "Segment id ", segment_id, " out of range [0, ", output_rows,
+              "), possibly because 'segment_ids' input is not sorted."));
+      run_starts.push_back(i);
+      run_ids.push_back(segment_id);
+    }
+    const int64 num_runs = run_ids.size();
+    run_starts.push_back(num_indices);
+
+    // Runs are independent; each one also zeroes the empty segments before its
+    // output row, so every output row is written by exactly one shard.
+    const int64 row_bytes = num_col * sizeof(T);
+    auto work = [&](int64 begin, int64 end) {
+      const int64 prefetch_end = run_starts[end];
+      for (int64 r = begin; r < end; ++r) {
+        const int32 first_row = r == 0 ? 0 : run_ids[r - 1] + 1;
+        if (run_ids[r] > first_row) {
+          typename TTypes<T>::UnalignedVec gap(
+              &output_flat(first_row, 0), (run_ids[r] - first_row) * num_col);
+          gap.setZero();
+        }
+        typename TTypes<T>::UnalignedVec out(&output_flat(run_ids[r], 0),
+                                             num_col);
+        for (int64 i = run_starts[r]; i < run_starts[r + 1]; ++i) {
+          if (i + kPrefetchDistance < prefetch_end) {
+            const char* next_row = reinterpret_cast<const char*>(
+                &params_flat(rows[i + kPrefetchDistance], 0));
+            for (int64 b = 0; b < row_bytes; b += 64) {
+              port::prefetch<port::PREFETCH_HINT_T0>(next_row + b);
+            }
+          }
+          typename TTypes<T>::UnalignedConstVec row(&params_flat(rows[i], 0),
+                                                    num_col);
+          if (i == run_starts[r]) {
+            if (has_weights_) {
+              out = row * row_weights[i];
+            } else {
+              out = row;
+            }
+          } else {
+            if (has_weights_) {
+              out += row * row_weights[i];
+            } else {
+              out += row;
+            }
+          }
+        }
+        const int64 num = run_starts[r + 1] - run_starts[r];
+        if (is_mean_ && num > 1) {
+          out = out / static_cast<T>(num);
+        }
+        if (is_sqrtn_ && num > 1) {
+          out = out / static_cast<T>(std::sqrt(num));
+        }
+      }
+    };
+    const int64 cost_per_run = (num_indices / num_runs + 1) * row_bytes;
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_runs,
+          cost_per_run, work);
+  }
+
+ private:
+  // Number of positions to look ahead when prefetching params rows.
+  static constexpr int64 kPrefetchDistance = 8;
+
+  bool has_weights_;
+  bool is_mean_;
+  bool is_sqrtn_;
+};
+
+#define REGISTER_CPU_KERNELS(T, Tids)                            \
+  REGISTER_KERNEL_BUILDER(Name("_FusedEmbeddingLookupSparse")    \
+                              .Device(DEVICE_CPU)                \
+                              .TypeConstraint<T>("T")            \
+                              .TypeConstraint<Tids>("Tids"),     \
+                          FusedEmbeddingLookupSparseOp<T, Tids>);
+#define REGISTER_CPU_KERNELS_ALL(T) \
+  REGISTER_CPU_KERNELS(T, int32);   \
+  REGISTER_CPU_KERNELS(T, int64);
+
+TF_CALL_float(REGISTER_CPU_KERNELS_ALL);
+TF_CALL_double(REGISTER_CPU_KERNELS_ALL);
+
+#undef REGISTER_CPU_KERNELS_ALL
+#undef REGISTER_CPU_KERNELS
+
+}  // namespace tensorflow
@@ -31,6 +31,7 @@ limitations under the License.
 #include "tensorflow/core/graph/testlib.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/public/session_options.h"
@@ -113,7 +114,63 @@ BM_Reduce_Arg(64, 32, 2);
 BM_Reduce_Arg(4096, 32, 2);
 BM_Reduce_Arg(4096, 128, 2);
 
-static void SparseSegmentMeanGradHelper(int iters, float uniqueness, int size) {
+static void SparseSegmentReductionHelper(int iters, const string& op,
+                                         int num_segments, int segment_size,
+                                         int num_cols, int num_threads) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+
+  // An embedding table gathered by `num_segments` bags of `segment_size`
+  // pseudo-random rows each.
+  const int kTableRows = 1 << 16;
+  const int kNumIndices = num_segments * segment_size;
+  Tensor input(DT_FLOAT, TensorShape({kTableRows, num_cols}));
+  input.flat<float>().setRandom();
+  Tensor indices(DT_INT32, TensorShape({kNumIndices}));
+  auto indices_flat = indices.flat<int32>();
+  Tensor segments(DT_INT32, TensorShape({kNumIndices}));
+  auto segments_flat = segments.flat<int32>();
+  for (int i = 0; i < kNumIndices; ++i) {
+    indices_flat(i) = (static_cast<int64>(i) * 7919) % kTableRows;
+    segments_flat(i) = i / segment_size;
+  }
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), op)
+                  .Input(test::graph::Constant(g, input))
+                  .Input(test::graph::Constant(g, indices))
+                  .Input(test::graph::Constant(g, segments))
+                  .Attr("T", DT_FLOAT)
+                  .Finalize(g, &node));
+
+  SessionOptions opts;
+  opts.config.set_intra_op_parallelism_threads(num_threads);
+  testing::UseRealTime();
+  testing::BytesProcessed(static_cast<int64>(iters) * kNumIndices * num_cols *
+                          sizeof(float));
+  testing::StartTiming();
+  test::Benchmark("cpu", g, &opts).Run(iters);
+}
+
+#define BM_SparseSegmentReduction(OP, SEGMENTS, SIZE, COLS)                  \
+  static void BM_##OP##_##SEGMENTS##_##SIZE##_##COLS(int iters,              \
+                                                     int num_threads) {      \
+    SparseSegmentReductionHelper(iters, #OP, SEGMENTS, SIZE, COLS,           \
+                                 num_threads);                               \
+  }                                                                          \
+  BENCHMARK(BM_##OP##_##SEGMENTS##_##SIZE##_##COLS)->Arg(1)->Arg(4)->Arg(16);
+
+#define BM_SparseSegmentReduction_Arg(SEGMENTS, SIZE, COLS)          \
+  BM_SparseSegmentReduction(SparseSegmentSum, SEGMENTS, SIZE, COLS);  \
+  BM_SparseSegmentReduction(SparseSegmentMean, SEGMENTS, SIZE, COLS); \
+  BM_SparseSegmentReduction(SparseSegmentSqrtN, SEGMENTS, SIZE, COLS);
+
+BM_SparseSegmentReduction_Arg(1000, 16, 64);
+BM_SparseSegmentReduction_Arg(100000, 16, 64);
+BM_SparseSegmentReduction_Arg(100000, 4, 256);
+
+static void SparseSegmentMeanGradHelper(int iters, float uniqueness, int size,
+                                        int num_threads = 0) {
   testing::StopTiming();
   Graph* g = new Graph(OpRegistry::Global());
   CHECK_LE(uniqueness, 1.0);
@@ -148,11 +205,13 @@ static void SparseSegmentMeanGradHelper(int iters, float uniqueness, int size) {
                   .Attr("T", DT_FLOAT)
                   .Finalize(g, &node));
 
+  SessionOptions opts;
+  opts.config.set_intra_op_parallelism_threads(num_threads);
   testing::UseRealTime();
   testing::BytesProcessed(static_cast<int64>(iters) * (kDim1 * kDim2) *
                           sizeof(float));
   testing::StartTiming();
-  test::Benchmark("cpu", g).Run(iters);
+  test::Benchmark("cpu", g, &opts).Run(iters);
 }
 
 static void BM_SparseSegmentMeanGrad_Low(int iters, int size) {
@@ -166,4 +225,141 @@ static void BM_SparseSegmentMeanGrad_High(int iters, int size) {
 BENCHMARK(BM_SparseSegmentMeanGrad_Low)->Arg(1000)->Arg(100000);
 BENCHMARK(BM_SparseSegmentMeanGrad_High)->Arg(1000)->Arg(100000);
 
+static void BM_SparseSegmentMeanGrad_Threads(int iters, int size,
+                                             int num_threads) {
+  return SparseSegmentMeanGradHelper(iters, 0.5, size, num_threads);
+}
+
+BENCHMARK(BM_SparseSegmentMeanGrad_Threads)
+    ->ArgPair(100000, 1)
+    ->ArgPair(100000, 4)
+    ->ArgPair(100000, 16);
+
+class FusedEmbeddingLookupSparseOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(int num_weights, const string& combiner) {
+    TF_ASSERT_OK(NodeDefBuilder("fused", "_FusedEmbeddingLookupSparse")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT64))
+                     .Input(FakeInput(DT_INT32))
+                     .Input(FakeInput(DT_INT32))
+                     .Input(FakeInput(num_weights, DT_FLOAT))
+                     .Attr("combiner", combiner)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(FusedEmbeddingLookupSparseOpTest, WeightedMean) {
+  MakeOp(1, "mean");
+  // params
+  AddInputFromArray<float>(TensorShape({4, 2}), {0, 1, 10, 11, 20, 21, 30, 31});
+  // ids, indices and segment_ids; segment 1 is empty.
+  AddInputFromArray<int64>(TensorShape({3}), {3, 1, 2});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 1, 2, 2});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 0, 2, 3});
+  // weights
+  AddInputFromArray<float>(TensorShape({3, 1}), {1, 2, 0.5});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({4, 2}));
+  test::FillValues<float>(&expected, {25, 26.5, 0, 0, 10, 10.5, 10, 10.5});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-6);
+}
+
+TEST_F(FusedEmbeddingLookupSparseOpTest, UnweightedSqrtN) {
+  MakeOp(0, "sqrtn");
+  AddInputFromArray<float>(TensorShape({3, 1}), {1, 2, 4});
+  AddInputFromArray<int64>(TensorShape({4}), {0, 1, 2, 2});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 1, 2, 3});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 0, 0, 0});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({1, 1}));
+  test::FillValues<float>(&expected, {11.0f / 2});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-6);
+}
+
+TEST_F(FusedEmbeddingLookupSparseOpTest, IdsOutOfRange) {
+  MakeOp(0, "sum");
+  AddInputFromArray<float>(TensorShape({2, 1}), {1, 2});
+  AddInputFromArray<int64>(TensorShape({2}), {0, 2});
+  AddInputFromArray<int32>(TensorShape({1}), {0});
+  AddInputFromArray<int32>(TensorShape({1}), {0});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(
+      str_util::StrContains(s.ToString(), "indices[1] = 2 is not in [0, 2)"))
+      << s;
+}
+
+// Embedding bags: `num_segments` bags of `segment_size` weighted rows of a
+// [kTableRows, num_cols] table, as GatherV2 + Mul + SparseSegmentSum or as the
+// fused op the remapper rewrites them into. The unfused graph additionally
+// writes and re-reads two [num_ids, num_cols] intermediates.
+static void EmbeddingLookupSparseHelper(int iters, bool fused, int num_segments,
+                                        int segment_size, int num_cols) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+
+  const int kTableRows = 1 << 16;
+  const int kNumIds = num_segments * segment_size;
+  Tensor params(DT_FLOAT, TensorShape({kTableRows, num_cols}));
+  params.flat<float>().setRandom();
+  Tensor ids(DT_INT64, TensorShape({kNumIds}));
+  Tensor weights(DT_FLOAT, TensorShape({kNumIds, 1}));
+  weights.flat<float>().setRandom();
+  Tensor indices(DT_INT32, TensorShape({kNumIds}));
+  Tensor segments(DT_INT32, TensorShape({kNumIds}));
+  for (int i = 0; i < kNumIds; ++i) {
+    ids.flat<int64>()(i) = (static_cast<int64>(i) * 7919) % kTableRows;
+    indices.flat<int32>()(i) = i;
+    segments.flat<int32>()(i) = i / segment_size;
+  }
+
+  Node* params_node = test::graph::Constant(g, params);
+  Node* ids_node = test::graph::Constant(g, ids);
+  Node* weights_node = test::graph::Constant(g, weights);
+  Node* indices_node = test::graph::Constant(g, indices);
+  Node* segments_node = test::graph::Constant(g, segments);
+  Node* node;
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "_FusedEmbeddingLookupSparse")
+                    .Input(params_node)
+                    .Input(ids_node)
+                    .Input(indices_node)
+                    .Input(segments_node)
+                    .Input({NodeBuilder::NodeOut(weights_node)})
+                    .Attr("combiner", "sum")
+                    .Finalize(g, &node));
+  } else {
+    Node* gather = test::graph::Gather(g, params_node, ids_node,
+                                       test::graph::Constant(g, Tensor(0)));
+    Node* mul = test::graph::Binary(g, "Mul", gather, weights_node);
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "SparseSegmentSum")
+                    .Input(mul)
+                    .Input(indices_node)
+                    .Input(segments_node)
+                    .Finalize(g, &node));
+  }
+
+  testing::UseRealTime();
+  testing::BytesProcessed(static_cast<int64>(iters) * kNumIds * num_cols *
+                          sizeof(float));
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+#define BM_EmbeddingLookupSparse(SEGMENTS, SIZE, COLS)                       \
+  static void BM_EmbeddingLookupSparse_##SEGMENTS##_##SIZE##_##COLS(         \
+      int iters, int fused) {                                                \
+    EmbeddingLookupSparseHelper(iters, fused, SEGMENTS, SIZE, COLS);         \
+  }                                                                          \
+  BENCHMARK(BM_EmbeddingLookupSparse_##SEGMENTS##_##SIZE##_##COLS)           \
+      ->Arg(0)                                                               \
+      ->Arg(1);
+
+BM_EmbeddingLookupSparse(1000, 16, 64);
+BM_EmbeddingLookupSparse(20000, 16, 64);
+BM_EmbeddingLookupSparse(1000, 64, 256);
+
 }  // namespace tensorflow
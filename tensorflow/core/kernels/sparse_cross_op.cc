@@ -26,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/string_hash_util.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/fingerprint.h"
@@ -310,17 +311,31 @@ class SparseCrossOp : public OpKernel {
 
     ValidateInput(context, indices_list_in, values_list_in, shapes_list_in,
                   dense_list_in);
+    if (!context->status().ok()) return;
 
+    std::vector<Tensor> values_list;
+    for (int i = 0; i < values_list_in.size(); ++i) {
+      values_list.push_back(values_list_in[i]);
+    }
+    std::vector<Tensor> dense_list;
+    for (int i = 0; i < dense_list_in.size(); ++i) {
+      dense_list.push_back(dense_list_in[i]);
+    }
+    if (HASHED_OUTPUT) {
+      OP_REQUIRES_OK(context, FingerprintStrings(context, &values_list));
+      OP_REQUIRES_OK(context, FingerprintStrings(context, &dense_list));
+    }
+
+    const int64 batch_size = CalculateBatchSize(shapes_list_in, dense_list_in);
     std::vector<std::unique_ptr<ColumnInterface<InternalType>>> columns =
-        GenerateColumnsFromInput(indices_list_in, values_list_in,
-                                 shapes_list_in, dense_list_in);
+        GenerateColumnsFromInput(indices_list_in, values_list, dense_list,
+                                 batch_size);
 
     typename CrossTraits<HASHED_OUTPUT, InternalType>::Crosser crosser(
         columns, num_buckets_, hash_key_);
     Tensor* indices_out;
     Tensor* values_out;
     Tensor* shape_out;
-    const int64 batch_size = CalculateBatchSize(shapes_list_in, dense_list_in);
     std::vector<int64> output_start_indices(batch_size);
     CreateOutputTensors(columns, batch_size, context, &indices_out, &values_out,
                         &shape_out, &output_start_indices);
@@ -441,15 +456,36 @@ class SparseCrossOp : public OpKernel {
     return 0;
   }
 
+  // Replaces every string tensor in `tensors` with an int64 tensor of the
+  // same shape holding the Fingerprint64 of each element. The hashed crosser
+  // would otherwise fingerprint a feature once for every cross it is part of.
+  Status FingerprintStrings(OpKernelContext* context,
+                            std::vector<Tensor>* tensors) {
+    for (Tensor& tensor : *tensors) {
+      if (tensor.dtype() != DT_STRING) continue;
+      Tensor fingerprints;
+      TF_RETURN_IF_ERROR(
+          context->allocate_temp(DT_INT64, tensor.shape(), &fingerprints));
+      auto fingerprints_flat = fingerprints.flat<int64>();
+      ParallelHashStrings(
+          context, tensor.flat<string>().data(), tensor.NumElements(),
+          [](const string& s) { return Fingerprint64(s); },
+          [&fingerprints_flat](int64 i, uint64 fingerprint) {
+            fingerprints_flat(i) = fingerprint;
+          });
+      tensor = fingerprints;
+    }
+    return Status::OK();
+  }
+
   // Generate the columns given the sparse and dense inputs.
   std::vector<std::unique_ptr<ColumnInterface<InternalType>>>
   GenerateColumnsFromInput(const OpInputList& indices_list_in,
-                           const OpInputList& values_list_in,
-                           const OpInputList& shapes_list_in,
-                           const OpInputList& dense_list_in) {
+                           const std::vector<Tensor>& values_list_in,
+                           const std::vector<Tensor>& dense_list_in,
+                           int64 batch_size) {
     std::vector<std::unique_ptr<ColumnInterface<InternalType>>> columns;
-    const int64 batch_size = CalculateBatchSize(shapes_list_in, dense_list_in);
-    const int64 number_of_columns = shapes_list_in.size();
+    const int64 number_of_columns = values_list_in.size();
 
     std::vector<std::vector<int64>> feature_counts(number_of_columns,
                                                    std::vector<int64>());
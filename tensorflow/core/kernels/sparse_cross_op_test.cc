@@ -0,0 +1,137 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <limits>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr int64 kHashKey = 956888297470;
+
+// Returns a [batch_size, width] matrix of feature strings.
+Tensor DenseStrings(int64 batch_size, int64 width, const string& prefix) {
+  Tensor t(DT_STRING, TensorShape({batch_size, width}));
+  auto matrix = t.matrix<string>();
+  for (int64 b = 0; b < batch_size; ++b) {
+    for (int64 i = 0; i < width; ++i) {
+      matrix(b, i) = strings::StrCat(prefix, "_", (b * 7 + i * 13) % 101);
+    }
+  }
+  return t;
+}
+
+class SparseCrossOpTest : public OpsTestBase {};
+
+TEST_F(SparseCrossOpTest, HashedDenseStrings) {
+  TF_ASSERT_OK(NodeDefBuilder("op", "SparseCross")
+                   .Input(FakeInput(0, DT_INT64))
+                   .Input(FakeInput(DataTypeVector()))
+                   .Input(FakeInput(0, DT_INT64))
+                   .Input(FakeInput({DT_STRING, DT_STRING}))
+                   .Attr("N", 0)
+                   .Attr("hashed_output", true)
+                   .Attr("num_buckets", 0)
+                   .Attr("hash_key", kHashKey)
+                   .Attr("out_type", DT_INT64)
+                   .Attr("internal_type", DT_STRING)
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  const Tensor a = DenseStrings(5, 3, "a");
+  const Tensor b = DenseStrings(5, 4, "b");
+  AddInputFromArray<string>(
+      a.shape(),
+      gtl::ArraySlice<string>(a.flat<string>().data(), a.NumElements()));
+  AddInputFromArray<string>(
+      b.shape(),
+      gtl::ArraySlice<string>(b.flat<string>().data(), b.NumElements()));
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_INT64, TensorShape({5 * 3 * 4}));
+  auto expected_vec = expected.vec<int64>();
+  const auto a_matrix = a.matrix<string>();
+  const auto b_matrix = b.matrix<string>();
+  int64 n = 0;
+  for (int64 row = 0; row < 5; ++row) {
+    for (int64 i = 0; i < 3; ++i) {
+      for (int64 j = 0; j < 4; ++j) {
+        uint64 hash = kHashKey;
+        hash = FingerprintCat64(hash, Fingerprint64(a_matrix(row, i)));
+        hash = FingerprintCat64(hash, Fingerprint64(b_matrix(row, j)));
+        expected_vec(n++) = hash % std::numeric_limits<int64>::max();
+      }
+    }
+  }
+  test::ExpectTensorEqual<int64>(expected, *GetOutput(1));
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({5, 12}),
+                                 *GetOutput(2));
+}
+
+Graph* HashedSparseCrossGraph(const Tensor& a, const Tensor& b) {
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(NodeBuilder("cross", "SparseCross")
+                  .Input(std::vector<NodeBuilder::NodeOut>())
+                  .Input(std::vector<NodeBuilder::NodeOut>())
+                  .Input(std::vector<NodeBuilder::NodeOut>())
+                  .Input(std::vector<NodeBuilder::NodeOut>(
+                      {test::graph::Constant(g, a),
+                       test::graph::Constant(g, b)}))
+                  .Attr("N", 0)
+                  .Attr("sparse_types", DataTypeVector())
+                  .Attr("dense_types", DataTypeVector({DT_STRING, DT_STRING}))
+                  .Attr("hashed_output", true)
+                  .Attr("num_buckets", 1000003)
+                  .Attr("hash_key", kHashKey)
+                  .Attr("out_type", DT_INT64)
+                  .Attr("internal_type", DT_STRING)
+                  .Finalize(g, nullptr /* node */));
+  return g;
+}
+
+// Crosses two dense string columns of `width` features each, so that every
+// feature takes part in `width` crosses.
+void BM_SparseCrossHashed(int iters, int batch_size, int width) {
+  testing::StopTiming();
+  testing::ItemsProcessed(static_cast<int64>(iters) * batch_size * width *
+                          width);
+  testing::UseRealTime();
+  const Tensor a = DenseStrings(batch_size, width, "user_country");
+  const Tensor b = DenseStrings(batch_size, width, "item_category");
+  Graph* g = HashedSparseCrossGraph(a, b);
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+BENCHMARK(BM_SparseCrossHashed)
+    ->ArgPair(128, 1)
+    ->ArgPair(128, 8)
+    ->ArgPair(4096, 1)
+    ->ArgPair(4096, 8)
+    ->ArgPair(4096, 32);
+
+}  // namespace
+}  // namespace tensorflow
@@ -19,6 +19,10 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/sparse_tensor_dense_matmul_op.h"
 
+#include <algorithm>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -244,6 +248,10 @@ struct SparseTensorDenseMatMulFunctor<CPUDevice, T, Tindices, ADJ_A, ADJ_B> {
   // Vectorize certain operations above this size.
   static const std::size_t kNumVectorize = 32;
 
+  // Below this many multiply-adds (nnz * output columns) the single-threaded
+  // COO loop is faster than building CSR and sharding output rows.
+  static const int64 kMinParallelCost = 1 << 17;
+
   static Status Compute(const CPUDevice& d, typename TTypes<T>::Matrix out,
                         typename TTypes<Tindices>::ConstMatrix a_indices,
                         typename TTypes<T>::ConstVec a_values,
@@ -254,11 +262,13 @@ struct SparseTensorDenseMatMulFunctor<CPUDevice, T, Tindices, ADJ_A, ADJ_B> {
     const int lhs_index_a = ADJ_A ? 1 : 0;
     const int rhs_index_a = ADJ_A ? 0 : 1;
 
-    out.setZero();
+    if (d.numThreads() > 1 &&
+        static_cast<int64>(nnz) * static_cast<int64>(rhs_right) >=
+            kMinParallelCost) {
+      return ComputeRowPartitioned(d, out, a_indices, a_values, b);
+    }
 
-    // TODO(ebrevdo): After many failed experiments, can't find a multi-threaded
-    // approach that achieves the performance of the single threaded
-    // one.  Perhaps Eigen threadpool implementation is just too slow?
+    out.setZero();
 
     if (rhs_right < kNumVectorize) {
       // Disable vectorization if the RHS of output is too small
@@ -312,6 +322,112 @@ struct SparseTensorDenseMatMulFunctor<CPUDevice, T, Tindices, ADJ_A, ADJ_B> {
     }
     return Status::OK();
   }
+
+ private:
+  typedef Eigen::Matrix<T, 1, Eigen::Dynamic, Eigen::RowMajor> RowVector;
+
+  // Converts `a` to CSR, ordered by output row, and shards the output rows
+  // across the intra-op threadpool. Every output row is written by exactly one
+  // shard, so no synchronization is needed, and each nonzero becomes a
+  // contiguous, vectorized axpy of a row of (the adjoint of) `b` into a row of
+  // `out`.
+  static Status ComputeRowPartitioned(
+      const CPUDevice& d, typename TTypes<T>::Matrix out,
+      typename TTypes<Tindices>::ConstMatrix a_indices,
+      typename TTypes<T>::ConstVec a_values,
+      typename TTypes<T>::ConstMatrix b) {
+    const int64 nnz = a_values.size();
+    const int64 num_rows = out.dimension(0);
+    const int64 rhs_right = (ADJ_B ? b.dimension(0) : b.dimension(1));
+    const int64 lhs_right = (ADJ_B ? b.dimension(1) : b.dimension(0));
+    const int lhs_index_a = ADJ_A ? 1 : 0;
+    const int rhs_index_a = ADJ_A ? 0 : 1;
+
+    // Count the nonzeros of each output row, checking bounds as we go. The
+    // indices are copied once, so that later passes do not read them again.
+    std::vector<Tindices> coo_rows(nnz);
+    std::vector<Tindices> coo_cols(nnz);
+    std::vector<int64> row_start(num_rows + 1, 0);
+    for (int64 i = 0; i < nnz; ++i) {
+      const Tindices m = internal::SubtleMustCopy(a_indices(i, lhs_index_a));
+      const Tindices k = internal::SubtleMustCopy(a_indices(i, rhs_index_a));
+      if (!FastBoundsCheck(k, lhs_right)) {
+        return KOutOfBoundsError(k, i, rhs_index_a, lhs_right);
+      }
+      if (!FastBoundsCheck(m, num_rows)) {
+        return MOutOfBoundsError(m, i, lhs_index_a, num_rows);
+      }
+      coo_rows[i] = m;
+      coo_cols[i] = k;
+      ++row_start[m + 1];
+    }
+    for (int64 m = 0; m < num_rows; ++m) {
+      row_start[m + 1] += row_start[m];
+    }
+
+    // Scatter the (column, value) pairs into CSR order. Nonzeros keep their
+    // relative order within a row, so results match the COO loop exactly.
+    std::vector<Tindices> cols(nnz);
+    std::vector<T> vals(nnz);
+    {
+      std::vector<int64> next(row_start.begin(), row_start.end() - 1);
+      for (int64 i = 0; i < nnz; ++i) {
+        const int64 pos = next[coo_rows[i]]++;
+        cols[pos] = coo_cols[i];
+        vals[pos] = ADJ_A ? MaybeConj(a_values(i)) : a_values(i);
+      }
+    }
+
+    // Rows of the right-hand side as they are consumed: b itself, or its
+    // adjoint materialized once in row-major order.
+    Eigen::Tensor<T, 2, Eigen::RowMajor, Eigen::DenseIndex> b_adjoint;
+    const T* b_rows = b.data();
+    if (ADJ_B) {
+      Eigen::array<int, 2> shuffle(1, 0);
+      b_adjoint.resize(lhs_right, rhs_right);
+      b_adjoint.device(d) = b.shuffle(shuffle).conjugate();
+      b_rows = b_adjoint.data();
+    }
+
+    // Split the rows into shards of roughly equal (nonzeros + rows), so that
+    // skewed rows do not leave threads idle.
+    const int64 num_shards =
+        std::min<int64>(num_rows, std::max(1, d.numThreads() * 4));
+    const int64 total_work = nnz + num_rows;
+    std::vector<int64> shard_start(num_shards + 1, num_rows);
+    shard_start[0] = 0;
+    {
+      int64 m = 0;
+      for (int64 s = 1; s < num_shards; ++s) {
+        const int64 target = total_work * s / num_shards;
+        while (m < num_rows && row_start[m] + m < target) ++m;
+        shard_start[s] = m;
+      }
+    }
+
+    T* out_data = out.data();
+    auto compute_shard = [&](int64 shard_begin, int64 shard_end) {
+      for (int64 m = shard_start[shard_begin]; m < shard_start[shard_end];
+           ++m) {
+        Eigen::Map<RowVector> out_row(out_data + m * rhs_right, rhs_right);
+        out_row.setZero();
+        for (int64 j = row_start[m]; j < row_start[m + 1]; ++j) {
+          Eigen::Map<const RowVector> b_row(
+              b_rows + static_cast<int64>(cols[j]) * rhs_right, rhs_right);
+          out_row.noalias() += vals[j] * b_row;
+        }
+      }
+    };
+    const double shard_nnz = static_cast<double>(total_work) / num_shards;
+    const Eigen::TensorOpCost cost(
+        shard_nnz * rhs_right * sizeof(T) /* bytes loaded */,
+        shard_nnz * rhs_right * sizeof(T) /* bytes stored */,
+        shard_nnz * rhs_right *
+            (Eigen::TensorOpCost::AddCost<T>() +
+             Eigen::TensorOpCost::MulCost<T>()) /* compute cycles */);
+    d.parallelFor(num_shards, cost, compute_shard);
+    return Status::OK();
+  }
 };
 
 }  // namespace functor
@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
 
 namespace tensorflow {
 
@@ -117,4 +118,37 @@ BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, false, true);
 BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, true, false);
 BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, true, true);
 
+// CPU with a fixed intra-op pool size, to compare the single-threaded path
+// with row-sharded execution across densities of a 4096 x 4096 sparse matrix.
+#define BM_SparseTensorDenseMatmulThreads(NNZ, M, K, N, TA, TB, THREADS)       \
+  static void                                                                  \
+      BM_SparseTensorDenseMatmul##_##NNZ##_##M##_##K##_##N##_##TA##_##TB##_##THREADS##_threads( \
+          int iters) {                                                         \
+    int64 items_per_iter = (static_cast<int64>(NNZ) * (TB ? K : N));           \
+    testing::ItemsProcessed(static_cast<int64>(iters) * items_per_iter);       \
+    testing::BytesProcessed(static_cast<int64>(iters) * items_per_iter *       \
+                            sizeof(float));                                    \
+    SessionOptions opts;                                                       \
+    opts.config.set_intra_op_parallelism_threads(THREADS);                     \
+    test::Benchmark("cpu", SparseTensorDenseMatmul(NNZ, M, K, N, TA, TB),      \
+                    &opts)                                                     \
+        .Run(iters);                                                           \
+  }                                                                            \
+  BENCHMARK(                                                                   \
+      BM_SparseTensorDenseMatmul##_##NNZ##_##M##_##K##_##N##_##TA##_##TB##_##THREADS##_threads);
+
+#define BM_SparseTensorDenseMatmulThreadSweep(NNZ, M, K, N, TA, TB)   \
+  BM_SparseTensorDenseMatmulThreads(NNZ, M, K, N, TA, TB, 1);         \
+  BM_SparseTensorDenseMatmulThreads(NNZ, M, K, N, TA, TB, 4);         \
+  BM_SparseTensorDenseMatmulThreads(NNZ, M, K, N, TA, TB, 16);
+
+// 0.1%, 1% and 10% dense.
+BM_SparseTensorDenseMatmulThreadSweep(16384, 4096, 4096, 128, false, false);
+BM_SparseTensorDenseMatmulThreadSweep(167772, 4096, 4096, 128, false, false);
+BM_SparseTensorDenseMatmulThreadSweep(1677721, 4096, 4096, 128, false, false);
+BM_SparseTensorDenseMatmulThreadSweep(167772, 4096, 4096, 16, false, false);
+BM_SparseTensorDenseMatmulThreadSweep(167772, 4096, 4096, 1024, false, false);
+BM_SparseTensorDenseMatmulThreadSweep(167772, 4096, 4096, 128, true, false);
+BM_SparseTensorDenseMatmulThreadSweep(167772, 4096, 4096, 128, false, true);
+
 }  // end namespace tensorflow
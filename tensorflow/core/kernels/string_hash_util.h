@@ -0,0 +1,92 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_STRING_HASH_UTIL_H_
+#define TENSORFLOW_CORE_KERNELS_STRING_HASH_UTIL_H_
+
+#include <algorithm>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/platform/prefetch.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+// Number of strings hashed as one block by HashStrings.
+constexpr int64 kStringHashBlockSize = 16;
+
+// Rough cost, in cycles, of hashing one feature string. Feature strings are
+// short, so the cost is dominated by the per-string overhead rather than by
+// the string length.
+constexpr int64 kStringHashCost = 100;
+
+// Maps 64-bit hashes to buckets in [0, num_buckets). The result is the same
+// as `hash % num_buckets`, with the division replaced by a mask when
+// `num_buckets` is a power of two.
+class HashBucketer {
+ public:
+  explicit HashBucketer(uint64 num_buckets)
+      : num_buckets_(num_buckets),
+        mask_(num_buckets - 1),
+        is_power_of_two_((num_buckets & (num_buckets - 1)) == 0) {}
+
+  uint64 operator()(uint64 hash) const {
+    return is_power_of_two_ ? hash & mask_ : hash % num_buckets_;
+  }
+
+ private:
+  const uint64 num_buckets_;
+  const uint64 mask_;
+  const bool is_power_of_two_;
+};
+
+// Calls `output(i, hash(input[i]))` for every i in [begin, end).
+//
+// The strings are processed in blocks of kStringHashBlockSize. While a block
+// is hashed, the contents of the next block are prefetched, so the loads of
+// heap-allocated string bodies overlap with hashing instead of stalling on
+// each string in turn.
+template <typename HashFn, typename OutputFn>
+void HashStrings(const string* input, int64 begin, int64 end,
+                 const HashFn& hash, const OutputFn& output) {
+  for (int64 block = begin; block < end; block += kStringHashBlockSize) {
+    const int64 block_end = std::min(end, block + kStringHashBlockSize);
+    const int64 next_end = std::min(end, block_end + kStringHashBlockSize);
+    for (int64 i = block_end; i < next_end; ++i) {
+      port::prefetch<port::PREFETCH_HINT_T0>(input[i].data());
+    }
+    for (int64 i = block; i < block_end; ++i) {
+      output(i, hash(input[i]));
+    }
+  }
+}
+
+// Like HashStrings, but shards [0, num_strings) across the CPU worker threads
+// of `context`.
+template <typename HashFn, typename OutputFn>
+void ParallelHashStrings(OpKernelContext* context, const string* input,
+                         int64 num_strings, const HashFn& hash,
+                         const OutputFn& output) {
+  auto* worker_threads = context->device()->tensorflow_cpu_worker_threads();
+  Shard(worker_threads->num_threads, worker_threads->workers, num_strings,
+        kStringHashCost, [&](int64 begin, int64 end) {
+          HashStrings(input, begin, end, hash, output);
+        });
+}
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_STRING_HASH_UTIL_H_
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/string_to_hash_bucket_op.h"
 
+#include "tensorflow/core/kernels/string_hash_util.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/strong_hash.h"
@@ -41,15 +42,16 @@ class LegacyStringToHashBucketOp : public OpKernel {
                                             &output_tensor));
     auto output_flat = output_tensor->flat<int64>();
 
-    typedef decltype(input_flat.size()) Index;
-    for (Index i = 0; i < input_flat.size(); ++i) {
-      const uint64 input_hash = Hash64(input_flat(i));
-      const uint64 bucket_id = input_hash % num_buckets_;
-      // The number of buckets is always in the positive range of int64 so is
-      // the resulting bucket_id. Casting the bucket_id from uint64 to int64 is
-      // safe.
-      output_flat(i) = static_cast<int64>(bucket_id);
-    }
+    const HashBucketer bucketer(num_buckets_);
+    ParallelHashStrings(
+        context, input_flat.data(), input_flat.size(),
+        [](const string& s) { return Hash64(s); },
+        [&output_flat, &bucketer](int64 i, uint64 input_hash) {
+          // The number of buckets is always in the positive range of int64 so
+          // is the resulting bucket_id. Casting the bucket_id from uint64 to
+          // int64 is safe.
+          output_flat(i) = static_cast<int64>(bucketer(input_hash));
+        });
   }
 
  private:
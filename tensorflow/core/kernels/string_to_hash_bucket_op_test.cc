@@ -0,0 +1,175 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/strong_hash.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns `n` strings whose lengths follow the shape of typical categorical
+// features: mostly short ids and tokens, some longer phrases and a few long
+// values such as URLs.
+Tensor FeatureStrings(int64 n) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Tensor t(DT_STRING, TensorShape({n}));
+  auto flat = t.flat<string>();
+  for (int64 i = 0; i < n; ++i) {
+    const uint32 bucket = rnd.Uniform(100);
+    int length;
+    if (bucket < 70) {
+      length = 3 + rnd.Uniform(10);
+    } else if (bucket < 95) {
+      length = 13 + rnd.Uniform(28);
+    } else {
+      length = 41 + rnd.Uniform(160);
+    }
+    string& s = flat(i);
+    s.resize(length);
+    for (int j = 0; j < length; ++j) {
+      s[j] = 'a' + rnd.Uniform(26);
+    }
+  }
+  return t;
+}
+
+class StringToHashBucketOpTest : public OpsTestBase {
+ protected:
+  Status Init(const string& op, int64 num_buckets) {
+    NodeDefBuilder builder("op", op);
+    builder.Input(FakeInput(DT_STRING)).Attr("num_buckets", num_buckets);
+    if (op == "StringToHashBucketStrong") {
+      builder.Attr("key", std::vector<int64>({123, 456}));
+    }
+    TF_CHECK_OK(builder.Finalize(node_def()));
+    return InitOp();
+  }
+
+  template <typename HashFn>
+  void CheckBuckets(const string& op, int64 num_buckets, const HashFn& hash) {
+    TF_ASSERT_OK(Init(op, num_buckets));
+    const Tensor input = FeatureStrings(10000);
+    AddInputFromArray<string>(
+        input.shape(), gtl::ArraySlice<string>(input.flat<string>().data(),
+                                               input.NumElements()));
+    TF_ASSERT_OK(RunOpKernel());
+
+    Tensor expected(allocator(), DT_INT64, input.shape());
+    for (int64 i = 0; i < input.NumElements(); ++i) {
+      const uint64 input_hash = hash(input.flat<string>()(i));
+      expected.flat<int64>()(i) = input_hash % num_buckets;
+    }
+    test::ExpectTensorEqual<int64>(expected, *GetOutput(0));
+  }
+};
+
+TEST_F(StringToHashBucketOpTest, Fast) {
+  CheckBuckets("StringToHashBucketFast", 1000,
+               [](const string& s) { return Fingerprint64(s); });
+}
+
+TEST_F(StringToHashBucketOpTest, FastPowerOfTwoBuckets) {
+  CheckBuckets("StringToHashBucketFast", 1 << 20,
+               [](const string& s) { return Fingerprint64(s); });
+}
+
+TEST_F(StringToHashBucketOpTest, FastSingleBucket) {
+  CheckBuckets("StringToHashBucketFast", 1,
+               [](const string& s) { return Fingerprint64(s); });
+}
+
+TEST_F(StringToHashBucketOpTest, Strong) {
+  const uint64 key[2] = {123, 456};
+  CheckBuckets("StringToHashBucketStrong", 1 << 10,
+               [&key](const string& s) { return StrongKeyedHash(key, s); });
+}
+
+TEST_F(StringToHashBucketOpTest, Legacy) {
+  CheckBuckets("StringToHashBucket", 77,
+               [](const string& s) { return Hash64(s); });
+}
+
+TEST_F(StringToHashBucketOpTest, EmptyInput) {
+  TF_ASSERT_OK(Init("StringToHashBucketFast", 10));
+  AddInputFromArray<string>(TensorShape({0, 3}), {});
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_EQ(TensorShape({0, 3}), GetOutput(0)->shape());
+}
+
+Graph* StringToHashBucketGraph(const string& op, const Tensor& input,
+                               int64 num_buckets) {
+  Graph* g = new Graph(OpRegistry::Global());
+  NodeBuilder builder("hash", op);
+  builder.Input(test::graph::Constant(g, input))
+      .Attr("num_buckets", num_buckets);
+  if (op == "StringToHashBucketStrong") {
+    builder.Attr("key", std::vector<int64>({123, 456}));
+  }
+  TF_CHECK_OK(builder.Finalize(g, nullptr /* node */));
+  return g;
+}
+
+void StringToHashBucketBenchmark(int iters, const string& op, int64 n,
+                                 int64 num_buckets) {
+  testing::StopTiming();
+  testing::ItemsProcessed(static_cast<int64>(iters) * n);
+  testing::UseRealTime();
+  const Tensor input = FeatureStrings(n);
+  Graph* g = StringToHashBucketGraph(op, input, num_buckets);
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+void BM_StringToHashBucketFast(int iters, int n) {
+  StringToHashBucketBenchmark(iters, "StringToHashBucketFast", n, 1000003);
+}
+BENCHMARK(BM_StringToHashBucketFast)
+    ->Arg(256)
+    ->Arg(4096)
+    ->Arg(65536)
+    ->Arg(1 << 20);
+
+void BM_StringToHashBucketFastPowerOfTwo(int iters, int n) {
+  StringToHashBucketBenchmark(iters, "StringToHashBucketFast", n, 1 << 20);
+}
+BENCHMARK(BM_StringToHashBucketFastPowerOfTwo)->Arg(4096)->Arg(1 << 20);
+
+void BM_StringToHashBucketStrong(int iters, int n) {
+  StringToHashBucketBenchmark(iters, "StringToHashBucketStrong", n, 1000003);
+}
+BENCHMARK(BM_StringToHashBucketStrong)
+    ->Arg(256)
+    ->Arg(4096)
+    ->Arg(65536)
+    ->Arg(1 << 20);
+
+}  // namespace
+}  // namespace tensorflow
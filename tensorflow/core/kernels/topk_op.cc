@@ -99,6 +99,73 @@ class TopK : public OpKernel {
 
 namespace functor {
 
+// Number of columns compared at once against the current k-th largest value.
+constexpr int32 kTopKBlockSize = 16;
+
+// Minimum number of columns of a row searched by one shard when a row is split
+// across threads.
+constexpr int64 kTopKMinColsPerShard = 16384;
+
+// Returns true if any of the kTopKBlockSize values starting at `data` is
+// greater than `threshold`. The loop has no branches, so the compiler turns it
+// into a few vector compares.
+template <typename T>
+EIGEN_ALWAYS_INLINE bool AnyGreater(const T* data, const T threshold) {
+  bool any = false;
+  for (int32 i = 0; i < kTopKBlockSize; ++i) {
+    any |= data[i] > threshold;
+  }
+  return any;
+}
+
+// Pushes the columns [begin, end) of the row `input_data`, in increasing
+// order, into `filter`, which keeps the top k of them.
+//
+// Once k columns have been pushed, a later column can only enter the filter if
+// its value is greater than the current k-th largest value, since ties keep
+// the lower index. Blocks of columns with no such value are skipped with one
+// branch-free compare; for long rows and small k that is almost all of them.
+template <typename T, typename Filter>
+void PushTopKColumns(const T* input_data, int32 begin, int32 end, int k,
+                     Filter* filter) {
+  int32 c = begin;
+  for (const int32 fill_end = std::min(end, begin + k); c < fill_end; ++c) {
+    filter->push(c);
+  }
+  if (c == end) return;
+
+  T threshold = input_data[filter->peek_bottom()];
+  const auto push = [input_data, filter, &threshold](const int32 col) {
+    if (input_data[col] > threshold) {
+      filter->push(col);
+      threshold = input_data[filter->peek_bottom()];
+    }
+  };
+  for (; c + kTopKBlockSize <= end; c += kTopKBlockSize) {
+    if (!AnyGreater(input_data + c, threshold)) continue;
+    for (int32 i = c; i < c + kTopKBlockSize; ++i) push(i);
+  }
+  for (; c < end; ++c) push(c);
+}
+
+// Orders column indices of a row by decreasing value, and by increasing index
+// among equal values.
+template <typename T>
+struct StableTopKComparator {
+  explicit StableTopKComparator(const T* input_data)
+      : input_data(input_data) {}
+  bool operator()(const int32 a, const int32 b) const {
+    if (input_data[b] < input_data[a]) {
+      return true;
+    } else if (input_data[b] > input_data[a]) {
+      return false;
+    } else {
+      return a < b;
+    }
+  }
+  const T* input_data;
+};
+
 template <typename T>
 struct TopKFunctor<CPUDevice, T> {
   static EIGEN_ALWAYS_INLINE Status
@@ -134,6 +201,22 @@ struct TopKFunctor<CPUDevice, T> {
       return Status::OK();
     }
 
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+
+    // With fewer rows than threads, long rows are also split across threads:
+    // each shard finds the top k of its columns, and the top k of a row is
+    // then picked from the top k candidates of its shards.
+    const int64 shards_per_row =
+        k == num_cols
+            ? 1
+            : std::min<int64>(
+                  (worker_threads.num_threads + num_rows - 1) / num_rows,
+                  num_cols / std::max<int64>(kTopKMinColsPerShard, 4 * k));
+    if (shards_per_row > 1) {
+      return SplitRowsCompute(context, k, input, num_rows, num_cols,
+                              shards_per_row, values, indices);
+    }
+
     auto SortIndices = [&](int start_batch, int limit_batch) {
       for (int32 b = start_batch; b < limit_batch; ++b) {
         const T* input_data = &input(b, 0);
@@ -179,10 +262,8 @@ struct TopKFunctor<CPUDevice, T> {
         } else {
           // Use the TopN heap object to sort.
           gtl::TopN<int32, decltype(stable_comp)> filter(k, stable_comp);
-          filter.reserve(num_cols);
-          for (int32 c = 0; c < num_cols; ++c) {
-            filter.push(c);
-          }
+          filter.reserve(k + 1);
+          PushTopKColumns(input_data, 0, num_cols, k, &filter);
 
           int32 i = 0;
           if (sorted) {
@@ -219,12 +300,79 @@ struct TopKFunctor<CPUDevice, T> {
     const int64 final_cost = (total_cost >= static_cast<double>(kint64max))
                                  ? kint64max
                                  : static_cast<int64>(total_cost);
-    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
     Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
           final_cost, SortIndices);
 
     return Status::OK();
   }
+
+  // Computes the top k of each row with every row split into
+  // `shards_per_row` ranges of columns that are searched in parallel. The
+  // output is always sorted.
+  static Status SplitRowsCompute(
+      OpKernelContext* context, int k,
+      const typename TTypes<T, 2>::ConstTensor& input, const int64 num_rows,
+      const int64 num_cols, const int64 shards_per_row,
+      typename TTypes<T, 2>::Tensor values,
+      typename TTypes<int, 2>::Tensor indices) {
+    const int64 num_shards = num_rows * shards_per_row;
+    const int64 cols_per_shard =
+        (num_cols + shards_per_row - 1) / shards_per_row;
+
+    // Shard s holds its candidates in
+    // candidates[s * k, s * k + num_candidates[s]).
+    std::vector<int32> candidates(num_shards * k);
+    std::vector<int32> num_candidates(num_shards);
+    auto FindCandidates = [&](int64 start_shard, int64 limit_shard) {
+      for (int64 s = start_shard; s < limit_shard; ++s) {
+        const T* input_data = &input(s / shards_per_row, 0);
+        const int32 begin = (s % shards_per_row) * cols_per_shard;
+        const int32 end = std::min(num_cols, begin + cols_per_shard);
+        StableTopKComparator<T> stable_comp(input_data);
+        gtl::TopN<int32, StableTopKComparator<T>> filter(k, stable_comp);
+        filter.reserve(k + 1);
+        PushTopKColumns(input_data, begin, end, k, &filter);
+        int32* out = &candidates[s * k];
+        int32* out_end =
+            std::copy(filter.unsorted_begin(), filter.unsorted_end(), out);
+        num_candidates[s] = out_end - out;
+      }
+    };
+
+    auto MergeCandidates = [&](int64 start_batch, int64 limit_batch) {
+      std::vector<int32> merged;
+      for (int64 b = start_batch; b < limit_batch; ++b) {
+        merged.clear();
+        for (int64 s = b * shards_per_row; s < (b + 1) * shards_per_row; ++s) {
+          merged.insert(merged.end(), &candidates[s * k],
+                        &candidates[s * k] + num_candidates[s]);
+        }
+        const T* input_data = &input(b, 0);
+        std::partial_sort(merged.begin(), merged.begin() + k, merged.end(),
+                          StableTopKComparator<T>(input_data));
+        std::copy(merged.begin(), merged.begin() + k, &indices(b, 0));
+        std::transform(merged.begin(), merged.begin() + k, &values(b, 0),
+                       [input_data](const int32 loc) {
+                         return input_data[loc];
+                       });
+      }
+    };
+
+    const double cmp_cost = 3 * Eigen::TensorOpCost::AddCost<int32>() +
+                            Eigen::TensorOpCost::AddCost<T>();
+    const double log_k = Eigen::numext::log2(static_cast<float>(k + 1));
+    const int64 find_cost = static_cast<int64>(
+        cols_per_shard * Eigen::TensorOpCost::AddCost<T>() +
+        4 * cmp_cost * k * log_k);
+    const int64 merge_cost =
+        static_cast<int64>(cmp_cost * shards_per_row * k * log_k);
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, num_shards,
+          find_cost, FindCandidates);
+    Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
+          merge_cost, MergeCandidates);
+    return Status::OK();
+  }
 };
 
 }  // namespace functor
@@ -15,7 +15,9 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
 #include <complex>
+#include <type_traits>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/attr_value.pb.h"
@@ -65,12 +67,166 @@ void TransposeSimple(const CPUDevice& device, const Tensor& in,
   device.parallelFor(in.NumElements(), cost, std::move(transpose_fn));
 }
 
+// Transposes a square block of kSize x kSize elements in SIMD registers. The
+// elements are moved as floating point packets of the same width, which never
+// alters their bits.
+template <typename Scalar>
+struct TransposePacketBlock {
+  typedef typename Eigen::internal::packet_traits<Scalar>::type Packet;
+  static constexpr int kSize = Eigen::internal::unpacket_traits<Packet>::size;
+
+  static void Run(const void* in, int64 in_stride, void* out,
+                  int64 out_stride) {
+    const Scalar* src = static_cast<const Scalar*>(in);
+    Scalar* dst = static_cast<Scalar*>(out);
+    Eigen::internal::PacketBlock<Packet, kSize> block;
+    for (int i = 0; i < kSize; ++i) {
+      block.packet[i] = Eigen::internal::ploadu<Packet>(src + i * in_stride);
+    }
+    Eigen::internal::ptranspose(block);
+    for (int i = 0; i < kSize; ++i) {
+      Eigen::internal::pstoreu<Scalar>(dst + i * out_stride, block.packet[i]);
+    }
+  }
+};
+
+// Element types without a SIMD micro-kernel use scalar copies.
+template <typename T>
+struct TransposeMicroKernel {
+  static constexpr int kSize = 1;
+  static void Run(const T* in, int64 in_stride, T* out, int64 out_stride) {}
+};
+
+template <>
+struct TransposeMicroKernel<uint32> : TransposePacketBlock<float> {};
+
+template <>
+struct TransposeMicroKernel<uint64> : TransposePacketBlock<double> {};
+
+// Transposes the [rows, cols] block at `in` (row stride `in_stride`) into the
+// [cols, rows] block at `out` (row stride `out_stride`), using square SIMD
+// micro-tiles where the element type has them.
+template <typename T>
+void TransposeTile(const T* in, int64 in_stride, T* out, int64 out_stride,
+                   int64 rows, int64 cols) {
+  constexpr int kMicro = TransposeMicroKernel<T>::kSize;
+  int64 r = 0;
+  if (kMicro > 1) {
+    for (; r + kMicro <= rows; r += kMicro) {
+      int64 c = 0;
+      for (; c + kMicro <= cols; c += kMicro) {
+        TransposeMicroKernel<T>::Run(in + r * in_stride + c, in_stride,
+                                     out + c * out_stride + r, out_stride);
+      }
+      for (; c < cols; ++c) {
+        for (int64 i = r; i < r + kMicro; ++i) {
+          out[c * out_stride + i] = in[i * in_stride + c];
+        }
+      }
+    }
+  }
+  for (int64 c = 0; c < cols; ++c) {
+    for (int64 i = r; i < rows; ++i) {
+      out[c * out_stride + i] = in[i * in_stride + c];
+    }
+  }
+}
+
+// TransposeUsingTile handles the permutations that, after merging dimensions
+// which stay adjacent, swap two dimensions of a tensor viewed as
+// [batch, rows, cols, inner]. This covers 2-D transposes, NCHW <-> NHWC (and
+// their 3-D and 5-D variants) and [B, S, H, D] -> [B, H, S, D]. The
+// [rows, cols] plane is split into cache-sized tiles that are transposed in
+// parallel. It returns false for permutations it does not handle.
+template <typename T, bool conjugate>
+struct TransposeUsingTile {
+  static bool run(const CPUDevice& d, const Tensor& in,
+                  const gtl::ArraySlice<int32> perm, Tensor* out) {
+    // Only plain 1, 2, 4 and 8 byte element moves are handled here.
+    if (conjugate || !std::is_unsigned<T>::value) return false;
+    if (in.NumElements() == 0) return true;
+
+    internal::TransposePermsVec new_perm;
+    internal::TransposeDimsVec new_dims;
+    internal::ReduceTransposeDimensions(in.shape(), perm, &new_perm,
+                                        &new_dims);
+    int64 batch = 1, rows, cols, inner = 1;
+    if (new_perm == internal::TransposePermsVec({1, 0})) {
+      rows = new_dims[0];
+      cols = new_dims[1];
+    } else if (new_perm == internal::TransposePermsVec({0, 2, 1})) {
+      batch = new_dims[0];
+      rows = new_dims[1];
+      cols = new_dims[2];
+    } else if (new_perm == internal::TransposePermsVec({1, 0, 2})) {
+      rows = new_dims[0];
+      cols = new_dims[1];
+      inner = new_dims[2];
+    } else if (new_perm == internal::TransposePermsVec({0, 2, 1, 3})) {
+      batch = new_dims[0];
+      rows = new_dims[1];
+      cols = new_dims[2];
+      inner = new_dims[3];
+    } else {
+      return false;
+    }
+
+    // Tiles of at most 16KB keep both the rows read and the rows written of a
+    // tile in L1. Rows of contiguous `inner` elements are moved as a unit.
+    const int64 element_bytes = inner * sizeof(T);
+    int64 tile_rows, tile_cols;
+    if (inner == 1) {
+      tile_rows = tile_cols = sizeof(T) >= 8 ? 32 : 64;
+    } else {
+      tile_rows = 8;
+      tile_cols = std::max<int64>(1, (16 << 10) / (tile_rows * element_bytes));
+    }
+    tile_rows = std::min(rows, tile_rows);
+    tile_cols = std::min(cols, tile_cols);
+    const int64 row_tiles = (rows + tile_rows - 1) / tile_rows;
+    const int64 col_tiles = (cols + tile_cols - 1) / tile_cols;
+    const int64 tiles_per_batch = row_tiles * col_tiles;
+
+    const T* p = reinterpret_cast<const T*>(in.tensor_data().data());
+    T* q = reinterpret_cast<T*>(const_cast<char*>(out->tensor_data().data()));
+    auto transpose_tiles = [=](int64 begin, int64 end) {
+      for (int64 tile = begin; tile < end; ++tile) {
+        const int64 b = tile / tiles_per_batch;
+        const int64 r0 = (tile % tiles_per_batch) / col_tiles * tile_rows;
+        const int64 c0 = (tile % col_tiles) * tile_cols;
+        const int64 r1 = std::min(rows, r0 + tile_rows);
+        const int64 c1 = std::min(cols, c0 + tile_cols);
+        const T* src = p + b * rows * cols * inner;
+        T* dst = q + b * rows * cols * inner;
+        if (inner == 1) {
+          TransposeTile(src + r0 * cols + c0, cols, dst + c0 * rows + r0, rows,
+                        r1 - r0, c1 - c0);
+        } else {
+          for (int64 c = c0; c < c1; ++c) {
+            for (int64 r = r0; r < r1; ++r) {
+              std::copy_n(src + (r * cols + c) * inner, inner,
+                          dst + (c * rows + r) * inner);
+            }
+          }
+        }
+      }
+    };
+    const int64 tile_bytes = tile_rows * tile_cols * element_bytes;
+    Eigen::TensorOpCost cost(/*bytes_loaded=*/tile_bytes,
+                             /*bytes_stored=*/tile_bytes,
+                             /*compute_cycles=*/tile_rows * tile_cols);
+    d.parallelFor(batch * tiles_per_batch, cost, std::move(transpose_tiles));
+    return true;
+  }
+};
+
 }  // namespace
 
 template <typename T, bool conjugate>
 struct Transpose<CPUDevice, T, conjugate> {
   static void run(const CPUDevice& d, const Tensor& in,
                   const gtl::ArraySlice<int32> perm, Tensor* out) {
+    if (TransposeUsingTile<T, conjugate>::run(d, in, perm, out)) return;
     switch (in.dims()) {
       case 2:
         internal::TransposeUsingEigen<CPUDevice, T, 2>(d, in, perm, conjugate,
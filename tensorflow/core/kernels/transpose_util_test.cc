@@ -13,10 +13,17 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#define EIGEN_USE_THREADS
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/kernels/transpose_functor.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 
@@ -130,4 +137,116 @@ TEST_F(TransposeUtilTest, NonSingletonDimensionAlignment) {
                                                      {0, 1, 2, 5, 4, 3}));
 }
 
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+template <typename T>
+Tensor Iota(const TensorShape& shape) {
+  Tensor t(DataTypeToEnum<T>::v(), shape);
+  auto flat = t.flat<T>();
+  for (int64 i = 0; i < flat.size(); ++i) flat(i) = static_cast<T>(i % 251);
+  return t;
+}
+
+TensorShape PermutedShape(const TensorShape& shape,
+                          const std::vector<int32>& perm) {
+  TensorShape out;
+  for (int32 d : perm) out.AddDim(shape.dim_size(d));
+  return out;
+}
+
+template <typename T, int NDIMS>
+void CheckTransposeMatchesEigen(const CPUDevice& device,
+                                const TensorShape& shape,
+                                const std::vector<int32>& perm) {
+  const Tensor in = Iota<T>(shape);
+  Tensor expected(in.dtype(), PermutedShape(shape, perm));
+  internal::TransposeUsingEigen<CPUDevice, T, NDIMS>(device, in, perm,
+                                                      /*conjugate=*/false,
+                                                      &expected);
+  Tensor out(in.dtype(), expected.shape());
+  TF_ASSERT_OK(DoTranspose(device, in, perm, &out));
+  test::ExpectTensorEqual<T>(expected, out);
+}
+
+template <typename T>
+void CheckTransposes(const CPUDevice& device) {
+  // Plain 2-D transposes, with and without partial micro-tiles.
+  CheckTransposeMatchesEigen<T, 2>(device, {64, 128}, {1, 0});
+  CheckTransposeMatchesEigen<T, 2>(device, {67, 131}, {1, 0});
+  CheckTransposeMatchesEigen<T, 2>(device, {1, 9}, {1, 0});
+  // Batched transposes: NCHW <-> NHWC in 3, 4 and 5 dimensions.
+  CheckTransposeMatchesEigen<T, 3>(device, {3, 17, 29}, {0, 2, 1});
+  CheckTransposeMatchesEigen<T, 4>(device, {2, 5, 7, 9}, {0, 2, 3, 1});
+  CheckTransposeMatchesEigen<T, 4>(device, {2, 9, 5, 7}, {0, 3, 1, 2});
+  CheckTransposeMatchesEigen<T, 5>(device, {2, 3, 4, 5, 6}, {0, 2, 3, 4, 1});
+  // Transposes that move contiguous rows: [B, S, H, D] -> [B, H, S, D].
+  CheckTransposeMatchesEigen<T, 3>(device, {13, 11, 5}, {1, 0, 2});
+  CheckTransposeMatchesEigen<T, 4>(device, {2, 7, 3, 5}, {0, 2, 1, 3});
+  CheckTransposeMatchesEigen<T, 4>(device, {2, 33, 4, 16}, {0, 2, 1, 3});
+  // Permutations that are not a swap of two dimensions use Eigen.
+  CheckTransposeMatchesEigen<T, 3>(device, {4, 5, 6}, {2, 1, 0});
+  CheckTransposeMatchesEigen<T, 4>(device, {2, 3, 4, 5}, {1, 3, 0, 2});
+}
+
+TEST(TransposeFunctorTest, MatchesEigenForAllElementSizes) {
+  thread::ThreadPool pool(Env::Default(), "transpose", 4);
+  CPUDevice device(pool.AsEigenThreadPool(), pool.NumThreads());
+  CheckTransposes<uint8>(device);
+  CheckTransposes<int16>(device);
+  CheckTransposes<float>(device);
+  CheckTransposes<int64>(device);
+}
+
+TEST(TransposeFunctorTest, EmptyTensor) {
+  thread::ThreadPool pool(Env::Default(), "transpose", 2);
+  CPUDevice device(pool.AsEigenThreadPool(), pool.NumThreads());
+  Tensor in(DT_FLOAT, TensorShape({0, 3}));
+  Tensor out(DT_FLOAT, TensorShape({3, 0}));
+  TF_EXPECT_OK(DoTranspose(device, in, {1, 0}, &out));
+}
+
+// Compares the tiled transpose used by DoTranspose (`use_tile` = 1) with the
+// generic Eigen shuffle (`use_tile` = 0).
+template <typename T, int NDIMS>
+void TransposeBenchmark(int iters, int use_tile, const TensorShape& shape,
+                        const std::vector<int32>& perm) {
+  testing::StopTiming();
+  thread::ThreadPool pool(Env::Default(), "transpose", 4);
+  CPUDevice device(pool.AsEigenThreadPool(), pool.NumThreads());
+  const Tensor in = Iota<T>(shape);
+  Tensor out(in.dtype(), PermutedShape(shape, perm));
+  testing::BytesProcessed(static_cast<int64>(iters) * 2 * in.TotalBytes());
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    if (use_tile) {
+      TF_CHECK_OK(DoTranspose(device, in, perm, &out));
+    } else {
+      internal::TransposeUsingEigen<CPUDevice, T, NDIMS>(
+          device, in, perm, /*conjugate=*/false, &out);
+    }
+  }
+}
+
+#define BM_TRANSPOSE_TYPE(NAME, T, NDIMS, SHAPE, PERM)                    \
+  static void BM_Transpose_##NAME##_##T(int iters, int use_tile) {        \
+    TransposeBenchmark<T, NDIMS>(iters, use_tile, TensorShape(SHAPE),      \
+                                 PERM);                                    \
+  }                                                                        \
+  BENCHMARK(BM_Transpose_##NAME##_##T)->Arg(0)->Arg(1);
+
+#define BM_TRANSPOSE(NAME, NDIMS, SHAPE, PERM)          \
+  BM_TRANSPOSE_TYPE(NAME, uint8, NDIMS, SHAPE, PERM)    \
+  BM_TRANSPOSE_TYPE(NAME, int16, NDIMS, SHAPE, PERM)    \
+  BM_TRANSPOSE_TYPE(NAME, float, NDIMS, SHAPE, PERM)    \
+  BM_TRANSPOSE_TYPE(NAME, int64, NDIMS, SHAPE, PERM)
+
+#define LIST(...) {__VA_ARGS__}
+BM_TRANSPOSE(2D, 2, LIST(2048, 2048), LIST(1, 0));
+BM_TRANSPOSE(NCHWToNHWC, 4, LIST(32, 64, 56, 56), LIST(0, 2, 3, 1));
+BM_TRANSPOSE(NHWCToNCHW, 4, LIST(32, 56, 56, 64), LIST(0, 3, 1, 2));
+BM_TRANSPOSE(BSHDToBHSD, 4, LIST(16, 128, 16, 64), LIST(0, 2, 1, 3));
+#undef LIST
+#undef BM_TRANSPOSE
+#undef BM_TRANSPOSE_TYPE
+
 }  // namespace tensorflow
@@ -13,9 +13,11 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <functional>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -23,12 +25,82 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/bits.h"
 #include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
 
+namespace {
+
+// Open-addressing (linear probing) hash set of distinct values of an array,
+// each identified by the position of its first occurrence. Ids are assigned
+// densely in insertion order. Like std::unordered_map, values are compared
+// with operator==, so every NaN is distinct.
+template <typename T>
+class FlatUniqueSet {
+ public:
+  explicit FlatUniqueSet(const T* values) : values_(values) {
+    Rehash(kInitialCapacity);
+  }
+
+  // Returns the id of `values[pos]`, whose hash is `hash`, first adding it
+  // with the next id if it is not in the set yet.
+  int32 FindOrInsert(int64 pos, uint64 hash) {
+    const T& value = values_[pos];
+    for (uint64 slot = Slot(hash);; slot = (slot + 1) & mask_) {
+      const int32 id = slots_[slot];
+      if (id < 0) {
+        const int32 new_id = static_cast<int32>(first_positions_.size());
+        slots_[slot] = new_id;
+        first_positions_.push_back(pos);
+        hashes_.push_back(hash);
+        if (2 * first_positions_.size() > slots_.size()) {
+          Rehash(2 * slots_.size());
+        }
+        return new_id;
+      }
+      if (hashes_[id] == hash && values_[first_positions_[id]] == value) {
+        return id;
+      }
+    }
+  }
+
+  int32 size() const { return static_cast<int32>(first_positions_.size()); }
+  int64 first_position(int32 id) const { return first_positions_[id]; }
+  uint64 hash(int32 id) const { return hashes_[id]; }
+
+ private:
+  static const int kInitialCapacity = 1 << 10;
+
+  // Fibonacci hashing, since std::hash is the identity for integers.
+  uint64 Slot(uint64 hash) const {
+    return (hash * 0x9E3779B97F4A7C15ULL) >> shift_;
+  }
+
+  void Rehash(size_t capacity) {
+    slots_.assign(capacity, -1);
+    mask_ = capacity - 1;
+    shift_ = 64 - Log2Floor64(capacity);
+    for (int32 id = 0; id < size(); ++id) {
+      uint64 slot = Slot(hashes_[id]);
+      while (slots_[slot] >= 0) slot = (slot + 1) & mask_;
+      slots_[slot] = id;
+    }
+  }
+
+  const T* values_;
+  std::vector<int32> slots_;  // Ids; -1 for empty slots.
+  std::vector<int64> first_positions_;
+  std::vector<uint64> hashes_;
+  uint64 mask_;
+  int shift_;
+};
+
+}  // namespace
+
 template <typename T, typename TIndex>
 class UniqueOp : public OpKernel {
  public:
@@ -98,93 +170,68 @@ class UniqueOp : public OpKernel {
                                 1, TensorShape({new_sizes[1]}), &idx));
     auto idx_vec = idx->template vec<TIndex>();
 
-    int64 uniq_size;
     if (new_sizes[0] == 1 && new_sizes[2] == 1) {
       // Specialized and faster implementation when unique is run over single
-      // elements. Here we put T directly into the map rather than ints pointing
-      // to them as in the general case.
-      auto Tin = input.flat<T>();
-      const int64 N = static_cast<int64>(Tin.size());
-
-      std::unordered_map<T, TIndex> uniq;
-      uniq.reserve(2 * N);
-      for (Eigen::Index i = 0, j = 0; i < N; ++i) {
-        auto it = uniq.insert(std::make_pair(Tin(i), j));
-        idx_vec(i) = it.first->second;
-        if (it.second) {
-          ++j;
-        }
-      }
+      // elements.
+      ComputeFlat(context, input, axis, idx_vec);
+      return;
+    }
 
-      uniq_size = static_cast<int64>(uniq.size());
-      TensorShape output_shape(input.shape());
-      output_shape.set_dim(axis, uniq_size);
-      Tensor* output = nullptr;
-      OP_REQUIRES_OK(context,
-                     context->allocate_output(0, output_shape, &output));
-      auto Tout = output->flat<T>();
+    // General implementation when unique is run over multiple elements.
+    auto Tin = input.shaped<T, 3>(new_sizes);
 
-      for (auto it : uniq) {
-        Tout(it.second) = it.first;
-      }
-    } else {
-      // General implementation when unique is run over multiple elements.
-      auto Tin = input.shaped<T, 3>(new_sizes);
-
-      auto hash_fn = [&Tin](const Eigen::Index& key) {
-        size_t h = 0;
-        for (Eigen::Index i = 0; i < Tin.dimension(0); i++) {
-          for (Eigen::Index j = 0; j < Tin.dimension(2); j++) {
-            h = Hash64Combine(h, hash<T>{}(Tin(i, key, j)));
-          }
+    auto hash_fn = [&Tin](const Eigen::Index& key) {
+      size_t h = 0;
+      for (Eigen::Index i = 0; i < Tin.dimension(0); i++) {
+        for (Eigen::Index j = 0; j < Tin.dimension(2); j++) {
+          h = Hash64Combine(h, hash<T>{}(Tin(i, key, j)));
         }
-        return h;
-      };
-
-      auto equal_to_fn = [&Tin](const Eigen::Index& lhs,
-                                const Eigen::Index& rhs) {
-        for (Eigen::Index i = 0; i < Tin.dimension(0); i++) {
-          for (Eigen::Index j = 0; j < Tin.dimension(2); j++) {
-            if (Tin(i, lhs, j) != Tin(i, rhs, j)) {
-              return false;
-            }
+      }
+      return h;
+    };
+
+    auto equal_to_fn = [&Tin](const Eigen::Index& lhs,
+                              const Eigen::Index& rhs) {
+      for (Eigen::Index i = 0; i < Tin.dimension(0); i++) {
+        for (Eigen::Index j = 0; j < Tin.dimension(2); j++) {
+          if (Tin(i, lhs, j) != Tin(i, rhs, j)) {
+            return false;
           }
         }
-        return true;
-      };
+      }
+      return true;
+    };
 
-      std::unordered_map<int64, int64, decltype(hash_fn), decltype(equal_to_fn)>
-          uniq(0, hash_fn, equal_to_fn);
+    std::unordered_map<int64, int64, decltype(hash_fn), decltype(equal_to_fn)>
+        uniq(0, hash_fn, equal_to_fn);
 
-      uniq.reserve(2 * Tin.dimension(1));
+    uniq.reserve(2 * Tin.dimension(1));
 
-      for (int64 i = 0, j = 0; i < Tin.dimension(1); ++i) {
-        auto it = uniq.insert(std::make_pair(i, j));
-        idx_vec(i) = it.first->second;
-        if (it.second) {
-          ++j;
-        }
+    for (int64 i = 0, j = 0; i < Tin.dimension(1); ++i) {
+      auto it = uniq.insert(std::make_pair(i, j));
+      idx_vec(i) = it.first->second;
+      if (it.second) {
+        ++j;
       }
+    }
 
-      uniq_size = static_cast<int64>(uniq.size());
-      new_sizes[1] = uniq_size;
-      TensorShape output_shape(input.shape());
-      output_shape.set_dim(axis, uniq_size);
-      Tensor* output = nullptr;
-      OP_REQUIRES_OK(context,
-                     context->allocate_output(0, output_shape, &output));
-      auto Tout = output->shaped<T, 3>(new_sizes);
-
-      for (auto it : uniq) {
-        Tout.chip(it.second, 1) = Tin.chip(it.first, 1);
-      }
+    const int64 uniq_size = static_cast<int64>(uniq.size());
+    new_sizes[1] = uniq_size;
+    TensorShape output_shape(input.shape());
+    output_shape.set_dim(axis, uniq_size);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
+    auto Tout = output->shaped<T, 3>(new_sizes);
+
+    for (auto it : uniq) {
+      Tout.chip(it.second, 1) = Tin.chip(it.first, 1);
     }
 
     if (num_outputs() > 2) {
-      Tensor* output = nullptr;
+      Tensor* count_output = nullptr;
       OP_REQUIRES_OK(context, context->allocate_output(
-                                  2, TensorShape({uniq_size}), &output));
-      auto count_output_vec = output->template vec<TIndex>();
+                                  2, TensorShape({uniq_size}), &count_output));
+      auto count_output_vec = count_output->template vec<TIndex>();
       count_output_vec.setZero();
       const int N = idx_vec.size();
       for (int64 i = 0; i < N; ++i) {
@@ -192,6 +239,133 @@ class UniqueOp : public OpKernel {
       }
     }
   }
+
+ private:
+  // Inputs with fewer elements are deduplicated on the calling thread.
+  static const int64 kMinParallelSize = 1 << 15;
+  // Minimum number of elements per shard of the parallel path.
+  static const int64 kMinShardSize = 1 << 13;
+
+  // Unique over the elements of a flat input, using open-addressing hash sets.
+  //
+  // Large inputs are split into contiguous shards that are deduplicated in
+  // parallel, each assigning local ids in order of first occurrence within the
+  // shard. The local sets are then merged in shard order, which assigns global
+  // ids in order of first occurrence in the whole input, exactly as the serial
+  // algorithm would. Finally the local ids in `idx` are remapped in parallel.
+  void ComputeFlat(OpKernelContext* context, const Tensor& input, int64 axis,
+                   typename TTypes<TIndex>::Vec idx_vec) {
+    const T* values = input.flat<T>().data();
+    const int64 N = input.NumElements();
+    const bool compute_counts = num_outputs() > 2;
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    int num_shards = 1;
+    if (N >= kMinParallelSize) {
+      num_shards = static_cast<int>(std::min<int64>(
+          worker_threads.num_threads, N / kMinShardSize));
+      num_shards = std::max(num_shards, 1);
+    }
+
+    // Phase 1: per-shard dedup. idx holds shard-local ids afterwards.
+    std::vector<FlatUniqueSet<T>> shard_sets;
+    shard_sets.reserve(num_shards);
+    for (int s = 0; s < num_shards; ++s) shard_sets.emplace_back(values);
+    std::vector<std::vector<int64>> shard_counts(num_shards);
+    auto shard_begin = [N, num_shards](int64 s) { return N * s / num_shards; };
+    auto dedup_shards = [&](int64 start, int64 limit) {
+      for (int64 s = start; s < limit; ++s) {
+        FlatUniqueSet<T>& set = shard_sets[s];
+        std::vector<int64>& counts = shard_counts[s];
+        for (int64 i = shard_begin(s), end = shard_begin(s + 1); i < end; ++i) {
+          const int32 id = set.FindOrInsert(i, hash<T>{}(values[i]));
+          idx_vec(i) = id;
+          if (compute_counts) {
+            if (id == static_cast<int32>(counts.size())) counts.push_back(0);
+            ++counts[id];
+          }
+        }
+      }
+    };
+    const int64 shard_cost = (N / num_shards) * 100;
+    if (num_shards == 1) {
+      dedup_shards(0, 1);
+    } else {
+      Shard(num_shards, worker_threads.workers, num_shards, shard_cost,
+            dedup_shards);
+    }
+
+    // Phase 2: merge the shard sets in order, so that global ids follow the
+    // first occurrence in the whole input.
+    const FlatUniqueSet<T>* uniq = &shard_sets[0];
+    FlatUniqueSet<T> merged(values);
+    std::vector<std::vector<int32>> remap(num_shards);
+    std::vector<int64> counts;
+    if (num_shards > 1) {
+      for (int s = 0; s < num_shards; ++s) {
+        const FlatUniqueSet<T>& set = shard_sets[s];
+        remap[s].resize(set.size());
+        for (int32 id = 0; id < set.size(); ++id) {
+          const int32 global_id =
+              merged.FindOrInsert(set.first_position(id), set.hash(id));
+          remap[s][id] = global_id;
+          if (compute_counts) {
+            if (global_id == static_cast<int32>(counts.size())) {
+              counts.push_back(0);
+            }
+            counts[global_id] += shard_counts[s][id];
+          }
+        }
+      }
+      uniq = &merged;
+    } else {
+      counts = std::move(shard_counts[0]);
+    }
+    const int64 uniq_size = uniq->size();
+
+    TensorShape output_shape(input.shape());
+    output_shape.set_dim(axis, uniq_size);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
+    auto Tout = output->flat<T>();
+    Tensor* count_output = nullptr;
+    if (compute_counts) {
+      OP_REQUIRES_OK(context, context->allocate_output(
+                                  2, TensorShape({uniq_size}), &count_output));
+    }
+
+    // Phase 3: remap the local ids and write the outputs.
+    auto remap_shards = [&](int64 start, int64 limit) {
+      for (int64 s = start; s < limit; ++s) {
+        const std::vector<int32>& shard_remap = remap[s];
+        for (int64 i = shard_begin(s), end = shard_begin(s + 1); i < end; ++i) {
+          idx_vec(i) = shard_remap[idx_vec(i)];
+        }
+      }
+    };
+    if (num_shards > 1) {
+      Shard(num_shards, worker_threads.workers, num_shards, shard_cost,
+            remap_shards);
+    }
+    auto write_outputs = [&](int64 start, int64 limit) {
+      for (int64 id = start; id < limit; ++id) {
+        Tout(id) = values[uniq->first_position(id)];
+      }
+      if (count_output != nullptr) {
+        auto count_output_vec = count_output->template vec<TIndex>();
+        for (int64 id = start; id < limit; ++id) {
+          count_output_vec(id) = static_cast<TIndex>(counts[id]);
+        }
+      }
+    };
+    if (num_shards > 1) {
+      Shard(num_shards, worker_threads.workers, uniq_size,
+            /*cost_per_unit=*/std::is_same<T, string>::value ? 100 : 5,
+            write_outputs);
+    } else {
+      write_outputs(0, uniq_size);
+    }
+  }
 };
 
 #define REGISTER_UNIQUE(type)                                    \
@@ -13,11 +13,18 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <functional>
+#include <limits>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
@@ -35,6 +42,64 @@ namespace {
 
 const int kMaxStrLen = 40;
 
+class UniqueWithCountsOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(DataType type) {
+    TF_ASSERT_OK(NodeDefBuilder("unique_with_counts", "UniqueWithCounts")
+                     .Input(FakeInput(type))
+                     .Attr("out_idx", DT_INT32)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+// Large enough to be split into shards that are deduplicated in parallel.
+TEST_F(UniqueWithCountsOpTest, ShardedMatchesFirstOccurrenceOrder) {
+  const int kSize = 200 * 1000;
+  std::vector<int64> values(kSize);
+  for (int i = 0; i < kSize; ++i) {
+    // Every 7th element is new, the rest mostly repeat earlier values.
+    values[i] = (i % 7 == 0) ? i : (i * 7919) % (i + 1);
+  }
+
+  std::vector<int64> expected_y;
+  std::vector<int32> expected_idx;
+  std::vector<int32> expected_count;
+  std::unordered_map<int64, int32> ids;
+  for (int64 value : values) {
+    auto it = ids.insert({value, static_cast<int32>(expected_y.size())});
+    if (it.second) {
+      expected_y.push_back(value);
+      expected_count.push_back(0);
+    }
+    expected_idx.push_back(it.first->second);
+    ++expected_count[it.first->second];
+  }
+
+  MakeOp(DT_INT64);
+  AddInputFromArray<int64>(TensorShape({kSize}), values);
+  TF_ASSERT_OK(RunOpKernel());
+  const int num_unique = static_cast<int>(expected_y.size());
+  test::ExpectTensorEqual<int64>(
+      *GetOutput(0), test::AsTensor<int64>(expected_y, {num_unique}));
+  test::ExpectTensorEqual<int32>(
+      *GetOutput(1), test::AsTensor<int32>(expected_idx, {kSize}));
+  test::ExpectTensorEqual<int32>(
+      *GetOutput(2), test::AsTensor<int32>(expected_count, {num_unique}));
+}
+
+TEST_F(UniqueWithCountsOpTest, NaNsAreDistinct) {
+  MakeOp(DT_FLOAT);
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  AddInputFromArray<float>(TensorShape({5}), {1, nan, 1, nan, 2});
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_EQ(4, GetOutput(0)->NumElements());
+  test::ExpectTensorEqual<int32>(*GetOutput(1),
+                                 test::AsTensor<int32>({0, 1, 0, 2, 3}));
+  test::ExpectTensorEqual<int32>(*GetOutput(2),
+                                 test::AsTensor<int32>({2, 1, 1, 1}));
+}
+
 TensorProto GetRandomInt32TensorProto(int dim, int max_int) {
   TensorProto tensor_proto;
   tensor_proto.set_dtype(DT_INT32);
@@ -189,5 +254,43 @@ BENCHMARK(BM_Unique_STRING)
     ->Arg(64 * 1024)
     ->Arg(256 * 1024);
 
+// `dim` int64 ids of which `dim / dup_ratio` are distinct, as in the
+// deduplication of embedding ids.
+static void BM_UniqueWithCounts_INT64(int iters, int dim, int dup_ratio) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+
+  Tensor input(DT_INT64, TensorShape({dim}));
+  const int num_distinct = std::max(dim / dup_ratio, 1);
+  auto input_flat = input.flat<int64>();
+  for (int i = 0; i < dim; ++i) {
+    input_flat(i) = (std::rand() % num_distinct) * 1000003LL;
+  }
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "UniqueWithCounts")
+                  .Input(test::graph::Constant(g, input))
+                  .Attr("T", DT_INT64)
+                  .Finalize(g, &node));
+
+  testing::BytesProcessed(static_cast<int64>(iters) * dim * sizeof(int64));
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+BENCHMARK(BM_UniqueWithCounts_INT64)
+    ->ArgPair(16 * 1024, 1)
+    ->ArgPair(16 * 1024, 10)
+    ->ArgPair(256 * 1024, 1)
+    ->ArgPair(256 * 1024, 2)
+    ->ArgPair(256 * 1024, 10)
+    ->ArgPair(256 * 1024, 100)
+    ->ArgPair(1024 * 1024, 1)
+    ->ArgPair(1024 * 1024, 2)
+    ->ArgPair(1024 * 1024, 10)
+    ->ArgPair(1024 * 1024, 100)
+    ->ArgPair(4 * 1024 * 1024, 10);
+
 }  // namespace
 }  // namespace tensorflow
@@ -896,28 +896,29 @@ Status CheckConfigDataType(DataType dtype) {
 }
 
 template <typename T>
-const SmallVector<T>& GetListFromBuffer(const SparseBuffer& buffer);
+SmallVector<T>* GetListFromBuffer(SparseBuffer* buffer);
 
 template <>
-const SmallVector<int64>& GetListFromBuffer<int64>(const SparseBuffer& buffer) {
-  return buffer.int64_list;
+SmallVector<int64>* GetListFromBuffer<int64>(SparseBuffer* buffer) {
+  return &buffer->int64_list;
 }
 template <>
-const SmallVector<float>& GetListFromBuffer<float>(const SparseBuffer& buffer) {
-  return buffer.float_list;
+SmallVector<float>* GetListFromBuffer<float>(SparseBuffer* buffer) {
+  return &buffer->float_list;
 }
 template <>
-const SmallVector<string>& GetListFromBuffer<string>(
-    const SparseBuffer& buffer) {
-  return buffer.bytes_list;
+SmallVector<string>* GetListFromBuffer<string>(SparseBuffer* buffer) {
+  return &buffer->bytes_list;
 }
 
+// Strings are moved out of the source block rather than copied, so each
+// parsed bytes value is allocated once. The source must not be used after.
 template <typename T>
-void CopyOrMoveBlock(const T* b, const T* e, T* t) {
+void CopyOrMoveBlock(T* b, T* e, T* t) {
   std::copy(b, e, t);
 }
 template <>
-void CopyOrMoveBlock(const string* b, const string* e, string* t) {
+void CopyOrMoveBlock(string* b, string* e, string* t) {
   std::move(b, e, t);
 }
 
@@ -925,7 +926,7 @@ template <typename T>
 void FillAndCopyVarLen(
     const int d, const size_t num_elements,
     const size_t num_elements_per_minibatch, const Config& config,
-    const std::vector<std::vector<SparseBuffer>>& varlen_dense_buffers,
+    std::vector<std::vector<SparseBuffer>>* varlen_dense_buffers,
     Tensor* values) {
   const Tensor& default_value = config.dense[d].default_value;
 
@@ -938,14 +939,14 @@ void FillAndCopyVarLen(
   auto data = values->flat<T>().data();
 
   // Iterate over minibatch elements
-  for (size_t i = 0; i < varlen_dense_buffers.size(); ++i) {
-    const SparseBuffer& buffer = varlen_dense_buffers[i][d];
+  for (size_t i = 0; i < varlen_dense_buffers->size(); ++i) {
+    SparseBuffer& buffer = (*varlen_dense_buffers)[i][d];
     // Number of examples being stored in this buffer
     const auto& end_indices = buffer.example_end_indices;
     const size_t examples_in_buffer = end_indices.size();
     // const size_t stride_size = config.dense[d].elements_per_stride;
 
-    const auto& list = GetListFromBuffer<T>(buffer);
+    SmallVector<T>& list = *GetListFromBuffer<T>(&buffer);
     auto list_ptr = list.begin();
 
     size_t elements_tally = 0;
@@ -1243,17 +1244,17 @@ Status FastParseExample(const Config& config,
     switch (config.dense[d].dtype) {
       case DT_INT64: {
         FillAndCopyVarLen<int64>(d, num_elements, num_elements_per_minibatch,
-                                 config, varlen_dense_buffers, &values);
+                                 config, &varlen_dense_buffers, &values);
         break;
       }
       case DT_FLOAT: {
         FillAndCopyVarLen<float>(d, num_elements, num_elements_per_minibatch,
-                                 config, varlen_dense_buffers, &values);
+                                 config, &varlen_dense_buffers, &values);
         break;
       }
       case DT_STRING: {
         FillAndCopyVarLen<string>(d, num_elements, num_elements_per_minibatch,
-                                  config, varlen_dense_buffers, &values);
+                                  config, &varlen_dense_buffers, &values);
         break;
       }
       default:
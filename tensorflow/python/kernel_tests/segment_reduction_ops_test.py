@@ -580,6 +580,95 @@ class SparseSegmentReductionOpTest(SparseSegmentReductionHelper):
         tf_ans = self.evaluate(s)
         self.assertAllClose(np.zeros([5, 4]), tf_ans)
 
+  def testManySegments(self):
+    # Enough segments, with holes between them, that the CPU kernels split
+    # the work across several shards.
+    np.random.seed(0)
+    shape = [1000, 32]
+    segment_sizes = np.random.randint(0, 6, 4000)
+    segment_indices = np.repeat(np.arange(4000), segment_sizes).astype(np.int32)
+    num_indices = len(segment_indices)
+    ops_list = [(np.add, None, math_ops.sparse_segment_sum),
+                (self._mean_cum_op, self._mean_reduce_op,
+                 math_ops.sparse_segment_mean),
+                (self._mean_cum_op, self._sqrt_n_reduce_op,
+                 math_ops.sparse_segment_sqrt_n)]
+    with self.cached_session(use_gpu=False):
+      tf_indices, np_indices, tf_x, np_x = self._sparse_input(
+          shape, num_indices, dtype=dtypes_lib.float64)
+      for np_op1, np_op2, tf_op in ops_list:
+        np_ans = self._sparseSegmentReduce(np_x, np_indices, segment_indices,
+                                           np_op1, np_op2)
+        s = tf_op(data=tf_x, indices=tf_indices, segment_ids=segment_indices)
+        self.assertAllClose(np_ans, self.evaluate(s))
+
+  def testSumOrderIsStable(self):
+    # The CPU kernels add the first n % 8 rows of a segment (8 or 9 if that is
+    # 0 or 1) one by one, and then the sums of groups of 8 rows, which changes
+    # float32 results in the last bits.
+    def reduce_segment(rows):
+      n = len(rows)
+      head = min(n % 8 + 8 if n % 8 < 2 else n % 8, n)
+      acc = rows[0].copy()
+      for row in rows[1:head]:
+        acc += row
+      for i in range(head, n, 8):
+        group = rows[i].copy()
+        for row in rows[i + 1:i + 8]:
+          group += row
+        acc += group
+      return acc
+
+    np.random.seed(0)
+    np_x = (np.random.randn(64, 16) *
+            np.exp(np.random.randn(64, 16) * 4)).astype(np.float32)
+    segment_sizes = np.arange(1, 26)
+    segment_indices = np.repeat(
+        np.arange(len(segment_sizes)), segment_sizes).astype(np.int32)
+    np_indices = np.random.randint(0, 64,
+                                   len(segment_indices)).astype(np.int32)
+    np_sum = np.stack([
+        reduce_segment(np_x[np_indices[segment_indices == i]])
+        for i in range(len(segment_sizes))
+    ])
+    np_mean = np.where(segment_sizes[:, None] > 1,
+                       np_sum / segment_sizes[:, None].astype(np.float32),
+                       np_sum)
+    with self.session(use_gpu=False):
+      self.assertAllEqual(
+          np_sum,
+          self.evaluate(
+              math_ops.sparse_segment_sum(
+                  data=np_x, indices=np_indices,
+                  segment_ids=segment_indices)))
+      self.assertAllEqual(
+          np_mean,
+          self.evaluate(
+              math_ops.sparse_segment_mean(
+                  data=np_x, indices=np_indices,
+                  segment_ids=segment_indices)))
+
+  def testManySegmentsGradient(self):
+    np.random.seed(0)
+    num_segments = 3000
+    output_dim0 = 500
+    segment_indices = np.sort(np.random.randint(0, num_segments,
+                                                8000)).astype(np.int32)
+    np_indices = np.random.randint(0, output_dim0, 8000).astype(np.int32)
+    counts = np.bincount(segment_indices, minlength=num_segments)
+    np_grad = np.random.rand(num_segments, 16)
+    for tf_op, scale in [
+        (math_ops.sparse_segment_mean_grad, 1.0 / np.maximum(counts, 1)),
+        (math_ops.sparse_segment_sqrt_n_grad,
+         1.0 / np.sqrt(np.maximum(counts, 1)))
+    ]:
+      np_ans = np.zeros([output_dim0, 16])
+      np.add.at(np_ans, np_indices,
+                np_grad[segment_indices] * scale[segment_indices, None])
+      with self.session(use_gpu=False):
+        s = tf_op(np_grad, np_indices, segment_indices, output_dim0)
+        self.assertAllClose(np_ans, self.evaluate(s))
+
   def testSegmentIdsGreaterThanZero(self):
     tf_x, np_x = self._input([10, 4], dtype=dtypes_lib.float32)
     ops_list = [(np.add, None, math_ops.sparse_segment_sum), (
@@ -631,6 +720,23 @@ class SparseSegmentReductionOpTest(SparseSegmentReductionHelper):
             r"indices\[3\] == 10 out of range \[0, 10\)"):
           self.evaluate(s)
 
+  @test_util.run_deprecated_v1
+  def testErrorsAreReportedInInputOrder(self):
+    tf_x, _ = self._input([10, 4], dtype=dtypes_lib.float32)
+    ops_list = [math_ops.sparse_segment_sum, math_ops.sparse_segment_mean]
+    tf_indices = [8, -1, 0, 9]
+    with self.session(use_gpu=False):
+      for tf_op in ops_list:
+        # The bad index is in a segment before the unsorted segment ids.
+        s = tf_op(data=tf_x, indices=tf_indices, segment_ids=[0, 0, 1, 0])
+        with self.assertRaisesOpError(
+            r"indices\[1\] == -1 out of range \[0, 10\)"):
+          self.evaluate(s)
+        # The unsorted segment ids come before the segment of the bad index.
+        s = tf_op(data=tf_x, indices=tf_indices, segment_ids=[0, 1, 0, 0])
+        with self.assertRaisesOpError("segment ids are not increasing"):
+          self.evaluate(s)
+
   @test_util.run_deprecated_v1
   def testSegmentsInvalid2(self):
     tf_x, _ = self._input([10, 4], dtype=dtypes_lib.float32)
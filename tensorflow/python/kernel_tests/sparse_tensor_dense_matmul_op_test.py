@@ -250,6 +250,22 @@ class SparseTensorDenseMatMulTest(test.TestCase):
             y = y.transpose() if adjoint_b else y
             self._testMatmul(x, y, adjoint_a, adjoint_b)
 
+  # Tests sizes large enough to use the row-sharded CPU kernel.
+  @test_util.run_deprecated_v1
+  def testRowPartitioned(self):
+    np.random.seed(127)  # Repeatable results
+    for np_dtype in [np.float32, np.float64]:
+      for adjoint_a in [True, False]:
+        for adjoint_b in [True, False]:
+          x = np.random.rand(300, 200).astype(np_dtype)
+          x[np.abs(x) < 0.5] = 0
+          # Leave a block of empty output rows so that shards are uneven.
+          x[:50] = 0
+          y = np.random.randn(200, 64).astype(np_dtype)
+          x = x.transpose() if adjoint_a else x
+          y = y.transpose() if adjoint_b else y
+          self._testMatmul(x, y, adjoint_a, adjoint_b)
+
 
 def _sparse_tensor_dense_vs_dense_matmul_benchmark_dense(x, y, adjoint_a,
                                                          adjoint_b):
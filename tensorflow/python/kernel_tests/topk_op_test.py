@@ -161,6 +161,32 @@ class TopKTest(test.TestCase):
       values = -np.sort(-inputs, axis=1)[:, :k]
       self._validateTopK(inputs, k, values, indices)
 
+  def _testLongRowTopK(self, dtype):
+    # Long enough rows that each row is split across threads.
+    b = 2
+    n = 200000
+    inputs = np.random.permutation(
+        np.linspace(0, 100, b * n, dtype=dtype)).reshape(b, n)
+    for k in [1, 7, 100]:
+      indices = np.argsort(-inputs, axis=1)[:, :k]
+      values = -np.sort(-inputs, axis=1)[:, :k]
+      self._validateTopK(inputs, k, values, indices)
+      self._validateTopK(inputs, k, values, indices, sorted=False)
+
+  def testLongRowTopK(self):
+    self._testLongRowTopK(np.float32)
+    self._testLongRowTopK(np.float64)
+
+  def testLongRowStableSort(self):
+    b = 1
+    n = 200000
+    for k in [5, 100]:
+      # Lots of repeated integers, so ties span the column shards.
+      inputs = np.random.randint(0, 20, size=(b, n)).astype(np.int32)
+      indices = np.argsort(-inputs, axis=1, kind="mergesort")[:, :k]
+      values = -np.sort(-inputs, axis=1)[:, :k]
+      self._validateTopK(inputs, k, values, indices)
+
   def testTopAll(self):
     inputs = [[0.1, 0.3, 0.2, 0.4], [0.1, 0.3, 0.3, 0.2]]
     self._validateTopK(inputs, 4, [[0.4, 0.3, 0.2, 0.1], [0.3, 0.3, 0.2, 0.1]],